@@ -4,10 +4,22 @@ set code=%cd%\src
 set glfw_include_path=%cd%\thirdparty\glfw-3.4\include
 set glew_include_path=%cd%\thirdparty\glew-2.1.0\include
 set thirdparty_include_path=%cd%\thirdparty
-set opts=-nologo /MDd -diagnostics:column -Zi -Fesidescroller.exe /I%glfw_include_path% /I%glew_include_path% /I%thirdparty_include_path% /EHsc -DDEBUG
+rem add -DBENCHMARK to opts to run the engine benchmarks instead of the game
+rem add -DFRAME_LATENCY=0 to opts to simulate and render in series (default lets the simulation run 1 frame ahead)
+rem run sidescroller.exe -headless -frames N [-input script.txt] to simulate without a window
+rem -record file and -replay file capture a session and play it back on a fixed step
+rem -trace file writes the last frames' profile as Chrome trace JSON at exit, add -DNO_PROFILER to opts to compile the zones out
+rem -stats prints frame time percentiles every second, -stats-out file.csv|file.json writes them at exit
+set opts=-nologo /MDd -diagnostics:column -Zi /I%glfw_include_path% /I%glew_include_path% /I%thirdparty_include_path% /EHsc -DDEBUG
 set glfw_lib_path=%cd%\thirdparty\glfw-3.4\build\src\Debug
 set glew_lib_path=%cd%\thirdparty\glew-2.1.0\lib\Debug\x64
 
 pushd build
-cl %opts% %code%\platform.cpp /link user32.lib shell32.lib opengl32.lib gdi32.lib /LIBPATH:%glew_lib_path% glew32sd.lib /LIBPATH:%glfw_lib_path% glfw3.lib 
+rem the game is its own dll so the running exe can reload it, drop -DHOT_RELOAD to link it in instead
+rem lock.tmp tells the exe the dll is still being written
+echo building > lock.tmp
+del rpg_*.pdb > NUL 2> NUL
+cl %opts% -DGAME_MODULE %code%\rpg.cpp -LD -Ferpg.dll /link opengl32.lib /LIBPATH:%glew_lib_path% glew32sd.lib -PDB:rpg_%random%.pdb
+del lock.tmp
+cl %opts% -DHOT_RELOAD -Fesidescroller.exe %code%\platform.cpp /link user32.lib shell32.lib opengl32.lib gdi32.lib /LIBPATH:%glew_lib_path% glew32sd.lib /LIBPATH:%glfw_lib_path% glfw3.lib 
 popd
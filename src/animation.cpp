@@ -0,0 +1,518 @@
+#include <immintrin.h>
+
+/*
+    Skeletal animation and CPU linear-blend skinning.
+
+    Joint transforms are stored SoA (one array per channel) and padded to a multiple of 4 joints so
+    pose blending runs 4 joints at a time. Joints are ordered parents-before-children so the model
+    space pass is a single linear walk.
+
+    Skinning works on SoA vertex streams in batches of SKINNING_BATCH_SIZE vertices. Each batch
+    transposes its joint matrices into per-lane registers, 4 vertices at a time with SSE
+    and 8 with AVX2. Skinning is range based so a mesh (or a list of characters) can be split
+    across worker threads.
+*/
+
+#define MAX_JOINTS 256
+#define MAX_JOINT_INFLUENCES 4
+
+#ifdef __AVX2__
+#define SKINNING_BATCH_SIZE 8
+#else
+#define SKINNING_BATCH_SIZE 4
+#endif
+
+struct Skeleton {
+    int joint_count;
+    int *parents; // parents[i] < i, -1 for the root
+    mat4 *inverse_bind;
+};
+
+// SoA joint transforms. joint_count is padded to a multiple of 4.
+struct Pose {
+    int joint_count;
+    f32 *tx, *ty, *tz;
+    f32 *qx, *qy, *qz, *qw;
+    f32 *scale;
+};
+
+#define POSE_CHANNELS 8
+
+// Uniformly sampled keyframes, each frame is a Pose laid out back to back.
+struct AnimationClip {
+    int joint_count;
+    int frame_count;
+    f32 frames_per_second;
+    f32 *data;
+};
+
+// Row-major 3x4 affine matrix, rows produce x, y and z.
+struct SkinMatrix {
+    alignas(16) f32 m[12];
+};
+
+struct SkinnedVertexStream {
+    f32 *px, *py, *pz;
+    f32 *nx, *ny, *nz;
+};
+
+// vertex_count is padded to SKINNING_BATCH_SIZE, padding vertices have zero weights.
+struct SkinnedMesh {
+    int vertex_count;
+    SkinnedVertexStream bind;
+    int *joints[MAX_JOINT_INFLUENCES];
+    f32 *weights[MAX_JOINT_INFLUENCES];
+};
+
+int GetPaddedJointCount(int joint_count) {
+    int result = AlignUp(joint_count, 4);
+    return result;
+}
+
+Pose GetPoseView(f32 *data, int joint_count) {
+    int stride = GetPaddedJointCount(joint_count);
+
+    Pose result = {};
+    result.joint_count = stride;
+    result.tx = data + 0 * stride;
+    result.ty = data + 1 * stride;
+    result.tz = data + 2 * stride;
+    result.qx = data + 3 * stride;
+    result.qy = data + 4 * stride;
+    result.qz = data + 5 * stride;
+    result.qw = data + 6 * stride;
+    result.scale = data + 7 * stride;
+
+    return result;
+}
+
+Pose PushPose(Arena *arena, int joint_count) {
+    int stride = GetPaddedJointCount(joint_count);
+    f32 *data = (f32 *)ArenaAllocAligned(arena, sizeof(f32) * POSE_CHANNELS * stride, 16);
+
+    Pose result = GetPoseView(data, joint_count);
+
+    for (int i = 0; i < stride; ++i) {
+        result.qw[i] = 1.0f;
+        result.scale[i] = 1.0f;
+    }
+
+    return result;
+}
+
+Skeleton PushSkeleton(Arena *arena, int joint_count) {
+    Assert(joint_count <= MAX_JOINTS);
+
+    Skeleton result = {};
+    result.joint_count = joint_count;
+    result.parents = (int *)ArenaAlloc(arena, sizeof(int) * joint_count);
+    result.inverse_bind = (mat4 *)ArenaAllocAligned(arena, sizeof(mat4) * joint_count, 16);
+
+    for (int i = 0; i < joint_count; ++i) {
+        result.parents[i] = i - 1;
+        result.inverse_bind[i] = mat4(1.0f);
+    }
+
+    return result;
+}
+
+AnimationClip PushAnimationClip(Arena *arena, int joint_count, int frame_count, f32 frames_per_second) {
+    int stride = GetPaddedJointCount(joint_count);
+
+    AnimationClip result = {};
+    result.joint_count = joint_count;
+    result.frame_count = frame_count;
+    result.frames_per_second = frames_per_second;
+    result.data = (f32 *)ArenaAllocAligned(arena, sizeof(f32) * POSE_CHANNELS * stride * frame_count, 16);
+
+    return result;
+}
+
+Pose GetClipFrame(AnimationClip *clip, int frame) {
+    int stride = GetPaddedJointCount(clip->joint_count);
+    Pose result = GetPoseView(clip->data + frame * POSE_CHANNELS * stride, clip->joint_count);
+    return result;
+}
+
+f32 GetClipDuration(AnimationClip *clip) {
+    f32 result = (clip->frame_count - 1) / clip->frames_per_second;
+    return result;
+}
+
+void CopyPose(Pose *source, Pose *dest) {
+    Assert(source->joint_count == dest->joint_count);
+    memcpy(dest->tx, source->tx, sizeof(f32) * POSE_CHANNELS * source->joint_count);
+}
+
+// out may alias a or b
+void BlendPoses(Pose *a, Pose *b, f32 t, Pose *out) {
+    Assert(a->joint_count == b->joint_count && a->joint_count == out->joint_count);
+
+    __m128 wt = _mm_set1_ps(t);
+    __m128 zero = _mm_setzero_ps();
+    __m128 one = _mm_set1_ps(1.0f);
+    __m128 sign_bit = _mm_set1_ps(-0.0f);
+
+    for (int i = 0; i < a->joint_count; i += 4) {
+        __m128 atx = _mm_load_ps(a->tx + i), btx = _mm_load_ps(b->tx + i);
+        __m128 aty = _mm_load_ps(a->ty + i), bty = _mm_load_ps(b->ty + i);
+        __m128 atz = _mm_load_ps(a->tz + i), btz = _mm_load_ps(b->tz + i);
+        __m128 as = _mm_load_ps(a->scale + i), bs = _mm_load_ps(b->scale + i);
+
+        _mm_store_ps(out->tx + i, _mm_add_ps(atx, _mm_mul_ps(_mm_sub_ps(btx, atx), wt)));
+        _mm_store_ps(out->ty + i, _mm_add_ps(aty, _mm_mul_ps(_mm_sub_ps(bty, aty), wt)));
+        _mm_store_ps(out->tz + i, _mm_add_ps(atz, _mm_mul_ps(_mm_sub_ps(btz, atz), wt)));
+        _mm_store_ps(out->scale + i, _mm_add_ps(as, _mm_mul_ps(_mm_sub_ps(bs, as), wt)));
+
+        __m128 aqx = _mm_load_ps(a->qx + i), bqx = _mm_load_ps(b->qx + i);
+        __m128 aqy = _mm_load_ps(a->qy + i), bqy = _mm_load_ps(b->qy + i);
+        __m128 aqz = _mm_load_ps(a->qz + i), bqz = _mm_load_ps(b->qz + i);
+        __m128 aqw = _mm_load_ps(a->qw + i), bqw = _mm_load_ps(b->qw + i);
+
+        // nlerp along the shortest arc
+        __m128 dot = _mm_add_ps(_mm_add_ps(_mm_mul_ps(aqx, bqx), _mm_mul_ps(aqy, bqy)),
+                                _mm_add_ps(_mm_mul_ps(aqz, bqz), _mm_mul_ps(aqw, bqw)));
+        __m128 flip = _mm_and_ps(_mm_cmplt_ps(dot, zero), sign_bit);
+        bqx = _mm_xor_ps(bqx, flip);
+        bqy = _mm_xor_ps(bqy, flip);
+        bqz = _mm_xor_ps(bqz, flip);
+        bqw = _mm_xor_ps(bqw, flip);
+
+        __m128 qx = _mm_add_ps(aqx, _mm_mul_ps(_mm_sub_ps(bqx, aqx), wt));
+        __m128 qy = _mm_add_ps(aqy, _mm_mul_ps(_mm_sub_ps(bqy, aqy), wt));
+        __m128 qz = _mm_add_ps(aqz, _mm_mul_ps(_mm_sub_ps(bqz, aqz), wt));
+        __m128 qw = _mm_add_ps(aqw, _mm_mul_ps(_mm_sub_ps(bqw, aqw), wt));
+
+        __m128 length_sq = _mm_add_ps(_mm_add_ps(_mm_mul_ps(qx, qx), _mm_mul_ps(qy, qy)),
+                                      _mm_add_ps(_mm_mul_ps(qz, qz), _mm_mul_ps(qw, qw)));
+        __m128 inv_length = _mm_div_ps(one, _mm_sqrt_ps(length_sq));
+
+        _mm_store_ps(out->qx + i, _mm_mul_ps(qx, inv_length));
+        _mm_store_ps(out->qy + i, _mm_mul_ps(qy, inv_length));
+        _mm_store_ps(out->qz + i, _mm_mul_ps(qz, inv_length));
+        _mm_store_ps(out->qw + i, _mm_mul_ps(qw, inv_length));
+    }
+}
+
+void SampleClip(AnimationClip *clip, f32 time, b32 looping, Pose *out) {
+    f32 duration = GetClipDuration(clip);
+
+    if (looping && duration > 0) {
+        time = fmodf(time, duration);
+        if (time < 0) time += duration;
+    }
+
+    f32 frame = clamp(time * clip->frames_per_second, 0.0f, (f32)(clip->frame_count - 1));
+    int frame0 = (int)frame;
+    int frame1 = Min(frame0 + 1, clip->frame_count - 1);
+
+    Pose pose0 = GetClipFrame(clip, frame0);
+    Pose pose1 = GetClipFrame(clip, frame1);
+    BlendPoses(&pose0, &pose1, frame - frame0, out);
+}
+
+mat4 GetJointTransform(Pose *pose, int joint) {
+    f32 x = pose->qx[joint];
+    f32 y = pose->qy[joint];
+    f32 z = pose->qz[joint];
+    f32 w = pose->qw[joint];
+    f32 s = pose->scale[joint];
+
+    mat4 result;
+    result[0] = v4(s * (1 - 2*(y*y + z*z)), s * 2*(x*y + z*w), s * 2*(x*z - y*w), 0);
+    result[1] = v4(s * 2*(x*y - z*w), s * (1 - 2*(x*x + z*z)), s * 2*(y*z + x*w), 0);
+    result[2] = v4(s * 2*(x*z + y*w), s * 2*(y*z - x*w), s * (1 - 2*(x*x + y*y)), 0);
+    result[3] = v4(pose->tx[joint], pose->ty[joint], pose->tz[joint], 1);
+
+    return result;
+}
+
+// model_transforms needs skeleton->joint_count entries
+void ComputeModelTransforms(Skeleton *skeleton, Pose *pose, mat4 *model_transforms) {
+    for (int i = 0; i < skeleton->joint_count; ++i) {
+        mat4 local = GetJointTransform(pose, i);
+        int parent = skeleton->parents[i];
+        model_transforms[i] = parent < 0 ? local : model_transforms[parent] * local;
+    }
+}
+
+void ComputeSkinMatrices(Skeleton *skeleton, Pose *pose, mat4 *model_transforms, SkinMatrix *skin_matrices) {
+    ComputeModelTransforms(skeleton, pose, model_transforms);
+
+    for (int i = 0; i < skeleton->joint_count; ++i) {
+        mat4 m = model_transforms[i] * skeleton->inverse_bind[i];
+        f32 *dest = skin_matrices[i].m;
+
+        for (int row = 0; row < 3; ++row) {
+            dest[row*4 + 0] = m[0][row];
+            dest[row*4 + 1] = m[1][row];
+            dest[row*4 + 2] = m[2][row];
+            dest[row*4 + 3] = m[3][row];
+        }
+    }
+}
+
+SkinnedVertexStream PushSkinnedVertexStream(Arena *arena, int vertex_count) {
+    int count = AlignUp(vertex_count, SKINNING_BATCH_SIZE);
+    f32 *data = (f32 *)ArenaAllocAligned(arena, sizeof(f32) * 6 * count, 32);
+
+    SkinnedVertexStream result = {};
+    result.px = data + 0 * count;
+    result.py = data + 1 * count;
+    result.pz = data + 2 * count;
+    result.nx = data + 3 * count;
+    result.ny = data + 4 * count;
+    result.nz = data + 5 * count;
+
+    return result;
+}
+
+SkinnedMesh PushSkinnedMesh(Arena *arena, int vertex_count) {
+    int count = AlignUp(vertex_count, SKINNING_BATCH_SIZE);
+
+    SkinnedMesh result = {};
+    result.vertex_count = count;
+    result.bind = PushSkinnedVertexStream(arena, count);
+
+    for (int i = 0; i < MAX_JOINT_INFLUENCES; ++i) {
+        result.joints[i] = (int *)ArenaAllocAligned(arena, sizeof(int) * count, 32);
+        result.weights[i] = (f32 *)ArenaAllocAligned(arena, sizeof(f32) * count, 32);
+    }
+
+    return result;
+}
+
+#ifdef __AVX2__
+static void SkinBatch(SkinnedMesh *mesh, SkinMatrix *skin_matrices, int v, SkinnedVertexStream *out) {
+    __m256 m[12];
+    for (int c = 0; c < 12; ++c) m[c] = _mm256_setzero_ps();
+
+    for (int k = 0; k < MAX_JOINT_INFLUENCES; ++k) {
+        __m256 w = _mm256_load_ps(mesh->weights[k] + v);
+        int *joints = mesh->joints[k] + v;
+
+        // lanes 0-3 in the low half, 4-7 in the high half, then the same transpose as the SSE path
+        for (int row = 0; row < 3; ++row) {
+            __m256 a = _mm256_insertf128_ps(_mm256_castps128_ps256(_mm_load_ps(skin_matrices[joints[0]].m + row*4)),
+                                            _mm_load_ps(skin_matrices[joints[4]].m + row*4), 1);
+            __m256 b = _mm256_insertf128_ps(_mm256_castps128_ps256(_mm_load_ps(skin_matrices[joints[1]].m + row*4)),
+                                            _mm_load_ps(skin_matrices[joints[5]].m + row*4), 1);
+            __m256 c = _mm256_insertf128_ps(_mm256_castps128_ps256(_mm_load_ps(skin_matrices[joints[2]].m + row*4)),
+                                            _mm_load_ps(skin_matrices[joints[6]].m + row*4), 1);
+            __m256 d = _mm256_insertf128_ps(_mm256_castps128_ps256(_mm_load_ps(skin_matrices[joints[3]].m + row*4)),
+                                            _mm_load_ps(skin_matrices[joints[7]].m + row*4), 1);
+
+            __m256 t0 = _mm256_unpacklo_ps(a, b);
+            __m256 t1 = _mm256_unpackhi_ps(a, b);
+            __m256 t2 = _mm256_unpacklo_ps(c, d);
+            __m256 t3 = _mm256_unpackhi_ps(c, d);
+
+            m[row*4 + 0] = _mm256_add_ps(m[row*4 + 0], _mm256_mul_ps(_mm256_shuffle_ps(t0, t2, _MM_SHUFFLE(1, 0, 1, 0)), w));
+            m[row*4 + 1] = _mm256_add_ps(m[row*4 + 1], _mm256_mul_ps(_mm256_shuffle_ps(t0, t2, _MM_SHUFFLE(3, 2, 3, 2)), w));
+            m[row*4 + 2] = _mm256_add_ps(m[row*4 + 2], _mm256_mul_ps(_mm256_shuffle_ps(t1, t3, _MM_SHUFFLE(1, 0, 1, 0)), w));
+            m[row*4 + 3] = _mm256_add_ps(m[row*4 + 3], _mm256_mul_ps(_mm256_shuffle_ps(t1, t3, _MM_SHUFFLE(3, 2, 3, 2)), w));
+        }
+    }
+
+    __m256 px = _mm256_load_ps(mesh->bind.px + v);
+    __m256 py = _mm256_load_ps(mesh->bind.py + v);
+    __m256 pz = _mm256_load_ps(mesh->bind.pz + v);
+    __m256 nx = _mm256_load_ps(mesh->bind.nx + v);
+    __m256 ny = _mm256_load_ps(mesh->bind.ny + v);
+    __m256 nz = _mm256_load_ps(mesh->bind.nz + v);
+
+    for (int row = 0; row < 3; ++row) {
+        __m256 *r = m + row*4;
+        __m256 p = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(r[0], px), _mm256_mul_ps(r[1], py)),
+                                 _mm256_add_ps(_mm256_mul_ps(r[2], pz), r[3]));
+        __m256 n = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(r[0], nx), _mm256_mul_ps(r[1], ny)),
+                                 _mm256_mul_ps(r[2], nz));
+
+        f32 *out_p = row == 0 ? out->px : row == 1 ? out->py : out->pz;
+        f32 *out_n = row == 0 ? out->nx : row == 1 ? out->ny : out->nz;
+        _mm256_store_ps(out_p + v, p);
+        _mm256_store_ps(out_n + v, n);
+    }
+}
+#else
+static void SkinBatch(SkinnedMesh *mesh, SkinMatrix *skin_matrices, int v, SkinnedVertexStream *out) {
+    __m128 m[12];
+    for (int c = 0; c < 12; ++c) m[c] = _mm_setzero_ps();
+
+    for (int k = 0; k < MAX_JOINT_INFLUENCES; ++k) {
+        __m128 w = _mm_load_ps(mesh->weights[k] + v);
+        int *joints = mesh->joints[k] + v;
+
+        const f32 *s0 = skin_matrices[joints[0]].m;
+        const f32 *s1 = skin_matrices[joints[1]].m;
+        const f32 *s2 = skin_matrices[joints[2]].m;
+        const f32 *s3 = skin_matrices[joints[3]].m;
+
+        // transpose each row so every register holds one matrix element for all 4 vertices
+        for (int row = 0; row < 3; ++row) {
+            __m128 a = _mm_load_ps(s0 + row*4);
+            __m128 b = _mm_load_ps(s1 + row*4);
+            __m128 c = _mm_load_ps(s2 + row*4);
+            __m128 d = _mm_load_ps(s3 + row*4);
+            _MM_TRANSPOSE4_PS(a, b, c, d);
+
+            m[row*4 + 0] = _mm_add_ps(m[row*4 + 0], _mm_mul_ps(a, w));
+            m[row*4 + 1] = _mm_add_ps(m[row*4 + 1], _mm_mul_ps(b, w));
+            m[row*4 + 2] = _mm_add_ps(m[row*4 + 2], _mm_mul_ps(c, w));
+            m[row*4 + 3] = _mm_add_ps(m[row*4 + 3], _mm_mul_ps(d, w));
+        }
+    }
+
+    __m128 px = _mm_load_ps(mesh->bind.px + v);
+    __m128 py = _mm_load_ps(mesh->bind.py + v);
+    __m128 pz = _mm_load_ps(mesh->bind.pz + v);
+    __m128 nx = _mm_load_ps(mesh->bind.nx + v);
+    __m128 ny = _mm_load_ps(mesh->bind.ny + v);
+    __m128 nz = _mm_load_ps(mesh->bind.nz + v);
+
+    for (int row = 0; row < 3; ++row) {
+        __m128 *r = m + row*4;
+        __m128 p = _mm_add_ps(_mm_add_ps(_mm_mul_ps(r[0], px), _mm_mul_ps(r[1], py)),
+                              _mm_add_ps(_mm_mul_ps(r[2], pz), r[3]));
+        __m128 n = _mm_add_ps(_mm_add_ps(_mm_mul_ps(r[0], nx), _mm_mul_ps(r[1], ny)),
+                              _mm_mul_ps(r[2], nz));
+
+        f32 *out_p = row == 0 ? out->px : row == 1 ? out->py : out->pz;
+        f32 *out_n = row == 0 ? out->nx : row == 1 ? out->ny : out->nz;
+        _mm_store_ps(out_p + v, p);
+        _mm_store_ps(out_n + v, n);
+    }
+}
+#endif
+
+// Normals are not renormalized, do it in the vertex shader.
+void SkinVertices(SkinnedMesh *mesh, SkinMatrix *skin_matrices, int first, int one_past_last, SkinnedVertexStream *out) {
+    Assert(first % SKINNING_BATCH_SIZE == 0);
+    Assert(one_past_last % SKINNING_BATCH_SIZE == 0 && one_past_last <= mesh->vertex_count);
+
+    for (int v = first; v < one_past_last; v += SKINNING_BATCH_SIZE) {
+        SkinBatch(mesh, skin_matrices, v, out);
+    }
+}
+
+void SkinVertices(SkinnedMesh *mesh, SkinMatrix *skin_matrices, SkinnedVertexStream *out) {
+    SkinVertices(mesh, skin_matrices, 0, mesh->vertex_count, out);
+}
+
+// One animated character: sample, build the palette and skin the whole mesh.
+struct SkinningJob {
+    Skeleton *skeleton;
+    SkinnedMesh *mesh;
+    AnimationClip *clip;
+    f32 time;
+
+    Pose pose;
+    mat4 *model_transforms;
+    SkinMatrix *skin_matrices;
+    SkinnedVertexStream out;
+};
+
+void RunSkinningJob(SkinningJob *job) {
+    SampleClip(job->clip, job->time, true, &job->pose);
+    ComputeSkinMatrices(job->skeleton, &job->pose, job->model_transforms, job->skin_matrices);
+    SkinVertices(job->mesh, job->skin_matrices, &job->out);
+}
+
+static void RunSkinningJobRange(void *data, int first, int one_past_last) {
+    SkinningJob *jobs = (SkinningJob *)data;
+    for (int i = first; i < one_past_last; ++i) RunSkinningJob(jobs + i);
+}
+
+// One job per character, spread over the job system.
+void RunSkinningJobs(SkinningJob *jobs, int job_count) {
+    ProfileFunction();
+
+    ParallelFor(RunSkinningJobRange, jobs, job_count, 1);
+}
+
+void BenchmarkSkinning() {
+    const int character_count = 256;
+    const int joint_count = 64;
+    const int vertex_count = 4096;
+    const int frame_count = 60;
+    const int iterations = 10;
+
+    Arena arena = CreateArena(Megabytes(256));
+
+    Skeleton skeleton = PushSkeleton(&arena, joint_count);
+    for (int i = 0; i < joint_count; ++i) {
+        skeleton.inverse_bind[i] = translate(mat4(1.0f), v3(0, -0.1f * i, 0));
+    }
+
+    AnimationClip clip = PushAnimationClip(&arena, joint_count, frame_count, 30.0f);
+    for (int f = 0; f < frame_count; ++f) {
+        Pose frame = GetClipFrame(&clip, f);
+        f32 angle = 0.25f * sinf(f * (2 * glm::pi<f32>() / (frame_count - 1)));
+
+        for (int j = 0; j < frame.joint_count; ++j) {
+            frame.tx[j] = 0;
+            frame.ty[j] = j ? 0.1f : 0;
+            frame.tz[j] = 0;
+            frame.qx[j] = 0;
+            frame.qy[j] = 0;
+            frame.qz[j] = sinf(angle * 0.5f);
+            frame.qw[j] = cosf(angle * 0.5f);
+            frame.scale[j] = 1;
+        }
+    }
+
+    SkinnedMesh mesh = PushSkinnedMesh(&arena, vertex_count);
+    for (int v = 0; v < vertex_count; ++v) {
+        f32 height = (f32)v / vertex_count * joint_count * 0.1f;
+        mesh.bind.px[v] = cosf((f32)v);
+        mesh.bind.py[v] = height;
+        mesh.bind.pz[v] = sinf((f32)v);
+        mesh.bind.nx[v] = cosf((f32)v);
+        mesh.bind.nz[v] = sinf((f32)v);
+
+        int joint = Min((int)(height / 0.1f), joint_count - 1);
+        for (int k = 0; k < MAX_JOINT_INFLUENCES; ++k) {
+            mesh.joints[k][v] = clamp(joint + k - 1, 0, joint_count - 1);
+            mesh.weights[k][v] = 0.25f;
+        }
+    }
+
+    SkinningJob *jobs = (SkinningJob *)ArenaAlloc(&arena, sizeof(SkinningJob) * character_count);
+    for (int i = 0; i < character_count; ++i) {
+        SkinningJob *job = jobs + i;
+        job->skeleton = &skeleton;
+        job->mesh = &mesh;
+        job->clip = &clip;
+        job->time = i * 0.01f;
+        job->pose = PushPose(&arena, joint_count);
+        job->model_transforms = (mat4 *)ArenaAllocAligned(&arena, sizeof(mat4) * joint_count, 16);
+        job->skin_matrices = (SkinMatrix *)ArenaAllocAligned(&arena, sizeof(SkinMatrix) * joint_count, 16);
+        job->out = PushSkinnedVertexStream(&arena, mesh.vertex_count);
+    }
+
+    int max_threads = GetCoreCount();
+
+    fprintf(stdout, "Skinning: %d characters, %d joints, %d vertices, batch %d\n",
+            character_count, joint_count, mesh.vertex_count, SKINNING_BATCH_SIZE);
+
+    for (int thread_count = 1; thread_count <= max_threads; thread_count = GetNextBenchmarkThreadCount(thread_count, max_threads)) {
+        u64 mark = arena.count;
+        InitJobSystem(&arena, thread_count);
+
+        double start = GetTime();
+        for (int i = 0; i < iterations; ++i) {
+            for (int c = 0; c < character_count; ++c) jobs[c].time += 1 / 60.0f;
+            RunSkinningJobs(jobs, character_count);
+        }
+        double seconds = GetTime() - start;
+
+        ShutdownJobSystem();
+        arena.count = mark;
+
+        double vertices = (double)mesh.vertex_count * character_count * iterations;
+        fprintf(stdout, "  %2d thread(s): %8.2f ms/frame, %7.1f M vertices/s\n",
+                thread_count, seconds * 1000 / iterations, vertices / seconds / 1e6);
+    }
+
+    free(arena.base_address);
+}
@@ -0,0 +1,473 @@
+/*
+    Compressed animation clips.
+
+    Every joint has its own rotation, translation and scale track. Each track keeps only the keys
+    needed to reproduce the source clip within a tolerance (linear interpolation between the kept
+    keys), so constant channels collapse to one key and linear ones to two.
+
+    Rotations are stored smallest-three: the largest component is dropped and rebuilt from the unit
+    length, the other three are quantized to 15 bits. Translation and scale are quantized to 16 bits
+    against the range of their track.
+
+    Sampling keeps a cursor per track so finding the keys around the sample time is a forward step
+    from the previous sample instead of a search over the whole track.
+*/
+
+#define QUAT_COMPONENT_RANGE 0.70710678f // no component but the largest can exceed 1/sqrt(2)
+
+struct PackedQuat {
+    u16 a, b, c; // top bits of a and b hold the index of the dropped component
+};
+
+struct RotationTrack {
+    int key_count;
+    u16 *frames;
+    PackedQuat *keys;
+};
+
+struct QuantizedTrack {
+    int key_count;
+    int components;
+    u16 *frames;
+    u16 *keys;
+    f32 min[3];
+    f32 extent[3];
+};
+
+struct CompressedClip {
+    int joint_count;
+    int frame_count;
+    f32 frames_per_second;
+
+    RotationTrack *rotations;
+    QuantizedTrack *translations;
+    QuantizedTrack *scales;
+
+    u64 size;
+};
+
+struct ClipCompressionSettings {
+    f32 rotation_tolerance;
+    f32 translation_tolerance;
+    f32 scale_tolerance;
+};
+
+// One key index per track, owned by whoever plays the clip.
+struct ClipCursor {
+    u16 *rotation;
+    u16 *translation;
+    u16 *scale;
+};
+
+struct AnimationLayer {
+    CompressedClip *clip;
+    ClipCursor cursor;
+    f32 time;
+    f32 speed;
+    f32 weight;
+    b32 looping;
+};
+
+PackedQuat PackQuaternion(f32 x, f32 y, f32 z, f32 w) {
+    f32 q[4] = { x, y, z, w };
+
+    int largest = 0;
+    for (int i = 1; i < 4; ++i) {
+        if (fabsf(q[i]) > fabsf(q[largest])) largest = i;
+    }
+
+    // q and -q are the same rotation, flip so the dropped component is positive
+    f32 sign = q[largest] < 0 ? -1.0f : 1.0f;
+
+    u16 bits[3];
+    for (int i = 0, n = 0; i < 4; ++i) {
+        if (i == largest) continue;
+
+        f32 v = clamp(q[i] * sign / QUAT_COMPONENT_RANGE, -1.0f, 1.0f);
+        bits[n++] = (u16)roundf((v * 0.5f + 0.5f) * 32767.0f);
+    }
+
+    PackedQuat result;
+    result.a = bits[0] | (u16)((largest & 1) << 15);
+    result.b = bits[1] | (u16)((largest >> 1) << 15);
+    result.c = bits[2];
+
+    return result;
+}
+
+void UnpackQuaternion(PackedQuat packed, f32 *q) {
+    int largest = (packed.a >> 15) | ((packed.b >> 15) << 1);
+    u16 bits[3] = { (u16)(packed.a & 0x7fff), (u16)(packed.b & 0x7fff), packed.c };
+
+    f32 sum_sq = 0;
+    for (int i = 0, n = 0; i < 4; ++i) {
+        if (i == largest) continue;
+
+        f32 v = (bits[n++] / 32767.0f * 2.0f - 1.0f) * QUAT_COMPONENT_RANGE;
+        q[i] = v;
+        sum_sq += v*v;
+    }
+
+    q[largest] = sqrtf(Max(1.0f - sum_sq, 0.0f));
+}
+
+static f32 GetSourceValue(Pose *frame, int channel, int joint) {
+    f32 *channels[] = { frame->tx, frame->ty, frame->tz, frame->qx, frame->qy, frame->qz, frame->qw, frame->scale };
+    return channels[channel][joint];
+}
+
+// Collects one joint channel group of the source clip, values[frame * components + component].
+static void GatherTrack(AnimationClip *clip, int joint, int first_channel, int components, f32 *values) {
+    for (int f = 0; f < clip->frame_count; ++f) {
+        Pose frame = GetClipFrame(clip, f);
+        for (int c = 0; c < components; ++c) {
+            values[f * components + c] = GetSourceValue(&frame, first_channel + c, joint);
+        }
+    }
+}
+
+static b32 SpanWithinTolerance(f32 *values, int components, int start, int end, f32 tolerance, b32 normalize_span) {
+    f32 *a = values + start * components;
+    f32 *b = values + end * components;
+
+    for (int f = start + 1; f < end; ++f) {
+        f32 t = (f32)(f - start) / (end - start);
+        f32 *actual = values + f * components;
+
+        f32 lerped[4];
+        f32 length_sq = 0;
+        for (int c = 0; c < components; ++c) {
+            lerped[c] = a[c] + (b[c] - a[c]) * t;
+            length_sq += lerped[c] * lerped[c];
+        }
+
+        f32 scale = normalize_span && length_sq > 0 ? 1.0f / sqrtf(length_sq) : 1.0f;
+        for (int c = 0; c < components; ++c) {
+            if (fabsf(lerped[c] * scale - actual[c]) > tolerance) return false;
+        }
+    }
+
+    return true;
+}
+
+// Greedy error-bounded reduction. Always keeps the first and last frame.
+static int ReduceKeys(f32 *values, int components, int frame_count, f32 tolerance, b32 normalize_span, u16 *kept) {
+    int count = 0;
+    kept[count++] = 0;
+
+    int start = 0;
+    while (start < frame_count - 1) {
+        int end = start + 1;
+        while (end + 1 < frame_count && SpanWithinTolerance(values, components, start, end + 1, tolerance, normalize_span)) {
+            ++end;
+        }
+
+        kept[count++] = (u16)end;
+        start = end;
+    }
+
+    return count;
+}
+
+static void BuildQuantizedTrack(Arena *arena, f32 *values, int components, int frame_count, f32 tolerance,
+                                u16 *kept, QuantizedTrack *track) {
+    *track = {};
+    track->components = components;
+
+    for (int c = 0; c < components; ++c) {
+        f32 lo = values[c], hi = values[c];
+        for (int f = 1; f < frame_count; ++f) {
+            lo = Min(lo, values[f * components + c]);
+            hi = Max(hi, values[f * components + c]);
+        }
+        track->min[c] = lo;
+        track->extent[c] = hi - lo;
+    }
+
+    // a constant track is exact at any tolerance, keep a single key
+    b32 constant = true;
+    for (int c = 0; c < components; ++c) {
+        if (track->extent[c] > 0) constant = false;
+    }
+
+    track->key_count = constant ? 1 : ReduceKeys(values, components, frame_count, tolerance, false, kept);
+    track->frames = (u16 *)ArenaAlloc(arena, sizeof(u16) * track->key_count);
+    track->keys = (u16 *)ArenaAlloc(arena, sizeof(u16) * track->key_count * components);
+
+    for (int k = 0; k < track->key_count; ++k) {
+        int frame = kept[k];
+        track->frames[k] = (u16)frame;
+
+        for (int c = 0; c < components; ++c) {
+            f32 normalized = track->extent[c] > 0 ? (values[frame * components + c] - track->min[c]) / track->extent[c] : 0;
+            track->keys[k * components + c] = (u16)roundf(normalized * 65535.0f);
+        }
+    }
+}
+
+static void BuildRotationTrack(Arena *arena, f32 *values, int frame_count, f32 tolerance, u16 *kept, RotationTrack *track) {
+    // keep neighbouring keys in the same hemisphere so the reduction lerps along the short arc
+    for (int f = 1; f < frame_count; ++f) {
+        f32 *prev = values + (f - 1) * 4;
+        f32 *q = values + f * 4;
+        if (prev[0]*q[0] + prev[1]*q[1] + prev[2]*q[2] + prev[3]*q[3] < 0) {
+            for (int c = 0; c < 4; ++c) q[c] = -q[c];
+        }
+    }
+
+    b32 constant = true;
+    for (int f = 1; f < frame_count && constant; ++f) {
+        for (int c = 0; c < 4; ++c) {
+            if (values[f * 4 + c] != values[c]) constant = false;
+        }
+    }
+
+    track->key_count = constant ? 1 : ReduceKeys(values, 4, frame_count, tolerance, true, kept);
+    track->frames = (u16 *)ArenaAlloc(arena, sizeof(u16) * track->key_count);
+    track->keys = (PackedQuat *)ArenaAlloc(arena, sizeof(PackedQuat) * track->key_count);
+
+    for (int k = 0; k < track->key_count; ++k) {
+        f32 *q = values + kept[k] * 4;
+        track->frames[k] = kept[k];
+        track->keys[k] = PackQuaternion(q[0], q[1], q[2], q[3]);
+    }
+}
+
+// scratch is only used during the build, everything the clip references is allocated from arena.
+CompressedClip CompressClip(Arena *arena, Arena *scratch, AnimationClip *source, ClipCompressionSettings settings) {
+    Assert(source->frame_count > 0 && source->frame_count <= 0xffff);
+
+    u64 scratch_mark = scratch->count;
+    u64 arena_mark = arena->count;
+
+    int joint_count = source->joint_count;
+    int frame_count = source->frame_count;
+
+    CompressedClip result = {};
+    result.joint_count = joint_count;
+    result.frame_count = frame_count;
+    result.frames_per_second = source->frames_per_second;
+    result.rotations = (RotationTrack *)ArenaAlloc(arena, sizeof(RotationTrack) * joint_count);
+    result.translations = (QuantizedTrack *)ArenaAlloc(arena, sizeof(QuantizedTrack) * joint_count);
+    result.scales = (QuantizedTrack *)ArenaAlloc(arena, sizeof(QuantizedTrack) * joint_count);
+
+    f32 *values = (f32 *)ArenaAlloc(scratch, sizeof(f32) * 4 * frame_count);
+    u16 *kept = (u16 *)ArenaAlloc(scratch, sizeof(u16) * frame_count);
+    kept[0] = 0; // constant tracks skip the reduction and use the first frame
+
+    for (int j = 0; j < joint_count; ++j) {
+        GatherTrack(source, j, 3, 4, values);
+        BuildRotationTrack(arena, values, frame_count, settings.rotation_tolerance, kept, result.rotations + j);
+
+        GatherTrack(source, j, 0, 3, values);
+        BuildQuantizedTrack(arena, values, 3, frame_count, settings.translation_tolerance, kept, result.translations + j);
+
+        GatherTrack(source, j, 7, 1, values);
+        BuildQuantizedTrack(arena, values, 1, frame_count, settings.scale_tolerance, kept, result.scales + j);
+    }
+
+    scratch->count = scratch_mark;
+    result.size = arena->count - arena_mark;
+
+    return result;
+}
+
+u64 GetAnimationClipSize(AnimationClip *clip) {
+    u64 result = sizeof(f32) * POSE_CHANNELS * GetPaddedJointCount(clip->joint_count) * clip->frame_count;
+    return result;
+}
+
+ClipCursor PushClipCursor(Arena *arena, int joint_count) {
+    ClipCursor result = {};
+    result.rotation = (u16 *)ArenaAlloc(arena, sizeof(u16) * joint_count);
+    result.translation = (u16 *)ArenaAlloc(arena, sizeof(u16) * joint_count);
+    result.scale = (u16 *)ArenaAlloc(arena, sizeof(u16) * joint_count);
+    return result;
+}
+
+// Returns the key at or before frame and writes the fraction towards the next key.
+static int AdvanceCursor(u16 *frames, int key_count, u16 *cursor, f32 frame, f32 *t) {
+    int i = *cursor;
+
+    // the clip looped or time went backwards
+    if (i >= key_count || frames[i] > frame) i = 0;
+
+    while (i + 1 < key_count && frames[i + 1] <= frame) ++i;
+
+    *cursor = (u16)i;
+    *t = i + 1 < key_count ? (frame - frames[i]) / (f32)(frames[i + 1] - frames[i]) : 0.0f;
+
+    return i;
+}
+
+static void DecodeQuantized(QuantizedTrack *track, int key, f32 *out) {
+    for (int c = 0; c < track->components; ++c) {
+        out[c] = track->min[c] + track->keys[key * track->components + c] / 65535.0f * track->extent[c];
+    }
+}
+
+static void SampleQuantizedTrack(QuantizedTrack *track, u16 *cursor, f32 frame, f32 *out) {
+    f32 t;
+    int key = AdvanceCursor(track->frames, track->key_count, cursor, frame, &t);
+
+    f32 a[3], b[3];
+    DecodeQuantized(track, key, a);
+
+    if (t > 0) {
+        DecodeQuantized(track, key + 1, b);
+        for (int c = 0; c < track->components; ++c) a[c] += (b[c] - a[c]) * t;
+    }
+
+    for (int c = 0; c < track->components; ++c) out[c] = a[c];
+}
+
+static void SampleRotationTrack(RotationTrack *track, u16 *cursor, f32 frame, f32 *out) {
+    f32 t;
+    int key = AdvanceCursor(track->frames, track->key_count, cursor, frame, &t);
+
+    UnpackQuaternion(track->keys[key], out);
+
+    if (t > 0) {
+        f32 b[4];
+        UnpackQuaternion(track->keys[key + 1], b);
+
+        f32 dot = out[0]*b[0] + out[1]*b[1] + out[2]*b[2] + out[3]*b[3];
+        f32 sign = dot < 0 ? -1.0f : 1.0f;
+
+        f32 length_sq = 0;
+        for (int c = 0; c < 4; ++c) {
+            out[c] += (b[c] * sign - out[c]) * t;
+            length_sq += out[c] * out[c];
+        }
+
+        f32 inv_length = 1.0f / sqrtf(length_sq);
+        for (int c = 0; c < 4; ++c) out[c] *= inv_length;
+    }
+}
+
+void SampleCompressedClip(CompressedClip *clip, ClipCursor *cursor, f32 time, b32 looping, Pose *out) {
+    f32 duration = (clip->frame_count - 1) / clip->frames_per_second;
+
+    if (looping && duration > 0) {
+        time = fmodf(time, duration);
+        if (time < 0) time += duration;
+    }
+
+    f32 frame = clamp(time * clip->frames_per_second, 0.0f, (f32)(clip->frame_count - 1));
+
+    for (int j = 0; j < clip->joint_count; ++j) {
+        f32 q[4], p[3];
+        SampleRotationTrack(clip->rotations + j, cursor->rotation + j, frame, q);
+        SampleQuantizedTrack(clip->translations + j, cursor->translation + j, frame, p);
+        SampleQuantizedTrack(clip->scales + j, cursor->scale + j, frame, out->scale + j);
+
+        out->qx[j] = q[0];
+        out->qy[j] = q[1];
+        out->qz[j] = q[2];
+        out->qw[j] = q[3];
+        out->tx[j] = p[0];
+        out->ty[j] = p[1];
+        out->tz[j] = p[2];
+    }
+}
+
+void ResetPose(Pose *pose) {
+    for (int i = 0; i < pose->joint_count; ++i) {
+        pose->tx[i] = pose->ty[i] = pose->tz[i] = 0;
+        pose->qx[i] = pose->qy[i] = pose->qz[i] = 0;
+        pose->qw[i] = 1;
+        pose->scale[i] = 1;
+    }
+}
+
+AnimationLayer CreateAnimationLayer(Arena *arena, CompressedClip *clip, b32 looping) {
+    AnimationLayer result = {};
+    result.clip = clip;
+    result.cursor = PushClipCursor(arena, clip->joint_count);
+    result.speed = 1.0f;
+    result.looping = looping;
+    return result;
+}
+
+void AdvanceAnimationLayers(AnimationLayer *layers, int layer_count, f32 dt) {
+    for (int i = 0; i < layer_count; ++i) {
+        layers[i].time += dt * layers[i].speed;
+    }
+}
+
+// Weighted blend of every layer, scratch and out must have the clips' joint count.
+void SampleAnimationLayers(AnimationLayer *layers, int layer_count, Pose *scratch, Pose *out) {
+    ProfileFunction();
+
+    f32 total_weight = 0;
+
+    for (int i = 0; i < layer_count; ++i) {
+        AnimationLayer *layer = layers + i;
+        if (layer->weight <= 0) continue;
+
+        if (total_weight == 0) {
+            SampleCompressedClip(layer->clip, &layer->cursor, layer->time, layer->looping, out);
+            total_weight = layer->weight;
+        } else {
+            SampleCompressedClip(layer->clip, &layer->cursor, layer->time, layer->looping, scratch);
+            total_weight += layer->weight;
+            BlendPoses(out, scratch, layer->weight / total_weight, out);
+        }
+    }
+
+    if (total_weight == 0) ResetPose(out);
+}
+
+void BenchmarkAnimationSampling() {
+    const int joint_count = 64;
+    const int samples = 10000;
+    int frame_counts[] = { 60, 600, 6000 };
+
+    Arena arena = CreateArena(Megabytes(256));
+    Arena scratch = CreateArena(Megabytes(16));
+
+    ClipCompressionSettings settings = { 0.0005f, 0.0005f, 0.0005f };
+
+    fprintf(stdout, "Animation sampling: %d joints\n", joint_count);
+
+    for (int i = 0; i < (int)ArrayCount(frame_counts); ++i) {
+        int frame_count = frame_counts[i];
+
+        AnimationClip source = PushAnimationClip(&arena, joint_count, frame_count, 30.0f);
+        for (int f = 0; f < frame_count; ++f) {
+            Pose frame = GetClipFrame(&source, f);
+            f32 time = f / 30.0f;
+
+            for (int j = 0; j < joint_count; ++j) {
+                // a mix of animated, linear and constant channels like a real character clip
+                f32 angle = j % 4 ? 0.5f * sinf(time * (1 + j % 3)) : 0.0f;
+                frame.qx[j] = sinf(angle * 0.5f);
+                frame.qy[j] = 0;
+                frame.qz[j] = 0;
+                frame.qw[j] = cosf(angle * 0.5f);
+                frame.tx[j] = j == 0 ? time : 0;
+                frame.ty[j] = j == 0 ? 0.05f * sinf(time * 6) : 0.1f;
+                frame.tz[j] = 0;
+                frame.scale[j] = 1;
+            }
+        }
+
+        CompressedClip clip = CompressClip(&arena, &scratch, &source, settings);
+        ClipCursor cursor = PushClipCursor(&arena, joint_count);
+        Pose pose = PushPose(&arena, joint_count);
+
+        double start = GetTime();
+        for (int s = 0; s < samples; ++s) {
+            SampleCompressedClip(&clip, &cursor, s / 60.0f, true, &pose);
+        }
+        double seconds = GetTime() - start;
+
+        u64 raw_size = GetAnimationClipSize(&source);
+        fprintf(stdout, "  %5d frames: %8llu -> %7llu bytes (%.1fx), %6.1f ns/joint\n",
+                frame_count, (unsigned long long)raw_size, (unsigned long long)clip.size,
+                (double)raw_size / clip.size, seconds * 1e9 / ((double)samples * joint_count));
+    }
+
+    free(arena.base_address);
+    free(scratch.base_address);
+}
@@ -0,0 +1,37 @@
+void *ArenaAlloc(Arena *arena, u64 count) {
+    if (arena->count + count > arena->size) {
+        u64 new_size = arena->size * 2;
+        arena->base_address = realloc(arena->base_address, new_size);
+        fprintf(stderr, "INFO: Arena resized: (%lld -> %lld)\n", arena->size, new_size);
+        arena->size = new_size;
+    }
+
+    void *result = (u8 *)arena->base_address + arena->count;
+    arena->count += count;
+
+    memset(result, 0, count);
+
+    return result;
+}
+
+void *ArenaAllocAligned(Arena *arena, u64 count, u64 alignment) {
+    u8 *result = (u8 *)ArenaAlloc(arena, count + alignment - 1);
+    result = (u8 *)AlignUp((u64)result, alignment);
+    return result;
+}
+
+Arena CreateArena(u64 size) {
+    Arena result = {};
+    result.base_address = malloc(size);
+    result.size = size;
+
+    return result;
+}
+
+Arena CreateArena(void *base_address, u64 size) {
+    Arena result = {};
+    result.base_address = base_address;
+    result.size = size;
+
+    return result;
+}
@@ -0,0 +1,606 @@
+/*
+    Bounding volumes and a dynamic bounding volume hierarchy.
+
+    The BVH is a binary AABB tree kept balanced with AVL style rotations on insert and remove.
+    Leaves hold a fattened box so small moves don't touch the tree at all; a move past the fat box
+    refits the leaf and its ancestors bottom-up (stopping once a box stops changing), and only an
+    object that jumped clear of its old box is removed and reinserted.
+
+    Queries: frustum (whole subtrees inside the frustum are accepted without further plane tests),
+    nearest ray hit and box overlap.
+*/
+
+#define BVH_NULL -1
+#define BVH_STACK_SIZE 256
+
+struct AABB {
+    v3 min;
+    v3 max;
+};
+
+struct Sphere {
+    v3 center;
+    f32 radius;
+};
+
+struct Ray {
+    v3 origin;
+    v3 direction;
+};
+
+// Plane equations (xyz = normal, w = distance), a point p is inside when dot(n, p) + w >= 0.
+struct Frustum {
+    v4 planes[6];
+};
+
+struct BVHNode {
+    AABB box; // fattened for leaves
+    AABB object_box;
+    int parent; // next free node when on the free list
+    int children[2];
+    int height; // 0 for leaves, -1 for free nodes
+    int object;
+};
+
+struct BVH {
+    BVHNode *nodes;
+    int node_capacity;
+    int root;
+    int free_list;
+    int proxy_count; // leaves
+    f32 margin;
+};
+
+inline AABB Union(AABB a, AABB b) {
+    AABB result = { glm::min(a.min, b.min), glm::max(a.max, b.max) };
+    return result;
+}
+
+inline b32 Contains(AABB outer, AABB inner) {
+    b32 result = all(lessThanEqual(outer.min, inner.min)) && all(greaterThanEqual(outer.max, inner.max));
+    return result;
+}
+
+inline b32 Overlaps(AABB a, AABB b) {
+    b32 result = all(lessThanEqual(a.min, b.max)) && all(greaterThanEqual(a.max, b.min));
+    return result;
+}
+
+inline AABB Expand(AABB box, f32 amount) {
+    AABB result = { box.min - v3(amount), box.max + v3(amount) };
+    return result;
+}
+
+inline f32 Perimeter(AABB box) {
+    v3 d = box.max - box.min;
+    f32 result = 2 * (d.x*d.y + d.y*d.z + d.z*d.x);
+    return result;
+}
+
+// Arvo's method, the box of the transformed box.
+AABB TransformAABB(AABB box, mat4 *m) {
+    v3 translation = v3((*m)[3]);
+    AABB result = { translation, translation };
+
+    for (int c = 0; c < 3; ++c) {
+        for (int r = 0; r < 3; ++r) {
+            f32 a = (*m)[c][r] * box.min[c];
+            f32 b = (*m)[c][r] * box.max[c];
+            result.min[r] += glm::min(a, b);
+            result.max[r] += glm::max(a, b);
+        }
+    }
+
+    return result;
+}
+
+Sphere GetBoundingSphere(AABB box) {
+    Sphere result;
+    result.center = (box.min + box.max) * 0.5f;
+    result.radius = length(box.max - result.center);
+    return result;
+}
+
+// Gribb-Hartmann plane extraction from a projection * view matrix.
+Frustum ExtractFrustumPlanes(mat4 *m) {
+    v4 row0 = v4((*m)[0][0], (*m)[1][0], (*m)[2][0], (*m)[3][0]);
+    v4 row1 = v4((*m)[0][1], (*m)[1][1], (*m)[2][1], (*m)[3][1]);
+    v4 row2 = v4((*m)[0][2], (*m)[1][2], (*m)[2][2], (*m)[3][2]);
+    v4 row3 = v4((*m)[0][3], (*m)[1][3], (*m)[2][3], (*m)[3][3]);
+
+    Frustum result;
+    result.planes[0] = row3 + row0; // left
+    result.planes[1] = row3 - row0; // right
+    result.planes[2] = row3 + row1; // bottom
+    result.planes[3] = row3 - row1; // top
+    result.planes[4] = row3 + row2; // near
+    result.planes[5] = row3 - row2; // far
+
+    for (int i = 0; i < 6; ++i) {
+        result.planes[i] /= length(v3(result.planes[i]));
+    }
+
+    return result;
+}
+
+enum FrustumTest {
+    FrustumOutside,
+    FrustumIntersects,
+    FrustumInside,
+};
+
+FrustumTest TestFrustumAABB(Frustum *frustum, AABB box) {
+    FrustumTest result = FrustumInside;
+
+    for (int i = 0; i < 6; ++i) {
+        v4 plane = frustum->planes[i];
+        v3 n = v3(plane);
+
+        // corners furthest along and against the plane normal
+        v3 positive = v3(n.x >= 0 ? box.max.x : box.min.x, n.y >= 0 ? box.max.y : box.min.y, n.z >= 0 ? box.max.z : box.min.z);
+        v3 negative = v3(n.x >= 0 ? box.min.x : box.max.x, n.y >= 0 ? box.min.y : box.max.y, n.z >= 0 ? box.min.z : box.max.z);
+
+        if (dot(n, positive) + plane.w < 0) return FrustumOutside;
+        if (dot(n, negative) + plane.w < 0) result = FrustumIntersects;
+    }
+
+    return result;
+}
+
+// Returns the entry distance or -1 on a miss.
+f32 IntersectRayAABB(v3 origin, v3 inv_direction, AABB box, f32 max_t) {
+    v3 t0 = (box.min - origin) * inv_direction;
+    v3 t1 = (box.max - origin) * inv_direction;
+    v3 near_t = glm::min(t0, t1);
+    v3 far_t = glm::max(t0, t1);
+
+    f32 enter = glm::max(glm::max(near_t.x, near_t.y), glm::max(near_t.z, 0.0f));
+    f32 exit = glm::min(glm::min(far_t.x, far_t.y), glm::min(far_t.z, max_t));
+
+    f32 result = enter <= exit ? enter : -1.0f;
+    return result;
+}
+
+// Ray through a framebuffer pixel, from the near plane into the scene.
+Ray ScreenToRay(f32 x, f32 y, int fb_width, int fb_height, mat4 *view_projection) {
+    ScreenToNDC(&x, &y, fb_width, fb_height);
+
+    mat4 inv = inverse(*view_projection);
+    v4 near_point = inv * v4(x, y, -1, 1);
+    v4 far_point = inv * v4(x, y, 1, 1);
+
+    Ray result;
+    result.origin = v3(near_point) / near_point.w;
+    result.direction = normalize(v3(far_point) / far_point.w - result.origin);
+
+    return result;
+}
+
+BVH CreateBVH(Arena *arena, int max_objects, f32 margin) {
+    BVH result = {};
+    result.node_capacity = 2 * max_objects;
+    result.nodes = (BVHNode *)ArenaAlloc(arena, sizeof(BVHNode) * result.node_capacity);
+    result.root = BVH_NULL;
+    result.margin = margin;
+
+    for (int i = 0; i < result.node_capacity; ++i) {
+        result.nodes[i].parent = i + 1 < result.node_capacity ? i + 1 : BVH_NULL;
+        result.nodes[i].height = -1;
+    }
+    result.free_list = 0;
+
+    return result;
+}
+
+static int AllocateBVHNode(BVH *bvh) {
+    Assert(bvh->free_list != BVH_NULL);
+
+    int result = bvh->free_list;
+    BVHNode *node = bvh->nodes + result;
+    bvh->free_list = node->parent;
+
+    node->parent = BVH_NULL;
+    node->children[0] = node->children[1] = BVH_NULL;
+    node->height = 0;
+    node->object = -1;
+
+    return result;
+}
+
+static void FreeBVHNode(BVH *bvh, int index) {
+    bvh->nodes[index].parent = bvh->free_list;
+    bvh->nodes[index].height = -1;
+    bvh->free_list = index;
+}
+
+inline b32 IsLeaf(BVHNode *node) {
+    return node->children[0] == BVH_NULL;
+}
+
+static void FixBVHNode(BVH *bvh, int index) {
+    BVHNode *node = bvh->nodes + index;
+    BVHNode *a = bvh->nodes + node->children[0];
+    BVHNode *b = bvh->nodes + node->children[1];
+    node->height = 1 + glm::max(a->height, b->height);
+    node->box = Union(a->box, b->box);
+}
+
+// AVL rotation: if one child is 2+ levels taller, promote it. Returns the subtree root.
+static int BalanceBVHNode(BVH *bvh, int ia) {
+    BVHNode *a = bvh->nodes + ia;
+    if (IsLeaf(a) || a->height < 2) return ia;
+
+    int ib = a->children[0];
+    int ic = a->children[1];
+    BVHNode *b = bvh->nodes + ib;
+    BVHNode *c = bvh->nodes + ic;
+
+    int balance = c->height - b->height;
+    if (balance > -2 && balance < 2) return ia;
+
+    // rotate the taller child (up) above a
+    int iup = balance > 0 ? ic : ib;
+    int iother = balance > 0 ? ib : ic;
+    BVHNode *up = bvh->nodes + iup;
+
+    int if_ = up->children[0];
+    int ig = up->children[1];
+    BVHNode *f = bvh->nodes + if_;
+    BVHNode *g = bvh->nodes + ig;
+
+    up->children[0] = ia;
+    up->parent = a->parent;
+    a->parent = iup;
+
+    if (up->parent != BVH_NULL) {
+        BVHNode *parent = bvh->nodes + up->parent;
+        if (parent->children[0] == ia) parent->children[0] = iup;
+        else parent->children[1] = iup;
+    } else {
+        bvh->root = iup;
+    }
+
+    // the taller grandchild stays under up, the shorter one moves under a
+    int keep = f->height > g->height ? if_ : ig;
+    int move = f->height > g->height ? ig : if_;
+
+    up->children[1] = keep;
+    a->children[0] = iother;
+    a->children[1] = move;
+    bvh->nodes[move].parent = ia;
+
+    FixBVHNode(bvh, ia);
+    FixBVHNode(bvh, iup);
+
+    return iup;
+}
+
+static void RefitBVHAncestors(BVH *bvh, int index) {
+    while (index != BVH_NULL) {
+        index = BalanceBVHNode(bvh, index);
+        FixBVHNode(bvh, index);
+        index = bvh->nodes[index].parent;
+    }
+}
+
+static void InsertBVHLeaf(BVH *bvh, int leaf) {
+    if (bvh->root == BVH_NULL) {
+        bvh->root = leaf;
+        bvh->nodes[leaf].parent = BVH_NULL;
+        return;
+    }
+
+    // descend towards the sibling with the lowest surface area cost
+    AABB leaf_box = bvh->nodes[leaf].box;
+    int index = bvh->root;
+
+    while (!IsLeaf(bvh->nodes + index)) {
+        BVHNode *node = bvh->nodes + index;
+
+        f32 area = Perimeter(node->box);
+        f32 combined_area = Perimeter(Union(node->box, leaf_box));
+        f32 cost = 2 * combined_area;
+        f32 inheritance_cost = 2 * (combined_area - area);
+
+        f32 child_cost[2];
+        for (int i = 0; i < 2; ++i) {
+            BVHNode *child = bvh->nodes + node->children[i];
+            f32 enlarged = Perimeter(Union(child->box, leaf_box));
+            child_cost[i] = (IsLeaf(child) ? enlarged : enlarged - Perimeter(child->box)) + inheritance_cost;
+        }
+
+        if (cost < child_cost[0] && cost < child_cost[1]) break;
+
+        index = child_cost[0] < child_cost[1] ? node->children[0] : node->children[1];
+    }
+
+    int sibling = index;
+    int old_parent = bvh->nodes[sibling].parent;
+    int new_parent = AllocateBVHNode(bvh);
+
+    BVHNode *parent = bvh->nodes + new_parent;
+    parent->parent = old_parent;
+    parent->children[0] = sibling;
+    parent->children[1] = leaf;
+    parent->box = Union(leaf_box, bvh->nodes[sibling].box);
+    parent->height = bvh->nodes[sibling].height + 1;
+
+    if (old_parent != BVH_NULL) {
+        BVHNode *grandparent = bvh->nodes + old_parent;
+        if (grandparent->children[0] == sibling) grandparent->children[0] = new_parent;
+        else grandparent->children[1] = new_parent;
+    } else {
+        bvh->root = new_parent;
+    }
+
+    bvh->nodes[sibling].parent = new_parent;
+    bvh->nodes[leaf].parent = new_parent;
+
+    RefitBVHAncestors(bvh, new_parent);
+}
+
+static void RemoveBVHLeaf(BVH *bvh, int leaf) {
+    if (leaf == bvh->root) {
+        bvh->root = BVH_NULL;
+        return;
+    }
+
+    int parent = bvh->nodes[leaf].parent;
+    int grandparent = bvh->nodes[parent].parent;
+    int sibling = bvh->nodes[parent].children[0] == leaf ? bvh->nodes[parent].children[1] : bvh->nodes[parent].children[0];
+
+    if (grandparent != BVH_NULL) {
+        BVHNode *node = bvh->nodes + grandparent;
+        if (node->children[0] == parent) node->children[0] = sibling;
+        else node->children[1] = sibling;
+
+        bvh->nodes[sibling].parent = grandparent;
+        FreeBVHNode(bvh, parent);
+
+        RefitBVHAncestors(bvh, grandparent);
+    } else {
+        bvh->root = sibling;
+        bvh->nodes[sibling].parent = BVH_NULL;
+        FreeBVHNode(bvh, parent);
+    }
+}
+
+// Returns the proxy id, object is handed back by queries.
+int AddBVHProxy(BVH *bvh, AABB box, int object) {
+    int result = AllocateBVHNode(bvh);
+
+    BVHNode *node = bvh->nodes + result;
+    node->box = Expand(box, bvh->margin);
+    node->object_box = box;
+    node->object = object;
+
+    InsertBVHLeaf(bvh, result);
+    ++bvh->proxy_count;
+
+    return result;
+}
+
+void RemoveBVHProxy(BVH *bvh, int proxy) {
+    RemoveBVHLeaf(bvh, proxy);
+    FreeBVHNode(bvh, proxy);
+    --bvh->proxy_count;
+}
+
+// Returns true if the tree changed.
+b32 MoveBVHProxy(BVH *bvh, int proxy, AABB box) {
+    BVHNode *node = bvh->nodes + proxy;
+    node->object_box = box;
+
+    if (Contains(node->box, box)) return false;
+
+    AABB old_box = node->box;
+    node->box = Expand(box, bvh->margin);
+
+    if (!Overlaps(old_box, node->box)) {
+        // teleported, the old position in the tree says nothing about the new one
+        RemoveBVHLeaf(bvh, proxy);
+        InsertBVHLeaf(bvh, proxy);
+        return true;
+    }
+
+    for (int index = node->parent; index != BVH_NULL; index = bvh->nodes[index].parent) {
+        AABB refit = Union(bvh->nodes[bvh->nodes[index].children[0]].box, bvh->nodes[bvh->nodes[index].children[1]].box);
+        if (Contains(bvh->nodes[index].box, refit) && Contains(refit, bvh->nodes[index].box)) break;
+        bvh->nodes[index].box = refit;
+    }
+
+    return true;
+}
+
+// Appends the objects of every leaf under index, without testing them.
+static int CollectBVHObjects(BVH *bvh, int index, int *objects, int count, int max_objects) {
+    int stack[BVH_STACK_SIZE];
+    int top = 0;
+    stack[top++] = index;
+
+    while (top && count < max_objects) {
+        BVHNode *node = bvh->nodes + stack[--top];
+        if (IsLeaf(node)) {
+            objects[count++] = node->object;
+        } else {
+            Assert(top + 2 <= BVH_STACK_SIZE);
+            stack[top++] = node->children[0];
+            stack[top++] = node->children[1];
+        }
+    }
+
+    return count;
+}
+
+int QueryBVHFrustum(BVH *bvh, Frustum *frustum, int *objects, int max_objects) {
+    int count = 0;
+    if (bvh->root == BVH_NULL) return count;
+
+    int stack[BVH_STACK_SIZE];
+    int top = 0;
+    stack[top++] = bvh->root;
+
+    while (top && count < max_objects) {
+        int index = stack[--top];
+        BVHNode *node = bvh->nodes + index;
+
+        if (IsLeaf(node)) {
+            if (TestFrustumAABB(frustum, node->object_box) != FrustumOutside) objects[count++] = node->object;
+            continue;
+        }
+
+        FrustumTest test = TestFrustumAABB(frustum, node->box);
+        if (test == FrustumInside) {
+            count = CollectBVHObjects(bvh, index, objects, count, max_objects);
+        } else if (test == FrustumIntersects) {
+            Assert(top + 2 <= BVH_STACK_SIZE);
+            stack[top++] = node->children[0];
+            stack[top++] = node->children[1];
+        }
+    }
+
+    return count;
+}
+
+int QueryBVHOverlap(BVH *bvh, AABB box, int *objects, int max_objects) {
+    int count = 0;
+    if (bvh->root == BVH_NULL) return count;
+
+    int stack[BVH_STACK_SIZE];
+    int top = 0;
+    stack[top++] = bvh->root;
+
+    while (top && count < max_objects) {
+        BVHNode *node = bvh->nodes + stack[--top];
+        if (!Overlaps(node->box, box)) continue;
+
+        if (IsLeaf(node)) {
+            if (Overlaps(node->object_box, box)) objects[count++] = node->object;
+        } else {
+            Assert(top + 2 <= BVH_STACK_SIZE);
+            stack[top++] = node->children[0];
+            stack[top++] = node->children[1];
+        }
+    }
+
+    return count;
+}
+
+// Nearest object whose box the ray hits within max_t, or -1. Writes the hit distance to t.
+int RaycastBVH(BVH *bvh, Ray ray, f32 max_t, f32 *t) {
+    int result = -1;
+    if (bvh->root == BVH_NULL) return result;
+
+    v3 inv_direction = 1.0f / ray.direction;
+    f32 nearest = max_t;
+
+    int stack[BVH_STACK_SIZE];
+    int top = 0;
+    stack[top++] = bvh->root;
+
+    while (top) {
+        BVHNode *node = bvh->nodes + stack[--top];
+
+        if (IsLeaf(node)) {
+            f32 hit = IntersectRayAABB(ray.origin, inv_direction, node->object_box, nearest);
+            if (hit >= 0) {
+                nearest = hit;
+                result = node->object;
+            }
+            continue;
+        }
+
+        // push the far child first so the near one is visited first and tightens nearest early
+        f32 hit0 = IntersectRayAABB(ray.origin, inv_direction, bvh->nodes[node->children[0]].box, nearest);
+        f32 hit1 = IntersectRayAABB(ray.origin, inv_direction, bvh->nodes[node->children[1]].box, nearest);
+        int first = hit1 >= 0 && (hit0 < 0 || hit1 < hit0) ? 1 : 0;
+        f32 first_hit = first ? hit1 : hit0;
+        f32 second_hit = first ? hit0 : hit1;
+
+        Assert(top + 2 <= BVH_STACK_SIZE);
+        if (second_hit >= 0) stack[top++] = node->children[1 - first];
+        if (first_hit >= 0) stack[top++] = node->children[first];
+    }
+
+    if (t) *t = nearest;
+
+    return result;
+}
+
+static f32 RandomUnit(u32 *state) {
+    *state = *state * 1664525u + 1013904223u;
+    f32 result = (*state >> 8) / (f32)(1 << 24);
+    return result;
+}
+
+void BenchmarkBVH() {
+    const int object_count = 100000;
+    const int frame_count = 10;
+    const int ray_count = 10000;
+    const f32 world_size = 1000.0f;
+
+    Arena arena = CreateArena(Megabytes(64));
+    BVH bvh = CreateBVH(&arena, object_count, 0.5f);
+
+    AABB *boxes = (AABB *)ArenaAlloc(&arena, sizeof(AABB) * object_count);
+    int *proxies = (int *)ArenaAlloc(&arena, sizeof(int) * object_count);
+    int *visible = (int *)ArenaAlloc(&arena, sizeof(int) * object_count);
+
+    u32 seed = 12345;
+    for (int i = 0; i < object_count; ++i) {
+        v3 p = v3(RandomUnit(&seed), RandomUnit(&seed), RandomUnit(&seed)) * world_size;
+        boxes[i] = { p - v3(0.5f), p + v3(0.5f) };
+    }
+
+    double start = GetTime();
+    for (int i = 0; i < object_count; ++i) proxies[i] = AddBVHProxy(&bvh, boxes[i], i);
+    double build_seconds = GetTime() - start;
+
+    mat4 projection = perspective(radians(45.0f), 16 / 9.0f, 0.1f, 500.0f);
+    mat4 view = lookAt(v3(world_size * 0.5f, world_size * 0.5f, -50), v3(world_size * 0.5f), v3(0, 1, 0));
+    mat4 view_projection = projection * view;
+    Frustum frustum = ExtractFrustumPlanes(&view_projection);
+
+    double move_seconds = 0, cull_seconds = 0, pick_seconds = 0;
+    int visible_count = 0, hits = 0;
+
+    for (int frame = 0; frame < frame_count; ++frame) {
+        // a tenth of the objects move each frame
+        start = GetTime();
+        for (int i = frame % 10; i < object_count; i += 10) {
+            v3 offset = (v3(RandomUnit(&seed), RandomUnit(&seed), RandomUnit(&seed)) - 0.5f) * 0.6f;
+            boxes[i].min += offset;
+            boxes[i].max += offset;
+            MoveBVHProxy(&bvh, proxies[i], boxes[i]);
+        }
+        move_seconds += GetTime() - start;
+
+        start = GetTime();
+        visible_count = QueryBVHFrustum(&bvh, &frustum, visible, object_count);
+        cull_seconds += GetTime() - start;
+
+        start = GetTime();
+        for (int r = 0; r < ray_count; ++r) {
+            Ray ray = ScreenToRay(RandomUnit(&seed) * 1280, RandomUnit(&seed) * 720, 1280, 720, &view_projection);
+            f32 t;
+            if (RaycastBVH(&bvh, ray, 1000.0f, &t) >= 0) ++hits;
+        }
+        pick_seconds += GetTime() - start;
+    }
+
+    start = GetTime();
+    int brute_force_visible = 0;
+    for (int i = 0; i < object_count; ++i) {
+        if (TestFrustumAABB(&frustum, boxes[i]) != FrustumOutside) ++brute_force_visible;
+    }
+    double brute_force_seconds = GetTime() - start;
+
+    fprintf(stdout, "BVH: %d objects\n", object_count);
+    fprintf(stdout, "  build:  %8.2f ms\n", build_seconds * 1000);
+    fprintf(stdout, "  move:   %8.3f ms/frame (%d objects)\n", move_seconds * 1000 / frame_count, object_count / 10);
+    fprintf(stdout, "  cull:   %8.3f ms/frame (%d visible, brute force %d in %.3f ms)\n",
+            cull_seconds * 1000 / frame_count, visible_count, brute_force_visible, brute_force_seconds * 1000);
+    fprintf(stdout, "  pick:   %8.3f us/ray (%d hits)\n", pick_seconds * 1e6 / ((double)frame_count * ray_count), hits);
+
+    free(arena.base_address);
+}
@@ -0,0 +1,118 @@
+/*
+    Frustum culling stage for draw submission.
+
+    Bounding spheres are kept SoA and tested against the six frustum planes 4 at a time (8 with
+    AVX). The stage writes a compact list of visible indices, so the draw loop only walks objects
+    that survive, and counts how many were tested, culled and drawn.
+*/
+
+#include <float.h>
+
+#ifdef __AVX__
+#define CULLING_BATCH_SIZE 8
+#else
+#define CULLING_BATCH_SIZE 4
+#endif
+
+struct BoundingSpheres {
+    int count;
+    int capacity;
+    f32 *x, *y, *z;
+    f32 *radius; // unused slots have a negative infinite radius so they always fail
+};
+
+struct CullingStats {
+    int tested;
+    int culled;
+    int drawn;
+};
+
+BoundingSpheres PushBoundingSpheres(Arena *arena, int capacity) {
+    capacity = AlignUp(capacity, CULLING_BATCH_SIZE);
+    f32 *data = (f32 *)ArenaAllocAligned(arena, sizeof(f32) * 4 * capacity, 32);
+
+    BoundingSpheres result = {};
+    result.capacity = capacity;
+    result.x = data + 0 * capacity;
+    result.y = data + 1 * capacity;
+    result.z = data + 2 * capacity;
+    result.radius = data + 3 * capacity;
+
+    for (int i = 0; i < capacity; ++i) result.radius[i] = -FLT_MAX;
+
+    return result;
+}
+
+int AddBoundingSphere(BoundingSpheres *spheres, Sphere sphere) {
+    Assert(spheres->count < spheres->capacity);
+
+    int result = spheres->count++;
+    spheres->x[result] = sphere.center.x;
+    spheres->y[result] = sphere.center.y;
+    spheres->z[result] = sphere.center.z;
+    spheres->radius[result] = sphere.radius;
+
+    return result;
+}
+
+void SetBoundingSphere(BoundingSpheres *spheres, int index, Sphere sphere) {
+    spheres->x[index] = sphere.center.x;
+    spheres->y[index] = sphere.center.y;
+    spheres->z[index] = sphere.center.z;
+    spheres->radius[index] = sphere.radius;
+}
+
+// visible needs room for spheres->capacity indices. Returns the visible count.
+int CullSpheres(Frustum *frustum, BoundingSpheres *spheres, int *visible, CullingStats *stats) {
+    ProfileFunction();
+
+    int count = 0;
+
+    for (int i = 0; i < spheres->count; i += CULLING_BATCH_SIZE) {
+#ifdef __AVX__
+        __m256 x = _mm256_load_ps(spheres->x + i);
+        __m256 y = _mm256_load_ps(spheres->y + i);
+        __m256 z = _mm256_load_ps(spheres->z + i);
+        __m256 neg_radius = _mm256_sub_ps(_mm256_setzero_ps(), _mm256_load_ps(spheres->radius + i));
+        __m256 inside = _mm256_castsi256_ps(_mm256_set1_epi32(-1));
+
+        for (int p = 0; p < 6; ++p) {
+            v4 plane = frustum->planes[p];
+            __m256 distance = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(x, _mm256_set1_ps(plane.x)), _mm256_mul_ps(y, _mm256_set1_ps(plane.y))),
+                                            _mm256_add_ps(_mm256_mul_ps(z, _mm256_set1_ps(plane.z)), _mm256_set1_ps(plane.w)));
+            inside = _mm256_and_ps(inside, _mm256_cmp_ps(distance, neg_radius, _CMP_GE_OQ));
+        }
+
+        int mask = _mm256_movemask_ps(inside);
+#else
+        __m128 x = _mm_load_ps(spheres->x + i);
+        __m128 y = _mm_load_ps(spheres->y + i);
+        __m128 z = _mm_load_ps(spheres->z + i);
+        __m128 neg_radius = _mm_sub_ps(_mm_setzero_ps(), _mm_load_ps(spheres->radius + i));
+        __m128 inside = _mm_castsi128_ps(_mm_set1_epi32(-1));
+
+        for (int p = 0; p < 6; ++p) {
+            v4 plane = frustum->planes[p];
+            __m128 distance = _mm_add_ps(_mm_add_ps(_mm_mul_ps(x, _mm_set1_ps(plane.x)), _mm_mul_ps(y, _mm_set1_ps(plane.y))),
+                                         _mm_add_ps(_mm_mul_ps(z, _mm_set1_ps(plane.z)), _mm_set1_ps(plane.w)));
+            inside = _mm_and_ps(inside, _mm_cmpge_ps(distance, neg_radius));
+        }
+
+        int mask = _mm_movemask_ps(inside);
+#endif
+
+        // branchless compaction, always write and only advance on visible lanes
+        for (int lane = 0; lane < CULLING_BATCH_SIZE; ++lane) {
+            visible[count] = i + lane;
+            count += (mask >> lane) & 1;
+        }
+    }
+
+    if (stats) {
+        stats->tested += spheres->count;
+        stats->drawn += count;
+        stats->culled += spheres->count - count;
+    }
+
+    return count;
+}
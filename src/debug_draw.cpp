@@ -0,0 +1,319 @@
+/*
+    Batched debug drawing.
+
+    Lines, points and the shapes built from them (boxes, spheres, frustums, axes) are appended to
+    vertex streams instead of drawn, anywhere in the frame and in world or screen space. The
+    renderer uploads everything once and draws all lines with one glDrawArrays and all points with
+    another, so a few thousand BVH boxes cost the same two draws as one gizmo.
+
+    Depth testing is a per-vertex flag rather than a separate pass: vertices without
+    DebugDepthTest are moved onto the near plane in the vertex shader, so they pass any depth test
+    and show through geometry. Screen space vertices are in pixels with a top left origin and are
+    always on top. The pass doesn't write depth.
+
+    A primitive with a duration stays for that many seconds of simulation time (so replays see
+    the same thing), one with 0 is drawn for the frame it was added in. Primitives that don't fit
+    are counted in dropped and skipped.
+*/
+
+enum DebugDrawFlags {
+    DebugDepthTest = 0x1, // hidden behind geometry, world space only
+    DebugScreenSpace = 0x2, // p is in pixels
+};
+
+struct DebugVertex {
+    v3 p;
+    u32 color; // RGBA8
+    f32 size; // points only
+    u32 flags;
+};
+
+struct DebugDrawStream {
+    int count; // vertices
+    int capacity;
+    DebugVertex *vertices;
+    f32 *lifetimes; // seconds left per primitive, timed streams only
+};
+
+struct DebugDraw {
+    DebugDrawStream lines; // this frame's, two vertices each
+    DebugDrawStream points;
+    DebugDrawStream timed_lines;
+    DebugDrawStream timed_points;
+    u32 dropped;
+};
+
+// What the renderer gets, copied into the snapshot.
+struct DebugDrawList {
+    int line_vertex_count;
+    int point_count;
+    DebugVertex *vertices; // lines, then points
+};
+
+static DebugDrawStream CreateDebugDrawStream(Arena *arena, int capacity, int vertices_per_primitive, b32 timed) {
+    DebugDrawStream result = {};
+    result.capacity = capacity;
+    result.vertices = (DebugVertex *)ArenaAlloc(arena, sizeof(DebugVertex) * capacity);
+    if (timed) result.lifetimes = (f32 *)ArenaAlloc(arena, sizeof(f32) * (capacity / vertices_per_primitive));
+    return result;
+}
+
+DebugDraw CreateDebugDraw(Arena *arena, int max_lines, int max_points, int max_timed_lines, int max_timed_points) {
+    DebugDraw result = {};
+    result.lines = CreateDebugDrawStream(arena, max_lines * 2, 2, false);
+    result.points = CreateDebugDrawStream(arena, max_points, 1, false);
+    result.timed_lines = CreateDebugDrawStream(arena, max_timed_lines * 2, 2, true);
+    result.timed_points = CreateDebugDrawStream(arena, max_timed_points, 1, true);
+    return result;
+}
+
+// Drops the primitives that expired, keeps the order of the rest.
+static void AgeDebugDrawStream(DebugDrawStream *stream, int vertices_per_primitive, f32 delta_time) {
+    int primitive_count = stream->count / vertices_per_primitive;
+    int kept = 0;
+    for (int i = 0; i < primitive_count; ++i) {
+        f32 lifetime = stream->lifetimes[i] - delta_time;
+        if (lifetime <= 0) continue;
+
+        stream->lifetimes[kept] = lifetime;
+        if (kept != i) {
+            memcpy(stream->vertices + kept * vertices_per_primitive, stream->vertices + i * vertices_per_primitive,
+                   sizeof(DebugVertex) * vertices_per_primitive);
+        }
+        ++kept;
+    }
+    stream->count = kept * vertices_per_primitive;
+}
+
+// Simulation thread, before anything is drawn this frame.
+void BeginDebugDrawFrame(DebugDraw *draw, f32 delta_time) {
+    draw->lines.count = 0;
+    draw->points.count = 0;
+    AgeDebugDrawStream(&draw->timed_lines, 2, delta_time);
+    AgeDebugDrawStream(&draw->timed_points, 1, delta_time);
+}
+
+// Room for count vertices in the stream the duration picks, null if it's full.
+static DebugVertex *PushDebugVertices(DebugDraw *draw, b32 line, int count, f32 duration) {
+    DebugDrawStream *stream = duration > 0 ? (line ? &draw->timed_lines : &draw->timed_points) :
+                                             (line ? &draw->lines : &draw->points);
+    if (stream->count + count > stream->capacity) {
+        ++draw->dropped;
+        return 0;
+    }
+
+    if (duration > 0) stream->lifetimes[stream->count / count] = duration;
+    DebugVertex *result = stream->vertices + stream->count;
+    stream->count += count;
+    return result;
+}
+
+void DebugLine(DebugDraw *draw, v3 a, v3 b, v4 color, u32 flags, f32 duration) {
+    DebugVertex *vertices = PushDebugVertices(draw, true, 2, duration);
+    if (!vertices) return;
+
+    u32 packed_color = PackColor(color);
+    vertices[0] = { a, packed_color, 0, flags };
+    vertices[1] = { b, packed_color, 0, flags };
+}
+
+void DebugPoint(DebugDraw *draw, v3 p, f32 size, v4 color, u32 flags, f32 duration) {
+    DebugVertex *vertex = PushDebugVertices(draw, false, 1, duration);
+    if (vertex) *vertex = { p, PackColor(color), size, flags };
+}
+
+// The 12 edges between 8 corners, ordered by bit: x = 1, y = 2, z = 4.
+static void DebugCornerBox(DebugDraw *draw, v3 *corners, v4 color, u32 flags, f32 duration) {
+    static const u8 edges[12][2] = {
+        { 0, 1 }, { 2, 3 }, { 4, 5 }, { 6, 7 }, // along x
+        { 0, 2 }, { 1, 3 }, { 4, 6 }, { 5, 7 }, // along y
+        { 0, 4 }, { 1, 5 }, { 2, 6 }, { 3, 7 }, // along z
+    };
+
+    for (int i = 0; i < 12; ++i) DebugLine(draw, corners[edges[i][0]], corners[edges[i][1]], color, flags, duration);
+}
+
+void DebugBox(DebugDraw *draw, v3 min, v3 max, v4 color, u32 flags, f32 duration) {
+    v3 corners[8];
+    for (int i = 0; i < 8; ++i) {
+        corners[i] = v3(i & 1 ? max.x : min.x, i & 2 ? max.y : min.y, i & 4 ? max.z : min.z);
+    }
+    DebugCornerBox(draw, corners, color, flags, duration);
+}
+
+// The unit cube (-0.5 to 0.5) under transform, the same space as the cube mesh.
+void DebugOrientedBox(DebugDraw *draw, mat4 *transform, v4 color, u32 flags, f32 duration) {
+    v3 corners[8];
+    for (int i = 0; i < 8; ++i) {
+        v4 local = v4(i & 1 ? 0.5f : -0.5f, i & 2 ? 0.5f : -0.5f, i & 4 ? 0.5f : -0.5f, 1);
+        corners[i] = v3(*transform * local);
+    }
+    DebugCornerBox(draw, corners, color, flags, duration);
+}
+
+// Every point view_projection maps inside the clip volume.
+void DebugFrustum(DebugDraw *draw, mat4 *view_projection, v4 color, u32 flags, f32 duration) {
+    mat4 inverse_view_projection = inverse(*view_projection);
+
+    v3 corners[8];
+    for (int i = 0; i < 8; ++i) {
+        v4 ndc = v4(i & 1 ? 1 : -1, i & 2 ? 1 : -1, i & 4 ? 1 : -1, 1);
+        v4 world = inverse_view_projection * ndc;
+        corners[i] = v3(world) / world.w;
+    }
+    DebugCornerBox(draw, corners, color, flags, duration);
+}
+
+#define DEBUG_SPHERE_SEGMENTS 24
+
+// Three great circles.
+void DebugSphere(DebugDraw *draw, v3 center, f32 radius, v4 color, u32 flags, f32 duration) {
+    v3 previous[3];
+    for (int i = 0; i <= DEBUG_SPHERE_SEGMENTS; ++i) {
+        f32 angle = i * (2.0f * 3.14159265f / DEBUG_SPHERE_SEGMENTS);
+        f32 c = cosf(angle) * radius;
+        f32 s = sinf(angle) * radius;
+
+        v3 points[3] = { center + v3(c, s, 0), center + v3(0, c, s), center + v3(s, 0, c) };
+        if (i) {
+            for (int circle = 0; circle < 3; ++circle) DebugLine(draw, previous[circle], points[circle], color, flags, duration);
+        }
+        for (int circle = 0; circle < 3; ++circle) previous[circle] = points[circle];
+    }
+}
+
+// Red, green and blue for the basis' x, y and z.
+void DebugAxes(DebugDraw *draw, v3 origin, mat3 *basis, f32 length, u32 flags, f32 duration) {
+    DebugLine(draw, origin, origin + (*basis)[0] * length, v4(1, 0, 0, 1), flags, duration);
+    DebugLine(draw, origin, origin + (*basis)[1] * length, v4(0, 1, 0, 1), flags, duration);
+    DebugLine(draw, origin, origin + (*basis)[2] * length, v4(0, 0, 1, 1), flags, duration);
+}
+
+void DebugScreenLine(DebugDraw *draw, v2 a, v2 b, v4 color, f32 duration) {
+    DebugLine(draw, v3(a, 0), v3(b, 0), color, DebugScreenSpace, duration);
+}
+
+void DebugScreenRect(DebugDraw *draw, f32 left, f32 right, f32 top, f32 bottom, v4 color, f32 duration) {
+    DebugScreenLine(draw, v2(left, top), v2(right, top), color, duration);
+    DebugScreenLine(draw, v2(right, top), v2(right, bottom), color, duration);
+    DebugScreenLine(draw, v2(right, bottom), v2(left, bottom), color, duration);
+    DebugScreenLine(draw, v2(left, bottom), v2(left, top), color, duration);
+}
+
+void DebugScreenPoint(DebugDraw *draw, v2 p, f32 size, v4 color, f32 duration) {
+    DebugPoint(draw, v3(p, 0), size, color, DebugScreenSpace, duration);
+}
+
+static GLuint debug_draw_vao;
+static GLuint debug_draw_vbo;
+static GLuint debug_draw_program;
+static int debug_draw_view_projection_location;
+static int debug_draw_screen_size_location;
+static int debug_draw_vbo_capacity; // vertices
+
+static void InitDebugDrawRenderer() {
+    glGenVertexArrays(1, &debug_draw_vao);
+    glGenBuffers(1, &debug_draw_vbo);
+    glBindVertexArray(debug_draw_vao);
+    glBindBuffer(GL_ARRAY_BUFFER, debug_draw_vbo);
+    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(DebugVertex), 0);
+    glEnableVertexAttribArray(0);
+    glVertexAttribPointer(1, 4, GL_UNSIGNED_BYTE, GL_TRUE, sizeof(DebugVertex), (void *)offsetof(DebugVertex, color));
+    glEnableVertexAttribArray(1);
+    glVertexAttribPointer(2, 1, GL_FLOAT, GL_FALSE, sizeof(DebugVertex), (void *)offsetof(DebugVertex, size));
+    glEnableVertexAttribArray(2);
+    glVertexAttribIPointer(3, 1, GL_UNSIGNED_INT, sizeof(DebugVertex), (void *)offsetof(DebugVertex, flags));
+    glEnableVertexAttribArray(3);
+    glBindVertexArray(0);
+
+    const char *vertex_source = R"(
+        #version 460
+        layout (location = 0) in vec3 p;
+        layout (location = 1) in vec4 color;
+        layout (location = 2) in float size;
+        layout (location = 3) in uint flags;
+
+        uniform mat4 view_projection;
+        uniform vec2 screen_size;
+
+        out vec4 vcolor;
+
+        void main() {
+            if ((flags & 2u) != 0u) {
+                gl_Position = vec4(p.x / screen_size.x * 2.0 - 1.0, 1.0 - p.y / screen_size.y * 2.0, 0.0, 1.0);
+            } else {
+                gl_Position = view_projection * vec4(p, 1.0);
+            }
+
+            // on the near plane, passes every depth test. Still clipped when behind the eye
+            if ((flags & 1u) == 0u) gl_Position.z = -gl_Position.w;
+
+            gl_PointSize = size;
+            vcolor = color;
+        }
+    )";
+
+    const char *frag_source = R"(
+        #version 460
+
+        in vec4 vcolor;
+        out vec4 frag_color;
+
+        void main() {
+            frag_color = vcolor;
+        }
+    )";
+
+    GLuint vs = glCreateShader(GL_VERTEX_SHADER);
+    glShaderSource(vs, 1, &vertex_source, 0);
+    CompileShader(vs);
+
+    GLuint fs = glCreateShader(GL_FRAGMENT_SHADER);
+    glShaderSource(fs, 1, &frag_source, 0);
+    CompileShader(fs);
+
+    debug_draw_program = glCreateProgram();
+    glAttachShader(debug_draw_program, vs);
+    glAttachShader(debug_draw_program, fs);
+    LinkProgram(debug_draw_program);
+    glDeleteShader(vs);
+    glDeleteShader(fs);
+
+    debug_draw_view_projection_location = glGetUniformLocation(debug_draw_program, "view_projection");
+    debug_draw_screen_size_location = glGetUniformLocation(debug_draw_program, "screen_size");
+}
+
+// Main thread. One upload, one draw for the lines and one for the points. Leaves depth test on.
+void SubmitDebugDraw(DebugDrawList *list, mat4 *view_projection) {
+    ProfileFunction();
+
+    int vertex_count = list->line_vertex_count + list->point_count;
+    if (!vertex_count) return;
+
+    if (!debug_draw_program) InitDebugDrawRenderer();
+
+    int fb_width, fb_height;
+    GetWindowFramebufferSize(&fb_width, &fb_height);
+
+    glBindBuffer(GL_ARRAY_BUFFER, debug_draw_vbo);
+    if (vertex_count > debug_draw_vbo_capacity) {
+        debug_draw_vbo_capacity = vertex_count * 2;
+        glBufferData(GL_ARRAY_BUFFER, sizeof(DebugVertex) * debug_draw_vbo_capacity, 0, GL_STREAM_DRAW);
+    }
+    glBufferSubData(GL_ARRAY_BUFFER, 0, sizeof(DebugVertex) * vertex_count, list->vertices);
+
+    glEnable(GL_DEPTH_TEST);
+    glDepthMask(GL_FALSE);
+    glEnable(GL_PROGRAM_POINT_SIZE);
+
+    glUseProgram(debug_draw_program);
+    glUniformMatrix4fv(debug_draw_view_projection_location, 1, GL_FALSE, (f32 *)view_projection);
+    glUniform2f(debug_draw_screen_size_location, (f32)fb_width, (f32)fb_height);
+    glBindVertexArray(debug_draw_vao);
+    if (list->line_vertex_count) glDrawArrays(GL_LINES, 0, list->line_vertex_count);
+    if (list->point_count) glDrawArrays(GL_POINTS, list->line_vertex_count, list->point_count);
+    glBindVertexArray(0);
+
+    glDisable(GL_PROGRAM_POINT_SIZE);
+    glDepthMask(GL_TRUE);
+}
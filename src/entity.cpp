@@ -0,0 +1,465 @@
+/*
+    Sparse set entity component system.
+
+    An entity is an index plus a generation. Every component type has a ComponentStore: a sparse
+    array from entity index to a dense slot and dense SoA columns, so a system walks contiguous
+    memory and removal is a swap with the last slot. Views iterate the dense slots of one store and
+    skip entities missing from the others; systems take a [first, one_past_last) slot range so a
+    pass can be split across threads. Ranges only write their own slots and nodes: MoveEntities
+    returns the lowest node it dirtied for the caller to fold into the hierarchy after the join,
+    and ExtractRenderables flags the proxies to move for the serial UpdateRenderProxies.
+
+    Transforms are nodes in the TransformHierarchy (already SoA with dirty flags), owned by their
+    entity. The render store keeps its world bounding spheres as columns so the culling stage reads
+    them in place.
+*/
+
+typedef u32 Entity;
+
+#define ENTITY_INDEX_BITS 24
+#define ENTITY_INDEX_MASK ((1u << ENTITY_INDEX_BITS) - 1)
+#define NULL_ENTITY 0xffffffffu
+#define EMPTY_SLOT 0xffffffffu
+#define MAX_COMPONENT_COLUMNS 12
+
+struct ComponentStore {
+    int count;
+    int capacity;
+    u32 *sparse; // entity index -> slot
+    Entity *entities; // slot -> entity
+
+    int column_count;
+    u32 column_sizes[MAX_COMPONENT_COLUMNS];
+    u8 *columns[MAX_COMPONENT_COLUMNS];
+};
+
+enum ComponentType {
+    TransformComponent,
+    VelocityComponent,
+    RenderComponent,
+    ComponentTypeCount,
+};
+
+enum TransformColumn { TransformNode };
+enum VelocityColumn { VelocityX, VelocityY, VelocityZ };
+enum RenderColumn {
+    RenderMesh,
+    RenderColor,
+    RenderLocalBounds,
+    RenderProxy,
+    RenderProxyMoved, // world bounds changed since UpdateRenderProxies
+    RenderWorldBounds,
+    RenderBoundsFrame, // hierarchy frame the world bounds were computed for
+    RenderSphereX,
+    RenderSphereY,
+    RenderSphereZ,
+    RenderSphereRadius,
+};
+
+#define GetColumn(store, type, column) ((type *)(store)->columns[column])
+
+struct EntityWorld {
+    int capacity;
+    u8 *generations;
+    u32 *free_indices;
+    int free_count;
+    u32 next_index;
+    int alive_count;
+
+    ComponentStore stores[ComponentTypeCount];
+};
+
+// Iterates the dense slots of stores[0], keeping entities that have every other store.
+struct EntityView {
+    ComponentStore *stores[4];
+    int store_count;
+};
+
+inline u32 GetEntityIndex(Entity entity) {
+    return entity & ENTITY_INDEX_MASK;
+}
+
+inline u32 GetEntityGeneration(Entity entity) {
+    return entity >> ENTITY_INDEX_BITS;
+}
+
+static void AddComponentColumn(Arena *arena, ComponentStore *store, u32 size) {
+    Assert(store->column_count < MAX_COMPONENT_COLUMNS);
+
+    int column = store->column_count++;
+    store->column_sizes[column] = size;
+    // padded so SIMD passes can read whole batches past the last slot
+    store->columns[column] = (u8 *)ArenaAllocAligned(arena, size * AlignUp(store->capacity, 8), 32);
+}
+
+static void InitComponentStore(Arena *arena, ComponentStore *store, int capacity, u32 *column_sizes, int column_count) {
+    *store = {};
+    store->capacity = capacity;
+    store->sparse = (u32 *)ArenaAlloc(arena, sizeof(u32) * capacity);
+    store->entities = (Entity *)ArenaAlloc(arena, sizeof(Entity) * capacity);
+    memset(store->sparse, 0xff, sizeof(u32) * capacity);
+
+    for (int i = 0; i < column_count; ++i) {
+        AddComponentColumn(arena, store, column_sizes[i]);
+    }
+}
+
+EntityWorld CreateEntityWorld(Arena *arena, int capacity) {
+    Assert(capacity <= (int)ENTITY_INDEX_MASK);
+
+    EntityWorld result = {};
+    result.capacity = capacity;
+    result.generations = (u8 *)ArenaAlloc(arena, sizeof(u8) * capacity);
+    result.free_indices = (u32 *)ArenaAlloc(arena, sizeof(u32) * capacity);
+
+    u32 transform_columns[] = { sizeof(int) };
+    u32 velocity_columns[] = { sizeof(f32), sizeof(f32), sizeof(f32) };
+    u32 render_columns[] = { sizeof(Mesh), sizeof(v4), sizeof(AABB), sizeof(int), sizeof(u8), sizeof(AABB),
+                             sizeof(u32), sizeof(f32), sizeof(f32), sizeof(f32), sizeof(f32) };
+
+    InitComponentStore(arena, &result.stores[TransformComponent], capacity, transform_columns, ArrayCount(transform_columns));
+    InitComponentStore(arena, &result.stores[VelocityComponent], capacity, velocity_columns, ArrayCount(velocity_columns));
+    InitComponentStore(arena, &result.stores[RenderComponent], capacity, render_columns, ArrayCount(render_columns));
+
+    return result;
+}
+
+Entity CreateEntity(EntityWorld *world) {
+    u32 index;
+    if (world->free_count) {
+        index = world->free_indices[--world->free_count];
+    } else {
+        Assert((int)world->next_index < world->capacity);
+        index = world->next_index++;
+    }
+
+    ++world->alive_count;
+
+    Entity result = ((u32)world->generations[index] << ENTITY_INDEX_BITS) | index;
+    return result;
+}
+
+b32 IsEntityAlive(EntityWorld *world, Entity entity) {
+    u32 index = GetEntityIndex(entity);
+    b32 result = entity != NULL_ENTITY && index < world->next_index && world->generations[index] == GetEntityGeneration(entity);
+    return result;
+}
+
+u32 GetComponentSlot(ComponentStore *store, Entity entity) {
+    return store->sparse[GetEntityIndex(entity)];
+}
+
+b32 HasComponent(ComponentStore *store, Entity entity) {
+    return store->sparse[GetEntityIndex(entity)] != EMPTY_SLOT;
+}
+
+// Returns the new slot, its columns are zeroed.
+u32 AddComponent(EntityWorld *world, ComponentType type, Entity entity) {
+    Assert(IsEntityAlive(world, entity));
+
+    ComponentStore *store = &world->stores[type];
+    u32 index = GetEntityIndex(entity);
+    Assert(store->sparse[index] == EMPTY_SLOT);
+    Assert(store->count < store->capacity);
+
+    u32 slot = store->count++;
+    store->sparse[index] = slot;
+    store->entities[slot] = entity;
+
+    for (int c = 0; c < store->column_count; ++c) {
+        memset(store->columns[c] + slot * store->column_sizes[c], 0, store->column_sizes[c]);
+    }
+
+    return slot;
+}
+
+void RemoveComponent(EntityWorld *world, ComponentType type, Entity entity) {
+    ComponentStore *store = &world->stores[type];
+    u32 index = GetEntityIndex(entity);
+    u32 slot = store->sparse[index];
+    if (slot == EMPTY_SLOT) return;
+
+    // move the last slot into the hole
+    u32 last = --store->count;
+    if (slot != last) {
+        for (int c = 0; c < store->column_count; ++c) {
+            u32 size = store->column_sizes[c];
+            memcpy(store->columns[c] + slot * size, store->columns[c] + last * size, size);
+        }
+
+        Entity moved = store->entities[last];
+        store->entities[slot] = moved;
+        store->sparse[GetEntityIndex(moved)] = slot;
+    }
+
+    store->sparse[index] = EMPTY_SLOT;
+}
+
+EntityView CreateEntityView(EntityWorld *world, ComponentType driver, ComponentType with0 = ComponentTypeCount,
+                            ComponentType with1 = ComponentTypeCount) {
+    EntityView result = {};
+    result.stores[result.store_count++] = &world->stores[driver];
+    if (with0 != ComponentTypeCount) result.stores[result.store_count++] = &world->stores[with0];
+    if (with1 != ComponentTypeCount) result.stores[result.store_count++] = &world->stores[with1];
+    return result;
+}
+
+inline int GetViewSlotCount(EntityView *view) {
+    return view->stores[0]->count;
+}
+
+inline b32 ViewContains(EntityView *view, u32 slot) {
+    Entity entity = view->stores[0]->entities[slot];
+    for (int i = 1; i < view->store_count; ++i) {
+        if (!HasComponent(view->stores[i], entity)) return false;
+    }
+    return true;
+}
+
+inline int GetTransformNode(EntityWorld *world, Entity entity) {
+    ComponentStore *transforms = &world->stores[TransformComponent];
+    int result = GetColumn(transforms, int, TransformNode)[GetComponentSlot(transforms, entity)];
+    return result;
+}
+
+// Frees the entity's transform node (its children move up to its parent) and BVH proxy.
+void DestroyEntity(EntityWorld *world, TransformHierarchy *h, BVH *bvh, Entity entity) {
+    if (!IsEntityAlive(world, entity)) return;
+
+    ComponentStore *renderables = &world->stores[RenderComponent];
+    if (HasComponent(renderables, entity)) {
+        int proxy = GetColumn(renderables, int, RenderProxy)[GetComponentSlot(renderables, entity)];
+        if (proxy >= 0) RemoveBVHProxy(bvh, proxy);
+    }
+    if (HasComponent(&world->stores[TransformComponent], entity)) {
+        RemoveTransform(h, GetTransformNode(world, entity));
+    }
+
+    for (int type = 0; type < ComponentTypeCount; ++type) {
+        RemoveComponent(world, (ComponentType)type, entity);
+    }
+
+    u32 index = GetEntityIndex(entity);
+    ++world->generations[index];
+    world->free_indices[world->free_count++] = index;
+    --world->alive_count;
+}
+
+Entity CreateTransformEntity(EntityWorld *world, TransformHierarchy *h, int parent_node) {
+    Entity result = CreateEntity(world);
+    u32 slot = AddComponent(world, TransformComponent, result);
+    GetColumn(&world->stores[TransformComponent], int, TransformNode)[slot] = AddTransform(h, parent_node, result);
+    return result;
+}
+
+// Reparenting under a later node re-sorts part of the hierarchy, the nodes of the entities in
+// that range are looked up again from the hierarchy's owners.
+void SetEntityParent(EntityWorld *world, TransformHierarchy *h, Entity entity, Entity parent) {
+    int node = GetTransformNode(world, entity);
+    int parent_node = parent == NULL_ENTITY ? NO_PARENT : GetTransformNode(world, parent);
+    ReparentTransform(h, node, parent_node);
+
+    ComponentStore *transforms = &world->stores[TransformComponent];
+    int *nodes = GetColumn(transforms, int, TransformNode);
+    for (int i = node; i <= parent_node; ++i) {
+        if (IsTransformFree(h, i)) continue;
+        nodes[GetComponentSlot(transforms, (Entity)h->owners[i])] = i;
+    }
+}
+
+void SetEntityVelocity(EntityWorld *world, Entity entity, v3 velocity) {
+    ComponentStore *store = &world->stores[VelocityComponent];
+    u32 slot = HasComponent(store, entity) ? GetComponentSlot(store, entity) : AddComponent(world, VelocityComponent, entity);
+
+    GetColumn(store, f32, VelocityX)[slot] = velocity.x;
+    GetColumn(store, f32, VelocityY)[slot] = velocity.y;
+    GetColumn(store, f32, VelocityZ)[slot] = velocity.z;
+}
+
+void AddRenderComponent(EntityWorld *world, Entity entity, Mesh mesh, AABB local_bounds, v4 color) {
+    ComponentStore *store = &world->stores[RenderComponent];
+    u32 slot = AddComponent(world, RenderComponent, entity);
+
+    GetColumn(store, Mesh, RenderMesh)[slot] = mesh;
+    GetColumn(store, v4, RenderColor)[slot] = color;
+    GetColumn(store, AABB, RenderLocalBounds)[slot] = local_bounds;
+    GetColumn(store, int, RenderProxy)[slot] = -1;
+}
+
+// Movement: integrates velocity into the local position of the entity's transform node. Marks the
+// nodes dirty but leaves h->first_dirty alone, returns the lowest node it marked (h->capacity for
+// none) for the caller to fold in once every range is done.
+int MoveEntities(EntityWorld *world, TransformHierarchy *h, f32 dt, int first, int one_past_last) {
+    ProfileFunction();
+
+    int first_dirty = h->capacity;
+
+    EntityView view = CreateEntityView(world, VelocityComponent, TransformComponent);
+    ComponentStore *velocities = view.stores[0];
+
+    f32 *vx = GetColumn(velocities, f32, VelocityX);
+    f32 *vy = GetColumn(velocities, f32, VelocityY);
+    f32 *vz = GetColumn(velocities, f32, VelocityZ);
+
+    for (int slot = first; slot < one_past_last; ++slot) {
+        if (vx[slot] == 0 && vy[slot] == 0 && vz[slot] == 0) continue;
+        if (!ViewContains(&view, slot)) continue;
+
+        int node = GetTransformNode(world, velocities->entities[slot]);
+        h->local.tx[node] += vx[slot] * dt;
+        h->local.ty[node] += vy[slot] * dt;
+        h->local.tz[node] += vz[slot] * dt;
+        h->dirty[node] = 1;
+        first_dirty = Min(first_dirty, node);
+    }
+
+    return first_dirty;
+}
+
+// Render extraction: refreshes the world bounds of renderables whose transform changed and flags
+// their BVH proxies for UpdateRenderProxies.
+void ExtractRenderables(EntityWorld *world, TransformHierarchy *h, int first, int one_past_last) {
+    ProfileFunction();
+
+    EntityView view = CreateEntityView(world, RenderComponent, TransformComponent);
+    ComponentStore *renderables = view.stores[0];
+
+    AABB *local_bounds = GetColumn(renderables, AABB, RenderLocalBounds);
+    u8 *proxies_moved = GetColumn(renderables, u8, RenderProxyMoved);
+    AABB *world_bounds = GetColumn(renderables, AABB, RenderWorldBounds);
+    u32 *bounds_frames = GetColumn(renderables, u32, RenderBoundsFrame);
+    f32 *sx = GetColumn(renderables, f32, RenderSphereX);
+    f32 *sy = GetColumn(renderables, f32, RenderSphereY);
+    f32 *sz = GetColumn(renderables, f32, RenderSphereZ);
+    f32 *radius = GetColumn(renderables, f32, RenderSphereRadius);
+
+    for (int slot = first; slot < one_past_last; ++slot) {
+        if (!ViewContains(&view, slot)) {
+            radius[slot] = -FLT_MAX;
+            continue;
+        }
+
+        Entity entity = renderables->entities[slot];
+        int node = GetTransformNode(world, entity);
+        if (h->world_frame[node] <= bounds_frames[slot]) continue;
+
+        AABB box = TransformAABB(local_bounds[slot], GetWorldTransform(h, node));
+        Sphere sphere = GetBoundingSphere(box);
+        sx[slot] = sphere.center.x;
+        sy[slot] = sphere.center.y;
+        sz[slot] = sphere.center.z;
+        radius[slot] = sphere.radius;
+        bounds_frames[slot] = h->world_frame[node];
+        world_bounds[slot] = box;
+        proxies_moved[slot] = 1;
+    }
+
+    // the SIMD culling pass reads whole batches, make sure stale slots past the end never pass
+    for (int slot = renderables->count; slot < AlignUp(renderables->count, 8); ++slot) {
+        radius[slot] = -FLT_MAX;
+    }
+}
+
+// Creates or moves the BVH proxies of the renderables ExtractRenderables flagged, after every
+// range of it is done.
+void UpdateRenderProxies(EntityWorld *world, BVH *bvh) {
+    ProfileFunction();
+
+    ComponentStore *renderables = &world->stores[RenderComponent];
+    int *proxies = GetColumn(renderables, int, RenderProxy);
+    u8 *proxies_moved = GetColumn(renderables, u8, RenderProxyMoved);
+    AABB *world_bounds = GetColumn(renderables, AABB, RenderWorldBounds);
+
+    for (int slot = 0; slot < renderables->count; ++slot) {
+        if (!proxies_moved[slot]) continue;
+        proxies_moved[slot] = 0;
+
+        if (proxies[slot] < 0) proxies[slot] = AddBVHProxy(bvh, world_bounds[slot], (int)renderables->entities[slot]);
+        else MoveBVHProxy(bvh, proxies[slot], world_bounds[slot]);
+    }
+}
+
+// View of the render store's world spheres for CullSpheres, indices are render slots.
+BoundingSpheres GetRenderBounds(EntityWorld *world) {
+    ComponentStore *renderables = &world->stores[RenderComponent];
+
+    BoundingSpheres result = {};
+    result.count = renderables->count;
+    result.capacity = AlignUp(renderables->capacity, 8);
+    result.x = GetColumn(renderables, f32, RenderSphereX);
+    result.y = GetColumn(renderables, f32, RenderSphereY);
+    result.z = GetColumn(renderables, f32, RenderSphereZ);
+    result.radius = GetColumn(renderables, f32, RenderSphereRadius);
+
+    return result;
+}
+
+void BenchmarkEntities() {
+    const int entity_count = 100000;
+    const int frame_count = 10;
+
+    Arena arena = CreateArena(Megabytes(128));
+    EntityWorld world = CreateEntityWorld(&arena, entity_count);
+    TransformHierarchy h = CreateTransformHierarchy(&arena, entity_count);
+
+    Mesh mesh = {};
+    AABB bounds = { v3(-0.5f), v3(0.5f) };
+
+    for (int i = 0; i < entity_count; ++i) {
+        Entity entity = CreateTransformEntity(&world, &h, NO_PARENT);
+        SetLocalPosition(&h, GetTransformNode(&world, entity), v3((f32)(i % 316), 0, (f32)(i / 316)));
+        AddRenderComponent(&world, entity, mesh, bounds, v4(1));
+
+        // a quarter of the entities move
+        if (i % 4 == 0) SetEntityVelocity(&world, entity, v3(1, 0, 0));
+    }
+
+    UpdateTransforms(&h);
+    ExtractRenderables(&world, &h, 0, world.stores[RenderComponent].count);
+
+    mat4 view_projection = perspective(radians(45.0f), 16 / 9.0f, 0.1f, 200.0f) * lookAt(v3(158, 50, -20), v3(158, 0, 100), v3(0, 1, 0));
+    Frustum frustum = ExtractFrustumPlanes(&view_projection);
+    int *visible = (int *)ArenaAlloc(&arena, sizeof(int) * AlignUp(entity_count, 8));
+
+    double move_seconds = 0, transform_seconds = 0, extract_seconds = 0, cull_seconds = 0;
+    int visible_count = 0;
+
+    for (int frame = 0; frame < frame_count; ++frame) {
+        double start = GetTime();
+        int first_dirty = MoveEntities(&world, &h, 1 / 60.0f, 0, world.stores[VelocityComponent].count);
+        h.first_dirty = Min(h.first_dirty, first_dirty);
+        double moved = GetTime();
+        UpdateTransforms(&h);
+        double transformed = GetTime();
+        ExtractRenderables(&world, &h, 0, world.stores[RenderComponent].count);
+        double extracted = GetTime();
+        BoundingSpheres spheres = GetRenderBounds(&world);
+        visible_count = CullSpheres(&frustum, &spheres, visible, 0);
+        double culled = GetTime();
+
+        move_seconds += moved - start;
+        transform_seconds += transformed - moved;
+        extract_seconds += extracted - transformed;
+        cull_seconds += culled - extracted;
+    }
+
+    fprintf(stdout, "Entities: %d (%d moving)\n", entity_count, world.stores[VelocityComponent].count);
+    fprintf(stdout, "  move:      %7.3f ms/frame\n", move_seconds * 1000 / frame_count);
+    fprintf(stdout, "  transform: %7.3f ms/frame\n", transform_seconds * 1000 / frame_count);
+    fprintf(stdout, "  extract:   %7.3f ms/frame\n", extract_seconds * 1000 / frame_count);
+    fprintf(stdout, "  cull:      %7.3f ms/frame (%d visible)\n", cull_seconds * 1000 / frame_count, visible_count);
+
+    // every renderable gets a proxy, destroying one has to take its leaf and node with it
+    BVH bvh = CreateBVH(&arena, entity_count, 0.1f);
+    double start = GetTime();
+    UpdateRenderProxies(&world, &bvh);
+    double proxy_seconds = GetTime() - start;
+    fprintf(stdout, "  proxies:   %7.3f ms (%d built)\n", proxy_seconds * 1000, bvh.proxy_count);
+
+    int proxy_count = bvh.proxy_count;
+    DestroyEntity(&world, &h, &bvh, world.stores[RenderComponent].entities[0]);
+    Assert(bvh.proxy_count == proxy_count - 1);
+    Assert(h.free_count == 1);
+
+    free(arena.base_address);
+}
@@ -0,0 +1,629 @@
+/*
+    Glyph atlas text.
+
+    Glyphs are rasterized with stb_truetype the first time they're drawn and copied into the
+    font's single channel atlas texture, so only the characters actually used are ever baked.
+    The atlas is shelf packed: rows of glyphs, each new glyph goes on the first shelf tall enough
+    for it (and not much taller), otherwise a new shelf is opened below the last one. When the
+    atlas or the glyph table is full everything is thrown away and baked again as it's drawn,
+    which for a debug font at one size never happens in practice.
+
+    Glyph metrics and atlas rects live in a flat open addressed hash keyed by codepoint, a lookup
+    is a multiply and usually one probe.
+
+    PushText only appends quads to the font's batch. FlushText uploads the batch and draws it in
+    one call, so everything printed with a font between flushes is a single draw no matter how
+    many strings it was.
+
+    A font loaded with LoadSdfFont bakes signed distance fields instead of coverage (stbtt's SDF
+    rasterizer, edge at 0.5, FONT_SDF_SPREAD texels of falloff each side) and draws them with a
+    shader that thresholds the distance at whatever scale the quad ends up. One bake size serves
+    every zoom level, so the atlas and the bake count don't change when text is scaled.
+    Coverage fonts are crisper at their own size, SDF fonts are for text that scales.
+*/
+
+#include <stdarg.h>
+
+#define FONT_ATLAS_SIZE 512
+#define FONT_GLYPH_SLOT_BITS 10
+#define FONT_GLYPH_SLOTS (1 << FONT_GLYPH_SLOT_BITS)
+#define FONT_MAX_SHELVES 64
+#define FONT_MAX_QUADS 16384 // per flush, a full batch flushes early
+#define FONT_GLYPH_PADDING 1 // empty texels around each glyph so linear filtering doesn't bleed
+#define FONT_SDF_SPREAD 4 // texels of distance field outside and inside the outline
+
+struct Glyph {
+    u32 key; // codepoint + 1, 0 is an empty slot
+    u16 atlas_x;
+    u16 atlas_y;
+    u16 width; // including padding
+    u16 height;
+    f32 x_offset; // from the pen position to the top left of the quad
+    f32 y_offset;
+    f32 advance;
+};
+
+struct FontShelf {
+    int y;
+    int height;
+    int x; // next free column
+};
+
+struct TextVertex {
+    v2 p; // pixels, top left origin
+    v2 uv;
+    u32 color; // RGBA8
+};
+
+struct Font {
+    b32 loaded;
+    b32 sdf;
+    u8 *file_data;
+    stbtt_fontinfo info;
+
+    f32 pixel_height; // the size glyphs are baked at
+    f32 scale;
+    f32 ascent; // pixels above the baseline
+    f32 line_height;
+
+    GLuint texture;
+    int shelf_count;
+    FontShelf shelves[FONT_MAX_SHELVES];
+
+    int glyph_count;
+    Glyph glyphs[FONT_GLYPH_SLOTS];
+
+    u8 *bake_buffer; // big enough for the largest glyph in the font
+    int bake_buffer_size;
+
+    GLuint vao;
+    GLuint vbo;
+    GLuint ibo;
+    int quad_count;
+    TextVertex *vertices; // 4 per quad
+
+    u32 glyphs_baked; // since load, including rebakes
+    u32 atlas_resets;
+    u32 draw_calls;
+};
+
+static GLuint text_program;
+static GLuint text_sdf_program;
+static int text_screen_size_location;
+static int text_sdf_screen_size_location;
+
+static GLuint CreateTextProgram(const char *vertex_source, const char *frag_source) {
+    GLuint vs = glCreateShader(GL_VERTEX_SHADER);
+    glShaderSource(vs, 1, &vertex_source, 0);
+    CompileShader(vs);
+
+    GLuint fs = glCreateShader(GL_FRAGMENT_SHADER);
+    glShaderSource(fs, 1, &frag_source, 0);
+    CompileShader(fs);
+
+    GLuint program = glCreateProgram();
+    glAttachShader(program, vs);
+    glAttachShader(program, fs);
+    LinkProgram(program);
+    glDeleteShader(vs);
+    glDeleteShader(fs);
+
+    return program;
+}
+
+static void InitTextPrograms() {
+    const char *vertex_source = R"(
+        #version 460
+        layout (location = 0) in vec2 p;
+        layout (location = 1) in vec2 uv;
+        layout (location = 2) in vec4 color;
+
+        uniform vec2 screen_size;
+
+        out vec2 vuv;
+        out vec4 vcolor;
+
+        void main() {
+            gl_Position = vec4(p.x / screen_size.x * 2.0 - 1.0, 1.0 - p.y / screen_size.y * 2.0, 0.0, 1.0);
+            vuv = uv;
+            vcolor = color;
+        }
+    )";
+
+    const char *frag_source = R"(
+        #version 460
+
+        in vec2 vuv;
+        in vec4 vcolor;
+
+        out vec4 frag_color;
+
+        uniform sampler2D atlas;
+
+        void main() {
+            frag_color = vec4(vcolor.rgb, vcolor.a * texture(atlas, vuv).r);
+        }
+    )";
+
+    // fwidth keeps the edge one screen pixel wide at any magnification
+    const char *sdf_frag_source = R"(
+        #version 460
+
+        in vec2 vuv;
+        in vec4 vcolor;
+
+        out vec4 frag_color;
+
+        uniform sampler2D atlas;
+
+        void main() {
+            float distance = texture(atlas, vuv).r;
+            float width = max(fwidth(distance) * 0.5, 1.0 / 255.0);
+            float coverage = smoothstep(0.5 - width, 0.5 + width, distance);
+            frag_color = vec4(vcolor.rgb, vcolor.a * coverage);
+        }
+    )";
+
+    text_program = CreateTextProgram(vertex_source, frag_source);
+    text_screen_size_location = glGetUniformLocation(text_program, "screen_size");
+
+    text_sdf_program = CreateTextProgram(vertex_source, sdf_frag_source);
+    text_sdf_screen_size_location = glGetUniformLocation(text_sdf_program, "screen_size");
+}
+
+static void ResetFontAtlas(Font *font) {
+    font->shelf_count = 0;
+    font->glyph_count = 0;
+    memset(font->glyphs, 0, sizeof(font->glyphs));
+}
+
+// Main thread, needs the GL context. pixel_height is the ascent to descent height glyphs are
+// baked at.
+bool LoadFont(Font *font, const char *filename, f32 pixel_height) {
+    ProfileFunction();
+
+    *font = {};
+
+    FILE *file = fopen(filename, "rb");
+    if (!file) {
+        fprintf(stderr, "Error: unable to open font %s\n", filename);
+        return false;
+    }
+
+    fseek(file, 0, SEEK_END);
+    long size = ftell(file);
+    rewind(file);
+    font->file_data = (u8 *)malloc(size);
+    bool read = fread(font->file_data, size, 1, file) == 1;
+    fclose(file);
+
+    if (!read || !stbtt_InitFont(&font->info, font->file_data, stbtt_GetFontOffsetForIndex(font->file_data, 0))) {
+        fprintf(stderr, "Error: %s is not a TrueType font\n", filename);
+        free(font->file_data);
+        font->file_data = 0;
+        return false;
+    }
+
+    int ascent, descent, line_gap;
+    stbtt_GetFontVMetrics(&font->info, &ascent, &descent, &line_gap);
+    font->pixel_height = pixel_height;
+    font->scale = stbtt_ScaleForPixelHeight(&font->info, pixel_height);
+    font->ascent = ascent * font->scale;
+    font->line_height = (ascent - descent + line_gap) * font->scale;
+
+    int x0, y0, x1, y1;
+    stbtt_GetFontBoundingBox(&font->info, &x0, &y0, &x1, &y1);
+    int max_width = (int)((x1 - x0) * font->scale) + 2 + FONT_GLYPH_PADDING * 2;
+    int max_height = (int)((y1 - y0) * font->scale) + 2 + FONT_GLYPH_PADDING * 2;
+    font->bake_buffer_size = max_width * max_height;
+    font->bake_buffer = (u8 *)malloc(font->bake_buffer_size);
+
+    if (!text_program) InitTextPrograms();
+
+    glGenTextures(1, &font->texture);
+    glBindTexture(GL_TEXTURE_2D, font->texture);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_R8, FONT_ATLAS_SIZE, FONT_ATLAS_SIZE, 0, GL_RED, GL_UNSIGNED_BYTE, 0);
+
+    // quads never change topology, the index buffer is built once
+    u32 *indices = (u32 *)malloc(sizeof(u32) * 6 * FONT_MAX_QUADS);
+    for (u32 i = 0; i < FONT_MAX_QUADS; ++i) {
+        u32 *quad = indices + i * 6;
+        quad[0] = i * 4 + 0;
+        quad[1] = i * 4 + 1;
+        quad[2] = i * 4 + 2;
+        quad[3] = i * 4 + 0;
+        quad[4] = i * 4 + 2;
+        quad[5] = i * 4 + 3;
+    }
+
+    font->vertices = (TextVertex *)malloc(sizeof(TextVertex) * 4 * FONT_MAX_QUADS);
+
+    glGenVertexArrays(1, &font->vao);
+    glGenBuffers(1, &font->vbo);
+    glGenBuffers(1, &font->ibo);
+    glBindVertexArray(font->vao);
+    glBindBuffer(GL_ARRAY_BUFFER, font->vbo);
+    glBufferData(GL_ARRAY_BUFFER, sizeof(TextVertex) * 4 * FONT_MAX_QUADS, 0, GL_STREAM_DRAW);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, font->ibo);
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(u32) * 6 * FONT_MAX_QUADS, indices, GL_STATIC_DRAW);
+    glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, sizeof(TextVertex), 0);
+    glEnableVertexAttribArray(0);
+    glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, sizeof(TextVertex), (void *)offsetof(TextVertex, uv));
+    glEnableVertexAttribArray(1);
+    glVertexAttribPointer(2, 4, GL_UNSIGNED_BYTE, GL_TRUE, sizeof(TextVertex), (void *)offsetof(TextVertex, color));
+    glEnableVertexAttribArray(2);
+    glBindVertexArray(0);
+
+    free(indices);
+
+    font->loaded = true;
+    return true;
+}
+
+// Distance field glyphs for text drawn at many sizes, 32 px is enough for sharp edges up to
+// several hundred pixels.
+bool LoadSdfFont(Font *font, const char *filename, f32 bake_height) {
+    if (!LoadFont(font, filename, bake_height)) return false;
+    font->sdf = true;
+    return true;
+}
+
+inline u32 HashCodepoint(u32 codepoint) {
+    // Fibonacci hashing, the top bits of the product are the well mixed ones
+    return (codepoint * 2654435769u) >> (32 - FONT_GLYPH_SLOT_BITS);
+}
+
+// The slot codepoint lives in, or the empty slot it would go in.
+static Glyph *FindGlyphSlot(Font *font, u32 codepoint) {
+    u32 key = codepoint + 1;
+    u32 index = HashCodepoint(codepoint);
+
+    for (;;) {
+        Glyph *glyph = font->glyphs + (index & (FONT_GLYPH_SLOTS - 1));
+        if (glyph->key == key || !glyph->key) return glyph;
+        ++index;
+    }
+}
+
+// Finds room for a width x height rect. False when the atlas is full.
+static bool PackGlyph(Font *font, int width, int height, int *x, int *y) {
+    FontShelf *best = 0;
+    for (int i = 0; i < font->shelf_count; ++i) {
+        FontShelf *shelf = font->shelves + i;
+        if (shelf->height < height || shelf->x + width > FONT_ATLAS_SIZE) continue;
+        // a short glyph on a tall shelf wastes the difference, take the tightest fit
+        if (!best || shelf->height < best->height) best = shelf;
+    }
+
+    // a much shorter glyph opens its own shelf if there's room for one
+    int shelf_y = font->shelf_count ? font->shelves[font->shelf_count - 1].y + font->shelves[font->shelf_count - 1].height : 0;
+    bool room_for_shelf = font->shelf_count < FONT_MAX_SHELVES && shelf_y + height <= FONT_ATLAS_SIZE;
+    if (best && best->height > height * 2 && room_for_shelf) best = 0;
+
+    if (!best) {
+        if (!room_for_shelf || width > FONT_ATLAS_SIZE) return false;
+        best = font->shelves + font->shelf_count++;
+        best->y = shelf_y;
+        best->height = height;
+        best->x = 0;
+    }
+
+    *x = best->x;
+    *y = best->y;
+    best->x += width;
+    return true;
+}
+
+static Glyph *BakeSdfGlyph(Font *font, u32 codepoint, int glyph_index, int advance, Glyph *slot) {
+    // 128 on the outline, falling off by 128 over FONT_SDF_SPREAD texels, so 0..255 spans the spread
+    int width = 0, height = 0, x_offset = 0, y_offset = 0;
+    u8 *field = stbtt_GetGlyphSDF(&font->info, font->scale, glyph_index, FONT_SDF_SPREAD, 128, 128.0f / FONT_SDF_SPREAD,
+                                  &width, &height, &x_offset, &y_offset);
+
+    int atlas_x = 0, atlas_y = 0;
+    if (field) {
+        // the field's own border is already empty space, one more texel keeps neighbours apart
+        if (!PackGlyph(font, width + FONT_GLYPH_PADDING, height + FONT_GLYPH_PADDING, &atlas_x, &atlas_y)) {
+            stbtt_FreeSDF(field, 0);
+            return 0;
+        }
+
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+        glBindTexture(GL_TEXTURE_2D, font->texture);
+        glTexSubImage2D(GL_TEXTURE_2D, 0, atlas_x, atlas_y, width, height, GL_RED, GL_UNSIGNED_BYTE, field);
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+        stbtt_FreeSDF(field, 0);
+    } else {
+        width = height = 0;
+    }
+
+    Glyph *glyph = slot;
+    glyph->key = codepoint + 1;
+    glyph->atlas_x = (u16)atlas_x;
+    glyph->atlas_y = (u16)atlas_y;
+    glyph->width = (u16)width;
+    glyph->height = (u16)height;
+    glyph->x_offset = (f32)x_offset;
+    glyph->y_offset = (f32)y_offset;
+    glyph->advance = advance * font->scale;
+
+    ++font->glyph_count;
+    ++font->glyphs_baked;
+    return glyph;
+}
+
+// Rasterizes codepoint into the atlas. Null if the atlas or the table is full.
+static Glyph *BakeGlyph(Font *font, u32 codepoint, Glyph *slot) {
+    if (font->glyph_count >= FONT_GLYPH_SLOTS * 3 / 4) return 0;
+
+    int glyph_index = stbtt_FindGlyphIndex(&font->info, codepoint);
+
+    int advance, left_side_bearing;
+    stbtt_GetGlyphHMetrics(&font->info, glyph_index, &advance, &left_side_bearing);
+
+    if (font->sdf) return BakeSdfGlyph(font, codepoint, glyph_index, advance, slot);
+
+    int x0, y0, x1, y1;
+    stbtt_GetGlyphBitmapBox(&font->info, glyph_index, font->scale, font->scale, &x0, &y0, &x1, &y1);
+
+    int bitmap_width = x1 - x0;
+    int bitmap_height = y1 - y0;
+    int width = bitmap_width + FONT_GLYPH_PADDING * 2;
+    int height = bitmap_height + FONT_GLYPH_PADDING * 2;
+    if (width * height > font->bake_buffer_size) width = height = 0; // broken metrics, draw nothing
+
+    int atlas_x = 0, atlas_y = 0;
+    if (bitmap_width > 0 && bitmap_height > 0 && width) {
+        if (!PackGlyph(font, width, height, &atlas_x, &atlas_y)) return 0;
+
+        // the padding is uploaded too, it overwrites whatever an earlier atlas left there
+        memset(font->bake_buffer, 0, width * height);
+        u8 *first_texel = font->bake_buffer + FONT_GLYPH_PADDING * width + FONT_GLYPH_PADDING;
+        stbtt_MakeGlyphBitmap(&font->info, first_texel, bitmap_width, bitmap_height, width, font->scale, font->scale, glyph_index);
+
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+        glBindTexture(GL_TEXTURE_2D, font->texture);
+        glTexSubImage2D(GL_TEXTURE_2D, 0, atlas_x, atlas_y, width, height, GL_RED, GL_UNSIGNED_BYTE, font->bake_buffer);
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+    } else {
+        width = height = 0; // spaces and the like only advance
+    }
+
+    Glyph *glyph = slot;
+    glyph->key = codepoint + 1;
+    glyph->atlas_x = (u16)atlas_x;
+    glyph->atlas_y = (u16)atlas_y;
+    glyph->width = (u16)width;
+    glyph->height = (u16)height;
+    glyph->x_offset = (f32)(x0 - FONT_GLYPH_PADDING);
+    glyph->y_offset = (f32)(y0 - FONT_GLYPH_PADDING);
+    glyph->advance = advance * font->scale;
+
+    ++font->glyph_count;
+    ++font->glyphs_baked;
+    return glyph;
+}
+
+// The program and atlas for drawing this font's quads, for callers with their own vertex
+// buffers (TextVertex layout, indexed like font->ibo).
+void BindTextProgram(Font *font) {
+    int fb_width, fb_height;
+    GetWindowFramebufferSize(&fb_width, &fb_height);
+
+    if (font->sdf) {
+        glUseProgram(text_sdf_program);
+        glUniform2f(text_sdf_screen_size_location, (f32)fb_width, (f32)fb_height);
+    } else {
+        glUseProgram(text_program);
+        glUniform2f(text_screen_size_location, (f32)fb_width, (f32)fb_height);
+    }
+    glBindTexture(GL_TEXTURE_2D, font->texture);
+}
+
+void FlushText(Font *font) {
+    if (!font->quad_count) return;
+
+    glNamedBufferSubData(font->vbo, 0, sizeof(TextVertex) * 4 * font->quad_count, font->vertices);
+
+    BindTextProgram(font);
+    glBindVertexArray(font->vao);
+    glDrawElements(GL_TRIANGLES, font->quad_count * 6, GL_UNSIGNED_INT, 0);
+    glBindVertexArray(0);
+
+    font->quad_count = 0;
+    ++font->draw_calls;
+}
+
+static Glyph *GetGlyph(Font *font, u32 codepoint) {
+    Glyph *glyph = FindGlyphSlot(font, codepoint);
+    if (glyph->key) return glyph;
+
+    Glyph *result = BakeGlyph(font, codepoint, glyph);
+    if (!result) {
+        // quads already in the batch point into the old atlas, they have to go out first
+        FlushText(font);
+        ResetFontAtlas(font);
+        ++font->atlas_resets;
+        result = BakeGlyph(font, codepoint, FindGlyphSlot(font, codepoint));
+    }
+
+    return result;
+}
+
+// Next codepoint of a UTF-8 string, U+FFFD for malformed sequences.
+static u32 DecodeUtf8(const char **text) {
+    const u8 *s = (const u8 *)*text;
+    u32 result = 0xfffd;
+    int length = 1;
+
+    if (s[0] < 0x80) {
+        result = s[0];
+    } else if ((s[0] & 0xe0) == 0xc0 && (s[1] & 0xc0) == 0x80) {
+        result = ((s[0] & 0x1f) << 6) | (s[1] & 0x3f);
+        length = 2;
+    } else if ((s[0] & 0xf0) == 0xe0 && (s[1] & 0xc0) == 0x80 && (s[2] & 0xc0) == 0x80) {
+        result = ((s[0] & 0x0f) << 12) | ((s[1] & 0x3f) << 6) | (s[2] & 0x3f);
+        length = 3;
+    } else if ((s[0] & 0xf8) == 0xf0 && (s[1] & 0xc0) == 0x80 && (s[2] & 0xc0) == 0x80 && (s[3] & 0xc0) == 0x80) {
+        result = ((s[0] & 0x07) << 18) | ((s[1] & 0x3f) << 12) | ((s[2] & 0x3f) << 6) | (s[3] & 0x3f);
+        length = 4;
+    }
+
+    *text += length;
+    return result;
+}
+
+inline u32 PackColor(v4 color) {
+    u32 r = (u32)(clamp(color.r, 0.0f, 1.0f) * 255.0f + 0.5f);
+    u32 g = (u32)(clamp(color.g, 0.0f, 1.0f) * 255.0f + 0.5f);
+    u32 b = (u32)(clamp(color.b, 0.0f, 1.0f) * 255.0f + 0.5f);
+    u32 a = (u32)(clamp(color.a, 0.0f, 1.0f) * 255.0f + 0.5f);
+    return r | (g << 8) | (b << 16) | (a << 24);
+}
+
+// Writes the quads for text with its top left corner at x, y (pixels, top left origin) and size
+// pixels from ascent to descent, 4 vertices each, at most max_quads. '\n' starts a new line at
+// x. Returns the quad count, end_x gets the pen position after the last glyph. Baking a glyph
+// can reset the atlas, which leaves quads built before it pointing at nothing: callers that keep
+// quads compare atlas_resets. Coverage fonts blur at any size but their own.
+int BuildTextQuads(Font *font, f32 x, f32 y, f32 size, const char *text, v4 color, TextVertex *quads, int max_quads, f32 *end_x) {
+    u32 packed_color = PackColor(color);
+    f32 atlas_scale = 1.0f / FONT_ATLAS_SIZE;
+    f32 scale = size / font->pixel_height;
+
+    // coverage glyphs at their baked size go on whole pixels, they were rasterized at integer
+    // positions and anything else resamples them
+    if (!font->sdf && scale == 1.0f) {
+        x = floorf(x + 0.5f);
+        y = floorf(y + font->ascent + 0.5f) - font->ascent;
+    }
+
+    f32 pen_x = x;
+    f32 baseline = y + font->ascent * scale;
+    int quad_count = 0;
+
+    while (*text && quad_count < max_quads) {
+        u32 codepoint = DecodeUtf8(&text);
+
+        if (codepoint == '\n') {
+            pen_x = x;
+            baseline += font->line_height * scale;
+            continue;
+        }
+
+        Glyph *glyph = GetGlyph(font, codepoint);
+        if (!glyph) continue;
+
+        if (glyph->width) {
+            f32 l = pen_x + glyph->x_offset * scale;
+            f32 t = baseline + glyph->y_offset * scale;
+            f32 r = l + glyph->width * scale;
+            f32 b = t + glyph->height * scale;
+
+            f32 u0 = glyph->atlas_x * atlas_scale;
+            f32 v0 = glyph->atlas_y * atlas_scale;
+            f32 u1 = (glyph->atlas_x + glyph->width) * atlas_scale;
+            f32 v1 = (glyph->atlas_y + glyph->height) * atlas_scale;
+
+            TextVertex *quad = quads + quad_count++ * 4;
+            quad[0] = { { l, t }, { u0, v0 }, packed_color };
+            quad[1] = { { l, b }, { u0, v1 }, packed_color };
+            quad[2] = { { r, b }, { u1, v1 }, packed_color };
+            quad[3] = { { r, t }, { u1, v0 }, packed_color };
+        }
+
+        pen_x += glyph->advance * scale;
+    }
+
+    if (end_x) *end_x = pen_x;
+    return quad_count;
+}
+
+// Queues text into the font's batch, nothing is drawn until FlushText. Returns the pen position
+// after the last glyph.
+f32 PushTextSized(Font *font, f32 x, f32 y, f32 size, const char *text, v4 color) {
+    if (!font->loaded) return x;
+
+    // a byte per glyph at most
+    if (FONT_MAX_QUADS - font->quad_count < (int)strlen(text)) FlushText(font);
+
+    // an atlas reset halfway flushes what was queued before this string, then the string is
+    // built again into the fresh atlas
+    f32 end_x = x;
+    for (int attempt = 0; attempt < 2; ++attempt) {
+        u32 atlas_resets = font->atlas_resets;
+        int count = BuildTextQuads(font, x, y, size, text, color, font->vertices + font->quad_count * 4,
+                                   FONT_MAX_QUADS - font->quad_count, &end_x);
+        if (font->atlas_resets == atlas_resets || attempt == 1) {
+            font->quad_count += count;
+            break;
+        }
+    }
+
+    return end_x;
+}
+
+f32 PushText(Font *font, f32 x, f32 y, const char *text, v4 color) {
+    return PushTextSized(font, x, y, font->pixel_height, text, color);
+}
+
+f32 PushTextFormat(Font *font, f32 x, f32 y, v4 color, const char *format, ...) {
+    char buffer[1024];
+
+    va_list args;
+    va_start(args, format);
+    vsnprintf(buffer, sizeof(buffer), format, args);
+    va_end(args);
+
+    return PushText(font, x, y, buffer, color);
+}
+
+f32 PushTextSizedFormat(Font *font, f32 x, f32 y, f32 size, v4 color, const char *format, ...) {
+    char buffer[1024];
+
+    va_list args;
+    va_start(args, format);
+    vsnprintf(buffer, sizeof(buffer), format, args);
+    va_end(args);
+
+    return PushTextSized(font, x, y, size, buffer, color);
+}
+
+// Width of the widest line at the baked size. Only needs the metrics, but bakes glyphs it
+// hasn't seen.
+f32 MeasureText(Font *font, const char *text) {
+    if (!font->loaded) return 0;
+
+    f32 result = 0;
+    f32 width = 0;
+    while (*text) {
+        u32 codepoint = DecodeUtf8(&text);
+        if (codepoint == '\n') {
+            result = Max(result, width);
+            width = 0;
+            continue;
+        }
+
+        Glyph *glyph = GetGlyph(font, codepoint);
+        if (glyph) width += glyph->advance;
+    }
+
+    return Max(result, width);
+}
+
+// Shared by the overlays. Loaded on first use, recreated with the module (the old copy leaks).
+static Font debug_font;
+
+Font *GetDebugFont() {
+    static b32 attempted;
+    if (!attempted) {
+        attempted = true;
+        LoadFont(&debug_font, "assets/FiraMono-Regular.ttf", 14);
+    }
+
+    return &debug_font;
+}
@@ -0,0 +1,295 @@
+/*
+    Frame time statistics.
+
+    Every displayed frame's time goes into a log-linear (HDR style) histogram of microseconds:
+    values below 64 us are exact, above that each power of 2 is split into 32 buckets, so any
+    percentile is within about 3% of the true value and the whole run costs 3.5 KB. One histogram
+    covers the run, a second one the current second; when a second is over its p50/p95/p99/max,
+    frame count and hitches become one summary line (printed with -stats) and one row of the dump.
+
+    A hitch is a frame over one of the hitch thresholds (-hitch 33.3,50,100 in ms). Frames over the
+    highest one are logged as they happen.
+
+    The last FRAME_STATS_HISTORY frame times are kept for the on-screen graph (F4 in game).
+
+    -stats-out file.csv | file.json writes the per-second rows and the run's totals at exit, the
+    JSON also has the non-empty histogram buckets.
+*/
+
+#define FRAME_STATS_SUB_BITS 5
+#define FRAME_STATS_SUB_BUCKETS (1 << FRAME_STATS_SUB_BITS)
+#define FRAME_STATS_BUCKET_COUNT ((32 - FRAME_STATS_SUB_BITS + 2) * FRAME_STATS_SUB_BUCKETS) // up to 2^32 us
+#define MAX_HITCH_THRESHOLDS 4
+
+struct FrameTimeHistogram {
+    u64 count;
+    u64 total_us;
+    u64 max_us;
+    u32 buckets[FRAME_STATS_BUCKET_COUNT];
+};
+
+struct FrameStatsSecond {
+    u64 frames;
+    f32 p50_ms;
+    f32 p95_ms;
+    f32 p99_ms;
+    f32 max_ms;
+    u32 hitches[MAX_HITCH_THRESHOLDS];
+};
+
+struct FrameStats {
+    b32 print_seconds;
+    int hitch_threshold_count;
+    f32 hitch_thresholds_ms[MAX_HITCH_THRESHOLDS]; // ascending
+
+    u64 frame;
+    FrameTimeHistogram run;
+    u64 run_hitches[MAX_HITCH_THRESHOLDS];
+
+    double second_elapsed;
+    FrameTimeHistogram second;
+    u32 second_hitches[MAX_HITCH_THRESHOLDS];
+
+    // one per finished second, grows
+    int second_count;
+    int second_capacity;
+    FrameStatsSecond *seconds;
+
+    int history_count;
+    int history_next;
+    f32 history_ms[FRAME_STATS_HISTORY];
+};
+
+static FrameStats frame_stats;
+
+static u32 GetFrameTimeBucket(u64 us) {
+    if (us < 2 * FRAME_STATS_SUB_BUCKETS) return (u32)us;
+
+    int msb = FRAME_STATS_SUB_BITS + 1;
+    while (msb < 63 && (us >> (msb + 1))) ++msb;
+
+    int shift = msb - FRAME_STATS_SUB_BITS; // keep the top SUB_BITS + 1 bits
+    u32 mantissa = (u32)(us >> shift); // [SUB_BUCKETS, 2 * SUB_BUCKETS)
+    u32 result = (shift + 1) * FRAME_STATS_SUB_BUCKETS + mantissa - FRAME_STATS_SUB_BUCKETS;
+    return result < FRAME_STATS_BUCKET_COUNT ? result : FRAME_STATS_BUCKET_COUNT - 1;
+}
+
+// Middle of the bucket's range.
+static double GetFrameTimeBucketValue(u32 bucket) {
+    if (bucket < 2 * FRAME_STATS_SUB_BUCKETS) return bucket;
+
+    int shift = bucket / FRAME_STATS_SUB_BUCKETS - 1;
+    u64 mantissa = FRAME_STATS_SUB_BUCKETS + bucket % FRAME_STATS_SUB_BUCKETS;
+    return ((mantissa << shift) + ((mantissa + 1) << shift)) * 0.5;
+}
+
+static void AddFrameTime(FrameTimeHistogram *histogram, u64 us) {
+    ++histogram->count;
+    histogram->total_us += us;
+    if (us > histogram->max_us) histogram->max_us = us;
+    ++histogram->buckets[GetFrameTimeBucket(us)];
+}
+
+static f32 GetFrameTimePercentile(FrameTimeHistogram *histogram, double percentile) {
+    if (!histogram->count) return 0;
+
+    u64 rank = (u64)(percentile * 0.01 * histogram->count + 0.5);
+    if (rank < 1) rank = 1;
+
+    u64 seen = 0;
+    for (u32 bucket = 0; bucket < FRAME_STATS_BUCKET_COUNT; ++bucket) {
+        seen += histogram->buckets[bucket];
+        if (seen >= rank) {
+            // never report more than was measured
+            double value = GetFrameTimeBucketValue(bucket);
+            if (value > histogram->max_us) value = (double)histogram->max_us;
+            return (f32)(value * 0.001);
+        }
+    }
+    return histogram->max_us * 0.001f;
+}
+
+// thresholds is a comma separated list of milliseconds, e.g. "33.3,50,100".
+void InitFrameStats(FrameStats *stats, const char *thresholds, b32 print_seconds) {
+    *stats = {};
+    stats->print_seconds = print_seconds;
+
+    const char *at = thresholds ? thresholds : "33.3,50,100";
+    while (*at && stats->hitch_threshold_count < MAX_HITCH_THRESHOLDS) {
+        char *end;
+        f32 threshold = strtof(at, &end);
+        if (end == at) break;
+        if (threshold > 0) stats->hitch_thresholds_ms[stats->hitch_threshold_count++] = threshold;
+        at = *end == ',' ? end + 1 : end;
+    }
+
+    // ascending, the last one is the one that logs
+    for (int i = 1; i < stats->hitch_threshold_count; ++i) {
+        for (int j = i; j > 0 && stats->hitch_thresholds_ms[j] < stats->hitch_thresholds_ms[j - 1]; --j) {
+            f32 swap = stats->hitch_thresholds_ms[j];
+            stats->hitch_thresholds_ms[j] = stats->hitch_thresholds_ms[j - 1];
+            stats->hitch_thresholds_ms[j - 1] = swap;
+        }
+    }
+}
+
+static void FinishFrameStatsSecond(FrameStats *stats) {
+    FrameStatsSecond second = {};
+    second.frames = stats->second.count;
+    second.p50_ms = GetFrameTimePercentile(&stats->second, 50);
+    second.p95_ms = GetFrameTimePercentile(&stats->second, 95);
+    second.p99_ms = GetFrameTimePercentile(&stats->second, 99);
+    second.max_ms = stats->second.max_us * 0.001f;
+    memcpy(second.hitches, stats->second_hitches, sizeof(second.hitches));
+
+    if (stats->second_count == stats->second_capacity) {
+        stats->second_capacity = stats->second_capacity ? stats->second_capacity * 2 : 64;
+        stats->seconds = (FrameStatsSecond *)realloc(stats->seconds, sizeof(FrameStatsSecond) * stats->second_capacity);
+    }
+    stats->seconds[stats->second_count++] = second;
+
+    if (stats->print_seconds) {
+        fprintf(stdout, "%4d s: %5llu fps | p50 %6.2f  p95 %6.2f  p99 %6.2f  max %6.2f ms | hitches",
+                stats->second_count, (unsigned long long)second.frames, second.p50_ms, second.p95_ms, second.p99_ms, second.max_ms);
+        for (int i = 0; i < stats->hitch_threshold_count; ++i) fprintf(stdout, " %u", second.hitches[i]);
+        fprintf(stdout, "\n");
+    }
+
+    stats->second = {};
+    memset(stats->second_hitches, 0, sizeof(stats->second_hitches));
+    stats->second_elapsed = 0;
+}
+
+// Main thread, once per displayed frame.
+void RecordFrameTime(FrameStats *stats, double seconds) {
+    u64 us = (u64)(seconds * 1e6 + 0.5);
+    f32 ms = (f32)(seconds * 1000);
+
+    AddFrameTime(&stats->run, us);
+    AddFrameTime(&stats->second, us);
+
+    for (int i = 0; i < stats->hitch_threshold_count; ++i) {
+        if (ms > stats->hitch_thresholds_ms[i]) {
+            ++stats->run_hitches[i];
+            ++stats->second_hitches[i];
+        }
+    }
+
+    int highest = stats->hitch_threshold_count - 1;
+    if (highest >= 0 && ms > stats->hitch_thresholds_ms[highest]) {
+        fprintf(stdout, "hitch: frame %llu took %.2f ms\n", (unsigned long long)stats->frame, ms);
+    }
+
+    stats->history_ms[stats->history_next] = ms;
+    stats->history_next = (stats->history_next + 1) % FRAME_STATS_HISTORY;
+    if (stats->history_count < FRAME_STATS_HISTORY) ++stats->history_count;
+
+    ++stats->frame;
+    stats->second_elapsed += seconds;
+    if (stats->second_elapsed >= 1.0) FinishFrameStatsSecond(stats);
+}
+
+// For the game's graph, oldest frame first.
+void GetFrameStats(FrameStatsView *view) {
+    FrameStats *stats = &frame_stats;
+
+    view->frame_count = stats->history_count;
+    int first = (stats->history_next - stats->history_count + FRAME_STATS_HISTORY) % FRAME_STATS_HISTORY;
+    for (int i = 0; i < stats->history_count; ++i) {
+        view->frame_ms[i] = stats->history_ms[(first + i) % FRAME_STATS_HISTORY];
+    }
+
+    FrameStatsSecond *last = stats->second_count ? stats->seconds + stats->second_count - 1 : 0;
+    view->p50_ms = last ? last->p50_ms : 0;
+    view->p95_ms = last ? last->p95_ms : 0;
+    view->p99_ms = last ? last->p99_ms : 0;
+    view->max_ms = last ? last->max_ms : 0;
+    view->hitch_ms = stats->hitch_threshold_count ? stats->hitch_thresholds_ms[0] : 0;
+}
+
+static void WriteFrameStatsCsv(FrameStats *stats, FILE *file) {
+    fprintf(file, "second,frames,p50_ms,p95_ms,p99_ms,max_ms");
+    for (int i = 0; i < stats->hitch_threshold_count; ++i) fprintf(file, ",hitches_over_%g_ms", stats->hitch_thresholds_ms[i]);
+    fprintf(file, "\n");
+
+    for (int s = 0; s < stats->second_count; ++s) {
+        FrameStatsSecond *second = stats->seconds + s;
+        fprintf(file, "%d,%llu,%.3f,%.3f,%.3f,%.3f", s + 1, (unsigned long long)second->frames,
+                second->p50_ms, second->p95_ms, second->p99_ms, second->max_ms);
+        for (int i = 0; i < stats->hitch_threshold_count; ++i) fprintf(file, ",%u", second->hitches[i]);
+        fprintf(file, "\n");
+    }
+
+    FrameTimeHistogram *run = &stats->run;
+    fprintf(file, "total,%llu,%.3f,%.3f,%.3f,%.3f", (unsigned long long)run->count,
+            GetFrameTimePercentile(run, 50), GetFrameTimePercentile(run, 95), GetFrameTimePercentile(run, 99), run->max_us * 0.001);
+    for (int i = 0; i < stats->hitch_threshold_count; ++i) fprintf(file, ",%llu", (unsigned long long)stats->run_hitches[i]);
+    fprintf(file, "\n");
+}
+
+static void WriteFrameStatsJson(FrameStats *stats, FILE *file) {
+    FrameTimeHistogram *run = &stats->run;
+
+    fprintf(file, "{\n  \"frames\": %llu,\n  \"mean_ms\": %.3f,\n  \"p50_ms\": %.3f,\n  \"p95_ms\": %.3f,\n  \"p99_ms\": %.3f,\n  \"max_ms\": %.3f,\n",
+            (unsigned long long)run->count, run->count ? run->total_us * 0.001 / run->count : 0.0,
+            GetFrameTimePercentile(run, 50), GetFrameTimePercentile(run, 95), GetFrameTimePercentile(run, 99), run->max_us * 0.001);
+
+    fprintf(file, "  \"hitches\": [");
+    for (int i = 0; i < stats->hitch_threshold_count; ++i) {
+        fprintf(file, "%s{\"over_ms\": %g, \"count\": %llu}", i ? ", " : "", stats->hitch_thresholds_ms[i], (unsigned long long)stats->run_hitches[i]);
+    }
+    fprintf(file, "],\n");
+
+    fprintf(file, "  \"seconds\": [");
+    for (int s = 0; s < stats->second_count; ++s) {
+        FrameStatsSecond *second = stats->seconds + s;
+        fprintf(file, "%s\n    {\"frames\": %llu, \"p50_ms\": %.3f, \"p95_ms\": %.3f, \"p99_ms\": %.3f, \"max_ms\": %.3f, \"hitches\": [",
+                s ? "," : "", (unsigned long long)second->frames, second->p50_ms, second->p95_ms, second->p99_ms, second->max_ms);
+        for (int i = 0; i < stats->hitch_threshold_count; ++i) fprintf(file, "%s%u", i ? ", " : "", second->hitches[i]);
+        fprintf(file, "]}");
+    }
+    fprintf(file, "\n  ],\n");
+
+    // [bucket middle in ms, frames]
+    fprintf(file, "  \"histogram\": [");
+    b32 first = true;
+    for (u32 bucket = 0; bucket < FRAME_STATS_BUCKET_COUNT; ++bucket) {
+        if (!run->buckets[bucket]) continue;
+        fprintf(file, "%s[%.3f, %u]", first ? "" : ", ", GetFrameTimeBucketValue(bucket) * 0.001, run->buckets[bucket]);
+        first = false;
+    }
+    fprintf(file, "]\n}\n");
+}
+
+// Prints the run's totals, and writes the dump if path isn't null. .json writes JSON, anything
+// else CSV.
+void FinishFrameStats(FrameStats *stats, const char *path) {
+    FrameTimeHistogram *run = &stats->run;
+    if (!run->count) return;
+
+    fprintf(stdout, "%llu frames: mean %.2f  p50 %.2f  p95 %.2f  p99 %.2f  max %.2f ms | hitches",
+            (unsigned long long)run->count, run->total_us * 0.001 / run->count,
+            GetFrameTimePercentile(run, 50), GetFrameTimePercentile(run, 95), GetFrameTimePercentile(run, 99), run->max_us * 0.001);
+    for (int i = 0; i < stats->hitch_threshold_count; ++i) {
+        fprintf(stdout, " %llu over %g ms%s", (unsigned long long)stats->run_hitches[i], stats->hitch_thresholds_ms[i],
+                i + 1 < stats->hitch_threshold_count ? "," : "");
+    }
+    fprintf(stdout, "\n");
+
+    if (path) {
+        FILE *file = fopen(path, "w");
+        if (!file) {
+            fprintf(stderr, "Error: unable to open %s\n", path);
+        } else {
+            size_t length = strlen(path);
+            if (length >= 5 && strcmp(path + length - 5, ".json") == 0) WriteFrameStatsJson(stats, file);
+            else WriteFrameStatsCsv(stats, file);
+            fclose(file);
+            fprintf(stdout, "Wrote frame stats to %s\n", path);
+        }
+    }
+
+    free(stats->seconds);
+    stats->seconds = 0;
+    stats->second_count = stats->second_capacity = 0;
+}
@@ -1,4 +1,14 @@
 #include "glutil.cpp"
+#include "gpu_profiler.cpp"
+#include "font.cpp"
+#include "ui.cpp"
+#include "radix_sort.cpp"
+#include "sprite_batch.cpp"
+#include "tilemap.cpp"
+#include "impostors.cpp"
+#include "picking.cpp"
+#include "world.cpp"
+#include "pathfinding.cpp"
 
 static Arena scratch_arena;
 static Arena persist_arena;
@@ -19,6 +29,7 @@ struct TilemapAsset {
     Texture texture;
     int tile_width;
     int tile_height;
+    Rect *opaque_bounds; // per cell, texels from the cell's top left, null for sheets nothing picks
 };
 
 struct TilemapAssetID {
@@ -28,31 +39,35 @@ struct TilemapAssetID {
 };
 
 #define TILE_WATER_1 { 1, 2, Tiles }
+#define TILE_HOVERED { 5, 4, TileOverlay }
+#define TILE_SELECTED { 5, 3, TileOverlay }
+#define TILE_PATH { 5, 2, TileOverlay }
 
-/*
-    https://www.youtube.com/watch?v=04oQ2jOUjkU&t=254s&ab_channel=SimonDev
-    i,j
-    rotate 45
-    squash in half
-
-    i moves horizontally 1 tile width and down a half tile width (1, 0.5)
-    j moves horizontally -1 tile width and down a half tile width (-1, 0.5)
-
-    to find the screen coordinates of a tile, transforms the tile coordinates tx(1, 0.5) + ty(-1, 0.5)
-
-*/
-struct Tilemap {
-    int rows;
-    int columns;
-    int tile_width;
-    int tile_height;
-};
+// Texel row in a sheet's cell that sits on the centre of the tile's top face, and the texels one
+// elevation step raises a sprite (the thickness of a Tiles block).
+#define TILE_SURFACE_Y 64
+#define OBJECT_ANCHOR_Y 192
+#define TREE_ANCHOR_Y 470
+#define ELEVATION_STEP 64
 
 struct Camera {
     v2 position;
     f32 zoom;
 };
 
+#define WORLD_PATH "build/test.world"
+#define TEST_WORLD_SIZE 4096 // tiles on a side, written when there's no world yet
+#define WORLD_CACHE_BYTES Megabytes(4) // decoded chunks kept around the window
+#define WORLD_WINDOW_CHUNKS 8 // chunks on a side of the resident tilemap
+#define WORLD_RECENTER_CHUNKS 1 // how far the view may drift off the window's middle before it moves
+#define WORLD_PREFETCH_CHUNKS 1 // requested around the window, so a move finds them decoded
+#define WORLD_WINDOW_LOADS_PER_FRAME 16
+
+#define SELECTION_MAX_LASSO_POINTS 256
+#define SELECTION_LASSO_SPACING 6.0f // pixels the cursor moves before the lasso gets another point
+#define PICK_MAX_CANDIDATE_CHUNKS 16
+#define MAX_PATH_POINTS 4096
+
 struct GameState {
     b32 initialized;
 
@@ -61,7 +76,45 @@ struct GameState {
     Camera camera;
 
     Tilemap tilemap;
+    int ground_layer;
+    int overlay_layer;
+    int object_layer;
+    int tree_layer;
+    int visible_layers; // last frame, for the overlay
+
+    WorldStream *world; // null when the map was generated in memory
+    int window_x; // world tile of the tilemap's (0, 0), chunk aligned
+    int window_y;
+    b32 window_loaded[WORLD_WINDOW_CHUNKS * WORLD_WINDOW_CHUNKS];
+
+    TilePicker picker;
+    PickResult hovered;
+    TileSelection selection;
+    b32 selecting; // left button dragging over the map
+    b32 lasso;
+    v2 drag_start;
+    int lasso_count;
+    v2 lasso_points[SELECTION_MAX_LASSO_POINTS];
+    int selection_tested; // tiles the last selection looked at
+    b32 left_button_down; // last frame
+
+    PathGrid path_grid; // the map's walkable tiles
+    PathFinder path_finder;
+    u32 *path_revisions; // of the map's chunks, when the path grid last copied them
+    PathRequest path; // from the selected tile to the hovered one
+    PathPoint path_points[MAX_PATH_POINTS];
+    double path_seconds;
+
+    TilemapImpostors impostors;
     Font font;
+    Font label_font; // SDF, world space labels that scale with the zoom
+
+    SpriteBatch sprites;
+
+    UIContext ui;
+    int inventory_first_slot; // widget ids
+    int inventory_status;
+    int selected_slot; // -1 for none
 
     int view_offset_x;
     int view_offset_y;
@@ -73,9 +126,13 @@ struct GameState {
 void PrintInputEvent(InputEvent *event);
 void InitializeGameState(GameState *state);
 void ProcessInputEvents(GameState *state);
+void UpdateInventoryUI(GameState *state);
 
 #define ZOOM_INCREMENT 0.05f
-#define TILEMAP_ROTATION (2 / 3.0f) // 4 : 3 ?
+#define IMPOSTOR_ZOOM 0.125f // below this the map is drawn from chunk impostors
+#define IMPOSTOR_TILE_WIDTH 32.0f // the switch's tile width, so the layers are only minified
+#define IMPOSTOR_BUDGET Megabytes(64) // VRAM for the layers, see impostors.cpp
+#define IMPOSTOR_BAKES_PER_FRAME 2
 #define PAN_SPEED 15
 
 int GetTilemapAssetRows(TilemapAsset *asset) {
@@ -109,7 +166,46 @@ Texture GetAssetTexture(TilemapAssetID id, GameState *state) {
     return result;
 }
 
+// Bounds of the opaque texels of each cell, so a tree is picked by its trunk and crown rather
+// than the empty corners of its 256x512 cell. Reads the sheet back once at load.
+static void ComputeOpaqueBounds(TilemapAsset *asset) {
+    int columns = GetTilemapAssetColumns(asset);
+    int rows = GetTilemapAssetRows(asset);
+    int width = asset->texture.width;
+    int height = asset->texture.height;
+
+    u8 *pixels = (u8 *)malloc((u64)width * height * 4);
+    glGetTextureImage(asset->texture.id, 0, GL_RGBA, GL_UNSIGNED_BYTE, width * height * 4, pixels);
+    asset->opaque_bounds = (Rect *)ArenaAlloc(&persist_arena, sizeof(Rect) * columns * rows);
+
+    for (int row = 0; row < rows; ++row) {
+        for (int column = 0; column < columns; ++column) {
+            int min_x = asset->tile_width, min_y = asset->tile_height;
+            int max_x = -1, max_y = -1;
+
+            for (int y = 0; y < asset->tile_height; ++y) {
+                // loaded flipped, the texture's first row is the bottom of the sheet
+                u8 *line = pixels + ((u64)(height - 1 - row * asset->tile_height - y) * width + column * asset->tile_width) * 4;
+                for (int x = 0; x < asset->tile_width; ++x) {
+                    if (line[x * 4 + 3] < 128) continue;
+                    min_x = Min(min_x, x);
+                    min_y = Min(min_y, y);
+                    max_x = Max(max_x, x);
+                    max_y = Max(max_y, y);
+                }
+            }
+
+            if (max_x < 0) continue;
+            asset->opaque_bounds[row * columns + column] = { (f32)min_x, (f32)min_y, (f32)(max_x - min_x + 1), (f32)(max_y - min_y + 1) };
+        }
+    }
+
+    free(pixels);
+}
+
 void LoadTilemapAssets(GameState *state) {
+    ProfileFunction();
+
     TilemapAsset *tiles = &state->assets[Tiles];
     LoadTexture("assets/isometric-asset-pack/256x192 Tiles.png", &tiles->texture);
     tiles->tile_width = 256;
@@ -149,6 +245,17 @@ void LoadTilemapAssets(GameState *state) {
     LoadTexture("assets/isometric-asset-pack/256x128 Tile Overlays.png", &overlays->texture);
     overlays->tile_width = 256;
     overlays->tile_height = 128;
+
+    // tiles get small when zoomed out, the first few mips stay inside a cell's padding
+    for (int i = 0; i < AssetTag::Count; ++i) {
+        if (i == UIElements) continue;
+        glTextureParameteri(state->assets[i].texture.id, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+        glTextureParameteri(state->assets[i].texture.id, GL_TEXTURE_MAX_LEVEL, 4);
+    }
+
+    // the sheets of the layers that stand up off the ground
+    ComputeOpaqueBounds(objects);
+    ComputeOpaqueBounds(trees);
 }
 
 // TODO(lmk): transform all tilemap coordinates at once
@@ -217,12 +324,668 @@ v2 ScreenToTile(int x, int y, Tilemap *tilemap, Camera camera) {
     return result;
 }
 
+// Places a cell of a sheet on a tile whose sprite has its top left at position (TileToScreen),
+// anchor_y is the texel row of the cell that touches the ground. The cell keeps its aspect and
+// scales with the tiles, scale is the tile width over 256.
+void PushTileSprite(GameState *state, TilemapAssetID id, v2 position, f32 scale, int tile_x, int tile_y, int elevation, SpriteLayer layer, f32 anchor_y) {
+    TilemapAsset *asset = &state->assets[id.tag];
+    v2 screen_coords = position;
+    f32 surface_y = screen_coords.y + (TILE_SURFACE_Y - elevation * ELEVATION_STEP) * scale;
+
+    Rect dest = {
+        screen_coords.x,
+        surface_y - anchor_y * scale,
+        asset->tile_width * scale,
+        asset->tile_height * scale
+    };
+
+    PushSprite(&state->sprites, asset->texture, dest, GetAssetTextureRect(id, state), IsoDepthKey(tile_x, tile_y, elevation, layer));
+}
+
+static u32 HashTile(int x, int y) {
+    u32 h = (u32)x * 73856093u ^ (u32)y * 19349663u;
+    h ^= h >> 13;
+    h *= 0x5bd1e995u;
+    h ^= h >> 15;
+    return h;
+}
+
+static void AddTestMapLayers(GameState *state, Tilemap *map) {
+    int tile_count = map->columns * map->rows;
+    state->ground_layer = AddTilemapLayer(map, &persist_arena, Tiles, SpriteLayerGround, TILE_SURFACE_Y, false, 0);
+    state->overlay_layer = AddTilemapLayer(map, &persist_arena, TileOverlay, SpriteLayerOverlay, TILE_SURFACE_Y, true, tile_count / 8);
+    state->object_layer = AddTilemapLayer(map, &persist_arena, Objects, SpriteLayerObject, OBJECT_ANCHOR_Y, true, tile_count / 8);
+    state->tree_layer = AddTilemapLayer(map, &persist_arena, Trees, SpriteLayerObject, TREE_ANCHOR_Y, true, tile_count / 4);
+}
+
+// Stand in content until maps are authored: grass with some water and a few hills, dirt and
+// pebble overlays, and trees, rocks and crates. Fills a tile id per layer and returns the height.
+static int GenerateTestTile(GameState *state, int x, int y, u16 *tiles) {
+    u32 hash = HashTile(x, y);
+
+    // terraced hills every 16 tiles
+    int dx = abs(x % 16 - 8);
+    int dy = abs(y % 16 - 8);
+    int height = (dx < 3 && dy < 3) ? 4 : (dx < 5 && dy < 5) ? 2 : 0;
+
+    if (!height && hash % 9 == 0) {
+        tiles[state->ground_layer] = MakeTile(1, 2); // water
+        return height;
+    }
+    tiles[state->ground_layer] = MakeTile(height ? 2 : 0, (hash >> 8) % 10); // sand on the hills
+
+    u32 prop = (hash >> 16) % 16;
+    if (prop < 2) tiles[state->tree_layer] = MakeTile(prop, (hash >> 4) % 6);
+    else if (prop == 2) tiles[state->object_layer] = MakeTile(0, (hash >> 4) % 4); // crates
+    else if (prop == 3) tiles[state->overlay_layer] = MakeTile(0, (hash >> 4) % 11); // dirt
+    else if (prop == 4) tiles[state->overlay_layer] = MakeTile(3, (hash >> 4) % 3); // pebbles
+
+    return height;
+}
+
+void GenerateTestMap(GameState *state, int columns, int rows) {
+    Tilemap *map = &state->tilemap;
+    *map = CreateTilemap(&persist_arena, columns, rows, 256, 192);
+    AddTestMapLayers(state, map);
+
+    for (int y = 0; y < rows; ++y) {
+        for (int x = 0; x < columns; ++x) {
+            u16 tiles[TILEMAP_MAX_LAYERS] = {};
+            SetTileHeight(map, x, y, GenerateTestTile(state, x, y, tiles));
+            for (int layer = 0; layer < map->layer_count; ++layer) {
+                if (tiles[layer]) SetTile(map, layer, x, y, tiles[layer]);
+            }
+        }
+    }
+}
+
+// The test content as a world file, a chunk at a time so the world never has to fit in memory.
+// The tilemap's layers are the file's.
+static b32 WriteTestWorld(GameState *state, const char *path, int columns, int rows) {
+    ProfileFunction();
+
+    WorldWriter writer;
+    if (!BeginWorldFile(&writer, path, columns, rows, &state->tilemap)) return false;
+
+    int layer_count = state->tilemap.layer_count;
+    int chunk_bytes = WorldChunkBytes(layer_count);
+    u8 *data = (u8 *)malloc(chunk_bytes);
+
+    for (u32 chunk_y = 0; chunk_y < writer.header.chunk_rows; ++chunk_y) {
+        for (u32 chunk_x = 0; chunk_x < writer.header.chunk_columns; ++chunk_x) {
+            memset(data, 0, chunk_bytes);
+            u8 *heights = GetWorldChunkHeights(data);
+
+            for (int local_y = 0; local_y < TILEMAP_CHUNK_SIZE; ++local_y) {
+                for (int local_x = 0; local_x < TILEMAP_CHUNK_SIZE; ++local_x) {
+                    int x = chunk_x * TILEMAP_CHUNK_SIZE + local_x;
+                    int y = chunk_y * TILEMAP_CHUNK_SIZE + local_y;
+                    if (x >= columns || y >= rows) continue;
+
+                    int i = local_y * TILEMAP_CHUNK_SIZE + local_x;
+                    u16 tiles[TILEMAP_MAX_LAYERS] = {};
+                    heights[i] = (u8)GenerateTestTile(state, x, y, tiles);
+                    for (int layer = 0; layer < layer_count; ++layer) GetWorldChunkTiles(data, layer)[i] = tiles[layer];
+                }
+            }
+
+            WriteWorldChunk(&writer, chunk_y * writer.header.chunk_columns + chunk_x, data);
+        }
+    }
+
+    free(data);
+    return EndWorldFile(&writer);
+}
+
+// The map is a window of WORLD_WINDOW_CHUNKS chunks onto a world file, streamed in around the
+// view (UpdateWorldWindow). The test world is written the first time. False when there's no
+// world to stream from.
+static b32 OpenTestWorld(GameState *state) {
+    Tilemap *map = &state->tilemap;
+    int size = WORLD_WINDOW_CHUNKS * TILEMAP_CHUNK_SIZE;
+    *map = CreateTilemap(&persist_arena, size, size, 256, 192);
+    AddTestMapLayers(state, map);
+
+    // missing, or written for other layers
+    WorldStream *world = OpenWorldStream(WORLD_PATH, WORLD_CACHE_BYTES, map);
+    if (!world) {
+        if (!WriteTestWorld(state, WORLD_PATH, TEST_WORLD_SIZE, TEST_WORLD_SIZE)) return false;
+        world = OpenWorldStream(WORLD_PATH, WORLD_CACHE_BYTES, map);
+        if (!world) return false;
+    }
+    state->world = world;
+
+    // sprites and impostors size their headroom before any column is loaded
+    map->max_height = world->header->max_height;
+
+    // start in the middle of the world
+    int chunk_x = Max((int)world->header->chunk_columns / 2 - WORLD_WINDOW_CHUNKS / 2, 0);
+    int chunk_y = Max((int)world->header->chunk_rows / 2 - WORLD_WINDOW_CHUNKS / 2, 0);
+    state->window_x = chunk_x * TILEMAP_CHUNK_SIZE;
+    state->window_y = chunk_y * TILEMAP_CHUNK_SIZE;
+    return true;
+}
+
+// Tiles whose sprites can touch the screen. A sprite reaches above its tile by its anchor and the
+// tallest column, and below by the rest of its cell, so the screen is grown by that much before
+// its corners are taken back to tile space.
+TileRange GetVisibleTiles(GameState *state, TilemapLayer *layer) {
+    Tilemap *map = &state->tilemap;
+    TilemapAsset *asset = &state->assets[layer->sheet];
+
+    int fb_width, fb_height;
+    GetWindowFramebufferSize(&fb_width, &fb_height);
+
+    f32 scale = map->tile_width / 256.0f;
+    f32 above = (layer->anchor_y + map->max_height * ELEVATION_STEP) * scale;
+    f32 below = (asset->tile_height - layer->anchor_y) * scale;
+
+    // TileToScreen's position is the sprite's top left, the tile's top corner is half a tile right
+    f32 left = -map->tile_width * 0.5f;
+    f32 right = fb_width + map->tile_width * 0.5f;
+    f32 top = -below;
+    f32 bottom = fb_height + above;
+
+    v2 corners[] = {
+        ScreenToTile(left, top, map, state->camera),
+        ScreenToTile(right, top, map, state->camera),
+        ScreenToTile(left, bottom, map, state->camera),
+        ScreenToTile(right, bottom, map, state->camera),
+    };
+
+    f32 min_x = corners[0].x, max_x = corners[0].x;
+    f32 min_y = corners[0].y, max_y = corners[0].y;
+    for (int i = 1; i < (int)ArrayCount(corners); ++i) {
+        min_x = Min(min_x, corners[i].x);
+        max_x = Max(max_x, corners[i].x);
+        min_y = Min(min_y, corners[i].y);
+        max_y = Max(max_y, corners[i].y);
+    }
+
+    TileRange result = { (int)floorf(min_x) - 1, (int)floorf(min_y) - 1, (int)floorf(max_x) + 1, (int)floorf(max_y) + 1 };
+    TileRange map_range = { 0, 0, map->columns - 1, map->rows - 1 };
+
+    return IntersectTileRanges(result, map_range);
+}
+
+// Pushes a layer's tiles in range. On screen when bake is null, otherwise into the layer of the
+// chunk the range covers.
+static void PushLayerTiles(GameState *state, int layer_index, TileRange range, TilemapImpostors *bake) {
+    Tilemap *map = &state->tilemap;
+    TilemapLayer *layer = map->layers + layer_index;
+    f32 scale = (bake ? bake->tile_width : map->tile_width) / 256.0f;
+
+    TileIterator it = IterateTiles(map, layer_index, range);
+    while (NextTile(&it)) {
+        TilemapAssetID id = { TileRow(it.tile), TileColumn(it.tile), (AssetTag)layer->sheet };
+        int height = map->heights[it.y * map->columns + it.x];
+
+        v2 position = bake ? GetImpostorTilePosition(bake, it.x - range.min_x, it.y - range.min_y) : TileToScreen(it.x, it.y, map, state->camera);
+
+        // raised ground is a column of the same block, one per elevation step
+        int bottom = layer->sprite_layer == SpriteLayerGround ? 0 : height;
+        for (int elevation = bottom; elevation <= height; ++elevation) {
+            PushTileSprite(state, id, position, scale, it.x, it.y, elevation, (SpriteLayer)layer->sprite_layer, layer->anchor_y);
+        }
+    }
+}
+
+// Marks a tile's top face with an overlay cell, under whatever stands on it.
+static void PushTileHighlight(GameState *state, TilemapAssetID id, int x, int y) {
+    Tilemap *map = &state->tilemap;
+    v2 position = TileToScreen(x, y, map, state->camera);
+    PushTileSprite(state, id, position, map->tile_width / 256.0f, x, y, GetTileHeight(map, x, y), SpriteLayerOverlay, TILE_SURFACE_Y);
+}
+
+// The selected tiles on screen, the path from a single selected tile and the hovered one. Costs
+// what the selection and the path hold, not the map.
+static void PushSelectionHighlights(GameState *state) {
+    Tilemap *map = &state->tilemap;
+    TileSelection *selection = &state->selection;
+    TileRange visible = GetVisibleTiles(state, map->layers + state->ground_layer);
+
+    for (int i = 0; i < selection->count; ++i) {
+        int x = selection->indices[i] % map->columns;
+        int y = selection->indices[i] / map->columns;
+        if (x < visible.min_x || x > visible.max_x || y < visible.min_y || y > visible.max_y) continue;
+        PushTileHighlight(state, TILE_SELECTED, x, y);
+    }
+
+    // the path's ends are the selected and the hovered tile
+    PathRequest *path = &state->path;
+    int path_points = Min(path->length, path->max_points);
+    for (int i = 1; i < path_points - 1; ++i) {
+        int x = path->points[i].x;
+        int y = path->points[i].y;
+        if (x < visible.min_x || x > visible.max_x || y < visible.min_y || y > visible.max_y) continue;
+        PushTileHighlight(state, TILE_PATH, x, y);
+    }
+
+    if (state->hovered.hit) PushTileHighlight(state, TILE_HOVERED, state->hovered.x, state->hovered.y);
+}
+
+// Each layer is its own batch, and one that's empty or off screen costs nothing. With the depth
+// buffer on a layer is flushed as soon as it's pushed, the keys order the layers against each
+// other. The radix sorted path needs every layer in one sort, so it flushes once at the end.
+void DrawTilemap(GameState *state) {
+    ProfileFunction();
+
+    Tilemap *map = &state->tilemap;
+    SpriteBatch *sprites = &state->sprites;
+    state->visible_layers = 0;
+
+    for (int layer_index = 0; layer_index < map->layer_count; ++layer_index) {
+        TileRange visible = GetVisibleTiles(state, map->layers + layer_index);
+        int count = sprites->count;
+        PushLayerTiles(state, layer_index, visible, 0);
+        if (sprites->count == count) continue;
+        ++state->visible_layers;
+
+        if (sprites->use_depth_buffer) FlushSprites(sprites);
+    }
+
+    PushSelectionHighlights(state);
+    if (!sprites->use_depth_buffer || sprites->count) FlushSprites(sprites);
+}
+
+// How far sprites reach above and below their tile's TileToScreen position, in texels of the
+// sheets, for the impostor layers' headroom.
+static void GetTilemapReach(GameState *state, f32 *above, f32 *below) {
+    Tilemap *map = &state->tilemap;
+    *above = 0;
+    *below = 0;
+
+    for (int i = 0; i < map->layer_count; ++i) {
+        TilemapLayer *layer = map->layers + i;
+        TilemapAsset *asset = &state->assets[layer->sheet];
+        f32 layer_above = layer->anchor_y + map->max_height * ELEVATION_STEP - TILE_SURFACE_Y;
+        f32 layer_below = TILE_SURFACE_Y - layer->anchor_y + asset->tile_height;
+        *above = Max(*above, layer_above);
+        *below = Max(*below, layer_below);
+    }
+}
+
+void CreateImpostors(GameState *state) {
+    f32 above, below;
+    GetTilemapReach(state, &above, &below);
+
+    // the sheets' tiles are 256 texels wide
+    state->impostors = CreateTilemapImpostors(&persist_arena, &state->tilemap, IMPOSTOR_TILE_WIDTH, above / 256.0f, below / 256.0f, IMPOSTOR_BUDGET);
+}
+
+void CreatePicking(GameState *state) {
+    Tilemap *map = &state->tilemap;
+    f32 above, below;
+    GetTilemapReach(state, &above, &below);
+
+    // a sprite covers the tiles behind it one per 2 * step (128 texels) it reaches up
+    int reach = (int)ceilf(above / (2 * PICK_WORLD_STEP)) + 1;
+    int object_layers = 0;
+    for (int i = 0; i < map->layer_count; ++i) object_layers += map->layers[i].sprite_layer == SpriteLayerObject;
+
+    state->picker = CreateTilePicker(&persist_arena, map, TILEMAP_CHUNK_SIZE * TILEMAP_CHUNK_SIZE * object_layers, reach);
+    state->selection = CreateTileSelection(&persist_arena, map, map->columns * map->rows);
+}
+
+void CreatePathfinding(GameState *state) {
+    Tilemap *map = &state->tilemap;
+    state->path_grid = CreatePathGrid(&persist_arena, map->columns, map->rows);
+    state->path_finder = CreatePathFinder(&persist_arena, &state->path_grid, GetJobThreadCount());
+    state->path_revisions = (u32 *)ArenaAlloc(&persist_arena, sizeof(u32) * map->chunk_columns * map->chunk_rows);
+}
+
+static void BakeChunkImpostor(GameState *state, int chunk) {
+    ProfileFunction();
+
+    Tilemap *map = &state->tilemap;
+    SpriteBatch *sprites = &state->sprites;
+    TilemapImpostors *impostors = &state->impostors;
+
+    // blended back to front, the layer has no depth buffer
+    b32 use_depth_buffer = sprites->use_depth_buffer;
+    sprites->use_depth_buffer = false;
+
+    BeginImpostorBake(impostors, chunk);
+    TileRange range = GetChunkTiles(map, chunk);
+    for (int layer_index = 0; layer_index < map->layer_count; ++layer_index) {
+        PushLayerTiles(state, layer_index, range, impostors);
+    }
+    FlushSpritesToTarget(sprites, impostors->texture_width, impostors->texture_height);
+    EndImpostorBake(impostors, map, chunk);
+
+    sprites->use_depth_buffer = use_depth_buffer;
+}
+
+// Zoomed out: one quad per chunk, back to front along the chunk diagonals. Stale chunks on screen
+// are baked again, at most IMPOSTOR_BAKES_PER_FRAME a frame, and ones never baked wait for theirs.
+void DrawTilemapImpostors(GameState *state) {
+    ProfileFunction();
+
+    Tilemap *map = &state->tilemap;
+    TilemapImpostors *impostors = &state->impostors;
+    impostors->bakes = 0;
+
+    int fb_width, fb_height;
+    GetWindowFramebufferSize(&fb_width, &fb_height);
+
+    f32 k = map->tile_width / impostors->tile_width;
+    int diagonals = map->chunk_columns + map->chunk_rows - 1;
+
+    for (int diagonal = 0; diagonal < diagonals; ++diagonal) {
+        for (int chunk_y = 0; chunk_y < map->chunk_rows; ++chunk_y) {
+            int chunk_x = diagonal - chunk_y;
+            if (chunk_x < 0 || chunk_x >= map->chunk_columns) continue;
+
+            int chunk = chunk_y * map->chunk_columns + chunk_x;
+            TileRange tiles = GetChunkTiles(map, chunk);
+
+            v2 first_tile = TileToScreen(tiles.min_x, tiles.min_y, map, state->camera);
+            Rect dest = {
+                first_tile.x - impostors->chunk_origin.x * k,
+                first_tile.y - impostors->chunk_origin.y * k,
+                impostors->texture_width * k,
+                impostors->texture_height * k
+            };
+
+            if (dest.x > fb_width || dest.y > fb_height || dest.x + dest.width < 0 || dest.y + dest.height < 0) continue;
+
+            if (IsImpostorStale(impostors, map, chunk) && impostors->bakes < IMPOSTOR_BAKES_PER_FRAME) {
+                BakeChunkImpostor(state, chunk);
+            }
+            if (!impostors->baked_revisions[chunk]) continue;
+
+            PushImpostor(impostors, chunk, dest);
+        }
+    }
+
+    FlushImpostors(impostors);
+}
+
+// TileToScreen as a TileProjection, from the tile's top corner rather than its sprite's top left.
+TileProjection GetTileProjection(GameState *state) {
+    Tilemap *map = &state->tilemap;
+
+    TileProjection result = {};
+    result.origin = TileToScreen(0, 0, map, state->camera);
+    result.origin.x += map->tile_width * 0.5f;
+    result.half_width = map->tile_width * 0.5f;
+    result.step = map->tile_height * 0.5f * TILEMAP_ROTATION;
+    result.elevation_step = ELEVATION_STEP * (map->tile_width / 256.0f);
+    return result;
+}
+
+// The bounds of a chunk's standing sprites, placed as PushTileSprite does at 256 pixel tiles in
+// the picker's world space (tile (0, 0)'s top corner at the origin).
+static void BuildPickChunk(GameState *state, int chunk) {
+    ProfileFunction();
+
+    Tilemap *map = &state->tilemap;
+    TileRange range = GetChunkTiles(map, chunk);
+    BeginPickChunk(&state->picker, chunk);
+
+    for (int layer_index = 0; layer_index < map->layer_count; ++layer_index) {
+        TilemapLayer *layer = map->layers + layer_index;
+        TilemapAsset *asset = &state->assets[layer->sheet];
+        if (layer->sprite_layer != SpriteLayerObject || !asset->opaque_bounds) continue;
+
+        int columns = GetTilemapAssetColumns(asset);
+        TileIterator it = IterateTiles(map, layer_index, range);
+        while (NextTile(&it)) {
+            Rect opaque = asset->opaque_bounds[TileRow(it.tile) * columns + TileColumn(it.tile)];
+            if (opaque.width <= 0) continue;
+
+            int height = map->heights[it.y * map->columns + it.x];
+            f32 left = (it.x - it.y) * PICK_WORLD_HALF_WIDTH - PICK_WORLD_HALF_WIDTH;
+            f32 top = (it.x + it.y) * PICK_WORLD_STEP + TILE_SURFACE_Y - height * ELEVATION_STEP - layer->anchor_y;
+            Rect bounds = { left + opaque.x, top + opaque.y, opaque.width, opaque.height };
+            AddPickSprite(&state->picker, chunk, bounds, it.x, it.y, layer_index, IsoDepthKey(it.x, it.y, height, layer->sprite_layer));
+        }
+    }
+
+    EndPickChunk(&state->picker, map, chunk);
+}
+
+PickResult PickScreenTile(GameState *state, v2 screen) {
+    Tilemap *map = &state->tilemap;
+    TileProjection projection = GetTileProjection(state);
+
+    int chunks[PICK_MAX_CANDIDATE_CHUNKS];
+    int count = GetPickCandidateChunks(&state->picker, map, &projection, screen, chunks, ArrayCount(chunks));
+    for (int i = 0; i < count; ++i) {
+        if (IsPickChunkStale(&state->picker, map, chunks[i])) BuildPickChunk(state, chunks[i]);
+    }
+
+    PickResult result = PickTile(&state->picker, map, state->ground_layer, &projection, screen, chunks, count);
+    return result;
+}
+
+// Left drag over the map selects the tiles in the dragged rect, with alt held a lasso along the
+// cursor's path. Shift adds to the selection instead of replacing it, a click selects the
+// hovered tile.
+void UpdateTileSelection(GameState *state, v2 cursor) {
+    b32 down = IsButtonPressed(GLFW_MOUSE_BUTTON_LEFT);
+    b32 pressed = down && !state->left_button_down;
+    state->left_button_down = down;
+
+    if (!state->selecting) {
+        if (!pressed || state->ui.hovered >= 0) return;
+
+        state->selecting = true;
+        state->lasso = IsKeyPressed(GLFW_KEY_LEFT_ALT);
+        state->drag_start = cursor;
+        state->lasso_count = 0;
+        state->lasso_points[state->lasso_count++] = cursor;
+        return;
+    }
+
+    if (down) {
+        v2 last = state->lasso_points[state->lasso_count - 1];
+        f32 dx = cursor.x - last.x;
+        f32 dy = cursor.y - last.y;
+        b32 moved = dx * dx + dy * dy >= SELECTION_LASSO_SPACING * SELECTION_LASSO_SPACING;
+        if (state->lasso && moved && state->lasso_count < SELECTION_MAX_LASSO_POINTS) state->lasso_points[state->lasso_count++] = cursor;
+        return;
+    }
+
+    state->selecting = false;
+
+    Tilemap *map = &state->tilemap;
+    TileSelection *selection = &state->selection;
+    TileProjection projection = GetTileProjection(state);
+    if (!IsKeyPressed(GLFW_KEY_LEFT_SHIFT)) ClearTileSelection(selection);
+
+    f32 width = fabsf(cursor.x - state->drag_start.x);
+    f32 height = fabsf(cursor.y - state->drag_start.y);
+
+    if (width < SELECTION_LASSO_SPACING && height < SELECTION_LASSO_SPACING) {
+        if (state->hovered.hit) SelectTile(selection, state->hovered.x, state->hovered.y);
+        state->selection_tested = 1;
+    } else if (state->lasso) {
+        state->selection_tested = SelectTilesInPolygon(selection, map, state->ground_layer, &projection, state->lasso_points, state->lasso_count);
+    } else {
+        f32 left = Min(cursor.x, state->drag_start.x);
+        f32 top = Min(cursor.y, state->drag_start.y);
+        state->selection_tested = SelectTilesInRect(selection, map, state->ground_layer, &projection, { left, top, width, height });
+    }
+}
+
+// The rect or lasso being dragged.
+static void DrawSelectionOutline(GameState *state, v2 cursor) {
+    if (!state->selecting) return;
+
+    v4 color = { 1.0f, 0.9f, 0.3f, 1.0f };
+    if (!state->lasso) {
+        v2 start = state->drag_start;
+        DrawRectangleLines(Min(start.x, cursor.x), Max(start.x, cursor.x), Min(start.y, cursor.y), Max(start.y, cursor.y), color);
+        return;
+    }
+
+    for (int i = 1; i < state->lasso_count; ++i) {
+        v2 a = state->lasso_points[i - 1];
+        v2 b = state->lasso_points[i];
+        DrawLine(a.x, a.y, b.x, b.y, color);
+    }
+    v2 last = state->lasso_points[state->lasso_count - 1];
+    DrawLine(last.x, last.y, cursor.x, cursor.y, color);
+}
+
+// Agents walk on land nothing stands on. Hills are terraced, a step up doesn't block.
+static b32 IsTileWalkable(GameState *state, int x, int y) {
+    Tilemap *map = &state->tilemap;
+    TilemapAssetID water = TILE_WATER_1;
+    u16 ground = GetTile(map, state->ground_layer, x, y);
+    b32 result = ground && ground != MakeTile(water.row, water.column) &&
+                 !GetTile(map, state->object_layer, x, y) && !GetTile(map, state->tree_layer, x, y);
+    return result;
+}
+
+// Copies the chunks that changed since the last frame into the path grid, then rebuilds the
+// clusters whose walkable tiles did change. Chunks still loading are empty, so blocked.
+void UpdatePathGrid(GameState *state) {
+    ProfileFunction();
+
+    Tilemap *map = &state->tilemap;
+    for (int chunk = 0; chunk < map->chunk_columns * map->chunk_rows; ++chunk) {
+        if (state->path_revisions[chunk] == map->chunk_revisions[chunk]) continue;
+        state->path_revisions[chunk] = map->chunk_revisions[chunk];
+
+        TileRange range = GetChunkTiles(map, chunk);
+        for (int y = range.min_y; y <= range.max_y; ++y) {
+            for (int x = range.min_x; x <= range.max_x; ++x) {
+                SetPathCost(&state->path_grid, x, y, IsTileWalkable(state, x, y) ? 1 : 0);
+            }
+        }
+    }
+
+    UpdatePathAbstraction(&state->path_finder);
+}
+
+// With a single tile selected, the path from it to the hovered tile.
+void UpdateTilePath(GameState *state) {
+    Tilemap *map = &state->tilemap;
+    PathRequest *path = &state->path;
+    path->found = false;
+    path->length = 0;
+    if (state->selection.count != 1 || !state->hovered.hit) return;
+
+    path->method = PathHierarchical;
+    path->start_x = state->selection.indices[0] % map->columns;
+    path->start_y = state->selection.indices[0] / map->columns;
+    path->goal_x = state->hovered.x;
+    path->goal_y = state->hovered.y;
+    path->points = state->path_points;
+    path->max_points = MAX_PATH_POINTS;
+
+    double start = GetTime();
+    FindPath(&state->path_finder, path);
+    state->path_seconds = GetTime() - start;
+}
+
+// Copies a decoded world chunk into the window, chunk_x and chunk_y in the window's chunks. The
+// window's chunk is empty, only the tiles that are there get set.
+static void LoadWindowChunk(GameState *state, int chunk_x, int chunk_y, u8 *data) {
+    Tilemap *map = &state->tilemap;
+    u8 *heights = GetWorldChunkHeights(data);
+
+    for (int local_y = 0; local_y < TILEMAP_CHUNK_SIZE; ++local_y) {
+        for (int local_x = 0; local_x < TILEMAP_CHUNK_SIZE; ++local_x) {
+            int x = chunk_x * TILEMAP_CHUNK_SIZE + local_x;
+            int y = chunk_y * TILEMAP_CHUNK_SIZE + local_y;
+            int i = local_y * TILEMAP_CHUNK_SIZE + local_x;
+
+            if (heights[i]) SetTileHeight(map, x, y, heights[i]);
+            for (int layer = 0; layer < map->layer_count; ++layer) {
+                u16 tile = GetWorldChunkTiles(data, layer)[i];
+                if (tile) SetTile(map, layer, x, y, tile);
+            }
+        }
+    }
+}
+
+// Moves the window to another chunk aligned world tile. The camera moves with it so the world
+// stays where it was on screen, the window's chunks load again from the cache.
+static void ShiftWorldWindow(GameState *state, int window_x, int window_y) {
+    ProfileFunction();
+
+    Tilemap *map = &state->tilemap;
+    v2 origin = TileToScreen(0, 0, map, state->camera);
+    v2 moved = TileToScreen(window_x - state->window_x, window_y - state->window_y, map, state->camera);
+    state->camera.position.x += moved.x - origin.x;
+    state->camera.position.y += moved.y - origin.y;
+
+    state->window_x = window_x;
+    state->window_y = window_y;
+    ClearTilemap(map);
+    memset(state->window_loaded, 0, sizeof(state->window_loaded));
+    ClearTileSelection(&state->selection); // window coordinates
+}
+
+// Keeps the window around the view. It moves by whole chunks once the view's centre drifts off
+// its middle. Every chunk of it and a ring around it are requested, nearest the view first, and
+// the decoded ones are copied in.
+void UpdateWorldWindow(GameState *state) {
+    ProfileFunction();
+
+    WorldStream *world = state->world;
+    if (!world) return;
+
+    Tilemap *map = &state->tilemap;
+    UpdateWorldStream(world);
+
+    int fb_width, fb_height;
+    GetWindowFramebufferSize(&fb_width, &fb_height);
+    v2 centre = ScreenToTile(fb_width / 2, fb_height / 2, map, state->camera);
+
+    int world_columns = world->header->chunk_columns;
+    int world_rows = world->header->chunk_rows;
+    int centre_x = state->window_x / TILEMAP_CHUNK_SIZE + (int)floorf(centre.x / TILEMAP_CHUNK_SIZE);
+    int centre_y = state->window_y / TILEMAP_CHUNK_SIZE + (int)floorf(centre.y / TILEMAP_CHUNK_SIZE);
+
+    int window_x = clamp(centre_x - WORLD_WINDOW_CHUNKS / 2, 0, Max(world_columns - WORLD_WINDOW_CHUNKS, 0));
+    int window_y = clamp(centre_y - WORLD_WINDOW_CHUNKS / 2, 0, Max(world_rows - WORLD_WINDOW_CHUNKS, 0));
+    int drift_x = abs(window_x - state->window_x / TILEMAP_CHUNK_SIZE);
+    int drift_y = abs(window_y - state->window_y / TILEMAP_CHUNK_SIZE);
+    if (drift_x > WORLD_RECENTER_CHUNKS || drift_y > WORLD_RECENTER_CHUNKS) {
+        ShiftWorldWindow(state, window_x * TILEMAP_CHUNK_SIZE, window_y * TILEMAP_CHUNK_SIZE);
+    }
+    window_x = state->window_x / TILEMAP_CHUNK_SIZE;
+    window_y = state->window_y / TILEMAP_CHUNK_SIZE;
+
+    int loads = 0;
+    int reach = WORLD_WINDOW_CHUNKS / 2 + WORLD_RECENTER_CHUNKS + WORLD_PREFETCH_CHUNKS;
+    for (int ring = 0; ring <= reach; ++ring) {
+        for (int chunk_y = centre_y - ring; chunk_y <= centre_y + ring; ++chunk_y) {
+            for (int chunk_x = centre_x - ring; chunk_x <= centre_x + ring; ++chunk_x) {
+                int distance = Max(abs(chunk_x - centre_x), abs(chunk_y - centre_y));
+                if (distance != ring || chunk_x < 0 || chunk_y < 0 || chunk_x >= world_columns || chunk_y >= world_rows) continue;
+
+                int chunk = chunk_y * world_columns + chunk_x;
+                int local_x = chunk_x - window_x;
+                int local_y = chunk_y - window_y;
+                b32 in_window = local_x >= 0 && local_y >= 0 && local_x < WORLD_WINDOW_CHUNKS && local_y < WORLD_WINDOW_CHUNKS;
+                b32 *loaded = in_window ? state->window_loaded + local_y * WORLD_WINDOW_CHUNKS + local_x : 0;
+
+                u8 *data = GetWorldChunk(world, chunk);
+                if (!data) {
+                    RequestWorldChunk(world, chunk);
+                } else if (loaded && !*loaded && loads < WORLD_WINDOW_LOADS_PER_FRAME) {
+                    LoadWindowChunk(state, local_x, local_y, data);
+                    *loaded = true;
+                    ++loads;
+                }
+            }
+        }
+    }
+}
+
 v2 Scale(v2 p, f32 width, f32 height, f32 s) {
     v2 ps = p * s;
     return ps;
 }
 
 void UpdateAndRender(GameState *state) {
+    ProfileFunction();
+
     if (!state->initialized) {
         InitializeGameState(state);
 
@@ -230,7 +993,16 @@ void UpdateAndRender(GameState *state) {
     }
 
     ProcessInputEvents(state);
+    UpdateWorldWindow(state);
+    UpdatePathGrid(state);
+    UpdateInventoryUI(state);
+
+    v2 cursor = { (f32)platform.cursor_x, (f32)platform.cursor_y };
+    state->hovered = PickScreenTile(state, cursor);
+    UpdateTileSelection(state, cursor);
+    UpdateTilePath(state);
 
+    BeginGpuFrame();
     glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
     // Draw texture preview
@@ -241,39 +1013,66 @@ void UpdateAndRender(GameState *state) {
     v4 line_color = { 0.0f, 0.0f, 1.0f, 1.0f };
     v4 fill_color = { .50f, .50f, 1.0f, 1.0f };
 
-    v2 cursor_tile = ScreenToTile(platform.cursor_x, platform.cursor_y, &state->tilemap, state->camera);
+    GpuPassBlock("Tiles");
+    b32 use_impostors = state->camera.zoom < IMPOSTOR_ZOOM;
+    if (use_impostors) {
+        DrawTilemapImpostors(state);
+    } else {
+        DrawTilemap(state);
+    }
 
-    Texture tile_texture = GetAssetTexture(TILE_WATER_1, state);
-    Rect water_uv_rect = GetAssetTextureRect(TILE_WATER_1, state);
+    // per tile labels would be O(tiles) again when zoomed out
+    TileRange labels = GetVisibleTiles(state, state->tilemap.layers + state->ground_layer);
+    if (use_impostors) labels = { 0, 0, -1, -1 };
 
-    for (int r = 0; r < state->tilemap.rows; ++r) {
-        for (int c = 0; c < state->tilemap.columns; ++c) {
+    for (int r = labels.min_y; r <= labels.max_y; ++r) {
+        for (int c = labels.min_x; c <= labels.max_x; ++c) {
             v2 screen_coords = TileToScreen(c, r, &state->tilemap, state->camera);
+            screen_coords.y -= GetTileHeight(&state->tilemap, c, r) * ELEVATION_STEP * (state->tilemap.tile_width / 256.0f);
+            DrawPixel(screen_coords.x, screen_coords.y, fill_color, 5);
 
-            if (r == (int)cursor_tile.y && c == (int)cursor_tile.x) {
-                screen_coords.y -= 20;
-            }
+            // tile coordinates, sized with the tile so they zoom with the map
+            f32 label_size = state->tilemap.tile_height * 0.2f;
+            PushTextSizedFormat(&state->label_font, screen_coords.x + state->tilemap.tile_width * 0.4f, screen_coords.y + state->tilemap.tile_height * 0.3f,
+                                label_size, v4(1, 1, 1, 0.8f), "%d,%d", c + state->window_x, r + state->window_y);
+        }
+    }
 
-            Rect dest_rect = {
-                screen_coords.x,
-                screen_coords.y,
-                (f32)state->tilemap.tile_width,
-                (f32)state->tilemap.tile_height
-            };
+    DrawPixel(fb_width*0.5, fb_height*0.5, fill_color, 5);
 
-            Rect uv_rect = {
-                r * 256.0f,
-                c * 192.0f,
-                256,
-                192
-            };
+    FlushText(&state->label_font);
+    DrawSelectionOutline(state, cursor);
 
-            DrawTextureRect(tile_texture, dest_rect, water_uv_rect);
-            DrawPixel(screen_coords.x, screen_coords.y, fill_color, 5);
-        }
+    char hovered[64];
+    if (state->hovered.hit) {
+        snprintf(hovered, sizeof(hovered), "tile %d, %d%s", state->hovered.x + state->window_x, state->hovered.y + state->window_y,
+                 state->hovered.layer >= 0 ? " (sprite)" : "");
+    } else {
+        snprintf(hovered, sizeof(hovered), "no tile");
     }
 
-    DrawPixel(fb_width*0.5, fb_height*0.5, fill_color, 5);
+    if (use_impostors) {
+        PushTextFormat(&state->font, 10, 10, v4(1), "%s  zoom %.2f  impostors, %d baked", hovered, state->camera.zoom, state->impostors.bakes);
+    } else {
+        PushTextFormat(&state->font, 10, 10, v4(1), "%s  zoom %.2f  %d layers, %s", hovered, state->camera.zoom, state->visible_layers,
+                       state->sprites.use_depth_buffer ? "depth buffer" : "radix sorted");
+    }
+    char path[96] = "";
+    if (state->path.found) {
+        snprintf(path, sizeof(path), ", path %d tiles in %.3f ms, %d nodes expanded", state->path.length, state->path_seconds * 1000, state->path.expanded);
+    } else if (state->selection.count == 1 && state->hovered.hit) {
+        snprintf(path, sizeof(path), ", no path");
+    }
+    PushTextFormat(&state->font, 10, 32, v4(1), "%d selected, %d tiles tested%s", state->selection.count, state->selection_tested, path);
+    if (state->world) {
+        WorldStream *world = state->world;
+        PushTextFormat(&state->font, 10, 54, v4(1), "world %u x %u, window at %d, %d  %d / %d chunks cached, %d loading, %llu loads, %llu evictions",
+                       world->header->columns, world->header->rows, state->window_x, state->window_y, world->resident, world->slot_count, world->loading,
+                       (unsigned long long)world->loads, (unsigned long long)world->evictions);
+    }
+    FlushText(&state->font);
+
+    DrawUI(&state->ui);
 }
 
 void PrintInputEvent(InputEvent *event) {
@@ -301,21 +1100,86 @@ void PrintInputEvent(InputEvent *event) {
     }
 }
 
+#define INVENTORY_COLUMNS 8
+#define INVENTORY_ROWS 4
+#define INVENTORY_SLOT_SIZE 48
+
+// Sprites in the UI sheet, texels from the top left.
+#define UI_SPRITE_SLOT { 0, 0, 256, 256 }
+#define UI_SPRITE_WIDE_PANEL { 256, 0, 512, 256 }
+
+void CreateInventoryUI(GameState *state) {
+    UIContext *ui = &state->ui;
+    *ui = CreateUI(&persist_arena, 256, state->assets[UIElements].texture, &state->font);
+
+    f32 padding = 8;
+    f32 width = INVENTORY_COLUMNS * (INVENTORY_SLOT_SIZE + padding) + padding;
+    f32 height = INVENTORY_ROWS * (INVENTORY_SLOT_SIZE + padding) + padding + 56;
+    f32 left = 20;
+    f32 top = 60;
+
+    AddUIImage(ui, { left, top, width, height }, UI_SPRITE_WIDE_PANEL);
+    AddUILabel(ui, left + 16, top + 12, "Inventory", v4(0.25f, 0.18f, 0.1f, 1));
+
+    state->inventory_first_slot = ui->widget_count;
+    for (int row = 0; row < INVENTORY_ROWS; ++row) {
+        for (int column = 0; column < INVENTORY_COLUMNS; ++column) {
+            Rect rect = { left + padding + column * (INVENTORY_SLOT_SIZE + padding), top + 36 + row * (INVENTORY_SLOT_SIZE + padding),
+                          INVENTORY_SLOT_SIZE, INVENTORY_SLOT_SIZE };
+            char number[8];
+            snprintf(number, sizeof(number), "%d", row * INVENTORY_COLUMNS + column + 1);
+            int id = AddUIButton(ui, rect, UI_SPRITE_SLOT, number);
+            ui->widgets[id].text_color = v4(0.25f, 0.18f, 0.1f, 1);
+        }
+    }
+
+    state->inventory_status = AddUILabel(ui, left + 16, top + height - 22, "Nothing selected", v4(0.25f, 0.18f, 0.1f, 1));
+    state->selected_slot = -1;
+}
+
+void UpdateInventoryUI(GameState *state) {
+    UIContext *ui = &state->ui;
+    int clicked = UpdateUI(ui, (f32)platform.cursor_x, (f32)platform.cursor_y, IsButtonPressed(GLFW_MOUSE_BUTTON_LEFT));
+
+    int slot_count = INVENTORY_COLUMNS * INVENTORY_ROWS;
+    int slot = clicked - state->inventory_first_slot;
+    if (clicked < 0 || slot < 0 || slot >= slot_count) return;
+
+    if (state->selected_slot >= 0) SetUISelected(ui, state->inventory_first_slot + state->selected_slot, false);
+    state->selected_slot = slot == state->selected_slot ? -1 : slot;
+
+    char status[UI_MAX_TEXT];
+    if (state->selected_slot >= 0) {
+        SetUISelected(ui, clicked, true);
+        snprintf(status, sizeof(status), "Slot %d selected", slot + 1);
+    } else {
+        snprintf(status, sizeof(status), "Nothing selected");
+    }
+    SetUIText(ui, state->inventory_status, status);
+}
+
 void InitializeGameState(GameState *state) {
     state->initialized = true;
 
     scratch_arena = CreateArena(Kilobytes(16));
-    persist_arena = CreateArena(Kilobytes(16));
+    // map, path searches (one per job thread), UI and sprite geometry, ArenaAlloc growing would move it
+    persist_arena = CreateArena(Megabytes(16) + Megabytes(1) * GetJobThreadCount());
 
-    state->tilemap.tile_width = 256;
-    state->tilemap.tile_height = 192;
-    state->tilemap.columns = 10;
-    state->tilemap.rows = 10;
+    if (!OpenTestWorld(state)) GenerateTestMap(state, 64, 64);
 
     state->camera.zoom = 0.25;
 
     LoadTexture("assets/isometric-asset-pack/256x192 Tiles.png", &state->atlas);
     LoadTilemapAssets(state);
+    LoadFont(&state->font, "assets/FiraMono-Regular.ttf", 18);
+    LoadSdfFont(&state->label_font, "assets/FiraMono-Regular.ttf", 32);
+
+    state->sprites = CreateSpriteBatch(&persist_arena, 1 << 14);
+    CreateImpostors(state);
+    CreatePicking(state);
+    CreatePathfinding(state);
+
+    CreateInventoryUI(state);
 }
 
 void ProcessInputEvents(GameState *state) {
@@ -335,6 +1199,10 @@ void ProcessInputEvents(GameState *state) {
             }
         }
 
+        if (event.type == InputEventType::KeyEvent && event.key == GLFW_KEY_F2 && event.action == GLFW_PRESS) {
+            state->sprites.use_depth_buffer = !state->sprites.use_depth_buffer;
+        }
+
         if (event.type == InputEventType::KeyEvent) {
             switch (event.key) {
                 case GLFW_KEY_UP: state->view_offset_y -= PAN_SPEED; break;
@@ -250,6 +250,8 @@ struct GLUtilVertex {
 };
 
 void InitializeUtilBuffers() {
+    glutil_initialized = true;
+
     glGenBuffers(1, &glutil_basic_vbo);
     glGenVertexArrays(1, &glutil_basic_vao);
     glBindVertexArray(glutil_basic_vao);
@@ -393,6 +395,8 @@ void DrawRectangle(int left, int right, int top, int bottom, v4 color) {
 }
 
 void LoadTexture(const char *filename, Texture *texture) {
+    ProfileFunction();
+
     stbi_set_flip_vertically_on_load(true);
 
     Texture result = {};
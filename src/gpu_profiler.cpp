@@ -0,0 +1,157 @@
+/*
+    GPU pass timing.
+
+    GpuPassBlock(name) wraps a render pass in a debug group (so RenderDoc, Nsight and apitrace
+    show it by name), a CPU profile zone, and a pair of GL_TIMESTAMP queries. Query results are
+    read GPU_QUERY_FRAMES frames later, by then the GPU is done with them and reading never
+    stalls; a frame whose results still aren't there is dropped rather than waited on.
+
+    Each frame also samples the GPU clock (glGetInteger64v GL_TIMESTAMP) against GetTime, which
+    maps its pass timestamps onto the CPU timeline. They are handed to the profiler as the "GPU"
+    thread, so the overlay and the Chrome trace show passes under the CPU work that issued them.
+
+    Only needs GL 3.3 timer queries and GL 4.3 debug groups, both of which Mesa's llvmpipe has.
+    Either one missing just turns that part off.
+*/
+
+#define GPU_QUERY_FRAMES 4 // frames between issuing a query and reading it back
+#define MAX_GPU_PASSES 32 // per frame
+#define MAX_GPU_PASS_DEPTH 8
+
+struct GpuProfilerFrame {
+    b32 issued;
+    u64 sync_gpu_time; // ns, GL_TIMESTAMP at the start of the frame
+    double sync_time; // GetTime at the same moment
+
+    int pass_count;
+    const char *names[MAX_GPU_PASSES];
+    u32 queries[MAX_GPU_PASSES * 2]; // begin, end
+};
+
+struct GpuProfiler {
+    b32 initialized;
+    b32 timer_queries;
+    b32 debug_groups;
+
+    u64 frame;
+    GpuProfilerFrame frames[GPU_QUERY_FRAMES];
+
+    int open_count; // may exceed MAX_GPU_PASS_DEPTH, the deeper passes aren't timed
+    int open_passes[MAX_GPU_PASS_DEPTH]; // -1 when the pass got no queries
+
+    u64 dropped_frames;
+};
+
+// recreated with the module, the old copy's query objects are leaked on reload
+static GpuProfiler gpu_profiler;
+
+static void InitGpuProfiler(GpuProfiler *profiler) {
+    profiler->initialized = true;
+    profiler->timer_queries = GLEW_VERSION_3_3 || GLEW_ARB_timer_query;
+    profiler->debug_groups = GLEW_VERSION_4_3 || GLEW_KHR_debug;
+
+    if (profiler->timer_queries) {
+        for (int i = 0; i < GPU_QUERY_FRAMES; ++i) {
+            glGenQueries(ArrayCount(profiler->frames[i].queries), profiler->frames[i].queries);
+        }
+    }
+
+    fprintf(stdout, "GPU profiler: timer queries %s, debug groups %s\n",
+            profiler->timer_queries ? "on" : "off", profiler->debug_groups ? "on" : "off");
+}
+
+// Hands a finished frame's passes to the profiler. False if the GPU isn't done with it yet.
+static bool ResolveGpuProfilerFrame(GpuProfilerFrame *frame) {
+    if (!frame->pass_count) return true;
+
+    for (int i = 0; i < frame->pass_count; ++i) {
+        GLint available = 0;
+        glGetQueryObjectiv(frame->queries[i * 2 + 1], GL_QUERY_RESULT_AVAILABLE, &available);
+        if (!available) return false;
+    }
+
+    for (int i = 0; i < frame->pass_count; ++i) {
+        GLuint64 begin = 0, end = 0;
+        glGetQueryObjectui64v(frame->queries[i * 2], GL_QUERY_RESULT, &begin);
+        glGetQueryObjectui64v(frame->queries[i * 2 + 1], GL_QUERY_RESULT, &end);
+
+        // signed, passes can start before the sync point was sampled
+        double start_time = frame->sync_time + (int64_t)(begin - frame->sync_gpu_time) * 1e-9;
+        double end_time = frame->sync_time + (int64_t)(end - frame->sync_gpu_time) * 1e-9;
+        RecordGpuProfileZone(frame->names[i], start_time, end_time);
+    }
+
+    return true;
+}
+
+// Main thread, before the first pass of the frame.
+void BeginGpuFrame() {
+    GpuProfiler *profiler = &gpu_profiler;
+    if (!profiler->initialized) InitGpuProfiler(profiler);
+    if (!profiler->timer_queries) return;
+
+    GpuProfilerFrame *frame = profiler->frames + profiler->frame % GPU_QUERY_FRAMES;
+    if (frame->issued && !ResolveGpuProfilerFrame(frame)) ++profiler->dropped_frames;
+
+    frame->issued = true;
+    frame->pass_count = 0;
+    profiler->open_count = 0;
+
+    GLint64 gpu_time = 0;
+    glGetInteger64v(GL_TIMESTAMP, &gpu_time);
+    frame->sync_gpu_time = (u64)gpu_time;
+    frame->sync_time = GetTime();
+
+    ++profiler->frame;
+}
+
+void BeginGpuPass(const char *name) {
+    GpuProfiler *profiler = &gpu_profiler;
+    if (profiler->debug_groups) glPushDebugGroup(GL_DEBUG_SOURCE_APPLICATION, 0, -1, name);
+
+    int depth = profiler->open_count++;
+    if (depth >= MAX_GPU_PASS_DEPTH) return;
+    int *open_pass = profiler->open_passes + depth;
+    *open_pass = -1;
+
+    if (!profiler->timer_queries || !profiler->frame) return;
+    GpuProfilerFrame *frame = profiler->frames + (profiler->frame - 1) % GPU_QUERY_FRAMES;
+    if (frame->pass_count == MAX_GPU_PASSES) return;
+
+    *open_pass = frame->pass_count++;
+    frame->names[*open_pass] = name;
+    glQueryCounter(frame->queries[*open_pass * 2], GL_TIMESTAMP);
+}
+
+void EndGpuPass() {
+    GpuProfiler *profiler = &gpu_profiler;
+
+    int depth = --profiler->open_count;
+    if (depth >= 0 && depth < MAX_GPU_PASS_DEPTH) {
+        int pass = profiler->open_passes[depth];
+        if (pass >= 0) {
+            GpuProfilerFrame *frame = profiler->frames + (profiler->frame - 1) % GPU_QUERY_FRAMES;
+            glQueryCounter(frame->queries[pass * 2 + 1], GL_TIMESTAMP);
+        }
+    }
+
+    if (profiler->debug_groups) glPopDebugGroup();
+}
+
+struct GpuPassZone {
+    ProfileZone cpu_zone;
+
+    GpuPassZone(const char *name) : cpu_zone(name) {
+        BeginGpuPass(name);
+    }
+
+    ~GpuPassZone() {
+        EndGpuPass();
+    }
+};
+
+#ifdef NO_PROFILER
+#define GpuPassBlock(name)
+#else
+#define GpuPassBlock(name) GpuPassZone ProfileConcat(gpu_pass_zone_, __LINE__)(name)
+#endif
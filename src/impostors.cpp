@@ -0,0 +1,335 @@
+/*
+    Tilemap impostors.
+
+    Zoomed far out a tile is a few pixels and a map is thousands of sprites, so each chunk of the
+    map (TILEMAP_CHUNK_SIZE square) is rendered once into a layer of a texture array and drawn as
+    one quad. The array is mipmapped and sampled trilinear, so small chunks don't shimmer.
+
+    A chunk's layer covers everything its tiles draw: the diamond of the chunk, the tallest sprite
+    on its back row and the bottom of its front row. Chunks are drawn back to front along their
+    diagonal, so a tree sticking out of a chunk in front correctly covers the one behind it.
+
+    The baker renders in texels of the layer with the tile size fixed at creation, the map's
+    max_height and tallest sprite at that point decide the headroom. Each chunk keeps the
+    revision of the tilemap chunk it was baked from, a different revision makes it stale. Bakes
+    are limited per frame, a stale chunk keeps drawing its old image until its turn comes.
+
+    Memory is one full mip chain of RGBA8 per chunk, about 4/3 * 4 bytes a texel. Creation takes
+    a byte budget and bakes tiles at the widest size up to the one asked for whose layers all fit
+    in it, so a bigger map or a taller sprite costs sharpness instead of VRAM. The game's 8 x 8
+    chunk window at 32 texel tiles is 64 layers of 512 x 347, about 58 MB.
+
+    Baking blends with premultiplied alpha into a transparent layer, so the layers (and their
+    mips) are premultiplied and drawn with GL_ONE, GL_ONE_MINUS_SRC_ALPHA. Each layer also has a
+    2D texture view, mips are generated through it so a bake only downsamples its own layer.
+*/
+
+struct ImpostorVertex {
+    v2 p; // pixels, top left origin
+    v3 uv; // z is the array layer
+};
+
+struct TilemapImpostors {
+    int chunk_count;
+    u32 *baked_revisions; // 0 until baked
+
+    f32 tile_width; // pixels of a tile in the layers
+    f32 tile_height;
+    int texture_width;
+    int texture_height;
+    int levels;
+    v2 chunk_origin; // where the sprite of a chunk's first tile has its top left, in texels
+
+    GLuint texture; // 2D array, one layer per chunk
+    GLuint *layer_views;
+    GLuint fbo;
+    GLint previous_fbo; // restored after a bake
+
+    int max_quads;
+    int quad_count;
+    ImpostorVertex *vertices;
+
+    GLuint vao;
+    GLuint vbo;
+    GLuint ibo;
+    GLuint program;
+    int screen_size_location;
+
+    int bakes; // last frame, for the overlay
+};
+
+static void InitImpostorRenderer(TilemapImpostors *impostors) {
+    glGenVertexArrays(1, &impostors->vao);
+    glGenBuffers(1, &impostors->vbo);
+    glGenBuffers(1, &impostors->ibo);
+    glBindVertexArray(impostors->vao);
+    glBindBuffer(GL_ARRAY_BUFFER, impostors->vbo);
+    glBufferData(GL_ARRAY_BUFFER, sizeof(ImpostorVertex) * 4 * impostors->max_quads, 0, GL_DYNAMIC_DRAW);
+
+    u32 *indices = (u32 *)malloc(sizeof(u32) * 6 * impostors->max_quads);
+    for (int i = 0; i < impostors->max_quads; ++i) {
+        u32 v = i * 4;
+        u32 *quad = indices + i * 6;
+        quad[0] = v; quad[1] = v + 1; quad[2] = v + 2;
+        quad[3] = v; quad[4] = v + 2; quad[5] = v + 3;
+    }
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, impostors->ibo);
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(u32) * 6 * impostors->max_quads, indices, GL_STATIC_DRAW);
+    free(indices);
+
+    glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, sizeof(ImpostorVertex), 0);
+    glEnableVertexAttribArray(0);
+    glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(ImpostorVertex), (void *)offsetof(ImpostorVertex, uv));
+    glEnableVertexAttribArray(1);
+    glBindVertexArray(0);
+
+    const char *vertex_source = R"(
+        #version 460
+        layout (location = 0) in vec2 p;
+        layout (location = 1) in vec3 uv;
+
+        uniform vec2 screen_size;
+
+        out vec3 vuv;
+
+        void main() {
+            gl_Position = vec4(p.x / screen_size.x * 2.0 - 1.0, 1.0 - p.y / screen_size.y * 2.0, 0.0, 1.0);
+            vuv = uv;
+        }
+    )";
+
+    const char *frag_source = R"(
+        #version 460
+
+        in vec3 vuv;
+
+        out vec4 frag_color;
+
+        uniform sampler2DArray chunks;
+
+        void main() {
+            frag_color = texture(chunks, vuv);
+        }
+    )";
+
+    GLuint vs = glCreateShader(GL_VERTEX_SHADER);
+    glShaderSource(vs, 1, &vertex_source, 0);
+    CompileShader(vs);
+
+    GLuint fs = glCreateShader(GL_FRAGMENT_SHADER);
+    glShaderSource(fs, 1, &frag_source, 0);
+    CompileShader(fs);
+
+    impostors->program = glCreateProgram();
+    glAttachShader(impostors->program, vs);
+    glAttachShader(impostors->program, fs);
+    LinkProgram(impostors->program);
+    glDeleteShader(vs);
+    glDeleteShader(fs);
+
+    impostors->screen_size_location = glGetUniformLocation(impostors->program, "screen_size");
+}
+
+#define IMPOSTOR_MIN_TILE_WIDTH 4.0f
+
+// above and below are in tile widths, so they scale with it.
+static void LayoutImpostors(TilemapImpostors *impostors, Tilemap *map, f32 tile_width, f32 above, f32 below) {
+    // the same shape as the map: x steps half a tile right and y half a tile left, each of them
+    // steps down TILEMAP_ROTATION of half a tile
+    impostors->tile_width = tile_width;
+    impostors->tile_height = tile_width * map->tile_height / map->tile_width;
+    f32 half_width = impostors->tile_width * 0.5f;
+    f32 step = impostors->tile_height * 0.5f * TILEMAP_ROTATION;
+
+    impostors->texture_width = (int)ceilf(TILEMAP_CHUNK_SIZE * 2 * half_width);
+    impostors->texture_height = (int)ceilf((above + below) * tile_width + 2 * (TILEMAP_CHUNK_SIZE - 1) * step);
+    impostors->chunk_origin = { (TILEMAP_CHUNK_SIZE - 1) * half_width, above * tile_width };
+
+    int size = Max(impostors->texture_width, impostors->texture_height);
+    impostors->levels = 1;
+    while (size >> impostors->levels) ++impostors->levels;
+}
+
+// Every layer with all its mips.
+u64 GetImpostorBytes(TilemapImpostors *impostors) {
+    u64 layer_bytes = 0;
+    for (int level = 0; level < impostors->levels; ++level) {
+        u64 width = Max(impostors->texture_width >> level, 1);
+        u64 height = Max(impostors->texture_height >> level, 1);
+        layer_bytes += width * height * 4;
+    }
+
+    u64 result = layer_bytes * impostors->chunk_count;
+    return result;
+}
+
+// Everything but the GL objects, BenchmarkImpostors runs on this without a context.
+static TilemapImpostors AllocateTilemapImpostors(Arena *arena, Tilemap *map, f32 max_tile_width, f32 above, f32 below, u64 budget) {
+    TilemapImpostors result = {};
+    result.chunk_count = map->chunk_columns * map->chunk_rows;
+    result.baked_revisions = (u32 *)ArenaAlloc(arena, sizeof(u32) * result.chunk_count);
+    result.layer_views = (GLuint *)ArenaAlloc(arena, sizeof(GLuint) * result.chunk_count);
+    result.max_quads = result.chunk_count;
+    result.vertices = (ImpostorVertex *)ArenaAlloc(arena, sizeof(ImpostorVertex) * 4 * result.max_quads);
+
+    // whole texels narrower each try, there's a floor below which a layer is no use
+    for (f32 tile_width = max_tile_width;; tile_width -= 1) {
+        LayoutImpostors(&result, map, tile_width, above, below);
+        if (GetImpostorBytes(&result) <= budget || tile_width - 1 < IMPOSTOR_MIN_TILE_WIDTH) break;
+    }
+
+    return result;
+}
+
+// Main thread, needs the GL context. max_tile_width is the size tiles are baked at when budget
+// (bytes of VRAM) allows, above and below are how far sprites reach above and below the top left
+// of their tile's sprite, the point TileToScreen gives, in tile widths.
+TilemapImpostors CreateTilemapImpostors(Arena *arena, Tilemap *map, f32 max_tile_width, f32 above, f32 below, u64 budget) {
+    TilemapImpostors result = AllocateTilemapImpostors(arena, map, max_tile_width, above, below, budget);
+
+    glCreateTextures(GL_TEXTURE_2D_ARRAY, 1, &result.texture);
+    glTextureStorage3D(result.texture, result.levels, GL_RGBA8, result.texture_width, result.texture_height, result.chunk_count);
+    glTextureParameteri(result.texture, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+    glTextureParameteri(result.texture, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTextureParameteri(result.texture, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTextureParameteri(result.texture, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+
+    glGenTextures(result.chunk_count, result.layer_views);
+    for (int i = 0; i < result.chunk_count; ++i) {
+        glTextureView(result.layer_views[i], GL_TEXTURE_2D, result.texture, GL_RGBA8, 0, result.levels, i, 1);
+    }
+
+    glCreateFramebuffers(1, &result.fbo);
+
+    InitImpostorRenderer(&result);
+
+    fprintf(stdout, "INFO: %d chunk impostors, %d x %d at %.0f texel tiles, %.1f of %.1f MB\n", result.chunk_count,
+            result.texture_width, result.texture_height, result.tile_width,
+            GetImpostorBytes(&result) / (1024.0 * 1024.0), budget / (1024.0 * 1024.0));
+
+    return result;
+}
+
+b32 IsImpostorStale(TilemapImpostors *impostors, Tilemap *map, int chunk) {
+    b32 result = impostors->baked_revisions[chunk] != map->chunk_revisions[chunk];
+    return result;
+}
+
+// Top left of a tile's sprite in its chunk's layer, tile_x and tile_y relative to the chunk.
+v2 GetImpostorTilePosition(TilemapImpostors *impostors, int tile_x, int tile_y) {
+    f32 half_width = impostors->tile_width * 0.5f;
+    f32 step = impostors->tile_height * 0.5f * TILEMAP_ROTATION;
+
+    v2 result = impostors->chunk_origin;
+    result.x += (tile_x - tile_y) * half_width;
+    result.y += (tile_x + tile_y) * step;
+    return result;
+}
+
+// Main thread. Everything drawn between begin and end lands in the chunk's layer, in texels of
+// the layer (GetImpostorTilePosition), blended premultiplied.
+void BeginImpostorBake(TilemapImpostors *impostors, int chunk) {
+    glGetIntegerv(GL_DRAW_FRAMEBUFFER_BINDING, &impostors->previous_fbo);
+    glNamedFramebufferTextureLayer(impostors->fbo, GL_COLOR_ATTACHMENT0, impostors->texture, 0, chunk);
+    glBindFramebuffer(GL_FRAMEBUFFER, impostors->fbo);
+    glViewport(0, 0, impostors->texture_width, impostors->texture_height);
+
+    f32 clear[4] = {};
+    glClearNamedFramebufferfv(impostors->fbo, GL_COLOR, 0, clear);
+    glBlendFuncSeparate(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA, GL_ONE, GL_ONE_MINUS_SRC_ALPHA);
+}
+
+void EndImpostorBake(TilemapImpostors *impostors, Tilemap *map, int chunk) {
+    glBindFramebuffer(GL_FRAMEBUFFER, impostors->previous_fbo);
+    glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+
+    int fb_width, fb_height;
+    GetWindowFramebufferSize(&fb_width, &fb_height);
+    glViewport(0, 0, fb_width, fb_height);
+
+    impostors->baked_revisions[chunk] = map->chunk_revisions[chunk];
+    glGenerateTextureMipmap(impostors->layer_views[chunk]);
+    ++impostors->bakes;
+}
+
+// dest is where the whole layer goes on screen.
+void PushImpostor(TilemapImpostors *impostors, int chunk, Rect dest) {
+    if (impostors->quad_count == impostors->max_quads) return;
+
+    f32 l = dest.x;
+    f32 r = dest.x + dest.width;
+    f32 t = dest.y;
+    f32 b = dest.y + dest.height;
+    f32 layer = (f32)chunk;
+
+    // rendered into with the usual bottom up framebuffer, so v = 1 is the top
+    ImpostorVertex *quad = impostors->vertices + impostors->quad_count++ * 4;
+    quad[0] = { { l, t }, { 0, 1, layer } };
+    quad[1] = { { r, t }, { 1, 1, layer } };
+    quad[2] = { { r, b }, { 1, 0, layer } };
+    quad[3] = { { l, b }, { 0, 0, layer } };
+}
+
+// Main thread. Draws the pushed chunks in one draw, in the order they were pushed.
+void FlushImpostors(TilemapImpostors *impostors) {
+    ProfileFunction();
+
+    if (!impostors->quad_count) return;
+
+    glNamedBufferSubData(impostors->vbo, 0, sizeof(ImpostorVertex) * 4 * impostors->quad_count, impostors->vertices);
+
+    int fb_width, fb_height;
+    GetWindowFramebufferSize(&fb_width, &fb_height);
+
+    glBlendFunc(GL_ONE, GL_ONE_MINUS_SRC_ALPHA);
+    glUseProgram(impostors->program);
+    glUniform2f(impostors->screen_size_location, (f32)fb_width, (f32)fb_height);
+    glBindTextureUnit(0, impostors->texture);
+    glBindVertexArray(impostors->vao);
+    glDrawElements(GL_TRIANGLES, impostors->quad_count * 6, GL_UNSIGNED_INT, 0);
+    glBindVertexArray(0);
+    glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+
+    impostors->quad_count = 0;
+}
+
+// CPU side only: the layer layout and the budget, baking needs a GL context.
+void BenchmarkImpostors() {
+    const int window_chunks = 8; // the game's resident window
+    const f32 tile_width = 32;
+    const f32 above = 2.5f; // tile widths, a tree on a raised tile
+    const f32 below = 0.75f;
+
+    Arena arena = CreateArena(Megabytes(1));
+    Tilemap map = CreateTilemap(&arena, window_chunks * TILEMAP_CHUNK_SIZE, window_chunks * TILEMAP_CHUNK_SIZE, 256, 192);
+
+    fprintf(stdout, "Impostors: %d chunks, %.0f texel tiles asked for\n", map.chunk_columns * map.chunk_rows, tile_width);
+
+    u64 budgets[] = { Megabytes(256), Megabytes(64), Megabytes(32), Megabytes(8), 0 };
+    for (int i = 0; i < (int)ArrayCount(budgets); ++i) {
+        u64 mark = arena.count;
+        TilemapImpostors impostors = AllocateTilemapImpostors(&arena, &map, tile_width, above, below, budgets[i]);
+        u64 bytes = GetImpostorBytes(&impostors);
+
+        fprintf(stdout, "  %6.1f MB budget: %4d x %-4d layers at %2.0f texel tiles, %6.1f MB\n", budgets[i] / (1024.0 * 1024.0),
+                impostors.texture_width, impostors.texture_height, impostors.tile_width, bytes / (1024.0 * 1024.0));
+
+        // only a budget under the floor can be overrun, a bigger one never sharpens past the ask
+        Assert(bytes <= budgets[i] || impostors.tile_width - 1 < IMPOSTOR_MIN_TILE_WIDTH);
+        Assert(impostors.tile_width <= tile_width);
+        if (budgets[i] >= Megabytes(64)) Assert(impostors.tile_width == tile_width);
+
+        // the sprites of the chunk's corner tiles, and what they reach, stay inside the layer
+        v2 back = GetImpostorTilePosition(&impostors, 0, 0);
+        v2 left = GetImpostorTilePosition(&impostors, 0, TILEMAP_CHUNK_SIZE - 1);
+        v2 right = GetImpostorTilePosition(&impostors, TILEMAP_CHUNK_SIZE - 1, 0);
+        v2 front = GetImpostorTilePosition(&impostors, TILEMAP_CHUNK_SIZE - 1, TILEMAP_CHUNK_SIZE - 1);
+        Assert(left.x >= 0 && right.x + impostors.tile_width <= impostors.texture_width);
+        Assert(back.y - above * impostors.tile_width >= 0);
+        Assert(front.y + below * impostors.tile_width <= impostors.texture_height);
+
+        arena.count = mark;
+    }
+
+    free(arena.base_address);
+}
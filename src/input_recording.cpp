@@ -0,0 +1,238 @@
+/*
+    Input recording and replay.
+
+    Recording stores what TakeFrameInput handed the simulation, one record per simulation frame,
+    so a replay feeds the game the exact same input on the exact same frames. Both run on a fixed
+    timestep (stored in the header) and start at GameInit, so with the same build the game state
+    in platform.memory evolves identically and a replay is a reproducible benchmark.
+
+    File layout, little endian, raw structs:
+        InputRecordingHeader
+        per frame:
+            InputFrameHeader
+            key bits        if InputFrameKeys
+            button bits     if InputFrameButtons
+            cursor x, y     if InputFrameCursor   (2 doubles)
+            framebuffer w,h if InputFrameFramebuffer (2 ints)
+            InputEvent * event_count
+
+    Only state that changed since the previous frame is written, an idle frame is 8 bytes.
+*/
+
+#define INPUT_RECORDING_MAGIC 0x49475052 // "RPGI"
+#define INPUT_RECORDING_VERSION 1
+
+struct InputRecordingHeader {
+    u32 magic;
+    u32 version;
+    double fixed_delta_time;
+    u64 frame_count; // patched when the recording is closed
+};
+
+enum InputFrameFlags {
+    InputFrameKeys = 0x1,
+    InputFrameButtons = 0x2,
+    InputFrameCursor = 0x4,
+    InputFrameFramebuffer = 0x8,
+};
+
+struct InputFrameHeader {
+    u32 frame; // stamp, checked on replay
+    u16 flags;
+    u16 event_count;
+};
+
+#define KEY_BITS_SIZE ((GLFW_KEY_LAST + 1 + 7) / 8)
+#define BUTTON_BITS_SIZE ((GLFW_MOUSE_BUTTON_LAST + 1 + 7) / 8)
+
+enum InputRecordingMode {
+    InputRecordingOff,
+    InputRecordingRecord,
+    InputRecordingReplay,
+};
+
+struct InputRecording {
+    InputRecordingMode mode;
+    FILE *file;
+    const char *path;
+    InputRecordingHeader header;
+    u64 frame;
+
+    // the last frame's state, records only store what changed
+    u8 keys[KEY_BITS_SIZE];
+    u8 buttons[BUTTON_BITS_SIZE];
+    double cursor_x;
+    double cursor_y;
+    int framebuffer_width;
+    int framebuffer_height;
+};
+
+static InputRecording input_recording;
+
+static void PackBits(u8 *bits, u8 *values, int count) {
+    memset(bits, 0, (count + 7) / 8);
+    for (int i = 0; i < count; ++i) {
+        if (values[i]) bits[i / 8] |= (u8)(1 << (i % 8));
+    }
+}
+
+static void UnpackBits(u8 *values, u8 *bits, int count) {
+    for (int i = 0; i < count; ++i) values[i] = (bits[i / 8] >> (i % 8)) & 1;
+}
+
+// Forces the fixed step for the rest of the run, a recording is only valid on it.
+bool BeginInputRecording(InputRecording *recording, const char *path, double fixed_delta_time) {
+    *recording = {};
+    recording->file = fopen(path, "wb");
+    if (!recording->file) {
+        fprintf(stderr, "Error: unable to open %s for recording\n", path);
+        return false;
+    }
+
+    recording->mode = InputRecordingRecord;
+    recording->path = path;
+    recording->header.magic = INPUT_RECORDING_MAGIC;
+    recording->header.version = INPUT_RECORDING_VERSION;
+    recording->header.fixed_delta_time = fixed_delta_time;
+    fwrite(&recording->header, sizeof(recording->header), 1, recording->file);
+
+    // force the first frame to write everything
+    memset(recording->keys, 0xff, sizeof(recording->keys));
+    memset(recording->buttons, 0xff, sizeof(recording->buttons));
+    recording->framebuffer_width = -1;
+
+    return true;
+}
+
+bool BeginInputReplay(InputRecording *recording, const char *path) {
+    *recording = {};
+    recording->file = fopen(path, "rb");
+    if (!recording->file) {
+        fprintf(stderr, "Error: unable to open recording %s\n", path);
+        return false;
+    }
+
+    InputRecordingHeader *header = &recording->header;
+    if (fread(header, sizeof(*header), 1, recording->file) != 1 ||
+        header->magic != INPUT_RECORDING_MAGIC || header->version != INPUT_RECORDING_VERSION) {
+        fprintf(stderr, "Error: %s is not an input recording\n", path);
+        fclose(recording->file);
+        recording->file = 0;
+        return false;
+    }
+
+    recording->mode = InputRecordingReplay;
+    recording->path = path;
+    return true;
+}
+
+void EndInputRecording(InputRecording *recording) {
+    if (!recording->file) return;
+
+    if (recording->mode == InputRecordingRecord) {
+        recording->header.frame_count = recording->frame;
+        fseek(recording->file, 0, SEEK_SET);
+        fwrite(&recording->header, sizeof(recording->header), 1, recording->file);
+        fprintf(stdout, "Recorded %llu frames to %s\n", (unsigned long long)recording->frame, recording->path);
+    } else {
+        fprintf(stdout, "Replayed %llu frames from %s\n", (unsigned long long)recording->frame, recording->path);
+    }
+
+    fclose(recording->file);
+    recording->file = 0;
+    recording->mode = InputRecordingOff;
+}
+
+// Simulation thread, right after TakeFrameInput.
+void RecordFrameInput(InputRecording *recording, PlatformServiceContext *context) {
+    InputFrameHeader frame = {};
+    frame.frame = (u32)recording->frame;
+    frame.event_count = (u16)context->input_event_queue.count;
+
+    u8 keys[KEY_BITS_SIZE];
+    u8 buttons[BUTTON_BITS_SIZE];
+    PackBits(keys, context->keys, ArrayCount(context->keys));
+    PackBits(buttons, context->buttons, ArrayCount(context->buttons));
+
+    if (memcmp(keys, recording->keys, sizeof(keys)) != 0) frame.flags |= InputFrameKeys;
+    if (memcmp(buttons, recording->buttons, sizeof(buttons)) != 0) frame.flags |= InputFrameButtons;
+    if (context->cursor_x != recording->cursor_x || context->cursor_y != recording->cursor_y) frame.flags |= InputFrameCursor;
+    if (context->framebuffer_width != recording->framebuffer_width ||
+        context->framebuffer_height != recording->framebuffer_height) frame.flags |= InputFrameFramebuffer;
+
+    FILE *file = recording->file;
+    fwrite(&frame, sizeof(frame), 1, file);
+
+    if (frame.flags & InputFrameKeys) {
+        fwrite(keys, sizeof(keys), 1, file);
+        memcpy(recording->keys, keys, sizeof(keys));
+    }
+    if (frame.flags & InputFrameButtons) {
+        fwrite(buttons, sizeof(buttons), 1, file);
+        memcpy(recording->buttons, buttons, sizeof(buttons));
+    }
+    if (frame.flags & InputFrameCursor) {
+        recording->cursor_x = context->cursor_x;
+        recording->cursor_y = context->cursor_y;
+        fwrite(&recording->cursor_x, sizeof(double), 1, file);
+        fwrite(&recording->cursor_y, sizeof(double), 1, file);
+    }
+    if (frame.flags & InputFrameFramebuffer) {
+        recording->framebuffer_width = context->framebuffer_width;
+        recording->framebuffer_height = context->framebuffer_height;
+        fwrite(&recording->framebuffer_width, sizeof(int), 1, file);
+        fwrite(&recording->framebuffer_height, sizeof(int), 1, file);
+    }
+    if (frame.event_count) {
+        fwrite(context->input_event_queue.events, sizeof(InputEvent), frame.event_count, file);
+    }
+
+    ++recording->frame;
+}
+
+// Simulation thread, instead of TakeFrameInput. Returns false at the end of the recording or if
+// it's damaged, context is left untouched then.
+bool ReplayFrameInput(InputRecording *recording, PlatformServiceContext *context) {
+    if (recording->frame >= recording->header.frame_count) return false;
+
+    FILE *file = recording->file;
+    InputFrameHeader frame;
+    if (fread(&frame, sizeof(frame), 1, file) != 1) return false;
+
+    if (frame.frame != (u32)recording->frame || frame.event_count > ArrayCount(InputEventQueue::events)) {
+        fprintf(stderr, "Error: %s is damaged at frame %llu\n", recording->path, (unsigned long long)recording->frame);
+        return false;
+    }
+
+    bool valid = true;
+    if (frame.flags & InputFrameKeys) valid &= fread(recording->keys, sizeof(recording->keys), 1, file) == 1;
+    if (frame.flags & InputFrameButtons) valid &= fread(recording->buttons, sizeof(recording->buttons), 1, file) == 1;
+    if (frame.flags & InputFrameCursor) {
+        valid &= fread(&recording->cursor_x, sizeof(double), 1, file) == 1;
+        valid &= fread(&recording->cursor_y, sizeof(double), 1, file) == 1;
+    }
+    if (frame.flags & InputFrameFramebuffer) {
+        valid &= fread(&recording->framebuffer_width, sizeof(int), 1, file) == 1;
+        valid &= fread(&recording->framebuffer_height, sizeof(int), 1, file) == 1;
+    }
+
+    InputEventQueue queue = {};
+    queue.count = frame.event_count;
+    if (queue.count) valid &= fread(queue.events, sizeof(InputEvent), queue.count, file) == (size_t)queue.count;
+
+    if (!valid) {
+        fprintf(stderr, "Error: %s ends early at frame %llu\n", recording->path, (unsigned long long)recording->frame);
+        return false;
+    }
+
+    context->input_event_queue = queue;
+    UnpackBits(context->keys, recording->keys, ArrayCount(context->keys));
+    UnpackBits(context->buttons, recording->buttons, ArrayCount(context->buttons));
+    context->cursor_x = recording->cursor_x;
+    context->cursor_y = recording->cursor_y;
+    context->framebuffer_width = recording->framebuffer_width;
+    context->framebuffer_height = recording->framebuffer_height;
+
+    ++recording->frame;
+    return true;
+}
@@ -0,0 +1,340 @@
+#include <immintrin.h>
+#include <new>
+#include <atomic>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+
+/*
+    Work-stealing job system.
+
+    One worker thread per core, the main thread is worker 0 and only runs jobs while it waits on a
+    counter. Every worker owns a Chase-Lev deque: the owner pushes and pops at the bottom (LIFO,
+    cache warm), idle workers steal from the top of a random victim. Jobs are allocated from a
+    per-worker ring so submission never locks or mallocs. A slot is reused only once its last job
+    is done; with a full ring of jobs outstanding, submitting runs jobs until it is.
+
+    A job can decrement a JobCounter when it finishes; WaitForCounter helps run other jobs until the
+    counter reaches zero, so waiting inside a job is safe and is how dependencies are expressed. A
+    job can also carry a counter it depends on, it will not start before that counter is zero.
+
+    GL calls stay on the main thread, jobs must not touch the context.
+*/
+
+#define JOB_DEQUE_SIZE 4096 // power of 2, also the per-worker job ring size
+
+struct Job {
+    JobFunction *function;
+    void *data;
+    int first;
+    int one_past_last;
+    JobCounter *counter;
+    JobCounter *dependency;
+    std::atomic<b32> done; // the ring slot can be reused
+};
+
+struct alignas(64) JobDeque {
+    std::atomic<int64_t> top;
+    alignas(64) std::atomic<int64_t> bottom;
+    std::atomic<Job *> jobs[JOB_DEQUE_SIZE];
+};
+
+struct alignas(64) JobWorker {
+    JobDeque deque;
+    Job ring[JOB_DEQUE_SIZE];
+    u32 next_job;
+    u32 random_state;
+    std::thread thread;
+};
+
+struct JobSystem {
+    int thread_count;
+    JobWorker *workers;
+
+    std::atomic<int> queued; // pushed but not yet taken, wakes sleeping workers
+    std::atomic<b32> quit;
+    std::mutex sleep_mutex;
+    std::condition_variable sleep_condition;
+};
+
+static JobSystem job_system;
+static thread_local int job_thread_index;
+
+int GetCoreCount() {
+    int result = (int)std::thread::hardware_concurrency();
+    return result > 0 ? result : 1;
+}
+
+int GetJobThreadIndex() {
+    return job_thread_index;
+}
+
+int GetJobThreadCount() {
+    return job_system.thread_count;
+}
+
+static void PushJob(JobDeque *deque, Job *job) {
+    int64_t bottom = deque->bottom.load(std::memory_order_relaxed);
+    int64_t top = deque->top.load(std::memory_order_acquire);
+    Assert(bottom - top < JOB_DEQUE_SIZE);
+
+    deque->jobs[bottom & (JOB_DEQUE_SIZE - 1)].store(job, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    deque->bottom.store(bottom + 1, std::memory_order_relaxed);
+}
+
+static Job *PopJob(JobDeque *deque) {
+    int64_t bottom = deque->bottom.load(std::memory_order_relaxed) - 1;
+    deque->bottom.store(bottom, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    int64_t top = deque->top.load(std::memory_order_relaxed);
+
+    Job *result = 0;
+    if (top <= bottom) {
+        result = deque->jobs[bottom & (JOB_DEQUE_SIZE - 1)].load(std::memory_order_relaxed);
+        if (top == bottom) {
+            // last job, race the thieves for it
+            if (!deque->top.compare_exchange_strong(top, top + 1, std::memory_order_seq_cst, std::memory_order_relaxed)) {
+                result = 0;
+            }
+            deque->bottom.store(bottom + 1, std::memory_order_relaxed);
+        }
+    } else {
+        deque->bottom.store(bottom + 1, std::memory_order_relaxed);
+    }
+
+    return result;
+}
+
+static Job *StealJob(JobDeque *deque) {
+    int64_t top = deque->top.load(std::memory_order_acquire);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    int64_t bottom = deque->bottom.load(std::memory_order_acquire);
+
+    Job *result = 0;
+    if (top < bottom) {
+        result = deque->jobs[top & (JOB_DEQUE_SIZE - 1)].load(std::memory_order_relaxed);
+        if (!deque->top.compare_exchange_strong(top, top + 1, std::memory_order_seq_cst, std::memory_order_relaxed)) {
+            result = 0;
+        }
+    }
+
+    return result;
+}
+
+static Job *GetJob() {
+    JobWorker *self = job_system.workers + job_thread_index;
+
+    Job *result = PopJob(&self->deque);
+    if (!result && job_system.thread_count > 1) {
+        // start at a random victim so thieves don't all hit the same deque
+        self->random_state = self->random_state * 1664525 + 1013904223;
+        int start = (int)((self->random_state >> 16) % job_system.thread_count);
+
+        for (int i = 0; i < job_system.thread_count && !result; ++i) {
+            int victim = (start + i) % job_system.thread_count;
+            if (victim != job_thread_index) result = StealJob(&job_system.workers[victim].deque);
+        }
+    }
+
+    if (result) --job_system.queued;
+
+    return result;
+}
+
+static void ExecuteJob(Job *job) {
+    if (job->dependency) WaitForCounter(job->dependency);
+
+    job->function(job->data, job->first, job->one_past_last);
+
+    if (job->counter) job->counter->value.fetch_sub(1, std::memory_order_release);
+    job->done.store(true, std::memory_order_release);
+}
+
+// Runs other jobs until the counter drains.
+void WaitForCounter(JobCounter *counter) {
+    while (counter->value.load(std::memory_order_acquire) > 0) {
+        Job *job = GetJob();
+        if (job) ExecuteJob(job);
+        else std::this_thread::yield();
+    }
+}
+
+static void WorkerThread(int index) {
+    job_thread_index = index;
+    SetProfileThreadName("Worker");
+
+    while (!job_system.quit) {
+        Job *job = GetJob();
+        if (job) {
+            ExecuteJob(job);
+            continue;
+        }
+
+        // spin a little before going to sleep, jobs tend to arrive in bursts
+        for (int spin = 0; spin < 64 && !job_system.queued; ++spin) _mm_pause();
+        if (job_system.queued) continue;
+
+        std::unique_lock<std::mutex> lock(job_system.sleep_mutex);
+        job_system.sleep_condition.wait(lock, []() { return job_system.queued > 0 || job_system.quit; });
+    }
+
+    ReleaseProfileThread();
+}
+
+// thread_count counts the main thread, 0 means one per core.
+void InitJobSystem(Arena *arena, int thread_count) {
+    if (thread_count <= 0) thread_count = GetCoreCount();
+    if (thread_count > MAX_WORKER_THREADS) thread_count = MAX_WORKER_THREADS;
+
+    job_system.thread_count = thread_count;
+    job_system.workers = (JobWorker *)ArenaAllocAligned(arena, sizeof(JobWorker) * thread_count, 64);
+    job_system.queued = 0;
+    job_system.quit = false;
+
+    job_thread_index = 0;
+    for (int i = 0; i < thread_count; ++i) {
+        new (job_system.workers + i) JobWorker;
+        job_system.workers[i].random_state = i + 1;
+        for (int j = 0; j < JOB_DEQUE_SIZE; ++j) job_system.workers[i].ring[j].done = true;
+    }
+    for (int i = 1; i < thread_count; ++i) {
+        job_system.workers[i].thread = std::thread(WorkerThread, i);
+    }
+}
+
+void ShutdownJobSystem() {
+    {
+        std::lock_guard<std::mutex> lock(job_system.sleep_mutex);
+        job_system.quit = true;
+    }
+    job_system.sleep_condition.notify_all();
+
+    for (int i = 1; i < job_system.thread_count; ++i) {
+        job_system.workers[i].thread.join();
+    }
+
+    job_system.thread_count = 0;
+    job_system.workers = 0;
+}
+
+static void SubmitJob(JobFunction *function, void *data, int first, int one_past_last, JobCounter *counter, JobCounter *dependency) {
+    JobWorker *self = job_system.workers + job_thread_index;
+
+    // the ring wraps, help out until the slot's last job is done
+    Job *job = self->ring + (self->next_job++ & (JOB_DEQUE_SIZE - 1));
+    while (!job->done.load(std::memory_order_acquire)) {
+        Job *other = GetJob();
+        if (other) ExecuteJob(other);
+        else std::this_thread::yield();
+    }
+
+    job->done.store(false, std::memory_order_relaxed);
+    job->function = function;
+    job->data = data;
+    job->first = first;
+    job->one_past_last = one_past_last;
+    job->counter = counter;
+    job->dependency = dependency;
+
+    PushJob(&self->deque, job);
+    ++job_system.queued;
+}
+
+static void WakeWorkers(int job_count) {
+    if (job_system.thread_count <= 1) return;
+
+    // take the lock so a worker can't miss the wakeup between its check and its wait
+    { std::lock_guard<std::mutex> lock(job_system.sleep_mutex); }
+    if (job_count == 1) job_system.sleep_condition.notify_one();
+    else job_system.sleep_condition.notify_all();
+}
+
+// Runs function(data, 0, 1) on some worker. counter is incremented now and decremented when it's
+// done; dependency (optional) must reach zero before it starts.
+void RunJob(JobFunction *function, void *data, JobCounter *counter, JobCounter *dependency) {
+    if (counter) counter->value.fetch_add(1, std::memory_order_relaxed);
+    SubmitJob(function, data, 0, 1, counter, dependency);
+    WakeWorkers(1);
+}
+
+// Splits [0, count) into batches of batch_size and runs them as jobs. Wait on counter for the result.
+void ParallelFor(JobFunction *function, void *data, int count, int batch_size, JobCounter *counter, JobCounter *dependency) {
+    Assert(batch_size > 0);
+
+    int job_count = (count + batch_size - 1) / batch_size;
+    Assert(job_count < JOB_DEQUE_SIZE);
+
+    counter->value.fetch_add(job_count, std::memory_order_relaxed);
+    for (int first = 0; first < count; first += batch_size) {
+        int one_past_last = first + batch_size < count ? first + batch_size : count;
+        SubmitJob(function, data, first, one_past_last, counter, dependency);
+    }
+    WakeWorkers(job_count);
+}
+
+// Blocking version for call sites that need the result right away.
+void ParallelFor(JobFunction *function, void *data, int count, int batch_size) {
+    if (job_system.thread_count <= 1 || count <= batch_size) {
+        function(data, 0, count);
+        return;
+    }
+
+    JobCounter counter = {};
+    ParallelFor(function, data, count, batch_size, &counter);
+    WaitForCounter(&counter);
+}
+
+static void BenchmarkJobKernel(void *data, int first, int one_past_last) {
+    f32 *values = (f32 *)data;
+    for (int i = first; i < one_past_last; ++i) {
+        f32 x = values[i];
+        for (int k = 0; k < 64; ++k) x = x * 0.999f + 0.5f;
+        values[i] = x;
+    }
+}
+
+static void BenchmarkEmptyJob(void *, int, int) {
+}
+
+void BenchmarkJobs() {
+    const int item_count = 1 << 20;
+    const int iterations = 10;
+    const int empty_job_count = 2048;
+
+    Arena arena = CreateArena(Megabytes(64));
+    f32 *values = (f32 *)ArenaAllocAligned(&arena, sizeof(f32) * item_count, 64);
+
+    int core_count = GetCoreCount();
+    fprintf(stdout, "Jobs: parallel-for over %d items, %d cores\n", item_count, core_count);
+
+    double single_thread_seconds = 0;
+    for (int thread_count = 1; thread_count <= core_count; thread_count = GetNextBenchmarkThreadCount(thread_count, core_count)) {
+        u64 mark = arena.count;
+        InitJobSystem(&arena, thread_count);
+
+        double start = GetTime();
+        for (int i = 0; i < iterations; ++i) {
+            ParallelFor(BenchmarkJobKernel, values, item_count, 4096);
+        }
+        double seconds = GetTime() - start;
+        if (thread_count == 1) single_thread_seconds = seconds;
+
+        start = GetTime();
+        for (int i = 0; i < iterations; ++i) {
+            JobCounter counter = {};
+            for (int j = 0; j < empty_job_count; ++j) RunJob(BenchmarkEmptyJob, 0, &counter);
+            WaitForCounter(&counter);
+        }
+        double overhead_seconds = GetTime() - start;
+
+        fprintf(stdout, "  %2d thread(s): %8.2f ms/iteration, %5.2fx, %6.0f ns/empty job\n",
+                thread_count, seconds * 1000 / iterations, single_thread_seconds / seconds,
+                overhead_seconds * 1e9 / (iterations * empty_job_count));
+
+        ShutdownJobSystem();
+        arena.count = mark;
+    }
+
+    free(arena.base_address);
+}
@@ -0,0 +1,1095 @@
+/*
+    Grid pathfinding.
+
+    Paths run over a PathGrid, a cost per tile (0 is blocked) the game fills from its map. Agents
+    move in 8 directions without cutting corners, a diagonal step needs both tiles beside it open.
+    A step costs PATH_STRAIGHT_COST (PATH_DIAGONAL_COST diagonally) times the mean cost of the two
+    tiles, so a path back costs what the path there did.
+
+    Every search is A* with a binary heap keyed on f, ties going to the node nearer the goal. Node
+    arrays are allocated up front from an arena and stamped with the search that last touched
+    them instead of being cleared, so a search costs what it visits.
+
+    PathAStar is plain A* with the octile heuristic and handles any costs.
+
+    PathJumpPoint is Jump Point Search. On a uniform grid most open list work is spent on paths
+    that are permutations of each other, so it runs along rows, columns and diagonals and only
+    opens the tiles where an obstacle beside the line forces a turn. It finds paths as short as
+    A*'s with a fraction of the heap work, but needs every open tile to cost 1 and falls back to
+    A* on a weighted grid.
+
+    PathHierarchical is HPA*. The grid is split into PATH_CLUSTER_SIZE square clusters (the
+    tilemap's chunks). Each run of tiles open on both sides of a border between two clusters is
+    an entrance, with a transition in its middle, or at both ends of a long one, and the tiles
+    either side of a transition are nodes of a small graph. Nodes of a cluster are joined by their
+    shortest path inside it, nodes across a border by the step between them. A query links its
+    start and goal into their clusters, searches the graph, then refines each edge with a search
+    inside one cluster. Paths come out a few percent longer than optimal and cost about the same
+    on any size of map.
+
+    The graph is kept per cluster. The grid bumps a cluster's revision when one of its tiles
+    changes, UpdatePathAbstraction rebuilds the nodes of those clusters and their neighbours
+    (entrances belong to both sides of a border) and recomputes their distances on the job system.
+
+    Requests are batched: FindPaths spreads a batch over the job system and each worker searches
+    with its own PathSearch. The grid and the graph are read only while a batch runs, they change
+    on the main thread between batches.
+*/
+
+#define PATH_CLUSTER_SIZE 16 // TILEMAP_CHUNK_SIZE, so a chunk is a cluster
+#define PATH_MAX_CLUSTER_NODES 32 // at most 8 transitions per border
+#define PATH_LONG_ENTRANCE 6 // entrances this wide get a transition at each end
+#define PATH_STRAIGHT_COST 10
+#define PATH_DIAGONAL_COST 14
+#define PATH_BATCH_SIZE 4 // requests per job, paths vary a lot in cost
+#define PATH_UNREACHABLE 0xFFFFFFFFu
+#define PATH_NONE 0xFFFFFFFFu
+#define PATH_CLOSED 0xFFFFFFFEu // heap index of an expanded node
+
+struct PathGrid {
+    int columns;
+    int rows;
+    u8 *costs; // columns * rows, 0 is blocked
+    int weighted_count; // open tiles that don't cost 1, JPS needs none
+
+    int cluster_columns;
+    int cluster_rows;
+    u32 *cluster_revisions; // start at 1
+};
+
+struct PathPoint {
+    int x;
+    int y;
+};
+
+enum PathMethod {
+    PathAStar,
+    PathJumpPoint,
+    PathHierarchical,
+};
+
+struct PathRequest {
+    PathMethod method;
+    int start_x;
+    int start_y;
+    int goal_x;
+    int goal_y;
+
+    PathPoint *points; // the caller's, a longer path only fills the first max_points
+    int max_points;
+
+    b32 found;
+    int length; // tiles on the path, start and goal included
+    u32 cost; // PATH_STRAIGHT_COST per straight step over tiles of cost 1
+    int expanded; // nodes taken off the open lists, every level
+};
+
+struct PathNode {
+    u32 g;
+    u32 parent;
+    u32 search; // the search that last touched it
+    u32 heap_index; // PATH_CLOSED once expanded
+};
+
+struct PathHeapEntry {
+    u32 f;
+    u32 h;
+    u32 node;
+};
+
+// Nodes and an open list for one kind of search.
+struct PathSpace {
+    u32 capacity;
+    u32 search;
+    PathNode *nodes;
+    u32 heap_count;
+    PathHeapEntry *heap;
+    int expanded;
+};
+
+// Inclusive, like a TileRange.
+struct PathBounds {
+    int min_x;
+    int min_y;
+    int max_x;
+    int max_y;
+};
+
+enum PathBorder {
+    PathBorderWest,
+    PathBorderEast,
+    PathBorderNorth, // towards y - 1
+    PathBorderSouth,
+};
+
+struct PathCluster {
+    int node_count;
+    u16 node_x[PATH_MAX_CLUSTER_NODES]; // tiles
+    u16 node_y[PATH_MAX_CLUSTER_NODES];
+    u8 node_borders[PATH_MAX_CLUSTER_NODES];
+    u32 partners[PATH_MAX_CLUSTER_NODES]; // the node across the border
+    u32 distances[PATH_MAX_CLUSTER_NODES * PATH_MAX_CLUSTER_NODES]; // i to j at i * MAX + j, inside the cluster
+};
+
+// One per job thread.
+struct PathSearch {
+    PathSpace grid; // A* and JPS, a node per tile
+    PathSpace cluster; // inside one cluster
+    PathSpace graph; // the cluster graph, plus a start and a goal node
+    u32 start_distances[PATH_MAX_CLUSTER_NODES];
+    u32 goal_distances[PATH_MAX_CLUSTER_NODES];
+    u32 *graph_path; // start to goal
+};
+
+struct PathFinder {
+    PathGrid *grid;
+
+    int cluster_count;
+    PathCluster *clusters;
+    u32 *built_revisions; // 0 until built
+    u8 *update_flags;
+    int *updates; // clusters the update is rebuilding
+    int rebuilt; // last update, for the overlay
+
+    int search_count;
+    PathSearch *searches;
+};
+
+struct PathBatch {
+    PathFinder *finder;
+    PathRequest *requests;
+    int count;
+};
+
+PathGrid CreatePathGrid(Arena *arena, int columns, int rows) {
+    PathGrid result = {};
+    result.columns = columns;
+    result.rows = rows;
+    result.costs = (u8 *)ArenaAlloc(arena, columns * rows);
+    memset(result.costs, 1, columns * rows);
+
+    result.cluster_columns = (columns + PATH_CLUSTER_SIZE - 1) / PATH_CLUSTER_SIZE;
+    result.cluster_rows = (rows + PATH_CLUSTER_SIZE - 1) / PATH_CLUSTER_SIZE;
+    result.cluster_revisions = (u32 *)ArenaAlloc(arena, sizeof(u32) * result.cluster_columns * result.cluster_rows);
+    for (int i = 0; i < result.cluster_columns * result.cluster_rows; ++i) result.cluster_revisions[i] = 1;
+
+    return result;
+}
+
+int GetPathCluster(PathGrid *grid, int x, int y) {
+    int result = (y / PATH_CLUSTER_SIZE) * grid->cluster_columns + x / PATH_CLUSTER_SIZE;
+    return result;
+}
+
+int GetPathCost(PathGrid *grid, int x, int y) {
+    b32 inside = x >= 0 && y >= 0 && x < grid->columns && y < grid->rows;
+    int result = inside ? grid->costs[y * grid->columns + x] : 0;
+    return result;
+}
+
+// Main thread, between batches. 0 blocks the tile.
+void SetPathCost(PathGrid *grid, int x, int y, int cost) {
+    if (x < 0 || y < 0 || x >= grid->columns || y >= grid->rows) return;
+
+    u8 *tile = grid->costs + y * grid->columns + x;
+    if (*tile == cost) return;
+
+    grid->weighted_count += (cost > 1) - (*tile > 1);
+    *tile = (u8)cost;
+    ++grid->cluster_revisions[GetPathCluster(grid, x, y)];
+}
+
+static b32 IsPathOpen(PathGrid *grid, int x, int y) {
+    b32 inside = (u32)x < (u32)grid->columns && (u32)y < (u32)grid->rows;
+    b32 result = inside && grid->costs[y * grid->columns + x];
+    return result;
+}
+
+static u32 GetOctileDistance(int ax, int ay, int bx, int by) {
+    int dx = abs(ax - bx);
+    int dy = abs(ay - by);
+    int diagonal = Min(dx, dy);
+    u32 result = diagonal * PATH_DIAGONAL_COST + (dx + dy - 2 * diagonal) * PATH_STRAIGHT_COST;
+    return result;
+}
+
+static PathSpace CreatePathSpace(Arena *arena, u32 capacity) {
+    PathSpace result = {};
+    result.capacity = capacity;
+    result.nodes = (PathNode *)ArenaAlloc(arena, sizeof(PathNode) * capacity);
+    result.heap = (PathHeapEntry *)ArenaAlloc(arena, sizeof(PathHeapEntry) * capacity);
+    return result;
+}
+
+static void BeginPathSearch(PathSpace *space) {
+    // stamps wrap after 4 billion searches
+    if (++space->search == 0) {
+        memset(space->nodes, 0, sizeof(PathNode) * space->capacity);
+        space->search = 1;
+    }
+    space->heap_count = 0;
+}
+
+static b32 IsPathHeapBefore(PathHeapEntry a, PathHeapEntry b) {
+    b32 result = a.f < b.f || (a.f == b.f && a.h < b.h);
+    return result;
+}
+
+static void SiftPathHeapUp(PathSpace *space, u32 i) {
+    PathHeapEntry entry = space->heap[i];
+    while (i) {
+        u32 parent = (i - 1) / 2;
+        if (!IsPathHeapBefore(entry, space->heap[parent])) break;
+        space->heap[i] = space->heap[parent];
+        space->nodes[space->heap[i].node].heap_index = i;
+        i = parent;
+    }
+    space->heap[i] = entry;
+    space->nodes[entry.node].heap_index = i;
+}
+
+static u32 PopPathHeap(PathSpace *space) {
+    u32 result = space->heap[0].node;
+    space->nodes[result].heap_index = PATH_CLOSED;
+    ++space->expanded;
+
+    PathHeapEntry last = space->heap[--space->heap_count];
+    u32 count = space->heap_count;
+    if (!count) return result;
+
+    u32 i = 0;
+    for (;;) {
+        u32 child = i * 2 + 1;
+        if (child >= count) break;
+        if (child + 1 < count && IsPathHeapBefore(space->heap[child + 1], space->heap[child])) ++child;
+        if (!IsPathHeapBefore(space->heap[child], last)) break;
+        space->heap[i] = space->heap[child];
+        space->nodes[space->heap[i].node].heap_index = i;
+        i = child;
+    }
+    space->heap[i] = last;
+    space->nodes[last.node].heap_index = i;
+
+    return result;
+}
+
+// Opens a node or lowers its g. The heuristics are consistent, so a closed node is final.
+static void RelaxPathNode(PathSpace *space, u32 node, u32 parent, u32 g, u32 h) {
+    PathNode *n = space->nodes + node;
+    if (n->search != space->search) {
+        n->search = space->search;
+        n->g = g;
+        n->parent = parent;
+        u32 i = space->heap_count++;
+        space->heap[i] = { g + h, h, node };
+        SiftPathHeapUp(space, i);
+        return;
+    }
+
+    if (n->heap_index == PATH_CLOSED || g >= n->g) return;
+    n->g = g;
+    n->parent = parent;
+    space->heap[n->heap_index].f = g + h;
+    SiftPathHeapUp(space, n->heap_index);
+}
+
+// g of a node the last search reached, PATH_UNREACHABLE otherwise.
+static u32 GetSearchDistance(PathSpace *space, u32 node) {
+    PathNode *n = space->nodes + node;
+    u32 result = n->search == space->search ? n->g : PATH_UNREACHABLE;
+    return result;
+}
+
+static const int path_directions[8][2] = {
+    { 1, 0 }, { -1, 0 }, { 0, 1 }, { 0, -1 }, { 1, 1 }, { -1, 1 }, { 1, -1 }, { -1, -1 },
+};
+
+// A* over the tiles in bounds, node i is the tile (min_x + i % width, min_y + i / width). True when
+// the goal was reached. With no goal (goal_x < 0) it's Dijkstra and stops once the target_count
+// nodes flagged in targets are settled, clearing their flags, or everything reachable is.
+static b32 SearchTiles(PathGrid *grid, PathSpace *space, PathBounds bounds, int start_x, int start_y, int goal_x, int goal_y,
+                       u8 *targets = 0, int target_count = 0) {
+    BeginPathSearch(space);
+    if (!IsPathOpen(grid, start_x, start_y)) return false;
+
+    int width = bounds.max_x - bounds.min_x + 1;
+    b32 has_goal = goal_x >= 0;
+    u32 goal = has_goal ? (goal_y - bounds.min_y) * width + (goal_x - bounds.min_x) : PATH_NONE;
+    u32 start = (start_y - bounds.min_y) * width + (start_x - bounds.min_x);
+    RelaxPathNode(space, start, PATH_NONE, 0, has_goal ? GetOctileDistance(start_x, start_y, goal_x, goal_y) : 0);
+
+    int columns = grid->columns;
+    while (space->heap_count) {
+        u32 node = PopPathHeap(space);
+        if (node == goal) return true;
+        if (targets && targets[node]) {
+            targets[node] = 0;
+            if (--target_count == 0) return false;
+        }
+
+        int x = bounds.min_x + node % width;
+        int y = bounds.min_y + node / width;
+        u32 g = space->nodes[node].g;
+        int cost = grid->costs[y * columns + x];
+
+        for (int d = 0; d < 8; ++d) {
+            int dx = path_directions[d][0];
+            int dy = path_directions[d][1];
+            int next_x = x + dx;
+            int next_y = y + dy;
+            if (next_x < bounds.min_x || next_y < bounds.min_y || next_x > bounds.max_x || next_y > bounds.max_y) continue;
+
+            int next_cost = grid->costs[next_y * columns + next_x];
+            if (!next_cost) continue;
+
+            b32 diagonal = dx && dy;
+            if (diagonal && (!grid->costs[y * columns + next_x] || !grid->costs[next_y * columns + x])) continue;
+
+            u32 step = (diagonal ? PATH_DIAGONAL_COST : PATH_STRAIGHT_COST) * (cost + next_cost) / 2;
+            u32 h = has_goal ? GetOctileDistance(next_x, next_y, goal_x, goal_y) : 0;
+            u32 next = (next_y - bounds.min_y) * width + (next_x - bounds.min_x);
+            RelaxPathNode(space, next, node, g + step, h);
+        }
+    }
+
+    return false;
+}
+
+// Past max_points a path is only counted.
+static void SetPathPoint(PathRequest *request, int index, int x, int y) {
+    if (index < request->max_points) request->points[index] = { x, y };
+}
+
+// Writes the chain of parents ending at end forward, from index offset on. Returns its length.
+static int WriteSearchPath(PathSpace *space, PathBounds bounds, u32 end, PathRequest *request, int offset) {
+    int width = bounds.max_x - bounds.min_x + 1;
+
+    int count = 0;
+    for (u32 node = end; node != PATH_NONE; node = space->nodes[node].parent) ++count;
+
+    int index = offset + count - 1;
+    for (u32 node = end; node != PATH_NONE; node = space->nodes[node].parent) {
+        SetPathPoint(request, index--, bounds.min_x + node % width, bounds.min_y + node / width);
+    }
+
+    return count;
+}
+
+// Steps along a row or column until the goal or a tile where an obstacle beside the line opens a
+// turn that only this tile can take without cutting the obstacle's corner. PATH_NONE when it runs
+// into a wall. The hot loop of JPS, it walks the cost rows directly, the lines beside it are
+// blocked past the edge of the map.
+static u32 JumpStraight(PathGrid *grid, int x, int y, int dx, int dy, int goal_x, int goal_y) {
+    int columns = grid->columns;
+    int rows = grid->rows;
+    u8 *costs = grid->costs;
+
+    if (dx) {
+        if ((u32)y >= (u32)rows) return PATH_NONE;
+        u8 *row = costs + y * columns;
+        u8 *above = y > 0 ? row - columns : 0;
+        u8 *below = y + 1 < rows ? row + columns : 0;
+        int goal = y == goal_y ? goal_x : -1;
+
+        for (; (u32)x < (u32)columns; x += dx) {
+            if (!row[x]) return PATH_NONE;
+            if (x == goal) break;
+            if (above && above[x] && !above[x - dx]) break;
+            if (below && below[x] && !below[x - dx]) break;
+        }
+        if ((u32)x >= (u32)columns) return PATH_NONE;
+    } else {
+        if ((u32)x >= (u32)columns) return PATH_NONE;
+        b32 has_left = x > 0;
+        b32 has_right = x + 1 < columns;
+        int goal = x == goal_x ? goal_y : -1;
+        int back = -dy * columns;
+
+        for (; (u32)y < (u32)rows; y += dy) {
+            u8 *tile = costs + y * columns + x;
+            if (!*tile) return PATH_NONE;
+            if (y == goal) break;
+            if (has_left && tile[-1] && !tile[back - 1]) break;
+            if (has_right && tile[1] && !tile[back + 1]) break;
+        }
+        if ((u32)y >= (u32)rows) return PATH_NONE;
+    }
+
+    u32 result = y * columns + x;
+    return result;
+}
+
+// Steps along a diagonal until the goal or a tile from which one of the two straight lines it's
+// made of finds a jump point. Diagonals never have forced turns of their own, stepping onto one
+// needs both tiles beside the step open.
+static u32 JumpDiagonal(PathGrid *grid, int x, int y, int dx, int dy, int goal_x, int goal_y) {
+    for (;;) {
+        if (!IsPathOpen(grid, x, y)) return PATH_NONE;
+        if (x == goal_x && y == goal_y) break;
+
+        if (JumpStraight(grid, x + dx, y, dx, 0, goal_x, goal_y) != PATH_NONE) break;
+        if (JumpStraight(grid, x, y + dy, 0, dy, goal_x, goal_y) != PATH_NONE) break;
+        if (!IsPathOpen(grid, x + dx, y) || !IsPathOpen(grid, x, y + dy)) return PATH_NONE;
+
+        x += dx;
+        y += dy;
+    }
+
+    u32 result = y * grid->columns + x;
+    return result;
+}
+
+static int GetStepSign(int value) {
+    int result = (value > 0) - (value < 0);
+    return result;
+}
+
+// Jump Point Search over the whole grid, every open tile costs 1. A node's parent is the jump
+// point it was reached from, on the same row, column or diagonal.
+static b32 SearchJumpPoints(PathGrid *grid, PathSpace *space, int start_x, int start_y, int goal_x, int goal_y) {
+    BeginPathSearch(space);
+    if (!IsPathOpen(grid, start_x, start_y) || !IsPathOpen(grid, goal_x, goal_y)) return false;
+
+    int columns = grid->columns;
+    u32 goal = goal_y * columns + goal_x;
+    RelaxPathNode(space, start_y * columns + start_x, PATH_NONE, 0, GetOctileDistance(start_x, start_y, goal_x, goal_y));
+
+    while (space->heap_count) {
+        u32 node = PopPathHeap(space);
+        if (node == goal) return true;
+
+        int x = node % columns;
+        int y = node / columns;
+        u32 g = space->nodes[node].g;
+        u32 parent = space->nodes[node].parent;
+
+        // pruned directions: ahead, and the turns a tile on this line can take without cutting
+        // a corner, everything else is reached as well through another tile
+        int directions[8][2];
+        int direction_count = 0;
+        if (parent == PATH_NONE) {
+            memcpy(directions, path_directions, sizeof(directions));
+            direction_count = 8;
+        } else {
+            int dx = GetStepSign(x - (int)(parent % columns));
+            int dy = GetStepSign(y - (int)(parent / columns));
+            if (dx && dy) {
+                int pruned[3][2] = { { dx, dy }, { dx, 0 }, { 0, dy } };
+                memcpy(directions, pruned, sizeof(pruned));
+                direction_count = 3;
+            } else if (dx) {
+                int pruned[5][2] = { { dx, 0 }, { 0, 1 }, { 0, -1 }, { dx, 1 }, { dx, -1 } };
+                memcpy(directions, pruned, sizeof(pruned));
+                direction_count = 5;
+            } else {
+                int pruned[5][2] = { { 0, dy }, { 1, 0 }, { -1, 0 }, { 1, dy }, { -1, dy } };
+                memcpy(directions, pruned, sizeof(pruned));
+                direction_count = 5;
+            }
+        }
+
+        for (int d = 0; d < direction_count; ++d) {
+            int dx = directions[d][0];
+            int dy = directions[d][1];
+            if (!IsPathOpen(grid, x + dx, y + dy)) continue;
+
+            u32 jump;
+            if (dx && dy) {
+                if (!IsPathOpen(grid, x + dx, y) || !IsPathOpen(grid, x, y + dy)) continue;
+                jump = JumpDiagonal(grid, x + dx, y + dy, dx, dy, goal_x, goal_y);
+            } else {
+                jump = JumpStraight(grid, x + dx, y + dy, dx, dy, goal_x, goal_y);
+            }
+            if (jump == PATH_NONE) continue;
+
+            int jump_x = jump % columns;
+            int jump_y = jump / columns;
+            RelaxPathNode(space, jump, node, g + GetOctileDistance(x, y, jump_x, jump_y), GetOctileDistance(jump_x, jump_y, goal_x, goal_y));
+        }
+    }
+
+    return false;
+}
+
+// The jump points ending at end, with the tiles between them filled in.
+static int WriteJumpPath(PathGrid *grid, PathSpace *space, u32 end, PathRequest *request) {
+    int columns = grid->columns;
+
+    int count = 1;
+    for (u32 node = end; space->nodes[node].parent != PATH_NONE; node = space->nodes[node].parent) {
+        u32 parent = space->nodes[node].parent;
+        int dx = abs((int)(node % columns) - (int)(parent % columns));
+        int dy = abs((int)(node / columns) - (int)(parent / columns));
+        count += Max(dx, dy);
+    }
+
+    int index = count - 1;
+    int x = end % columns;
+    int y = end / columns;
+    SetPathPoint(request, index--, x, y);
+    for (u32 node = end; space->nodes[node].parent != PATH_NONE; node = space->nodes[node].parent) {
+        u32 parent = space->nodes[node].parent;
+        int parent_x = parent % columns;
+        int parent_y = parent / columns;
+        int dx = GetStepSign(parent_x - x);
+        int dy = GetStepSign(parent_y - y);
+        while (x != parent_x || y != parent_y) {
+            x += dx;
+            y += dy;
+            SetPathPoint(request, index--, x, y);
+        }
+    }
+
+    return count;
+}
+
+static PathBounds GetPathClusterBounds(PathGrid *grid, int cluster) {
+    int x = (cluster % grid->cluster_columns) * PATH_CLUSTER_SIZE;
+    int y = (cluster / grid->cluster_columns) * PATH_CLUSTER_SIZE;
+    int end_x = Min(x + PATH_CLUSTER_SIZE, grid->columns);
+    int end_y = Min(y + PATH_CLUSTER_SIZE, grid->rows);
+    PathBounds result = { x, y, end_x - 1, end_y - 1 };
+    return result;
+}
+
+// -1 past the edge of the grid.
+static int GetNeighbourCluster(PathGrid *grid, int cluster, int border) {
+    int x = cluster % grid->cluster_columns;
+    int y = cluster / grid->cluster_columns;
+    switch (border) {
+        case PathBorderWest: return x > 0 ? cluster - 1 : -1;
+        case PathBorderEast: return x < grid->cluster_columns - 1 ? cluster + 1 : -1;
+        case PathBorderNorth: return y > 0 ? cluster - grid->cluster_columns : -1;
+        default: return y < grid->cluster_rows - 1 ? cluster + grid->cluster_columns : -1;
+    }
+}
+
+static void AddClusterNode(PathCluster *cluster, int border, int x, int y) {
+    Assert(cluster->node_count < PATH_MAX_CLUSTER_NODES);
+    int i = cluster->node_count++;
+    cluster->node_x[i] = (u16)x;
+    cluster->node_y[i] = (u16)y;
+    cluster->node_borders[i] = (u8)border;
+}
+
+// The transitions of one border, seen from the cluster's side. (x, y) is its first tile on the
+// border, (step_x, step_y) walks along it and (out_x, out_y) points across. Both clusters walk a
+// border the same way, so they agree on where its transitions are.
+static void AddBorderNodes(PathGrid *grid, PathCluster *cluster, int border, int x, int y,
+                           int step_x, int step_y, int out_x, int out_y, int length) {
+    int run = 0;
+    for (int i = 0; i <= length; ++i) {
+        int tile_x = x + i * step_x;
+        int tile_y = y + i * step_y;
+        b32 open = i < length && IsPathOpen(grid, tile_x, tile_y) && IsPathOpen(grid, tile_x + out_x, tile_y + out_y);
+        if (open) {
+            ++run;
+            continue;
+        }
+        if (!run) continue;
+
+        int first = i - run;
+        int last = i - 1;
+        if (run >= PATH_LONG_ENTRANCE) {
+            AddClusterNode(cluster, border, x + first * step_x, y + first * step_y);
+            AddClusterNode(cluster, border, x + last * step_x, y + last * step_y);
+        } else {
+            int middle = (first + last) / 2;
+            AddClusterNode(cluster, border, x + middle * step_x, y + middle * step_y);
+        }
+        run = 0;
+    }
+}
+
+static void BuildClusterNodes(PathFinder *finder, int c) {
+    PathGrid *grid = finder->grid;
+    PathCluster *cluster = finder->clusters + c;
+    PathBounds bounds = GetPathClusterBounds(grid, c);
+    int width = bounds.max_x - bounds.min_x + 1;
+    int height = bounds.max_y - bounds.min_y + 1;
+
+    cluster->node_count = 0;
+    if (GetNeighbourCluster(grid, c, PathBorderWest) >= 0) {
+        AddBorderNodes(grid, cluster, PathBorderWest, bounds.min_x, bounds.min_y, 0, 1, -1, 0, height);
+    }
+    if (GetNeighbourCluster(grid, c, PathBorderEast) >= 0) {
+        AddBorderNodes(grid, cluster, PathBorderEast, bounds.max_x, bounds.min_y, 0, 1, 1, 0, height);
+    }
+    if (GetNeighbourCluster(grid, c, PathBorderNorth) >= 0) {
+        AddBorderNodes(grid, cluster, PathBorderNorth, bounds.min_x, bounds.min_y, 1, 0, 0, -1, width);
+    }
+    if (GetNeighbourCluster(grid, c, PathBorderSouth) >= 0) {
+        AddBorderNodes(grid, cluster, PathBorderSouth, bounds.min_x, bounds.max_y, 1, 0, 0, 1, width);
+    }
+}
+
+// Finds each node's partner across its border, by the tile and the opposite border.
+static void LinkClusterNodes(PathFinder *finder, int c) {
+    static const int offsets[4][2] = { { -1, 0 }, { 1, 0 }, { 0, -1 }, { 0, 1 } };
+
+    PathGrid *grid = finder->grid;
+    PathCluster *cluster = finder->clusters + c;
+
+    for (int i = 0; i < cluster->node_count; ++i) {
+        int border = cluster->node_borders[i];
+        int neighbour_index = GetNeighbourCluster(grid, c, border);
+        PathCluster *neighbour = finder->clusters + neighbour_index;
+        int x = cluster->node_x[i] + offsets[border][0];
+        int y = cluster->node_y[i] + offsets[border][1];
+
+        cluster->partners[i] = PATH_NONE;
+        for (int j = 0; j < neighbour->node_count; ++j) {
+            if (neighbour->node_borders[j] == (border ^ 1) && neighbour->node_x[j] == x && neighbour->node_y[j] == y) {
+                cluster->partners[i] = neighbour_index * PATH_MAX_CLUSTER_NODES + j;
+                break;
+            }
+        }
+        Assert(cluster->partners[i] != PATH_NONE);
+    }
+}
+
+// Node i of a cluster in its cluster's search space.
+static u32 GetClusterNodeTile(PathCluster *cluster, PathBounds bounds, int i) {
+    u32 result = (cluster->node_y[i] - bounds.min_y) * (bounds.max_x - bounds.min_x + 1) + (cluster->node_x[i] - bounds.min_x);
+    return result;
+}
+
+// Dijkstra inside the cluster from (x, y), until the nodes from first on are settled.
+static void SearchClusterNodes(PathGrid *grid, PathSearch *search, PathCluster *cluster, PathBounds bounds, int x, int y, int first) {
+    u8 targets[PATH_CLUSTER_SIZE * PATH_CLUSTER_SIZE] = {};
+    int target_count = 0;
+    for (int i = first; i < cluster->node_count; ++i) {
+        u32 tile = GetClusterNodeTile(cluster, bounds, i);
+        target_count += !targets[tile];
+        targets[tile] = 1;
+    }
+    SearchTiles(grid, &search->cluster, bounds, x, y, -1, -1, targets, target_count);
+}
+
+// Distances between the nodes of a cluster, a Dijkstra inside it from each one. Costs are
+// symmetric, so each only has to reach the nodes after it.
+static void ComputeClusterDistances(PathFinder *finder, PathSearch *search, int c) {
+    PathGrid *grid = finder->grid;
+    PathCluster *cluster = finder->clusters + c;
+    PathBounds bounds = GetPathClusterBounds(grid, c);
+
+    for (int i = 0; i < cluster->node_count; ++i) {
+        cluster->distances[i * PATH_MAX_CLUSTER_NODES + i] = 0;
+        if (i + 1 == cluster->node_count) break;
+
+        SearchClusterNodes(grid, search, cluster, bounds, cluster->node_x[i], cluster->node_y[i], i + 1);
+        for (int j = i + 1; j < cluster->node_count; ++j) {
+            u32 distance = GetSearchDistance(&search->cluster, GetClusterNodeTile(cluster, bounds, j));
+            cluster->distances[i * PATH_MAX_CLUSTER_NODES + j] = distance;
+            cluster->distances[j * PATH_MAX_CLUSTER_NODES + i] = distance;
+        }
+    }
+}
+
+static void ComputeClusterDistancesJob(void *data, int first, int one_past_last) {
+    PathFinder *finder = (PathFinder *)data;
+    PathSearch *search = finder->searches + GetJobThreadIndex();
+    for (int i = first; i < one_past_last; ++i) ComputeClusterDistances(finder, search, finder->updates[i]);
+}
+
+// thread_count is the most job threads that will search at once, each gets its own PathSearch.
+// Searches over the whole grid need a node per tile each, the cluster graph is built by the
+// first UpdatePathAbstraction.
+PathFinder CreatePathFinder(Arena *arena, PathGrid *grid, int thread_count) {
+    PathFinder result = {};
+    result.grid = grid;
+    result.cluster_count = grid->cluster_columns * grid->cluster_rows;
+    result.clusters = (PathCluster *)ArenaAlloc(arena, sizeof(PathCluster) * result.cluster_count);
+    result.built_revisions = (u32 *)ArenaAlloc(arena, sizeof(u32) * result.cluster_count);
+    result.update_flags = (u8 *)ArenaAlloc(arena, result.cluster_count);
+    result.updates = (int *)ArenaAlloc(arena, sizeof(int) * result.cluster_count);
+
+    u32 graph_capacity = result.cluster_count * PATH_MAX_CLUSTER_NODES + 2;
+    result.search_count = Max(thread_count, 1);
+    result.searches = (PathSearch *)ArenaAlloc(arena, sizeof(PathSearch) * result.search_count);
+    for (int i = 0; i < result.search_count; ++i) {
+        PathSearch *search = result.searches + i;
+        search->grid = CreatePathSpace(arena, grid->columns * grid->rows);
+        search->cluster = CreatePathSpace(arena, PATH_CLUSTER_SIZE * PATH_CLUSTER_SIZE);
+        search->graph = CreatePathSpace(arena, graph_capacity);
+        search->graph_path = (u32 *)ArenaAlloc(arena, sizeof(u32) * graph_capacity);
+    }
+
+    return result;
+}
+
+#define PATH_UPDATE_REBUILD 1
+#define PATH_UPDATE_RELINK 2
+
+// Main thread, between batches. Brings the graph up to date with the grid: a changed cluster and
+// its neighbours get their nodes again, since the entrances on a border belong to both sides,
+// their neighbours relink to the renumbered nodes, and the rebuilt clusters' distances are
+// recomputed on the job system. Returns the clusters rebuilt.
+int UpdatePathAbstraction(PathFinder *finder) {
+    ProfileFunction();
+
+    PathGrid *grid = finder->grid;
+    u8 *flags = finder->update_flags;
+
+    for (int c = 0; c < finder->cluster_count; ++c) {
+        if (finder->built_revisions[c] == grid->cluster_revisions[c]) continue;
+        finder->built_revisions[c] = grid->cluster_revisions[c];
+
+        flags[c] |= PATH_UPDATE_REBUILD;
+        for (int border = 0; border < 4; ++border) {
+            int neighbour = GetNeighbourCluster(grid, c, border);
+            if (neighbour >= 0) flags[neighbour] |= PATH_UPDATE_REBUILD;
+        }
+    }
+
+    int update_count = 0;
+    for (int c = 0; c < finder->cluster_count; ++c) {
+        if (!(flags[c] & PATH_UPDATE_REBUILD)) continue;
+
+        BuildClusterNodes(finder, c);
+        finder->updates[update_count++] = c;
+        for (int border = 0; border < 4; ++border) {
+            int neighbour = GetNeighbourCluster(grid, c, border);
+            if (neighbour >= 0) flags[neighbour] |= PATH_UPDATE_RELINK;
+        }
+    }
+
+    for (int c = 0; c < finder->cluster_count; ++c) {
+        if (flags[c]) LinkClusterNodes(finder, c);
+        flags[c] = 0;
+    }
+
+    if (update_count) {
+        Assert(GetJobThreadCount() <= finder->search_count);
+        int batch_size = Max(update_count / 1024 + 1, PATH_BATCH_SIZE);
+        ParallelFor(ComputeClusterDistancesJob, finder, update_count, batch_size);
+    }
+
+    finder->rebuilt = update_count;
+    return update_count;
+}
+
+// Tile of a graph node, the last two are the request's start and goal.
+static void GetGraphNodeTile(PathFinder *finder, PathRequest *request, u32 node, int *x, int *y) {
+    u32 start = finder->cluster_count * PATH_MAX_CLUSTER_NODES;
+    if (node == start) {
+        *x = request->start_x;
+        *y = request->start_y;
+    } else if (node == start + 1) {
+        *x = request->goal_x;
+        *y = request->goal_y;
+    } else {
+        PathCluster *cluster = finder->clusters + node / PATH_MAX_CLUSTER_NODES;
+        *x = cluster->node_x[node % PATH_MAX_CLUSTER_NODES];
+        *y = cluster->node_y[node % PATH_MAX_CLUSTER_NODES];
+    }
+}
+
+static void RelaxGraphNode(PathFinder *finder, PathSearch *search, PathRequest *request, u32 node, u32 parent, u32 g) {
+    int x, y;
+    GetGraphNodeTile(finder, request, node, &x, &y);
+    RelaxPathNode(&search->graph, node, parent, g, GetOctileDistance(x, y, request->goal_x, request->goal_y));
+}
+
+// Distances from a tile to the nodes of its cluster. Costs are symmetric, so they're also the
+// distances back to it.
+static void LinkTileToCluster(PathFinder *finder, PathSearch *search, int x, int y, u32 *distances) {
+    PathGrid *grid = finder->grid;
+    int c = GetPathCluster(grid, x, y);
+    PathCluster *cluster = finder->clusters + c;
+    PathBounds bounds = GetPathClusterBounds(grid, c);
+
+    SearchClusterNodes(grid, search, cluster, bounds, x, y, 0);
+    for (int i = 0; i < cluster->node_count; ++i) {
+        distances[i] = GetSearchDistance(&search->cluster, GetClusterNodeTile(cluster, bounds, i));
+    }
+}
+
+// HPA*: a search inside the cluster when the start and goal share one, otherwise over the
+// cluster graph, refined an edge at a time.
+static b32 SearchHierarchical(PathFinder *finder, PathSearch *search, PathRequest *request) {
+    PathGrid *grid = finder->grid;
+    int start_x = request->start_x;
+    int start_y = request->start_y;
+    int goal_x = request->goal_x;
+    int goal_y = request->goal_y;
+    if (!IsPathOpen(grid, start_x, start_y) || !IsPathOpen(grid, goal_x, goal_y)) return false;
+
+    int start_cluster = GetPathCluster(grid, start_x, start_y);
+    int goal_cluster = GetPathCluster(grid, goal_x, goal_y);
+
+    if (start_cluster == goal_cluster) {
+        PathBounds bounds = GetPathClusterBounds(grid, start_cluster);
+        if (SearchTiles(grid, &search->cluster, bounds, start_x, start_y, goal_x, goal_y)) {
+            u32 goal = (goal_y - bounds.min_y) * (bounds.max_x - bounds.min_x + 1) + (goal_x - bounds.min_x);
+            request->cost = search->cluster.nodes[goal].g;
+            request->length = WriteSearchPath(&search->cluster, bounds, goal, request, 0);
+            return true;
+        }
+    }
+
+    LinkTileToCluster(finder, search, start_x, start_y, search->start_distances);
+    LinkTileToCluster(finder, search, goal_x, goal_y, search->goal_distances);
+
+    PathSpace *space = &search->graph;
+    u32 start = finder->cluster_count * PATH_MAX_CLUSTER_NODES;
+    u32 goal = start + 1;
+    BeginPathSearch(space);
+    RelaxGraphNode(finder, search, request, start, PATH_NONE, 0);
+
+    b32 found = false;
+    while (space->heap_count) {
+        u32 node = PopPathHeap(space);
+        if (node == goal) {
+            found = true;
+            break;
+        }
+
+        u32 g = space->nodes[node].g;
+        if (node == start) {
+            PathCluster *cluster = finder->clusters + start_cluster;
+            for (int i = 0; i < cluster->node_count; ++i) {
+                u32 distance = search->start_distances[i];
+                if (distance != PATH_UNREACHABLE) RelaxGraphNode(finder, search, request, start_cluster * PATH_MAX_CLUSTER_NODES + i, node, g + distance);
+            }
+            continue;
+        }
+
+        int c = node / PATH_MAX_CLUSTER_NODES;
+        int i = node % PATH_MAX_CLUSTER_NODES;
+        PathCluster *cluster = finder->clusters + c;
+
+        for (int j = 0; j < cluster->node_count; ++j) {
+            u32 distance = cluster->distances[i * PATH_MAX_CLUSTER_NODES + j];
+            if (j != i && distance != PATH_UNREACHABLE) RelaxGraphNode(finder, search, request, c * PATH_MAX_CLUSTER_NODES + j, node, g + distance);
+        }
+
+        int x, y, partner_x, partner_y;
+        u32 partner = cluster->partners[i];
+        GetGraphNodeTile(finder, request, node, &x, &y);
+        GetGraphNodeTile(finder, request, partner, &partner_x, &partner_y);
+        u32 step = PATH_STRAIGHT_COST * (GetPathCost(grid, x, y) + GetPathCost(grid, partner_x, partner_y)) / 2;
+        RelaxGraphNode(finder, search, request, partner, node, g + step);
+
+        if (c == goal_cluster && search->goal_distances[i] != PATH_UNREACHABLE) {
+            RelaxGraphNode(finder, search, request, goal, node, g + search->goal_distances[i]);
+        }
+    }
+    if (!found) return false;
+
+    int count = 0;
+    for (u32 node = goal; node != PATH_NONE; node = space->nodes[node].parent) ++count;
+    int index = count;
+    for (u32 node = goal; node != PATH_NONE; node = space->nodes[node].parent) search->graph_path[--index] = node;
+
+    // edges inside a cluster are searched again, edges across a border are one step
+    int length = 1;
+    u32 cost = 0;
+    SetPathPoint(request, 0, start_x, start_y);
+    for (int k = 1; k < count; ++k) {
+        int from_x, from_y, to_x, to_y;
+        GetGraphNodeTile(finder, request, search->graph_path[k - 1], &from_x, &from_y);
+        GetGraphNodeTile(finder, request, search->graph_path[k], &to_x, &to_y);
+
+        int c = GetPathCluster(grid, from_x, from_y);
+        if (c != GetPathCluster(grid, to_x, to_y)) {
+            cost += PATH_STRAIGHT_COST * (GetPathCost(grid, from_x, from_y) + GetPathCost(grid, to_x, to_y)) / 2;
+            SetPathPoint(request, length++, to_x, to_y);
+            continue;
+        }
+
+        PathBounds bounds = GetPathClusterBounds(grid, c);
+        b32 refined = SearchTiles(grid, &search->cluster, bounds, from_x, from_y, to_x, to_y);
+        Assert(refined);
+
+        u32 end = (to_y - bounds.min_y) * (bounds.max_x - bounds.min_x + 1) + (to_x - bounds.min_x);
+        cost += search->cluster.nodes[end].g;
+        length += WriteSearchPath(&search->cluster, bounds, end, request, length - 1) - 1;
+    }
+
+    request->cost = cost;
+    request->length = length;
+    return true;
+}
+
+// Any thread, searching with the calling job thread's PathSearch.
+void FindPath(PathFinder *finder, PathRequest *request) {
+    Assert(GetJobThreadIndex() < finder->search_count);
+    PathSearch *search = finder->searches + GetJobThreadIndex();
+    PathGrid *grid = finder->grid;
+
+    request->found = false;
+    request->length = 0;
+    request->cost = 0;
+    search->grid.expanded = 0;
+    search->cluster.expanded = 0;
+    search->graph.expanded = 0;
+
+    int start_x = request->start_x;
+    int start_y = request->start_y;
+    int goal_x = request->goal_x;
+    int goal_y = request->goal_y;
+    PathBounds bounds = { 0, 0, grid->columns - 1, grid->rows - 1 };
+    u32 goal = goal_y * grid->columns + goal_x;
+
+    // a blocked or outside tile has no path, and no node to index
+    if (!IsPathOpen(grid, start_x, start_y) || !IsPathOpen(grid, goal_x, goal_y)) return;
+
+    if (request->method == PathHierarchical) {
+        request->found = SearchHierarchical(finder, search, request);
+    } else if (request->method == PathJumpPoint && !grid->weighted_count) {
+        request->found = SearchJumpPoints(grid, &search->grid, start_x, start_y, goal_x, goal_y);
+        if (request->found) {
+            request->cost = search->grid.nodes[goal].g;
+            request->length = WriteJumpPath(grid, &search->grid, goal, request);
+        }
+    } else {
+        request->found = SearchTiles(grid, &search->grid, bounds, start_x, start_y, goal_x, goal_y);
+        if (request->found) {
+            request->cost = search->grid.nodes[goal].g;
+            request->length = WriteSearchPath(&search->grid, bounds, goal, request, 0);
+        }
+    }
+
+    request->expanded = search->grid.expanded + search->cluster.expanded + search->graph.expanded;
+}
+
+static void FindPathsJob(void *data, int first, int one_past_last) {
+    PathBatch *batch = (PathBatch *)data;
+    for (int i = first; i < one_past_last; ++i) FindPath(batch->finder, batch->requests + i);
+}
+
+// Spreads the batch over the job system, counter reaches zero once every request has its path.
+// The batch and the requests must live until then.
+void FindPaths(PathBatch *batch, JobCounter *counter) {
+    Assert(GetJobThreadCount() <= batch->finder->search_count);
+    int batch_size = Max(batch->count / 1024 + 1, PATH_BATCH_SIZE);
+    ParallelFor(FindPathsJob, batch, batch->count, batch_size, counter);
+}
+
+void FindPaths(PathBatch *batch) {
+    ProfileFunction();
+
+    Assert(GetJobThreadCount() <= batch->finder->search_count);
+    int batch_size = Max(batch->count / 1024 + 1, PATH_BATCH_SIZE);
+    ParallelFor(FindPathsJob, batch, batch->count, batch_size);
+}
+
+static u32 HashPathTile(int x, int y) {
+    u32 h = (u32)x * 73856093u ^ (u32)y * 19349663u;
+    h ^= h >> 13;
+    h *= 0x5bd1e995u;
+    h ^= h >> 15;
+    return h;
+}
+
+// Rocks on rock_percent of the tiles and walls with gaps every 64, so paths have to find their
+// way around instead of running straight.
+static void FillBenchmarkPathGrid(PathGrid *grid, u32 rock_percent) {
+    for (int y = 0; y < grid->rows; ++y) {
+        for (int x = 0; x < grid->columns; ++x) {
+            b32 wall = (x % 64 == 0 && y % 64 > 8) || (y % 64 == 0 && x % 64 < 56);
+            b32 rock = HashPathTile(x, y) % 100 < rock_percent;
+            SetPathCost(grid, x, y, (wall || rock) ? 0 : 1);
+        }
+    }
+}
+
+static void PickOpenPathTile(PathGrid *grid, u32 *seed, int *x, int *y) {
+    do {
+        *seed = *seed * 1664525u + 1013904223u;
+        *x = (*seed >> 8) % grid->columns;
+        *seed = *seed * 1664525u + 1013904223u;
+        *y = (*seed >> 8) % grid->rows;
+    } while (!IsPathOpen(grid, *x, *y));
+}
+
+void BenchmarkPathfinding() {
+    const int size = 1024;
+    const int request_count = 128;
+    const int max_points = 4096;
+    const int edit_count = 64;
+    const u32 rock_percents[] = { 0, 20 }; // rooms, where JPS skips across the open floor, and scattered rocks, where it can't
+
+    const char *method_names[] = { "A*", "JPS", "HPA*" };
+    int max_threads = GetCoreCount();
+    u64 search_bytes = sizeof(PathSearch) + (sizeof(PathNode) + sizeof(PathHeapEntry)) * (u64)size * size + Megabytes(8);
+
+    Arena arena = CreateArena(Megabytes(64) + search_bytes * max_threads);
+    PathGrid grid = CreatePathGrid(&arena, size, size);
+
+    PathRequest *requests = (PathRequest *)ArenaAlloc(&arena, sizeof(PathRequest) * request_count);
+    PathPoint *points = (PathPoint *)ArenaAlloc(&arena, sizeof(PathPoint) * max_points * request_count);
+    u32 *optimal_costs = (u32 *)ArenaAlloc(&arena, sizeof(u32) * request_count);
+
+    fprintf(stdout, "Pathfinding: %d x %d, %d paths between random tiles, %d x %d clusters\n", size, size, request_count,
+            grid.cluster_columns, grid.cluster_rows);
+
+    for (int map = 0; map < (int)ArrayCount(rock_percents); ++map) {
+        FillBenchmarkPathGrid(&grid, rock_percents[map]);
+
+        u32 seed = 12345;
+        for (int i = 0; i < request_count; ++i) {
+            PathRequest *request = requests + i;
+            PickOpenPathTile(&grid, &seed, &request->start_x, &request->start_y);
+            PickOpenPathTile(&grid, &seed, &request->goal_x, &request->goal_y);
+            request->points = points + i * max_points;
+            request->max_points = max_points;
+        }
+
+        fprintf(stdout, "  %u%% rocks\n", rock_percents[map]);
+
+        for (int thread_count = 1; thread_count <= max_threads; thread_count = GetNextBenchmarkThreadCount(thread_count, max_threads)) {
+            u64 mark = arena.count;
+            InitJobSystem(&arena, thread_count);
+            PathFinder finder = CreatePathFinder(&arena, &grid, GetJobThreadCount());
+
+            double start = GetTime();
+            int built = UpdatePathAbstraction(&finder);
+            double build_seconds = GetTime() - start;
+
+            fprintf(stdout, "    %2d thread(s): graph built in %.2f ms (%d clusters)\n", thread_count, build_seconds * 1000, built);
+
+            for (int method = PathAStar; method <= PathHierarchical; ++method) {
+                for (int i = 0; i < request_count; ++i) requests[i].method = (PathMethod)method;
+
+                PathBatch batch = { &finder, requests, request_count };
+                start = GetTime();
+                FindPaths(&batch);
+                double seconds = GetTime() - start;
+
+                int found = 0;
+                double expanded = 0, excess = 0;
+                for (int i = 0; i < request_count; ++i) {
+                    PathRequest *request = requests + i;
+                    if (method == PathAStar) optimal_costs[i] = request->found ? request->cost : 0;
+                    if (!request->found) continue;
+                    ++found;
+                    expanded += request->expanded;
+                    excess += (double)request->cost / optimal_costs[i] - 1;
+                }
+
+                int divisor = Max(found, 1);
+                fprintf(stdout, "      %-5s %9.0f paths/s, %8.0f nodes expanded/path, %d found, %5.2f%% longer than A*\n", method_names[method],
+                        request_count / seconds, expanded / divisor, found, excess * 100 / divisor);
+            }
+
+            // a few tiles change somewhere on the map, only their clusters and neighbours rebuild
+            for (int i = 0; i < edit_count; ++i) {
+                int x, y;
+                PickOpenPathTile(&grid, &seed, &x, &y);
+                SetPathCost(&grid, x, y, 0);
+            }
+            start = GetTime();
+            int rebuilt = UpdatePathAbstraction(&finder);
+            double update_seconds = GetTime() - start;
+            fprintf(stdout, "      %d tiles blocked, graph updated in %.3f ms (%d clusters)\n", edit_count, update_seconds * 1000, rebuilt);
+
+            ShutdownJobSystem();
+            arena.count = mark;
+            FillBenchmarkPathGrid(&grid, rock_percents[map]);
+        }
+    }
+
+    free(arena.base_address);
+}
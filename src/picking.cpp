@@ -0,0 +1,603 @@
+/*
+    Tile picking and selection.
+
+    A TileProjection is the map's screen transform: continuous tile coordinates (tile x covers
+    [x, x + 1)) at an elevation go to screen pixels and back with a couple of multiplies, so the
+    tile under a point on flat ground is a floor away (a floor, not a cast, tiles left of and
+    above tile 0 are negative).
+
+    Elevation: a column raised by one step looks the same as a column moved back along the (1, 1)
+    diagonal by elevation_step / (2 * step) tiles. PickGround walks that diagonal from the
+    tallest column the map has down to the ground, cell by cell, and stops at the first column
+    tall enough to cover the ray. That's O(max_height), not O(tiles).
+
+    Sprites standing on tiles (trees, crates) reach over the tiles behind them. Their bounds are
+    kept per map chunk in world space (the projection at 256 pixel tiles, origin on tile (0, 0)'s
+    top corner, so pan and zoom don't invalidate them) with a uniform grid over each chunk. A
+    chunk is rebuilt when its revision changes. A pick only looks at the chunks a sprite over the
+    point could come from, then at one grid cell in each. The front most hit (highest depth key)
+    between the sprites and the ground wins.
+
+    Selections are a bitset over the map plus the list of selected indices, clearing one costs
+    what it holds. Polygon (lasso) and rect selection walk the map row by row: a row's tile
+    centres lie on a line on screen, only the stretch of it inside the polygon's bounds is tested,
+    each candidate with an even odd point in polygon test. The cost is the area of the polygon's
+    bounds in tiles, not the map.
+*/
+
+#define PICK_CELL_SIZE 256.0f // world pixels, doubled for chunks whose entries don't fit
+#define PICK_MAX_CELLS 512
+#define PICK_WORLD_HALF_WIDTH 128.0f
+#define PICK_WORLD_STEP 64.0f
+
+struct TileProjection {
+    v2 origin; // screen position of tile (0, 0)'s top corner at elevation 0
+    f32 half_width; // screen x per tile of x - y
+    f32 step; // screen y per tile of x + y
+    f32 elevation_step; // screen y per elevation step
+};
+
+struct PickResult {
+    b32 hit;
+    int x;
+    int y;
+    int layer; // -1 for the ground
+    int elevation;
+    u32 key;
+};
+
+struct PickSprite {
+    Rect bounds; // world pixels
+    int x;
+    int y;
+    int layer;
+    u32 key;
+};
+
+struct PickChunk {
+    u32 revision; // of the tilemap chunk, 0 until built
+    Rect bounds; // of all its sprites, world pixels
+
+    f32 cell_size;
+    int grid_columns;
+    int grid_rows;
+    int *cell_offsets; // grid_columns * grid_rows + 1, into cell_entries
+    int *cell_entries; // sprite indices
+
+    int sprite_count;
+    PickSprite *sprites;
+};
+
+struct TilePicker {
+    int chunk_count;
+    PickChunk *chunks;
+    int max_sprites; // per chunk
+    int max_entries;
+    int reach; // tiles along the diagonal the tallest sprite reaches back, only grows
+};
+
+struct TileSelection {
+    int columns;
+    int count;
+    int capacity;
+    u32 *indices;
+    u64 *bits;
+};
+
+v2 ProjectTile(TileProjection *projection, v2 tile, f32 elevation) {
+    v2 result = {
+        projection->origin.x + (tile.x - tile.y) * projection->half_width,
+        projection->origin.y + (tile.x + tile.y) * projection->step - elevation * projection->elevation_step
+    };
+    return result;
+}
+
+v2 UnprojectTile(TileProjection *projection, v2 screen, f32 elevation) {
+    f32 a = (screen.x - projection->origin.x) / projection->half_width; // x - y
+    f32 b = (screen.y - projection->origin.y + elevation * projection->elevation_step) / projection->step; // x + y
+    v2 result = { (a + b) * 0.5f, (b - a) * 0.5f };
+    return result;
+}
+
+v2 ScreenToPickWorld(TileProjection *projection, v2 screen) {
+    v2 result = {
+        (screen.x - projection->origin.x) * PICK_WORLD_HALF_WIDTH / projection->half_width,
+        (screen.y - projection->origin.y) * PICK_WORLD_STEP / projection->step
+    };
+    return result;
+}
+
+static b32 RectContains(Rect rect, v2 p) {
+    b32 result = p.x >= rect.x && p.y >= rect.y && p.x < rect.x + rect.width && p.y < rect.y + rect.height;
+    return result;
+}
+
+// The column a tile's ground has, -1 where there's no ground.
+static int GetGroundHeight(Tilemap *map, int ground_layer, int x, int y) {
+    if (!IsTileInMap(map, x, y) || !GetTile(map, ground_layer, x, y)) return -1;
+    return map->heights[y * map->columns + x];
+}
+
+PickResult PickGround(Tilemap *map, int ground_layer, TileProjection *projection, v2 screen) {
+    PickResult result = {};
+    result.layer = -1;
+
+    f32 k = projection->elevation_step / (2 * projection->step); // diagonal tiles per elevation step
+    v2 ground = UnprojectTile(projection, screen, 0);
+    f32 t = map->max_height * k;
+
+    while (t > 0) {
+        f32 bx = ground.x + t;
+        f32 by = ground.y + t;
+
+        // the cell the ray is in just below t, boundaries belong to the cell behind
+        int cx = (int)ceilf(bx) - 1;
+        int cy = (int)ceilf(by) - 1;
+        f32 t_next = Max(t - (bx - cx), t - (by - cy));
+        if (t_next < 0) t_next = 0;
+
+        int height = GetGroundHeight(map, ground_layer, cx, cy);
+        if (height >= 0 && height * k >= t_next) {
+            result = { true, cx, cy, -1, height, IsoDepthKey(cx, cy, height, SpriteLayerGround) };
+            return result;
+        }
+
+        t = t_next;
+    }
+
+    int x = (int)floorf(ground.x);
+    int y = (int)floorf(ground.y);
+    if (GetGroundHeight(map, ground_layer, x, y) >= 0) {
+        result = { true, x, y, -1, 0, IsoDepthKey(x, y, 0, SpriteLayerGround) };
+    }
+
+    return result;
+}
+
+// reach is how many tiles along the diagonal the tallest sprite covers behind its own, chunks
+// that were never built can't tell. It grows with the sprites added. Every chunk's sprites and
+// grid are allocated here, picking never allocates.
+TilePicker CreateTilePicker(Arena *arena, Tilemap *map, int max_sprites_per_chunk, int reach) {
+    TilePicker result = {};
+    result.reach = reach;
+    result.chunk_count = map->chunk_columns * map->chunk_rows;
+    result.chunks = (PickChunk *)ArenaAlloc(arena, sizeof(PickChunk) * result.chunk_count);
+    result.max_sprites = max_sprites_per_chunk;
+    result.max_entries = max_sprites_per_chunk * 6;
+
+    PickSprite *sprites = (PickSprite *)ArenaAlloc(arena, sizeof(PickSprite) * result.max_sprites * result.chunk_count);
+    int *cell_offsets = (int *)ArenaAlloc(arena, sizeof(int) * (PICK_MAX_CELLS + 1) * result.chunk_count);
+    int *cell_entries = (int *)ArenaAlloc(arena, sizeof(int) * result.max_entries * result.chunk_count);
+    for (int chunk = 0; chunk < result.chunk_count; ++chunk) {
+        PickChunk *pick = result.chunks + chunk;
+        pick->sprites = sprites + chunk * result.max_sprites;
+        pick->cell_offsets = cell_offsets + chunk * (PICK_MAX_CELLS + 1);
+        pick->cell_entries = cell_entries + chunk * result.max_entries;
+    }
+
+    return result;
+}
+
+b32 IsPickChunkStale(TilePicker *picker, Tilemap *map, int chunk) {
+    b32 result = picker->chunks[chunk].revision != map->chunk_revisions[chunk];
+    return result;
+}
+
+// Chunks are filled on first use, most of a big map is never picked from.
+void BeginPickChunk(TilePicker *picker, int chunk) {
+    picker->chunks[chunk].sprite_count = 0;
+}
+
+void AddPickSprite(TilePicker *picker, int chunk, Rect bounds, int x, int y, int layer, u32 key) {
+    PickChunk *pick = picker->chunks + chunk;
+    if (pick->sprite_count == picker->max_sprites) return;
+
+    pick->sprites[pick->sprite_count++] = { bounds, x, y, layer, key };
+
+    f32 tile_top = (x + y) * PICK_WORLD_STEP;
+    int reach = (int)ceilf((tile_top - bounds.y) / (2 * PICK_WORLD_STEP)) + 1;
+    picker->reach = Max(picker->reach, reach);
+}
+
+static int CountPickEntries(PickChunk *pick, f32 cell_size, int *columns, int *rows) {
+    *columns = Max(1, (int)ceilf(pick->bounds.width / cell_size));
+    *rows = Max(1, (int)ceilf(pick->bounds.height / cell_size));
+
+    int total = 0;
+    for (int i = 0; i < pick->sprite_count; ++i) {
+        Rect b = pick->sprites[i].bounds;
+        int x0 = (int)((b.x - pick->bounds.x) / cell_size);
+        int y0 = (int)((b.y - pick->bounds.y) / cell_size);
+        int x1 = Min((int)((b.x + b.width - pick->bounds.x) / cell_size), *columns - 1);
+        int y1 = Min((int)((b.y + b.height - pick->bounds.y) / cell_size), *rows - 1);
+        total += (x1 - x0 + 1) * (y1 - y0 + 1);
+    }
+    return total;
+}
+
+// Buckets the chunk's sprites into its grid (counting sort, so a cell's entries are contiguous).
+void EndPickChunk(TilePicker *picker, Tilemap *map, int chunk) {
+    PickChunk *pick = picker->chunks + chunk;
+    pick->revision = map->chunk_revisions[chunk];
+
+    if (!pick->sprite_count) {
+        pick->bounds = {};
+        pick->grid_columns = 0;
+        pick->grid_rows = 0;
+        return;
+    }
+
+    f32 x0 = pick->sprites[0].bounds.x, y0 = pick->sprites[0].bounds.y;
+    f32 x1 = x0 + pick->sprites[0].bounds.width, y1 = y0 + pick->sprites[0].bounds.height;
+    for (int i = 1; i < pick->sprite_count; ++i) {
+        Rect b = pick->sprites[i].bounds;
+        x0 = Min(x0, b.x);
+        y0 = Min(y0, b.y);
+        x1 = Max(x1, b.x + b.width);
+        y1 = Max(y1, b.y + b.height);
+    }
+    pick->bounds = { x0, y0, x1 - x0, y1 - y0 };
+
+    // coarser cells until both the grid and its entries fit
+    f32 cell_size = PICK_CELL_SIZE;
+    int columns, rows;
+    while (columns = 0, CountPickEntries(pick, cell_size, &columns, &rows) > picker->max_entries || columns * rows > PICK_MAX_CELLS) {
+        cell_size *= 2;
+    }
+    pick->cell_size = cell_size;
+    pick->grid_columns = columns;
+    pick->grid_rows = rows;
+
+    int cell_count = columns * rows;
+    memset(pick->cell_offsets, 0, sizeof(int) * (cell_count + 1));
+
+    for (int pass = 0; pass < 2; ++pass) {
+        for (int i = 0; i < pick->sprite_count; ++i) {
+            Rect b = pick->sprites[i].bounds;
+            int cx0 = (int)((b.x - x0) / cell_size);
+            int cy0 = (int)((b.y - y0) / cell_size);
+            int cx1 = Min((int)((b.x + b.width - x0) / cell_size), columns - 1);
+            int cy1 = Min((int)((b.y + b.height - y0) / cell_size), rows - 1);
+
+            for (int cy = cy0; cy <= cy1; ++cy) {
+                for (int cx = cx0; cx <= cx1; ++cx) {
+                    int cell = cy * columns + cx;
+                    if (pass == 0) ++pick->cell_offsets[cell + 1];
+                    else pick->cell_entries[pick->cell_offsets[cell]++] = i;
+                }
+            }
+        }
+
+        if (pass == 0) {
+            for (int cell = 0; cell < cell_count; ++cell) pick->cell_offsets[cell + 1] += pick->cell_offsets[cell];
+        } else {
+            // the fill moved every offset to the start of the next cell, shift them back
+            for (int cell = cell_count; cell > 0; --cell) pick->cell_offsets[cell] = pick->cell_offsets[cell - 1];
+            pick->cell_offsets[0] = 0;
+        }
+    }
+}
+
+// The chunks whose sprites could cover a screen point: a sprite covers tiles behind its own, so
+// they're between the ground under the point and picker->reach tiles in front of it. Returns
+// how many were written.
+int GetPickCandidateChunks(TilePicker *picker, Tilemap *map, TileProjection *projection, v2 screen, int *chunks, int max_chunks) {
+    v2 ground = UnprojectTile(projection, screen, 0);
+    int min_x = (int)floorf(ground.x) - 1;
+    int min_y = (int)floorf(ground.y) - 1;
+    int max_x = (int)floorf(ground.x) + picker->reach + 1;
+    int max_y = (int)floorf(ground.y) + picker->reach + 1;
+
+    TileRange range = IntersectTileRanges({ min_x, min_y, max_x, max_y }, { 0, 0, map->columns - 1, map->rows - 1 });
+    if (IsTileRangeEmpty(range)) return 0;
+
+    int count = 0;
+    for (int cy = range.min_y / TILEMAP_CHUNK_SIZE; cy <= range.max_y / TILEMAP_CHUNK_SIZE; ++cy) {
+        for (int cx = range.min_x / TILEMAP_CHUNK_SIZE; cx <= range.max_x / TILEMAP_CHUNK_SIZE; ++cx) {
+            if (count == max_chunks) return count;
+            chunks[count++] = cy * map->chunk_columns + cx;
+        }
+    }
+    return count;
+}
+
+// The candidate chunks must be up to date (IsPickChunkStale).
+PickResult PickTile(TilePicker *picker, Tilemap *map, int ground_layer, TileProjection *projection, v2 screen, int *chunks, int chunk_count) {
+    PickResult result = PickGround(map, ground_layer, projection, screen);
+    v2 world = ScreenToPickWorld(projection, screen);
+
+    for (int i = 0; i < chunk_count; ++i) {
+        PickChunk *pick = picker->chunks + chunks[i];
+        if (!pick->sprite_count || !RectContains(pick->bounds, world)) continue;
+
+        int cx = Min((int)((world.x - pick->bounds.x) / pick->cell_size), pick->grid_columns - 1);
+        int cy = Min((int)((world.y - pick->bounds.y) / pick->cell_size), pick->grid_rows - 1);
+        int cell = cy * pick->grid_columns + cx;
+
+        for (int entry = pick->cell_offsets[cell]; entry < pick->cell_offsets[cell + 1]; ++entry) {
+            PickSprite *sprite = pick->sprites + pick->cell_entries[entry];
+            if ((result.hit && sprite->key <= result.key) || !RectContains(sprite->bounds, world)) continue;
+
+            result = { true, sprite->x, sprite->y, sprite->layer, GetTileHeight(map, sprite->x, sprite->y), sprite->key };
+        }
+    }
+
+    return result;
+}
+
+TileSelection CreateTileSelection(Arena *arena, Tilemap *map, int capacity) {
+    TileSelection result = {};
+    result.columns = map->columns;
+    result.capacity = capacity;
+    result.indices = (u32 *)ArenaAlloc(arena, sizeof(u32) * capacity);
+    result.bits = (u64 *)ArenaAlloc(arena, sizeof(u64) * ((map->columns * map->rows + 63) / 64));
+
+    return result;
+}
+
+b32 IsTileSelected(TileSelection *selection, int x, int y) {
+    u32 index = y * selection->columns + x;
+    b32 result = (selection->bits[index / 64] >> (index % 64)) & 1;
+    return result;
+}
+
+// Returns false when the selection is full.
+b32 SelectTile(TileSelection *selection, int x, int y) {
+    u32 index = y * selection->columns + x;
+    u64 bit = 1ull << (index % 64);
+    if (selection->bits[index / 64] & bit) return true;
+    if (selection->count == selection->capacity) return false;
+
+    selection->bits[index / 64] |= bit;
+    selection->indices[selection->count++] = index;
+    return true;
+}
+
+void ClearTileSelection(TileSelection *selection) {
+    for (int i = 0; i < selection->count; ++i) {
+        u32 index = selection->indices[i];
+        selection->bits[index / 64] &= ~(1ull << (index % 64));
+    }
+    selection->count = 0;
+}
+
+static b32 PolygonContains(v2 *points, int count, v2 p) {
+    b32 inside = false;
+    for (int i = 0, j = count - 1; i < count; j = i++) {
+        v2 a = points[i];
+        v2 b = points[j];
+        if ((a.y > p.y) != (b.y > p.y) && p.x < (b.x - a.x) * (p.y - a.y) / (b.y - a.y) + a.x) inside = !inside;
+    }
+    return inside;
+}
+
+// Where along a row (tile x) the line of centres starting at start and moving delta per tile is
+// inside [min, max] on both axes. False when it never is.
+static b32 ClipRowToBounds(v2 start, v2 delta, v2 min, v2 max, f32 *t0, f32 *t1) {
+    *t0 = -1e30f;
+    *t1 = 1e30f;
+    f32 starts[2] = { start.x, start.y };
+    f32 deltas[2] = { delta.x, delta.y };
+    f32 mins[2] = { min.x, min.y };
+    f32 maxs[2] = { max.x, max.y };
+
+    for (int axis = 0; axis < 2; ++axis) {
+        if (fabsf(deltas[axis]) < 1e-6f) {
+            if (starts[axis] < mins[axis] || starts[axis] > maxs[axis]) return false;
+            continue;
+        }
+        f32 a = (mins[axis] - starts[axis]) / deltas[axis];
+        f32 b = (maxs[axis] - starts[axis]) / deltas[axis];
+        f32 enter = Min(a, b);
+        f32 exit = Max(a, b);
+        *t0 = Max(*t0, enter);
+        *t1 = Min(*t1, exit);
+    }
+    return *t0 <= *t1;
+}
+
+// Selects the ground tiles whose top face centre is inside a screen space polygon. Returns how
+// many tiles were tested.
+int SelectTilesInPolygon(TileSelection *selection, Tilemap *map, int ground_layer, TileProjection *projection, v2 *points, int count) {
+    if (count < 3) return 0;
+
+    v2 min = points[0], max = points[0];
+    for (int i = 1; i < count; ++i) {
+        min.x = Min(min.x, points[i].x);
+        min.y = Min(min.y, points[i].y);
+        max.x = Max(max.x, points[i].x);
+        max.y = Max(max.y, points[i].y);
+    }
+
+    // rows any centre inside the bounds can be on, raised columns come from further down
+    v2 corners[] = {
+        UnprojectTile(projection, min, 0), UnprojectTile(projection, { max.x, min.y }, 0),
+        UnprojectTile(projection, { min.x, max.y }, (f32)map->max_height), UnprojectTile(projection, max, (f32)map->max_height),
+        UnprojectTile(projection, { min.x, max.y }, 0), UnprojectTile(projection, max, 0),
+    };
+    f32 min_row = corners[0].y, max_row = corners[0].y;
+    for (int i = 1; i < (int)ArrayCount(corners); ++i) {
+        min_row = Min(min_row, corners[i].y);
+        max_row = Max(max_row, corners[i].y);
+    }
+    int first_row = Max((int)floorf(min_row) - 1, 0);
+    int last_row = Min((int)floorf(max_row) + 1, map->rows - 1);
+
+    v2 delta = ProjectTile(projection, { 1, 0 }, 0) - ProjectTile(projection, { 0, 0 }, 0);
+    int tested = 0;
+
+    for (int y = first_row; y <= last_row; ++y) {
+        // the centres of this row at the lowest and the highest elevation
+        f32 t0, t1, u0, u1;
+        v2 low = ProjectTile(projection, { 0.5f, y + 0.5f }, 0);
+        v2 high = ProjectTile(projection, { 0.5f, y + 0.5f }, (f32)map->max_height);
+        b32 low_hit = ClipRowToBounds(low, delta, min, max, &t0, &t1);
+        b32 high_hit = ClipRowToBounds(high, delta, min, max, &u0, &u1);
+        if (!low_hit && !high_hit) continue;
+        if (!low_hit) { t0 = u0; t1 = u1; }
+        if (!high_hit) { u0 = t0; u1 = t1; }
+
+        int first = Max((int)floorf(Min(t0, u0)), 0);
+        int last = Min((int)ceilf(Max(t1, u1)), map->columns - 1);
+
+        for (int x = first; x <= last; ++x) {
+            int height = GetGroundHeight(map, ground_layer, x, y);
+            if (height < 0) continue;
+
+            ++tested;
+            v2 centre = ProjectTile(projection, { x + 0.5f, y + 0.5f }, (f32)height);
+            if (PolygonContains(points, count, centre) && !SelectTile(selection, x, y)) return tested;
+        }
+    }
+
+    return tested;
+}
+
+int SelectTilesInRect(TileSelection *selection, Tilemap *map, int ground_layer, TileProjection *projection, Rect rect) {
+    v2 points[] = {
+        { rect.x, rect.y },
+        { rect.x + rect.width, rect.y },
+        { rect.x + rect.width, rect.y + rect.height },
+        { rect.x, rect.y + rect.height },
+    };
+    return SelectTilesInPolygon(selection, map, ground_layer, projection, points, ArrayCount(points));
+}
+
+// Every column and sprite against the point, the front most (highest key) wins.
+static PickResult PickTileSlow(TilePicker *picker, Tilemap *map, int ground_layer, TileProjection *projection, v2 screen) {
+    PickResult result = {};
+    result.layer = -1;
+
+    // a column covers the point where the diagonal through its ground point crosses the column's
+    // cell no higher than the column is tall
+    f32 k = projection->elevation_step / (2 * projection->step);
+    v2 ground = UnprojectTile(projection, screen, 0);
+    for (int y = 0; y < map->rows; ++y) {
+        for (int x = 0; x < map->columns; ++x) {
+            int height = GetGroundHeight(map, ground_layer, x, y);
+            if (height < 0) continue;
+
+            f32 t0 = Max(x - ground.x, y - ground.y);
+            f32 t1 = Min(x + 1 - ground.x, y + 1 - ground.y);
+            if (t1 <= 0 || t0 > height * k || t0 >= t1) continue;
+
+            u32 key = IsoDepthKey(x, y, height, SpriteLayerGround);
+            if (!result.hit || key > result.key) result = { true, x, y, -1, height, key };
+        }
+    }
+
+    v2 world = ScreenToPickWorld(projection, screen);
+    for (int chunk = 0; chunk < picker->chunk_count; ++chunk) {
+        PickChunk *pick = picker->chunks + chunk;
+        for (int i = 0; i < pick->sprite_count; ++i) {
+            PickSprite *sprite = pick->sprites + i;
+            if ((result.hit && sprite->key <= result.key) || !RectContains(sprite->bounds, world)) continue;
+            result = { true, sprite->x, sprite->y, sprite->layer, GetTileHeight(map, sprite->x, sprite->y), sprite->key };
+        }
+    }
+
+    return result;
+}
+
+// CPU side only: picks random points, many of them off the map's top and left edges where tile
+// coordinates go negative, with the chunk grids and against every column and sprite.
+void BenchmarkPicking() {
+    const int size = 128;
+    const int point_count = 4000;
+    const f32 zoom = 0.25f;
+
+    Arena arena = CreateArena(Megabytes(16));
+    Tilemap map = CreateTilemap(&arena, size, size, 256, 192);
+    int ground = AddTilemapLayer(&map, &arena, 0, SpriteLayerGround, 64, false, 0);
+    int trees = AddTilemapLayer(&map, &arena, 0, SpriteLayerObject, 470, true, size * size);
+
+    // hills with a hole here and there, a tree on every ninth tile
+    u32 seed = 2024;
+    for (int y = 0; y < size; ++y) {
+        for (int x = 0; x < size; ++x) {
+            seed = seed * 1664525u + 1013904223u;
+            if ((seed >> 8) % 50 == 0) continue;
+
+            SetTile(&map, ground, x, y, MakeTile(0, 0));
+            SetTileHeight(&map, x, y, (x / 8 + y / 8) % 3 == 1 ? (int)((seed >> 16) % 5) : 0);
+            if ((seed >> 20) % 9 == 0) SetTile(&map, trees, x, y, MakeTile(0, 1));
+        }
+    }
+
+    TilePicker picker = CreateTilePicker(&arena, &map, TILEMAP_CHUNK_SIZE * TILEMAP_CHUNK_SIZE, 1);
+    for (int chunk = 0; chunk < picker.chunk_count; ++chunk) {
+        BeginPickChunk(&picker, chunk);
+        TileIterator it = IterateTiles(&map, trees, GetChunkTiles(&map, chunk));
+        while (NextTile(&it)) {
+            // a 256 x 512 sprite standing on the tile's top face, in world pixels
+            int height = GetTileHeight(&map, it.x, it.y);
+            f32 left = (it.x - it.y) * PICK_WORLD_HALF_WIDTH - PICK_WORLD_HALF_WIDTH;
+            f32 bottom = (it.x + it.y + 2) * PICK_WORLD_STEP - height * PICK_WORLD_STEP;
+            Rect bounds = { left, bottom - 512, 2 * PICK_WORLD_HALF_WIDTH, 512 };
+            AddPickSprite(&picker, chunk, bounds, it.x, it.y, trees, IsoDepthKey(it.x, it.y, height, SpriteLayerObject));
+        }
+        EndPickChunk(&picker, &map, chunk);
+    }
+
+    TileProjection projection = { { 900, 40 }, PICK_WORLD_HALF_WIDTH * zoom, PICK_WORLD_STEP * zoom, PICK_WORLD_STEP * zoom };
+
+    // the ground around tile (0, 0) is flat, so just off its top corner is tile (-1, -1), no tile at all
+    Assert(!PickGround(&map, ground, &projection, ProjectTile(&projection, { -0.5f, -0.5f }, 0)).hit);
+    Assert(!PickGround(&map, ground, &projection, ProjectTile(&projection, { -0.25f, 3.5f }, 0)).hit);
+
+    v2 *points = (v2 *)ArenaAlloc(&arena, sizeof(v2) * point_count);
+    for (int i = 0; i < point_count; ++i) {
+        seed = seed * 1664525u + 1013904223u;
+        f32 x = (f32)((seed >> 8) % (size + 16)) - 12 + ((seed >> 4) & 0xf) / 16.0f;
+        seed = seed * 1664525u + 1013904223u;
+        f32 y = (f32)((seed >> 8) % (size + 16)) - 12 + ((seed >> 4) & 0xf) / 16.0f;
+        points[i] = ProjectTile(&projection, { x + 0.03f, y + 0.07f }, 0);
+    }
+
+    int chunks[64];
+    int hits = 0, negative = 0, mismatches = 0;
+    double start = GetTime();
+    for (int i = 0; i < point_count; ++i) {
+        int chunk_count = GetPickCandidateChunks(&picker, &map, &projection, points[i], chunks, ArrayCount(chunks));
+        PickResult pick = PickTile(&picker, &map, ground, &projection, points[i], chunks, chunk_count);
+        hits += pick.hit;
+    }
+    double pick_seconds = GetTime() - start;
+
+    for (int i = 0; i < point_count; ++i) {
+        int chunk_count = GetPickCandidateChunks(&picker, &map, &projection, points[i], chunks, ArrayCount(chunks));
+        PickResult pick = PickTile(&picker, &map, ground, &projection, points[i], chunks, chunk_count);
+        PickResult expected = PickTileSlow(&picker, &map, ground, &projection, points[i]);
+        if (pick.hit != expected.hit || (pick.hit && (pick.x != expected.x || pick.y != expected.y || pick.layer != expected.layer))) ++mismatches;
+
+        v2 tile = UnprojectTile(&projection, points[i], 0);
+        negative += tile.x < 0 || tile.y < 0;
+    }
+
+    // a rect selection against testing every tile's top face centre
+    Rect rect = { 500, 300, 700, 400 };
+    TileSelection selection = CreateTileSelection(&arena, &map, size * size);
+    start = GetTime();
+    int tested = SelectTilesInRect(&selection, &map, ground, &projection, rect);
+    double select_seconds = GetTime() - start;
+
+    int selection_mismatches = 0, expected_count = 0;
+    for (int y = 0; y < size; ++y) {
+        for (int x = 0; x < size; ++x) {
+            int height = GetGroundHeight(&map, ground, x, y);
+            v2 centre = ProjectTile(&projection, { x + 0.5f, y + 0.5f }, (f32)height);
+            b32 inside = height >= 0 && RectContains(rect, centre);
+            expected_count += inside;
+            selection_mismatches += inside != IsTileSelected(&selection, x, y);
+        }
+    }
+
+    fprintf(stdout, "Picking: %d x %d, %d sprites reaching %d tiles back\n", size, size, map.layers[trees].tile_count, picker.reach);
+    fprintf(stdout, "  pick:   %7.3f us/point (%d of %d hit, %d off the top or left, %d mismatches)\n",
+            pick_seconds * 1e6 / point_count, hits, point_count, negative, mismatches);
+    fprintf(stdout, "  select: %7.3f ms for a %.0f x %.0f rect (%d selected, %d tested, %d mismatches)\n",
+            select_seconds * 1000, rect.width, rect.height, selection.count, tested, selection_mismatches);
+    Assert(mismatches == 0 && selection_mismatches == 0 && selection.count == expected_count);
+
+    free(arena.base_address);
+}
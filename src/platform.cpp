@@ -5,11 +5,116 @@
 //#include <GLFW/glfw3native.h>
 #include "platform.h"
 #include <iostream>
+#include <stdlib.h>
+#include <string.h>
+#include <chrono>
 
 static PlatformServiceContext platform;
 
-#include "glutil.cpp"
+#include "arena.cpp"
+#include "jobs.cpp"
+#include "profiler.cpp"
+#include "frame_stats.cpp"
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+// HOT_RELOAD builds the game as its own library (rpg.cpp with -DGAME_MODULE) and reloads it when
+// it changes on disk, otherwise it's compiled in.
+#ifdef HOT_RELOAD
+#ifdef _WIN32
+#ifndef GAME_MODULE_PATH
+#define GAME_MODULE_PATH "build/rpg.dll"
+#endif
+#define GAME_MODULE_LOADED_PATH "build/rpg_loaded.dll"
+#define GAME_MODULE_LOCK_PATH "build/lock.tmp"
+#else
+#include <dlfcn.h>
+#ifndef GAME_MODULE_PATH
+#define GAME_MODULE_PATH "build/librpg.so"
+#endif
+#endif
+#else
 #include "rpg.cpp"
+#endif
+
+#ifndef FRAME_LATENCY
+#define FRAME_LATENCY 1 // frames the simulation may run ahead of rendering, 0 runs them in series
+#endif
+
+#define FIXED_DELTA_TIME (1.0 / 60.0) // headless runs and input recordings
+
+struct GameCode {
+    void *library;
+    u64 write_time;
+
+    GameLoadFunction *Load;
+    GameInitFunction *Init;
+    GameUpdateFunction *Update;
+    GameRenderFunction *Render;
+    GameRunBenchmarksFunction *RunBenchmarks;
+};
+
+// Input gathered by the GLFW callbacks on the main thread. The simulation takes it at the start of
+// each of its frames, so it never calls GLFW itself.
+struct PendingInput {
+    std::mutex mutex;
+    InputEventQueue input_event_queue;
+    double cursor_x;
+    double cursor_y;
+    int framebuffer_width;
+    int framebuffer_height;
+    u8 keys[GLFW_KEY_LAST + 1];
+    u8 buttons[GLFW_MOUSE_BUTTON_LAST + 1];
+};
+
+// The simulation fills snapshots while the main thread draws older ones. With FRAME_LATENCY + 1
+// snapshots the simulation can be up to FRAME_LATENCY frames ahead.
+struct FramePipeline {
+    int snapshot_count; // the snapshots themselves live in game memory
+    u64 produced; // snapshots the simulation finished
+    u64 consumed; // snapshots the renderer finished
+    b32 quit;
+    double last_frame_time;
+    double fixed_delta_time; // used instead of the wall clock when set
+    std::thread simulation_thread;
+
+    std::mutex mutex;
+    std::condition_variable changed;
+};
+
+#define MAX_SCRIPTED_INPUT_EVENTS 4096
+
+// One line of a headless input script, applied at the start of the given frame.
+struct ScriptedInputEvent {
+    u64 frame;
+    InputEventType type;
+    int code; // key or button
+    int action;
+    double x;
+    double y;
+};
+
+struct InputScript {
+    int count;
+    int next;
+    ScriptedInputEvent events[MAX_SCRIPTED_INPUT_EVENTS];
+};
+
+static PendingInput pending_input;
+static FramePipeline pipeline;
+static GameCode game;
+static PlatformApi platform_api;
+
+#include "input_recording.cpp"
 
 void GLFWErrorCallback(int error, const char *desc);
 void GLFWKeyCallback(GLFWwindow *window, int key, int scancode, int action, int mods);
@@ -21,10 +126,77 @@ void GLFWFramebufferSizeCallback(GLFWwindow *window, int width, int height);
 
 bool InitRenderer();
 void PollEvents();
+void RunBenchmarks();
+int RunHeadless(u64 frame_count, const char *script_path);
+void InitPlatformMemory();
+bool BeginRecordingOrReplay(const char *record_path, const char *replay_path);
+void ExportLastProfileFrames(const char *path);
+void LoadPlatformApi(PlatformApi *api);
+void SimulationThread();
+void SimulateFrame(int snapshot);
+void StartSimulation();
+void StopSimulation();
+void LoadGameCode();
+void UnloadGameCode();
+u64 GetGameCodeWriteTime();
 void APIENTRY glDebugOutput(GLenum source, GLenum type, unsigned int id, GLenum severity,
                             GLsizei length, const char *message, const void *userParam);
 
-int main() {
+/*
+    Command line:
+        -headless           no window or GL context, simulate as fast as possible
+        -frames N           stop after N frames, headless only (0 runs until killed)
+        -input script.txt   scripted input for headless runs, see LoadInputScript
+        -record file        record the input of this run, see input_recording.cpp
+        -replay file        play a recording back instead of live input, headless runs stop at its end
+        -trace file         write the last frames' profile as Chrome trace JSON at exit
+        -stats              print a frame time summary every second
+        -stats-out file     write the frame time statistics at exit, .csv or .json
+        -hitch ms,ms,...    hitch thresholds, default 33.3,50,100
+*/
+int main(int argc, char **argv) {
+    b32 headless = false;
+    u64 frame_count = 0;
+    const char *script_path = 0;
+    const char *record_path = 0;
+    const char *replay_path = 0;
+    const char *trace_path = 0;
+    const char *stats_path = 0;
+    const char *hitch_thresholds = 0;
+    b32 print_stats = false;
+
+    for (int i = 1; i < argc; ++i) {
+        if (strcmp(argv[i], "-headless") == 0) headless = true;
+        else if (strcmp(argv[i], "-frames") == 0 && i + 1 < argc) frame_count = strtoull(argv[++i], 0, 10);
+        else if (strcmp(argv[i], "-input") == 0 && i + 1 < argc) script_path = argv[++i];
+        else if (strcmp(argv[i], "-record") == 0 && i + 1 < argc) record_path = argv[++i];
+        else if (strcmp(argv[i], "-replay") == 0 && i + 1 < argc) replay_path = argv[++i];
+        else if (strcmp(argv[i], "-trace") == 0 && i + 1 < argc) trace_path = argv[++i];
+        else if (strcmp(argv[i], "-stats") == 0) print_stats = true;
+        else if (strcmp(argv[i], "-stats-out") == 0 && i + 1 < argc) stats_path = argv[++i];
+        else if (strcmp(argv[i], "-hitch") == 0 && i + 1 < argc) hitch_thresholds = argv[++i];
+        else fprintf(stderr, "Unknown argument %s\n", argv[i]);
+    }
+
+    InitProfiler();
+    SetProfileThreadName("Main");
+    InitFrameStats(&frame_stats, hitch_thresholds, print_stats);
+    LoadPlatformApi(&platform_api);
+
+#ifdef BENCHMARK
+    RunBenchmarks();
+    return 0;
+#endif
+
+    // headless never touches GLFW, it runs where there is no display
+    if (headless) {
+        if (!BeginRecordingOrReplay(record_path, replay_path)) return -1;
+        int result = RunHeadless(frame_count, script_path);
+        FinishFrameStats(&frame_stats, stats_path);
+        if (trace_path) ExportLastProfileFrames(trace_path);
+        return result;
+    }
+
     if (!glfwInit()) return -1;
 
     glfwSetErrorCallback(GLFWErrorCallback);
@@ -43,6 +215,8 @@ int main() {
     }
 
     glfwGetFramebufferSize(platform.window, &platform.framebuffer_width, &platform.framebuffer_height);
+    pending_input.framebuffer_width = platform.framebuffer_width;
+    pending_input.framebuffer_height = platform.framebuffer_height;
 
     glfwSetKeyCallback(platform.window, GLFWKeyCallback);
     glfwSetMouseButtonCallback(platform.window, GLFWMouseButtonCallback);
@@ -52,35 +226,501 @@ int main() {
     glfwSetFramebufferSizeCallback(platform.window, GLFWFramebufferSizeCallback);
 
     glfwGetCursorPos(platform.window, &platform.cursor_x, &platform.cursor_y);
+    pending_input.cursor_x = platform.cursor_x;
+    pending_input.cursor_y = platform.cursor_y;
     glfwMakeContextCurrent(platform.window);
 
     if (!InitRenderer()) return -1;
 
-    platform.memory = malloc(Kilobytes(16));
-    memset(platform.memory, 0, Kilobytes(16));
+    InitPlatformMemory();
+
+    LoadGameCode();
+    if (!game.Load) return -1;
 
-    double last_frame_time = glfwGetTime();
+    Assert(FRAME_LATENCY <= MAX_FRAME_LATENCY);
+    pipeline.snapshot_count = FRAME_LATENCY + 1;
+    game.Init(pipeline.snapshot_count);
 
+    if (!BeginRecordingOrReplay(record_path, replay_path)) return -1;
+
+    // the simulation thread owns the job system (thread index 0) from here on, the main thread
+    // only draws and pumps events
+    pipeline.last_frame_time = GetTime();
+    StartSimulation();
+
+    double last_frame_start = GetTime();
     while (!glfwWindowShouldClose(platform.window)) {
-        double current_frame_time = glfwGetTime();
-        platform.delta_time = current_frame_time - last_frame_time;
-        last_frame_time = current_frame_time;
+        MarkProfileFrame();
+
+        double frame_start = GetTime();
+        RecordFrameTime(&frame_stats, frame_start - last_frame_start);
+        last_frame_start = frame_start;
+
+        int snapshot = 0;
 
-        UpdateAndRender();
+        if (FRAME_LATENCY) {
+            std::unique_lock<std::mutex> lock(pipeline.mutex);
+            pipeline.changed.wait(lock, []() { return pipeline.produced > pipeline.consumed; });
+            snapshot = (int)(pipeline.consumed % pipeline.snapshot_count);
+        } else {
+            SimulateFrame(snapshot);
+        }
+
+        {
+            ProfileBlock("Render");
+            game.Render(snapshot);
+        }
+        {
+            ProfileBlock("SwapBuffers");
+            glfwSwapBuffers(platform.window);
+        }
+
+        if (FRAME_LATENCY) {
+            {
+                std::lock_guard<std::mutex> lock(pipeline.mutex);
+                ++pipeline.consumed;
+            }
+            pipeline.changed.notify_all();
+        }
 
-        glfwSwapBuffers(platform.window);
         glfwPollEvents();
+
+#ifdef HOT_RELOAD
+        if (GetGameCodeWriteTime() != game.write_time) {
+            // nothing may be running module code while it's swapped, the simulation finishes its
+            // frame (and its jobs) first, snapshots already made stay valid
+            StopSimulation();
+            UnloadGameCode();
+            ClearProfiler(); // zone names pointed into the old module
+            LoadGameCode();
+            if (!game.Load) return -1;
+            StartSimulation();
+        }
+#endif
+    }
+
+    StopSimulation();
+    EndInputRecording(&input_recording);
+    FinishFrameStats(&frame_stats, stats_path);
+    if (trace_path) ExportLastProfileFrames(trace_path);
+    ShutdownJobSystem();
+}
+
+// As many complete frames as the history holds.
+void ExportLastProfileFrames(const char *path) {
+    u64 frame_count = GetProfileFrameCount();
+    if (frame_count < 2) return;
+
+    u64 last = frame_count - 1;
+    u64 first = last > PROFILE_FRAME_COUNT - 1 ? last - (PROFILE_FRAME_COUNT - 1) : 0;
+    ExportProfileTrace(path, first, last);
+}
+
+// Both switch the simulation to the fixed step, the recording's own for a replay.
+bool BeginRecordingOrReplay(const char *record_path, const char *replay_path) {
+    if (record_path && replay_path) {
+        fprintf(stderr, "Error: can't record and replay at the same time\n");
+        return false;
+    }
+
+    if (record_path) {
+        if (!BeginInputRecording(&input_recording, record_path, FIXED_DELTA_TIME)) return false;
+        pipeline.fixed_delta_time = FIXED_DELTA_TIME;
     }
+
+    if (replay_path) {
+        if (!BeginInputReplay(&input_recording, replay_path)) return false;
+        pipeline.fixed_delta_time = input_recording.header.fixed_delta_time;
+        fprintf(stdout, "Replaying %llu frames from %s\n", (unsigned long long)input_recording.header.frame_count, replay_path);
+    }
+
+    return true;
+}
+
+void InitPlatformMemory() {
+    platform.memory_size = Megabytes(64);
+    platform.memory = malloc(platform.memory_size);
+    memset(platform.memory, 0, platform.memory_size);
+
+    static Arena job_arena = CreateArena(sizeof(JobWorker) * GetCoreCount() + 64);
+    InitJobSystem(&job_arena, 0);
+}
+
+/*
+    Input script, one event per line, '#' starts a comment:
+        <frame> key <glfw key code> press|release
+        <frame> button <glfw button> press|release
+        <frame> cursor <x> <y>
+        <frame> scroll <x> <y>
+    Lines must be in frame order.
+*/
+bool LoadInputScript(const char *path, InputScript *script) {
+    size_t size = 0;
+    char *text = (char *)ReadEntireFile(path, &size);
+    if (!text) {
+        fprintf(stderr, "Error: unable to read input script %s\n", path);
+        return false;
+    }
+
+    script->count = 0;
+    script->next = 0;
+
+    int line_number = 0;
+    char line[256];
+    for (size_t at = 0; at < size;) {
+        // the file isn't null terminated, copy each line out
+        int length = 0;
+        while (at < size && text[at] != '\n') {
+            if (length < (int)sizeof(line) - 1) line[length++] = text[at];
+            ++at;
+        }
+        ++at;
+        line[length] = 0;
+        ++line_number;
+
+        char *comment = strchr(line, '#');
+        if (comment) *comment = 0;
+
+        char kind[16];
+        char action[16];
+        unsigned long long frame;
+        ScriptedInputEvent event = {};
+        int rest = 0; // where the kind's arguments start
+        int fields = sscanf(line, "%llu %15s%n", &frame, kind, &rest);
+        if (fields == EOF) continue; // blank or comment
+
+        bool valid = fields == 2;
+        char *arguments = line + rest;
+        event.frame = frame;
+        if (valid && strcmp(kind, "key") == 0) {
+            event.type = KeyEvent;
+            valid = sscanf(arguments, "%d %15s", &event.code, action) == 2;
+        } else if (valid && strcmp(kind, "button") == 0) {
+            event.type = MouseButtonEvent;
+            valid = sscanf(arguments, "%d %15s", &event.code, action) == 2;
+        } else if (valid && strcmp(kind, "cursor") == 0) {
+            event.type = CursorPositionEvent;
+            valid = sscanf(arguments, "%lf %lf", &event.x, &event.y) == 2;
+        } else if (valid && strcmp(kind, "scroll") == 0) {
+            event.type = MouseScrollEvent;
+            valid = sscanf(arguments, "%lf %lf", &event.x, &event.y) == 2;
+        } else {
+            valid = false;
+        }
+
+        if (valid && (event.type == KeyEvent || event.type == MouseButtonEvent)) {
+            if (strcmp(action, "press") == 0) event.action = GLFW_PRESS;
+            else if (strcmp(action, "release") == 0) event.action = GLFW_RELEASE;
+            else valid = false;
+        }
+
+        if (!valid) {
+            fprintf(stderr, "%s(%d): unable to parse input event\n", path, line_number);
+        } else if (script->count < MAX_SCRIPTED_INPUT_EVENTS) {
+            script->events[script->count++] = event;
+        }
+    }
+
+    free(text);
+    return true;
+}
+
+// Feeds the events for this frame through the same path as the GLFW callbacks.
+void FeedInputScript(InputScript *script, u64 frame) {
+    while (script->next < script->count && script->events[script->next].frame <= frame) {
+        ScriptedInputEvent *event = script->events + script->next++;
+        switch (event->type) {
+            case KeyEvent: GLFWKeyCallback(0, event->code, 0, event->action, 0); break;
+            case MouseButtonEvent: GLFWMouseButtonCallback(0, event->code, event->action, 0); break;
+            case CursorPositionEvent: GLFWCursorPosCallback(0, event->x, event->y); break;
+            case MouseScrollEvent: GLFWScrollCallback(0, event->x, event->y); break;
+            default: break;
+        }
+    }
+}
+
+// No window, no GL. The simulation runs serially on a fixed step as fast as it can and the
+// game's null renderer counts what it would have drawn.
+int RunHeadless(u64 frame_count, const char *script_path) {
+    static InputScript script;
+    if (script_path && !LoadInputScript(script_path, &script)) return -1;
+
+    platform.window = 0;
+    platform.framebuffer_width = pending_input.framebuffer_width = 1280;
+    platform.framebuffer_height = pending_input.framebuffer_height = 720;
+
+    InitPlatformMemory();
+
+    LoadGameCode();
+    if (!game.Load) return -1;
+
+    pipeline.snapshot_count = 1;
+    if (!pipeline.fixed_delta_time) pipeline.fixed_delta_time = FIXED_DELTA_TIME;
+    game.Init(pipeline.snapshot_count);
+
+    if (frame_count) fprintf(stdout, "Headless, %llu frames\n", (unsigned long long)frame_count);
+    else fprintf(stdout, "Headless\n");
+
+    double start = GetTime();
+    double last_frame_start = start;
+    for (u64 frame = 0; !frame_count || frame < frame_count; ++frame) {
+        if (input_recording.mode == InputRecordingReplay && input_recording.frame >= input_recording.header.frame_count) break;
+
+        MarkProfileFrame();
+        FeedInputScript(&script, frame);
+        SimulateFrame(0);
+        game.Render(0);
+
+        double frame_end = GetTime();
+        RecordFrameTime(&frame_stats, frame_end - last_frame_start);
+        last_frame_start = frame_end;
+    }
+    double seconds = GetTime() - start;
+
+    NullRendererStats *stats = &platform.null_renderer;
+    u64 frames = stats->frames ? stats->frames : 1;
+    fprintf(stdout, "%llu frames in %.3f s, %.1f frames/s, %.1f commands/frame, %.1f lines/frame\n",
+            (unsigned long long)stats->frames, seconds, stats->frames / seconds,
+            (double)stats->commands / frames, (double)stats->lines / frames);
+    fprintf(stdout, "Command checksum %016llx\n", (unsigned long long)stats->checksum);
+
+    EndInputRecording(&input_recording);
+    ShutdownJobSystem();
+    return 0;
+}
+
+#ifdef HOT_RELOAD
+u64 GetGameCodeWriteTime() {
+    u64 result = 0;
+#ifdef _WIN32
+    WIN32_FILE_ATTRIBUTE_DATA data;
+    // still being written while the build holds the lock
+    if (GetFileAttributesExA(GAME_MODULE_LOCK_PATH, GetFileExInfoStandard, &data)) return game.write_time;
+    if (GetFileAttributesExA(GAME_MODULE_PATH, GetFileExInfoStandard, &data)) {
+        result = ((u64)data.ftLastWriteTime.dwHighDateTime << 32) | data.ftLastWriteTime.dwLowDateTime;
+    }
+#else
+    struct stat info;
+    if (stat(GAME_MODULE_PATH, &info) == 0) result = (u64)info.st_mtime;
+#endif
+    return result;
+}
+
+void LoadGameCode() {
+    game = {};
+    game.write_time = GetGameCodeWriteTime();
+
+#ifdef _WIN32
+    // load a copy so the build can overwrite the original
+    CopyFileA(GAME_MODULE_PATH, GAME_MODULE_LOADED_PATH, FALSE);
+    HMODULE library = LoadLibraryA(GAME_MODULE_LOADED_PATH);
+    if (library) {
+        game.library = library;
+        game.Load = (GameLoadFunction *)GetProcAddress(library, "GameLoad");
+        game.Init = (GameInitFunction *)GetProcAddress(library, "GameInit");
+        game.Update = (GameUpdateFunction *)GetProcAddress(library, "GameUpdate");
+        game.Render = (GameRenderFunction *)GetProcAddress(library, "GameRender");
+        game.RunBenchmarks = (GameRunBenchmarksFunction *)GetProcAddress(library, "GameRunBenchmarks");
+    }
+#else
+    void *library = dlopen(GAME_MODULE_PATH, RTLD_NOW | RTLD_LOCAL);
+    if (library) {
+        game.library = library;
+        game.Load = (GameLoadFunction *)dlsym(library, "GameLoad");
+        game.Init = (GameInitFunction *)dlsym(library, "GameInit");
+        game.Update = (GameUpdateFunction *)dlsym(library, "GameUpdate");
+        game.Render = (GameRenderFunction *)dlsym(library, "GameRender");
+        game.RunBenchmarks = (GameRunBenchmarksFunction *)dlsym(library, "GameRunBenchmarks");
+    } else {
+        fprintf(stderr, "Error: %s\n", dlerror());
+    }
+#endif
+
+    if (!game.Load || !game.Init || !game.Update || !game.Render || !game.RunBenchmarks) {
+        fprintf(stderr, "Error: unable to load game code from %s\n", GAME_MODULE_PATH);
+        game.Load = 0;
+        return;
+    }
+
+    game.Load(&platform, &platform_api);
+    fprintf(stdout, "Loaded game code %s\n", GAME_MODULE_PATH);
+}
+
+void UnloadGameCode() {
+    if (game.library) {
+#ifdef _WIN32
+        FreeLibrary((HMODULE)game.library);
+#else
+        dlclose(game.library);
+#endif
+    }
+    game = {};
+}
+#else
+void LoadGameCode() {
+    game = {};
+    game.Load = GameLoad;
+    game.Init = GameInit;
+    game.Update = GameUpdate;
+    game.Render = GameRender;
+    game.RunBenchmarks = GameRunBenchmarks;
+
+    game.Load(&platform, &platform_api);
+}
+#endif
+
+void LoadPlatformApi(PlatformApi *api) {
+    api->GetTime = GetTime;
+    api->GetWindowFramebufferSize = GetWindowFramebufferSize;
+    api->GetNextInputEvent = GetNextInputEvent;
+    api->IsButtonPressed = IsButtonPressed;
+    api->IsKeyPressed = IsKeyPressed;
+    api->MapFile = MapFile;
+    api->UnmapFile = UnmapFile;
+
+    api->GetCoreCount = GetCoreCount;
+    api->InitJobSystem = InitJobSystem;
+    api->ShutdownJobSystem = ShutdownJobSystem;
+    api->GetJobThreadIndex = GetJobThreadIndex;
+    api->GetJobThreadCount = GetJobThreadCount;
+    api->RunJob = RunJob;
+    api->ParallelFor = ParallelFor;
+    api->ParallelForAndWait = ParallelFor;
+    api->WaitForCounter = WaitForCounter;
+
+    api->RecordProfileZone = RecordProfileZone;
+    api->RecordGpuProfileZone = RecordGpuProfileZone;
+    api->GetProfileFrameCount = GetProfileFrameCount;
+    api->GetProfileSummary = GetProfileSummary;
+    api->ExportProfileTrace = ExportProfileTrace;
+
+    api->GetFrameStats = GetFrameStats;
+}
+
+// Hands the input gathered since the last call to the simulation.
+void TakeFrameInput() {
+    std::lock_guard<std::mutex> lock(pending_input.mutex);
+
+    platform.input_event_queue = pending_input.input_event_queue;
+    pending_input.input_event_queue.count = 0;
+
+    platform.cursor_x = pending_input.cursor_x;
+    platform.cursor_y = pending_input.cursor_y;
+    platform.framebuffer_width = pending_input.framebuffer_width;
+    platform.framebuffer_height = pending_input.framebuffer_height;
+    memcpy(platform.keys, pending_input.keys, sizeof(platform.keys));
+    memcpy(platform.buttons, pending_input.buttons, sizeof(platform.buttons));
+}
+
+void SimulateFrame(int snapshot) {
+    ProfileFunction();
+
+    if (pipeline.fixed_delta_time) {
+        platform.delta_time = pipeline.fixed_delta_time;
+    } else {
+        double current_frame_time = GetTime();
+        platform.delta_time = current_frame_time - pipeline.last_frame_time;
+        pipeline.last_frame_time = current_frame_time;
+    }
+
+    if (input_recording.mode == InputRecordingReplay) {
+        if (ReplayFrameInput(&input_recording, &platform)) {
+            // live input is still gathered, just not used
+            std::lock_guard<std::mutex> lock(pending_input.mutex);
+            pending_input.input_event_queue.count = 0;
+        } else {
+            // out of recording, back to live input on the wall clock
+            EndInputRecording(&input_recording);
+            if (platform.window) pipeline.fixed_delta_time = 0;
+            pipeline.last_frame_time = GetTime();
+            TakeFrameInput();
+        }
+    } else {
+        TakeFrameInput();
+    }
+
+    if (input_recording.mode == InputRecordingRecord) RecordFrameInput(&input_recording, &platform);
+
+    game.Update(snapshot);
+}
+
+void SimulationThread() {
+    SetProfileThreadName("Simulation");
+
+    for (;;) {
+        int snapshot;
+        {
+            // wait for a snapshot the renderer is done with
+            std::unique_lock<std::mutex> lock(pipeline.mutex);
+            pipeline.changed.wait(lock, []() { return pipeline.quit || pipeline.produced - pipeline.consumed < (u64)pipeline.snapshot_count; });
+            if (pipeline.quit) break;
+
+            snapshot = (int)(pipeline.produced % pipeline.snapshot_count);
+        }
+
+        SimulateFrame(snapshot);
+
+        {
+            std::lock_guard<std::mutex> lock(pipeline.mutex);
+            ++pipeline.produced;
+        }
+        pipeline.changed.notify_all();
+    }
+
+    ReleaseProfileThread();
+}
+
+void StartSimulation() {
+    if (FRAME_LATENCY) {
+        pipeline.quit = false;
+        pipeline.simulation_thread = std::thread(SimulationThread);
+    }
+}
+
+// Returns once the simulation thread is out of the game code.
+void StopSimulation() {
+    if (FRAME_LATENCY) {
+        {
+            std::lock_guard<std::mutex> lock(pipeline.mutex);
+            pipeline.quit = true;
+        }
+        pipeline.changed.notify_all();
+        pipeline.simulation_thread.join();
+    }
+}
+
+void RunBenchmarks() {
+    BenchmarkJobs();
+    BenchmarkProfiler();
+
+    LoadGameCode();
+    if (game.RunBenchmarks) game.RunBenchmarks();
 }
 
 void RegisterInputEvent(InputEvent *event) {
-    if (platform.input_event_queue.count < ArrayCount(InputEventQueue::events)) {
-        platform.input_event_queue.events[platform.input_event_queue.count++] = *event;
+    std::lock_guard<std::mutex> lock(pending_input.mutex);
+    InputEventQueue *queue = &pending_input.input_event_queue;
+
+    if (queue->count < ArrayCount(InputEventQueue::events)) {
+        queue->events[queue->count++] = *event;
     } else {
-        for (int i = 0; i < ArrayCount(platform.input_event_queue.events) - 1; ++i) {
-            platform.input_event_queue.events[i] = platform.input_event_queue.events[i + 1];
+        for (int i = 0; i < ArrayCount(queue->events) - 1; ++i) {
+            queue->events[i] = queue->events[i + 1];
         }
-        platform.input_event_queue.events[platform.input_event_queue.count - 1] = *event;
+        queue->events[queue->count - 1] = *event;
+    }
+
+    if (event->type == KeyEvent && event->key >= 0 && event->key <= GLFW_KEY_LAST) {
+        pending_input.keys[event->key] = event->action != GLFW_RELEASE;
+    }
+
+    if (event->type == MouseButtonEvent && event->button >= 0 && event->button <= GLFW_MOUSE_BUTTON_LAST) {
+        pending_input.buttons[event->button] = event->action != GLFW_RELEASE;
+    }
+
+    if (event->type == CursorPositionEvent) {
+        pending_input.cursor_x = event->x;
+        pending_input.cursor_y = event->y;
     }
 }
 
@@ -132,16 +772,14 @@ void GLFWCursorPosCallback(GLFWwindow *window, double xpos, double ypos) {
     event.x = xpos;
     event.y = ypos;
 
-    event.dx = xpos - platform.cursor_x;
-    event.dy = ypos - platform.cursor_y;
+    // only the main thread writes the pending cursor
+    event.dx = xpos - pending_input.cursor_x;
+    event.dy = ypos - pending_input.cursor_y;
 
     event.device = InputDevice::Mouse;
     event.type = InputEventType::CursorPositionEvent;
 
     RegisterInputEvent(&event);
-
-    platform.cursor_x = xpos;
-    platform.cursor_y = ypos;
 }
 
 void GLFWCursorEnterCallback(GLFWwindow *window, int entered) {
@@ -164,8 +802,11 @@ void GLFWScrollCallback(GLFWwindow *window, double x, double y) {
 }
 
 void GLFWFramebufferSizeCallback(GLFWwindow *window, int width, int height) {
-    platform.framebuffer_width = width;
-    platform.framebuffer_height = height;
+    {
+        std::lock_guard<std::mutex> lock(pending_input.mutex);
+        pending_input.framebuffer_width = width;
+        pending_input.framebuffer_height = height;
+    }
 
     glViewport(0, 0, width, height);
 }
@@ -236,6 +877,57 @@ void *ReadEntireFile(const char *filename, size_t *count) {
     return result;
 }
 
+// Read only, the pages are loaded as they're touched and can be read from any thread.
+bool MapFile(const char *filename, MappedFile *file) {
+    *file = {};
+
+#ifdef _WIN32
+    HANDLE handle = CreateFileA(filename, GENERIC_READ, FILE_SHARE_READ, 0, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, 0);
+    if (handle == INVALID_HANDLE_VALUE) return false;
+
+    LARGE_INTEGER size;
+    HANDLE mapping = 0;
+    if (GetFileSizeEx(handle, &size) && size.QuadPart) mapping = CreateFileMappingA(handle, 0, PAGE_READONLY, 0, 0, 0);
+    CloseHandle(handle); // the mapping keeps the file open
+    if (!mapping) return false;
+
+    file->data = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+    if (!file->data) {
+        CloseHandle(mapping);
+        return false;
+    }
+    file->size = (u64)size.QuadPart;
+    file->handle = mapping;
+#else
+    int fd = open(filename, O_RDONLY);
+    if (fd < 0) return false;
+
+    struct stat info;
+    void *data = MAP_FAILED;
+    if (fstat(fd, &info) == 0 && info.st_size) data = mmap(0, info.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd); // so does the mapping
+    if (data == MAP_FAILED) return false;
+
+    file->data = data;
+    file->size = (u64)info.st_size;
+#endif
+
+    return true;
+}
+
+void UnmapFile(MappedFile *file) {
+    if (!file->data) return;
+
+#ifdef _WIN32
+    UnmapViewOfFile(file->data);
+    CloseHandle(file->handle);
+#else
+    munmap(file->data, file->size);
+#endif
+
+    *file = {};
+}
+
 bool InitRenderer() {
     GLenum err = glewInit();
     if (err != GLEW_OK) {
@@ -261,20 +953,28 @@ bool InitRenderer() {
     glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
     glClearColor(0, 0, 0, 1);
 
-    InitializeUtilBuffers();
-
     return true;
 }
 
+// The size as of the simulation frame's TakeFrameInput, also valid headless.
 void GetWindowFramebufferSize(int *width, int *height) {
-    glfwGetFramebufferSize(platform.window, width, height);
+    *width = platform.framebuffer_width;
+    *height = platform.framebuffer_height;
 }
 
+// Button and key state as of the simulation frame's TakeFrameInput.
 bool IsButtonPressed(int button) {
-    return glfwGetMouseButton(platform.window, button) == GLFW_PRESS;
+    return platform.buttons[button] != 0;
 }
 
 bool IsKeyPressed(int key) {
-    bool result = glfwGetKey(platform.window, key) == GLFW_PRESS;
+    bool result = platform.keys[key] != 0;
     return result;
 }
+
+// Steady clock instead of glfwGetTime so it works before glfwInit and headless.
+double GetTime() {
+    static std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+    return elapsed.count();
+}
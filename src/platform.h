@@ -1,5 +1,11 @@
 #include "stdint.h"
 #include "stdio.h"
+#include <atomic>
+#ifdef _MSC_VER
+#include <intrin.h>
+#else
+#include <x86intrin.h>
+#endif
 
 typedef int b32;
 typedef uint8_t  u8;
@@ -16,6 +22,7 @@ typedef float f32;
 #define Min(a, b) a < b ? a : b
 #define Max(a, b) a > b ? a : b
 #define U32_MAX -(u32)1;
+#define AlignUp(value, alignment) (((value) + ((alignment) - 1)) & ~((alignment) - 1))
 
 #define Assert(expression) if (!(expression)) { *(int *)0 = 0; }
 
@@ -54,17 +61,29 @@ struct InputEventQueue {
     InputEvent events[10];
 };
 
+// Filled by the game's null renderer in headless runs.
+struct NullRendererStats {
+    u64 frames;
+    u64 commands;
+    u64 lines;
+    u64 checksum; // of the submitted commands, compares replays
+};
+
 struct PlatformServiceContext {
-    GLFWwindow *window;
+    GLFWwindow *window; // null when headless
     double delta_time;
     double cursor_x;
     double cursor_y;
     InputEventQueue input_event_queue;
     int framebuffer_width;
     int framebuffer_height;
+    u8 keys[GLFW_KEY_LAST + 1];
+    u8 buttons[GLFW_MOUSE_BUTTON_LAST + 1];
 
     void *memory;
     u64 memory_size;
+
+    NullRendererStats null_renderer;
 };
 
 void RegisterInputEvent(InputEvent *event);
@@ -74,6 +93,16 @@ void GetWindowFramebufferSize(int *width, int *height);
 bool IsButtonPressed(int button);
 bool IsKeyPressed(int key);
 double GetFrameTime();
+double GetTime();
+
+struct MappedFile {
+    void *data;
+    u64 size;
+    void *handle; // the mapping object on Windows
+};
+
+bool MapFile(const char *filename, MappedFile *file);
+void UnmapFile(MappedFile *file);
 
 struct Arena {
     void *base_address;
@@ -82,4 +111,156 @@ struct Arena {
 };
 
 void *ScratchAlloc(u64 count);
+void *ArenaAlloc(Arena *arena, u64 count);
+void *ArenaAllocAligned(Arena *arena, u64 count, u64 alignment);
 Arena CreateArena(u64 size);
+
+// Job system (jobs.cpp). The game module reaches it through PlatformApi.
+#define MAX_WORKER_THREADS 64
+
+typedef void JobFunction(void *data, int first, int one_past_last);
+
+struct JobCounter {
+    std::atomic<int> value;
+};
+
+int GetCoreCount();
+void InitJobSystem(Arena *arena, int thread_count);
+void ShutdownJobSystem();
+int GetJobThreadIndex();
+int GetJobThreadCount();
+void RunJob(JobFunction *function, void *data, JobCounter *counter, JobCounter *dependency = 0);
+void ParallelFor(JobFunction *function, void *data, int count, int batch_size, JobCounter *counter, JobCounter *dependency = 0);
+void ParallelFor(JobFunction *function, void *data, int count, int batch_size);
+void WaitForCounter(JobCounter *counter);
+
+// 1, 2, 4, ... and finally max_threads
+inline int GetNextBenchmarkThreadCount(int thread_count, int max_threads) {
+    if (thread_count >= max_threads) return max_threads + 1;
+    return thread_count * 2 < max_threads ? thread_count * 2 : max_threads;
+}
+
+// Profiler (profiler.cpp). Zones are timed with the TSC and written to a ring owned by the
+// calling thread, ProfileBlock costs two rdtsc and one 24 byte store. Define NO_PROFILER to
+// compile them out.
+#define MAX_PROFILE_THREADS (MAX_WORKER_THREADS + 2)
+#define MAX_PROFILE_SUMMARY_ZONES 256
+
+inline u64 ReadTimestamp() {
+    return __rdtsc();
+}
+
+void RecordProfileZone(const char *name, u64 start, u64 end);
+
+struct ProfileZone {
+    const char *name;
+    u64 start;
+
+    ProfileZone(const char *zone_name) {
+        name = zone_name;
+        start = ReadTimestamp();
+    }
+
+    ~ProfileZone() {
+        RecordProfileZone(name, start, ReadTimestamp());
+    }
+};
+
+#define ProfileConcat_(a, b) a##b
+#define ProfileConcat(a, b) ProfileConcat_(a, b)
+#ifdef NO_PROFILER
+#define ProfileBlock(name)
+#else
+#define ProfileBlock(name) ProfileZone ProfileConcat(profile_zone_, __LINE__)(name)
+#endif
+#define ProfileFunction() ProfileBlock(__FUNCTION__)
+
+// One frame's zones merged by call path, depth first per thread. Sibling zones with the same
+// name (job batches, calls in a loop) are one entry with a count.
+struct ProfileSummaryZone {
+    const char *name;
+    int thread;
+    int depth;
+    u32 count;
+    double start_ms; // first start, relative to the frame
+    double ms; // total
+};
+
+struct ProfileSummary {
+    u64 frame;
+    double frame_ms;
+    int thread_count;
+    const char *thread_names[MAX_PROFILE_THREADS];
+    int zone_count;
+    ProfileSummaryZone zones[MAX_PROFILE_SUMMARY_ZONES];
+};
+
+void RecordGpuProfileZone(const char *name, double start, double end);
+void SetProfileThreadName(const char *name);
+void ReleaseProfileThread();
+void MarkProfileFrame();
+u64 GetProfileFrameCount();
+bool GetProfileSummary(ProfileSummary *summary, u64 frame);
+bool ExportProfileTrace(const char *path, u64 first_frame, u64 one_past_last_frame);
+
+// Frame time statistics (frame_stats.cpp), the game draws the graph.
+#define FRAME_STATS_HISTORY 256
+
+struct FrameStatsView {
+    int frame_count;
+    f32 frame_ms[FRAME_STATS_HISTORY]; // oldest first
+    f32 p50_ms; // of the last full second
+    f32 p95_ms;
+    f32 p99_ms;
+    f32 max_ms;
+    f32 hitch_ms; // lowest hitch threshold
+};
+
+void GetFrameStats(FrameStatsView *view);
+
+#define MAX_FRAME_LATENCY 3
+
+// Platform services the game module calls back into. The game links nothing but GL.
+struct PlatformApi {
+    double (*GetTime)();
+    void (*GetWindowFramebufferSize)(int *width, int *height);
+    bool (*GetNextInputEvent)(InputEvent *event);
+    bool (*IsButtonPressed)(int button);
+    bool (*IsKeyPressed)(int key);
+    bool (*MapFile)(const char *filename, MappedFile *file);
+    void (*UnmapFile)(MappedFile *file);
+
+    int (*GetCoreCount)();
+    void (*InitJobSystem)(Arena *arena, int thread_count);
+    void (*ShutdownJobSystem)();
+    int (*GetJobThreadIndex)();
+    int (*GetJobThreadCount)();
+    void (*RunJob)(JobFunction *function, void *data, JobCounter *counter, JobCounter *dependency);
+    void (*ParallelFor)(JobFunction *function, void *data, int count, int batch_size, JobCounter *counter, JobCounter *dependency);
+    void (*ParallelForAndWait)(JobFunction *function, void *data, int count, int batch_size);
+    void (*WaitForCounter)(JobCounter *counter);
+
+    void (*RecordProfileZone)(const char *name, u64 start, u64 end);
+    void (*RecordGpuProfileZone)(const char *name, double start, double end);
+    u64 (*GetProfileFrameCount)();
+    bool (*GetProfileSummary)(ProfileSummary *summary, u64 frame);
+    bool (*ExportProfileTrace)(const char *path, u64 first_frame, u64 one_past_last_frame);
+
+    void (*GetFrameStats)(FrameStatsView *view);
+};
+
+// Game module entry points. Snapshots are referred to by index, the game owns them.
+#define GAME_LOAD(name) void name(PlatformServiceContext *context, PlatformApi *api)
+typedef GAME_LOAD(GameLoadFunction);
+
+#define GAME_INIT(name) void name(int snapshot_count)
+typedef GAME_INIT(GameInitFunction);
+
+#define GAME_UPDATE(name) void name(int snapshot)
+typedef GAME_UPDATE(GameUpdateFunction);
+
+#define GAME_RENDER(name) void name(int snapshot)
+typedef GAME_RENDER(GameRenderFunction);
+
+#define GAME_RUN_BENCHMARKS(name) void name()
+typedef GAME_RUN_BENCHMARKS(GameRunBenchmarksFunction);
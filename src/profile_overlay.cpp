@@ -0,0 +1,169 @@
+/*
+    Profiler overlay, frame time graph and their hotkeys.
+
+        F1  toggle the overlay: one frame as one bar per call path, indented by depth and grouped
+            by thread, 400 px per 16.6 ms, labelled with name and ms when the debug font loaded.
+            It trails by GPU_QUERY_FRAMES so the GPU passes are in
+        F2  print the same tree to stdout
+        F3  write the last PROFILE_EXPORT_FRAMES frames to profile.json (Chrome trace_event)
+        F4  toggle the frame time graph: the last FRAME_STATS_HISTORY frames bottom left, with the
+            16.6 ms budget, the hitch threshold and the last second's p99 as lines, the last
+            second's percentiles printed above it
+*/
+
+#define PROFILE_EXPORT_FRAMES 120
+#define PROFILE_OVERLAY_PIXELS_PER_MS (400.0f / 16.6f)
+#define PROFILE_OVERLAY_LABEL_WIDTH 300 // name and time column left of the bars
+#define FRAME_GRAPH_PIXELS_PER_MS 4.0f
+#define FRAME_GRAPH_BAR_WIDTH 2
+
+static void PrintProfileSummary(ProfileSummary *summary) {
+    fprintf(stdout, "frame %llu: %.2f ms\n", (unsigned long long)summary->frame, summary->frame_ms);
+
+    int thread = -1;
+    for (int i = 0; i < summary->zone_count; ++i) {
+        ProfileSummaryZone *zone = summary->zones + i;
+        if (zone->thread != thread) {
+            thread = zone->thread;
+            const char *name = summary->thread_names[thread];
+            fprintf(stdout, "  [%d] %s\n", thread, name ? name : "Thread");
+        }
+
+        fprintf(stdout, "    %*s%-*s %8.3f ms", zone->depth * 2, "", 40 - zone->depth * 2, zone->name, zone->ms);
+        if (zone->count > 1) fprintf(stdout, "  x%u", zone->count);
+        fprintf(stdout, "\n");
+    }
+}
+
+// Simulation thread, on key presses.
+void HandleProfilerKey(b32 *show_profiler, b32 *show_frame_graph, int key) {
+    u64 frame_count = GetProfileFrameCount();
+
+    if (key == GLFW_KEY_F1) {
+        *show_profiler = !*show_profiler;
+    } else if (key == GLFW_KEY_F4) {
+        *show_frame_graph = !*show_frame_graph;
+    } else if (key == GLFW_KEY_F2 && frame_count >= 2 + GPU_QUERY_FRAMES) {
+        ProfileSummary summary;
+        if (GetProfileSummary(&summary, frame_count - 2 - GPU_QUERY_FRAMES)) PrintProfileSummary(&summary);
+    } else if (key == GLFW_KEY_F3 && frame_count >= 2) {
+        u64 last = frame_count - 1;
+        u64 first = last > PROFILE_EXPORT_FRAMES ? last - PROFILE_EXPORT_FRAMES : 0;
+        ExportProfileTrace("profile.json", first, last);
+    }
+}
+
+static v4 GetProfileZoneColor(const char *name) {
+    u32 hash = 2166136261u;
+    for (const char *c = name; *c; ++c) hash = (hash ^ (u8)*c) * 16777619u;
+
+    v4 result = { 0.3f + 0.6f * ((hash >> 0) & 0xff) / 255.0f,
+                  0.3f + 0.6f * ((hash >> 8) & 0xff) / 255.0f,
+                  0.3f + 0.6f * ((hash >> 16) & 0xff) / 255.0f,
+                  0.85f };
+    return result;
+}
+
+// Main thread, inside RenderGame. Text goes into the debug font's batch, flushed by the caller.
+void DrawProfileOverlay() {
+    ProfileFunction();
+
+    static ProfileSummary summary;
+    u64 frame_count = GetProfileFrameCount();
+    if (frame_count < 2 + GPU_QUERY_FRAMES || !GetProfileSummary(&summary, frame_count - 2 - GPU_QUERY_FRAMES)) return;
+
+    Font *font = GetDebugFont();
+    v4 text_color = v4(1, 1, 1, 0.9f);
+
+    // call paths and times in a column left of the bars when there's a font to print them with
+    int left = 10;
+    int top = 10;
+    int row_height = font->loaded ? (int)font->line_height : 6;
+    int label_width = font->loaded ? PROFILE_OVERLAY_LABEL_WIDTH : 0;
+    int bars_left = left + label_width;
+    int budget_width = (int)(16.6f * PROFILE_OVERLAY_PIXELS_PER_MS);
+
+    // whole frame against the 60 Hz budget
+    v4 frame_color = summary.frame_ms <= 16.7 ? v4(0.2f, 0.8f, 0.2f, 0.85f) :
+                     summary.frame_ms <= 33.4 ? v4(0.9f, 0.8f, 0.1f, 0.85f) : v4(0.9f, 0.2f, 0.2f, 0.85f);
+    DrawRectangle(bars_left, bars_left + (int)(summary.frame_ms * PROFILE_OVERLAY_PIXELS_PER_MS), top, top + row_height, frame_color);
+    DrawRectangle(bars_left + budget_width, bars_left + budget_width + 1, top - 4, top + row_height + 4, v4(1));
+    PushTextFormat(font, (f32)left, (f32)top, text_color, "frame %llu %8.3f ms", (unsigned long long)summary.frame, summary.frame_ms);
+    top += row_height + 6;
+
+    int fb_width, fb_height;
+    GetWindowFramebufferSize(&fb_width, &fb_height);
+
+    int thread = -1;
+    for (int i = 0; i < summary.zone_count && top + row_height < fb_height; ++i) {
+        ProfileSummaryZone *zone = summary.zones + i;
+        if (zone->thread != thread) {
+            if (thread >= 0) top += 4;
+            thread = zone->thread;
+            DrawRectangle(left, bars_left + budget_width, top, top + 1, v4(0.5f, 0.5f, 0.5f, 0.85f));
+            top += 3;
+
+            if (font->loaded) {
+                const char *name = summary.thread_names[thread];
+                PushText(font, (f32)left, (f32)top, name ? name : "Thread", v4(0.6f, 0.8f, 1, 0.9f));
+                top += row_height;
+            }
+        }
+
+        int x = bars_left + zone->depth * 8;
+        int width = (int)(zone->ms * PROFILE_OVERLAY_PIXELS_PER_MS);
+        DrawRectangle(x, x + (width > 1 ? width : 1), top, top + row_height - 1, GetProfileZoneColor(zone->name));
+
+        if (font->loaded) {
+            // name indented by depth, time right aligned against the bars
+            PushText(font, (f32)(left + 8 + zone->depth * 8), (f32)top, zone->name, text_color);
+            char ms[32];
+            snprintf(ms, sizeof(ms), zone->count > 1 ? "%.3f x%u" : "%.3f", zone->ms, zone->count);
+            PushText(font, bars_left - 8 - MeasureText(font, ms), (f32)top, ms, text_color);
+        }
+        top += row_height;
+    }
+}
+
+// Main thread, inside RenderGame. Text goes into the debug font's batch, flushed by the caller.
+void DrawFrameTimeGraph() {
+    ProfileFunction();
+
+    static FrameStatsView stats;
+    GetFrameStats(&stats);
+
+    int fb_width, fb_height;
+    GetWindowFramebufferSize(&fb_width, &fb_height);
+
+    int left = 10;
+    int bottom = fb_height - 10;
+    int right = left + FRAME_STATS_HISTORY * FRAME_GRAPH_BAR_WIDTH;
+    int top = bottom - (int)(50.0f * FRAME_GRAPH_PIXELS_PER_MS); // clipped at 50 ms
+
+    DrawRectangle(left, right, top, bottom, v4(0, 0, 0, 0.5f));
+
+    for (int i = 0; i < stats.frame_count; ++i) {
+        f32 ms = stats.frame_ms[i];
+        v4 color = ms <= 16.7f ? v4(0.2f, 0.8f, 0.2f, 0.9f) :
+                   ms <= stats.hitch_ms ? v4(0.9f, 0.8f, 0.1f, 0.9f) : v4(0.9f, 0.2f, 0.2f, 0.9f);
+
+        int x = left + i * FRAME_GRAPH_BAR_WIDTH;
+        int height = (int)(ms * FRAME_GRAPH_PIXELS_PER_MS);
+        if (height > bottom - top) height = bottom - top;
+        DrawRectangle(x, x + FRAME_GRAPH_BAR_WIDTH - 1, bottom - (height > 1 ? height : 1), bottom, color);
+    }
+
+    f32 lines[] = { 16.6f, stats.hitch_ms, stats.p99_ms };
+    v4 line_colors[] = { v4(1, 1, 1, 0.6f), v4(0.9f, 0.2f, 0.2f, 0.6f), v4(0.3f, 0.6f, 1, 0.8f) };
+    for (int i = 0; i < (int)ArrayCount(lines); ++i) {
+        int y = bottom - (int)(lines[i] * FRAME_GRAPH_PIXELS_PER_MS);
+        if (lines[i] > 0 && y > top) DrawRectangle(left, right, y, y + 1, line_colors[i]);
+    }
+
+    Font *font = GetDebugFont();
+    if (font->loaded) {
+        f32 y = top - font->line_height - 2;
+        PushTextFormat(font, (f32)left, y, v4(1, 1, 1, 0.9f), "p50 %.2f  p95 %.2f  p99 %.2f  max %.2f ms",
+                       stats.p50_ms, stats.p95_ms, stats.p99_ms, stats.max_ms);
+    }
+}
@@ -0,0 +1,391 @@
+/*
+    Hierarchical CPU profiler.
+
+    ProfileBlock(name) times its scope with rdtsc and, at the end of the scope, writes one
+    {name, start, end} record into a ring owned by the calling thread. Rings are single writer, the
+    write index is published with a release store and readers never block the writer, so the
+    markers can stay in shipping builds. A ring holds the last PROFILE_RING_SIZE zones of its
+    thread; the reader skips the oldest part of the ring since the writer may be overwriting it.
+
+    Nesting isn't stored. Zones on one thread nest properly, so depth falls out of sorting a frame's
+    records by start time. MarkProfileFrame (main thread, once per displayed frame) stamps the frame
+    boundaries, GetProfileSummary merges one frame into a call tree for the overlay and
+    ExportProfileTrace writes a range of frames as Chrome trace_event JSON (chrome://tracing or
+    ui.perfetto.dev).
+
+    GPU pass timings (gpu_profiler.cpp) arrive a few frames late, already converted to GetTime
+    seconds. They go into their own "GPU" ring, still in end order since passes finish in order.
+
+    Zone names are pointers, a game module reload clears everything recorded so far. Threads that
+    exit (job workers on shutdown, the simulation thread on a reload) hand their ring back with
+    ReleaseProfileThread and the next thread to register reuses it, so restarting threads doesn't
+    run out of the MAX_PROFILE_THREADS slots.
+*/
+
+#define PROFILE_RING_SIZE (1 << 15) // per thread, power of 2
+#define PROFILE_RING_READ_MARGIN (PROFILE_RING_SIZE / 8) // oldest records, may be mid-overwrite
+#define PROFILE_FRAME_COUNT 256 // frame boundaries kept, power of 2
+
+struct ProfileRecord {
+    const char *name;
+    u64 start;
+    u64 end;
+};
+
+struct ProfileThread {
+    std::atomic<u64> write_index;
+    const char *name;
+    ProfileRecord records[PROFILE_RING_SIZE];
+};
+
+struct Profiler {
+    std::atomic<int> thread_count;
+    std::atomic<ProfileThread *> threads[MAX_PROFILE_THREADS];
+    ProfileThread *gpu_thread; // written by the main thread
+
+    std::mutex register_mutex;
+    int free_thread_count;
+    ProfileThread *free_threads[MAX_PROFILE_THREADS]; // released by threads that exited
+
+    std::atomic<u64> frame_count;
+    u64 frame_starts[PROFILE_FRAME_COUNT];
+
+    // TSC rate, measured against GetTime between InitProfiler and the first read
+    u64 calibration_ticks;
+    double calibration_time;
+    double ticks_per_second;
+
+    std::mutex read_mutex; // summary and export share the scratch records
+    ProfileRecord scratch[PROFILE_RING_SIZE];
+};
+
+static Profiler profiler;
+static thread_local ProfileThread *profile_thread;
+
+void InitProfiler() {
+    profiler.calibration_ticks = ReadTimestamp();
+    profiler.calibration_time = GetTime();
+}
+
+static ProfileThread *RegisterProfileThread(const char *name) {
+    std::lock_guard<std::mutex> lock(profiler.register_mutex);
+
+    // the ring keeps its old records, they read as history of the thread that left
+    if (profiler.free_thread_count > 0) {
+        ProfileThread *thread = profiler.free_threads[--profiler.free_thread_count];
+        thread->name = name;
+        return thread;
+    }
+
+    int index = profiler.thread_count.load(std::memory_order_relaxed);
+    if (index >= MAX_PROFILE_THREADS) return 0;
+
+    ProfileThread *thread = (ProfileThread *)calloc(1, sizeof(ProfileThread));
+    thread->name = name;
+    profiler.threads[index].store(thread, std::memory_order_release);
+    profiler.thread_count.store(index + 1, std::memory_order_release);
+    return thread;
+}
+
+void SetProfileThreadName(const char *name) {
+    if (!profile_thread) profile_thread = RegisterProfileThread(name);
+    if (profile_thread) profile_thread->name = name;
+}
+
+// Call last thing on a thread that is about to exit, its zones stop being written.
+void ReleaseProfileThread() {
+    if (!profile_thread) return;
+
+    std::lock_guard<std::mutex> lock(profiler.register_mutex);
+    profiler.free_threads[profiler.free_thread_count++] = profile_thread;
+    profile_thread = 0;
+}
+
+static void WriteProfileRecord(ProfileThread *thread, const char *name, u64 start, u64 end) {
+    u64 index = thread->write_index.load(std::memory_order_relaxed);
+    ProfileRecord *record = thread->records + (index & (PROFILE_RING_SIZE - 1));
+    record->name = name;
+    record->start = start;
+    record->end = end;
+    thread->write_index.store(index + 1, std::memory_order_release);
+}
+
+void RecordProfileZone(const char *name, u64 start, u64 end) {
+    ProfileThread *thread = profile_thread;
+    if (!thread) {
+        thread = profile_thread = RegisterProfileThread(0);
+        if (!thread) return;
+    }
+
+    WriteProfileRecord(thread, name, start, end);
+}
+
+// Main thread, at the start of every frame.
+void MarkProfileFrame() {
+    u64 frame = profiler.frame_count.load(std::memory_order_relaxed);
+    profiler.frame_starts[frame & (PROFILE_FRAME_COUNT - 1)] = ReadTimestamp();
+    profiler.frame_count.store(frame + 1, std::memory_order_release);
+}
+
+// Frames started so far, frame_count - 2 is the last complete one.
+u64 GetProfileFrameCount() {
+    return profiler.frame_count.load(std::memory_order_acquire);
+}
+
+// Only call with nothing recording, i.e. while the game module is unloaded.
+void ClearProfiler() {
+    int thread_count = Min(profiler.thread_count.load(), MAX_PROFILE_THREADS);
+    for (int i = 0; i < thread_count; ++i) {
+        ProfileThread *thread = profiler.threads[i].load(std::memory_order_acquire);
+        if (thread) thread->write_index.store(0, std::memory_order_release);
+    }
+    profiler.frame_count.store(0, std::memory_order_release);
+}
+
+static double GetProfileTicksPerSecond() {
+    // re-measured on each read, it only gets more accurate with a longer baseline
+    double elapsed = GetTime() - profiler.calibration_time;
+    if (elapsed > 0.01) {
+        profiler.ticks_per_second = (ReadTimestamp() - profiler.calibration_ticks) / elapsed;
+    }
+    return profiler.ticks_per_second > 0 ? profiler.ticks_per_second : 3e9;
+}
+
+// Main thread. start and end are GetTime seconds.
+void RecordGpuProfileZone(const char *name, double start, double end) {
+    std::lock_guard<std::mutex> lock(profiler.read_mutex);
+
+    if (!profiler.gpu_thread) profiler.gpu_thread = RegisterProfileThread("GPU");
+    if (!profiler.gpu_thread) return;
+
+    double ticks_per_second = GetProfileTicksPerSecond();
+    u64 start_ticks = profiler.calibration_ticks + (u64)((start - profiler.calibration_time) * ticks_per_second);
+    u64 end_ticks = profiler.calibration_ticks + (u64)((end - profiler.calibration_time) * ticks_per_second);
+    WriteProfileRecord(profiler.gpu_thread, name, start_ticks, end_ticks);
+}
+
+static bool GetProfileFrameRange(u64 first_frame, u64 one_past_last_frame, u64 *start, u64 *end) {
+    u64 frame_count = GetProfileFrameCount();
+    // the last boundary is the start of the frame in progress
+    if (first_frame >= one_past_last_frame || one_past_last_frame >= frame_count) return false;
+    if (frame_count - first_frame > PROFILE_FRAME_COUNT) return false;
+
+    *start = profiler.frame_starts[first_frame & (PROFILE_FRAME_COUNT - 1)];
+    *end = profiler.frame_starts[one_past_last_frame & (PROFILE_FRAME_COUNT - 1)];
+    return true;
+}
+
+static int CompareProfileRecords(const void *a, const void *b) {
+    ProfileRecord *x = (ProfileRecord *)a;
+    ProfileRecord *y = (ProfileRecord *)b;
+
+    // parents before children: earlier start first, longer first on a tie
+    if (x->start != y->start) return x->start < y->start ? -1 : 1;
+    if (x->end != y->end) return x->end > y->end ? -1 : 1;
+    return 0;
+}
+
+// Copies the thread's records that overlap [start, end) into profiler.scratch, sorted parents
+// first. Holds read_mutex.
+static int GatherProfileRecords(ProfileThread *thread, u64 start, u64 end) {
+    u64 write_index = thread->write_index.load(std::memory_order_acquire);
+    u64 oldest = write_index > PROFILE_RING_SIZE - PROFILE_RING_READ_MARGIN ? write_index - (PROFILE_RING_SIZE - PROFILE_RING_READ_MARGIN) : 0;
+
+    // records are written in end order, walk back until they end before the range
+    int count = 0;
+    for (u64 i = write_index; i > oldest; --i) {
+        ProfileRecord record = thread->records[(i - 1) & (PROFILE_RING_SIZE - 1)];
+        if (record.end < start) break;
+        if (record.start < end) profiler.scratch[count++] = record;
+    }
+
+    qsort(profiler.scratch, count, sizeof(ProfileRecord), CompareProfileRecords);
+    return count;
+}
+
+struct ProfileSummaryNode {
+    const char *name;
+    int parent;
+    int depth;
+    u32 count;
+    u64 first_start;
+    u64 ticks;
+};
+
+static void AppendProfileSummaryNodes(ProfileSummary *summary, ProfileSummaryNode *nodes, int node_count,
+                                      int parent, int thread, u64 frame_start, double ms_per_tick) {
+    for (int i = 0; i < node_count; ++i) {
+        ProfileSummaryNode *node = nodes + i;
+        if (node->parent != parent || summary->zone_count >= MAX_PROFILE_SUMMARY_ZONES) continue;
+
+        ProfileSummaryZone *zone = summary->zones + summary->zone_count++;
+        zone->name = node->name;
+        zone->thread = thread;
+        zone->depth = node->depth;
+        zone->count = node->count;
+        zone->start_ms = node->first_start > frame_start ? (node->first_start - frame_start) * ms_per_tick : 0;
+        zone->ms = node->ticks * ms_per_tick;
+
+        AppendProfileSummaryNodes(summary, nodes, node_count, i, thread, frame_start, ms_per_tick);
+    }
+}
+
+// False if the frame isn't complete yet or already out of the history.
+bool GetProfileSummary(ProfileSummary *summary, u64 frame) {
+    std::lock_guard<std::mutex> lock(profiler.read_mutex);
+
+    u64 start, end;
+    if (!GetProfileFrameRange(frame, frame + 1, &start, &end)) return false;
+
+    double ms_per_tick = 1000.0 / GetProfileTicksPerSecond();
+    summary->frame = frame;
+    summary->frame_ms = (end - start) * ms_per_tick;
+    summary->zone_count = 0;
+    summary->thread_count = Min(profiler.thread_count.load(), MAX_PROFILE_THREADS);
+
+    for (int t = 0; t < summary->thread_count; ++t) {
+        ProfileThread *thread = profiler.threads[t].load(std::memory_order_acquire);
+        summary->thread_names[t] = thread ? thread->name : 0;
+        if (!thread) continue;
+
+        int record_count = GatherProfileRecords(thread, start, end);
+
+        ProfileSummaryNode nodes[MAX_PROFILE_SUMMARY_ZONES];
+        int node_count = 0;
+        u64 open_ends[64];
+        int open_nodes[64];
+        int depth = 0;
+
+        for (int r = 0; r < record_count; ++r) {
+            ProfileRecord *record = profiler.scratch + r;
+            while (depth && record->start >= open_ends[depth - 1]) --depth;
+            if (depth == ArrayCount(open_ends)) continue;
+
+            // clipped to the frame, zones may straddle the boundary
+            u64 clipped_start = record->start > start ? record->start : start;
+            u64 clipped_end = record->end < end ? record->end : end;
+            int parent = depth ? open_nodes[depth - 1] : -1;
+
+            int node = -1;
+            for (int n = 0; n < node_count; ++n) {
+                if (nodes[n].parent == parent && strcmp(nodes[n].name, record->name) == 0) {
+                    node = n;
+                    break;
+                }
+            }
+            if (node < 0 && node_count < (int)ArrayCount(nodes)) {
+                node = node_count++;
+                nodes[node] = {};
+                nodes[node].name = record->name;
+                nodes[node].parent = parent;
+                nodes[node].depth = depth;
+                nodes[node].first_start = clipped_start;
+            }
+            if (node < 0) continue;
+
+            ++nodes[node].count;
+            nodes[node].ticks += clipped_end > clipped_start ? clipped_end - clipped_start : 0;
+
+            open_ends[depth] = record->end;
+            open_nodes[depth] = node;
+            ++depth;
+        }
+
+        AppendProfileSummaryNodes(summary, nodes, node_count, -1, t, start, ms_per_tick);
+    }
+
+    return true;
+}
+
+static void WriteJsonString(FILE *file, const char *string) {
+    fputc('"', file);
+    for (const char *c = string; *c; ++c) {
+        if (*c == '"' || *c == '\\') fputc('\\', file);
+        if ((u8)*c >= 0x20) fputc(*c, file);
+    }
+    fputc('"', file);
+}
+
+// Writes every zone that overlaps [first_frame, one_past_last_frame) as a complete ("X") event,
+// plus an instant event at every frame boundary. Timestamps are microseconds from the first frame.
+bool ExportProfileTrace(const char *path, u64 first_frame, u64 one_past_last_frame) {
+    std::lock_guard<std::mutex> lock(profiler.read_mutex);
+
+    u64 start, end;
+    if (!GetProfileFrameRange(first_frame, one_past_last_frame, &start, &end)) {
+        fprintf(stderr, "Error: frames %llu-%llu aren't in the profile history\n",
+                (unsigned long long)first_frame, (unsigned long long)one_past_last_frame);
+        return false;
+    }
+
+    FILE *file = fopen(path, "w");
+    if (!file) {
+        fprintf(stderr, "Error: unable to open %s\n", path);
+        return false;
+    }
+
+    double us_per_tick = 1e6 / GetProfileTicksPerSecond();
+
+    fprintf(file, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+    fprintf(file, "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":1,\"tid\":0,\"args\":{\"name\":\"rpg\"}}");
+
+    for (u64 frame = first_frame; frame <= one_past_last_frame; ++frame) {
+        u64 frame_start = profiler.frame_starts[frame & (PROFILE_FRAME_COUNT - 1)];
+        fprintf(file, ",\n{\"name\":\"Frame %llu\",\"ph\":\"i\",\"s\":\"g\",\"pid\":1,\"tid\":0,\"ts\":%.3f}",
+                (unsigned long long)frame, (frame_start - start) * us_per_tick);
+    }
+
+    int event_count = 0;
+    int thread_count = Min(profiler.thread_count.load(), MAX_PROFILE_THREADS);
+    for (int t = 0; t < thread_count; ++t) {
+        ProfileThread *thread = profiler.threads[t].load(std::memory_order_acquire);
+        if (!thread) continue;
+
+        fprintf(file, ",\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%d,\"args\":{\"name\":", t);
+        WriteJsonString(file, thread->name ? thread->name : "Thread");
+        fprintf(file, "}}");
+
+        int record_count = GatherProfileRecords(thread, start, end);
+        for (int r = 0; r < record_count; ++r) {
+            ProfileRecord *record = profiler.scratch + r;
+            // signed, a zone may have started before the range
+            double ts = ((double)record->start - (double)start) * us_per_tick;
+            double duration = (record->end - record->start) * us_per_tick;
+
+            fprintf(file, ",\n{\"name\":");
+            WriteJsonString(file, record->name);
+            fprintf(file, ",\"ph\":\"X\",\"pid\":1,\"tid\":%d,\"ts\":%.3f,\"dur\":%.3f}", t, ts, duration);
+        }
+        event_count += record_count;
+    }
+
+    fprintf(file, "\n]}\n");
+    fclose(file);
+
+    fprintf(stdout, "Wrote %d zones from frames %llu-%llu to %s\n", event_count,
+            (unsigned long long)first_frame, (unsigned long long)one_past_last_frame - 1, path);
+    return true;
+}
+
+void BenchmarkProfiler() {
+    const int zone_count = 1 << 20;
+
+    // the static build calls RecordProfileZone directly, the game module through PlatformApi
+    double start = GetTime();
+    for (int i = 0; i < zone_count; ++i) {
+        ProfileBlock("BenchmarkProfiler");
+    }
+    double seconds = GetTime() - start;
+
+    // two of these per zone, rdtsc is a lot slower under some hypervisors
+    volatile u64 sink;
+    start = GetTime();
+    for (int i = 0; i < zone_count; ++i) sink = ReadTimestamp();
+    double timestamp_seconds = GetTime() - start;
+    (void)sink;
+
+    fprintf(stdout, "Profiler: %.1f ns/zone over %d zones, %.1f ns of it rdtsc\n",
+            seconds * 1e9 / zone_count, zone_count, 2 * timestamp_seconds * 1e9 / zone_count);
+
+    ClearProfiler();
+}
@@ -0,0 +1,48 @@
+/*
+    Radix sort shared by the render command queue and the sprite batch.
+
+    LSD on 8 bit digits, stable. All eight histograms come from one read of the input, and a pass
+    where every key has the same digit would be a plain copy, so it's skipped: keys that only use
+    their low bits (sprite depth keys) cost as many passes as they have bytes in use.
+*/
+
+struct SortEntry {
+    u64 key;
+    u32 index;
+};
+
+// Returns whichever of entries/temp holds the result, pass_count (optional) gets the passes run.
+SortEntry *RadixSort(SortEntry *entries, SortEntry *temp, int count, int *pass_count = 0) {
+    u32 histograms[8][256] = {};
+    for (int i = 0; i < count; ++i) {
+        u64 key = entries[i].key;
+        for (int pass = 0; pass < 8; ++pass) ++histograms[pass][(key >> (pass * 8)) & 0xff];
+    }
+
+    SortEntry *source = entries;
+    SortEntry *dest = temp;
+    int passes = 0;
+
+    for (int pass = 0; pass < 8 && count; ++pass) {
+        u32 *histogram = histograms[pass];
+        int shift = pass * 8;
+        if (histogram[(source[0].key >> shift) & 0xff] == (u32)count) continue;
+
+        u32 offsets[256];
+        u32 total = 0;
+        for (int digit = 0; digit < 256; ++digit) {
+            offsets[digit] = total;
+            total += histogram[digit];
+        }
+
+        for (int i = 0; i < count; ++i) dest[offsets[(source[i].key >> shift) & 0xff]++] = source[i];
+
+        SortEntry *swap = source;
+        source = dest;
+        dest = swap;
+        ++passes;
+    }
+
+    if (pass_count) *pass_count = passes;
+    return source;
+}
@@ -0,0 +1,258 @@
+/*
+    Render command recording.
+
+    Draws are recorded as plain structs instead of GL calls so frame building can run on any
+    thread. Every job thread has its own command buffer in its own arena, recording never locks.
+    At the end of the frame each buffer is sorted by its 64 bit key (in parallel, one job per
+    buffer), the sorted runs are merged and the GL thread submits them in key order.
+
+    Sort key, high to low bits:
+        layer   8  draw order between passes
+        texture 16 \ state changes, so equal state ends up adjacent
+        mesh    16 /
+        depth   24 front to back inside a layer
+
+    A RenderSnapshot is everything the render thread needs for one frame, copied out of the
+    simulation so the next simulation frame can run while this one is drawn, debug draw vertices
+    included.
+*/
+
+struct RenderCommand {
+    u64 sort_key;
+    Mesh mesh;
+    u32 texture;
+    v4 color;
+    mat4 model;
+};
+
+struct alignas(64) RenderCommandBuffer {
+    Arena arena; // RenderCommands, may grow
+    int count;
+    SortEntry *order; // sorted by FinishRenderQueue
+};
+
+struct RenderSnapshot {
+    Arena arena; // commands, may be recreated bigger
+    u64 frame;
+
+    mat4 view;
+    mat4 projection;
+
+    int command_count;
+    RenderCommand *commands; // in submission order
+
+    Arena debug_arena; // debug draw vertices, may be recreated bigger
+    DebugDrawList debug_draw;
+
+    b32 show_profiler;
+    b32 show_frame_graph;
+};
+
+struct RenderQueue {
+    int buffer_count;
+    RenderCommandBuffer *buffers;
+
+    Arena sort_arena; // per-frame sort entries and the merged list
+    int command_count;
+    RenderCommand **commands; // every buffer merged in key order
+};
+
+u64 MakeRenderSortKey(u32 layer, u32 texture, u32 mesh, f32 depth) {
+    u32 quantized_depth = (u32)(clamp(depth, 0.0f, 1.0f) * 0xffffff);
+
+    u64 result = ((u64)(layer & 0xff) << 56) |
+                 ((u64)(texture & 0xffff) << 40) |
+                 ((u64)(mesh & 0xffff) << 24) |
+                 (u64)quantized_depth;
+    return result;
+}
+
+// Discards the contents, makes sure size bytes fit without ArenaAlloc having to grow.
+static void ReserveArena(Arena *arena, u64 size) {
+    if (size > arena->size) {
+        free(arena->base_address);
+        *arena = CreateArena(size * 2);
+    }
+    arena->count = 0;
+}
+
+RenderQueue CreateRenderQueue(Arena *arena, int buffer_count) {
+    RenderQueue result = {};
+    result.buffer_count = buffer_count;
+    result.buffers = (RenderCommandBuffer *)ArenaAllocAligned(arena, sizeof(RenderCommandBuffer) * buffer_count, 64);
+
+    // malloc'd so they can grow, ArenaAlloc reallocs on overflow
+    for (int i = 0; i < buffer_count; ++i) {
+        result.buffers[i].arena = CreateArena(Kilobytes(64));
+    }
+    result.sort_arena = CreateArena(Kilobytes(256));
+
+    return result;
+}
+
+void ResetRenderQueue(RenderQueue *queue) {
+    for (int i = 0; i < queue->buffer_count; ++i) {
+        queue->buffers[i].arena.count = 0;
+        queue->buffers[i].count = 0;
+        queue->buffers[i].order = 0;
+    }
+
+    queue->sort_arena.count = 0;
+    queue->command_count = 0;
+    queue->commands = 0;
+}
+
+// The calling thread's buffer.
+RenderCommandBuffer *GetRenderCommandBuffer(RenderQueue *queue) {
+    int index = GetJobThreadIndex();
+    Assert(index < queue->buffer_count);
+    return queue->buffers + index;
+}
+
+inline RenderCommand *GetRenderCommands(RenderCommandBuffer *buffer) {
+    return (RenderCommand *)buffer->arena.base_address;
+}
+
+void PushMeshCommand(RenderCommandBuffer *buffer, u64 sort_key, Mesh mesh, u32 texture, v4 color, mat4 *model) {
+    // the arena may move when it grows, so commands are always addressed from its base
+    RenderCommand *command = (RenderCommand *)ArenaAlloc(&buffer->arena, sizeof(RenderCommand));
+    command->sort_key = sort_key;
+    command->mesh = mesh;
+    command->texture = texture;
+    command->color = color;
+    command->model = *model;
+
+    ++buffer->count;
+}
+
+static void SortRenderCommandBuffers(void *data, int first, int one_past_last) {
+    RenderQueue *queue = (RenderQueue *)data;
+
+    for (int b = first; b < one_past_last; ++b) {
+        RenderCommandBuffer *buffer = queue->buffers + b;
+        if (!buffer->count) continue;
+
+        RenderCommand *commands = GetRenderCommands(buffer);
+        SortEntry *entries = buffer->order;
+        SortEntry *temp = entries + buffer->count;
+        for (int i = 0; i < buffer->count; ++i) {
+            entries[i].key = commands[i].sort_key;
+            entries[i].index = i;
+        }
+
+        buffer->order = RadixSort(entries, temp, buffer->count);
+    }
+}
+
+// Main thread, after every recording job finished. Sorts each buffer and merges them into
+// queue->commands.
+void FinishRenderQueue(RenderQueue *queue) {
+    ProfileFunction();
+
+    int total = 0;
+    for (int b = 0; b < queue->buffer_count; ++b) total += queue->buffers[b].count;
+
+    // one allocation, sized up front since ArenaAlloc only doubles once
+    u64 size = (sizeof(SortEntry) * 2 + sizeof(RenderCommand *)) * total;
+    ReserveArena(&queue->sort_arena, size);
+    SortEntry *entries = (SortEntry *)ArenaAlloc(&queue->sort_arena, size);
+    queue->commands = (RenderCommand **)(entries + 2 * total);
+
+    for (int b = 0; b < queue->buffer_count; ++b) {
+        RenderCommandBuffer *buffer = queue->buffers + b;
+        buffer->order = entries;
+        entries += 2 * buffer->count;
+    }
+
+    ParallelFor(SortRenderCommandBuffers, queue, queue->buffer_count, 1);
+
+    // k-way merge of the sorted runs, k is the thread count so a linear scan of the heads is fine
+    int heads[MAX_WORKER_THREADS] = {};
+    Assert(queue->buffer_count <= MAX_WORKER_THREADS);
+
+    for (int n = 0; n < total; ++n) {
+        int best = -1;
+        u64 best_key = 0;
+        for (int b = 0; b < queue->buffer_count; ++b) {
+            RenderCommandBuffer *buffer = queue->buffers + b;
+            if (heads[b] < buffer->count && (best < 0 || buffer->order[heads[b]].key < best_key)) {
+                best = b;
+                best_key = buffer->order[heads[b]].key;
+            }
+        }
+
+        RenderCommandBuffer *buffer = queue->buffers + best;
+        queue->commands[n] = GetRenderCommands(buffer) + buffer->order[heads[best]++].index;
+    }
+
+    queue->command_count = total;
+}
+
+void InitRenderSnapshot(RenderSnapshot *snapshot) {
+    *snapshot = {};
+    snapshot->arena = CreateArena(Kilobytes(256));
+    snapshot->debug_arena = CreateArena(Kilobytes(64));
+}
+
+void BeginRenderSnapshot(RenderSnapshot *snapshot, u64 frame, mat4 *view, mat4 *projection) {
+    snapshot->arena.count = 0;
+    snapshot->frame = frame;
+    snapshot->view = *view;
+    snapshot->projection = *projection;
+    snapshot->command_count = 0;
+    snapshot->commands = 0;
+    snapshot->debug_draw = {};
+    snapshot->show_profiler = false;
+    snapshot->show_frame_graph = false;
+}
+
+// Copies the merged queue so its buffers can be reused right away.
+void CopyRenderQueue(RenderSnapshot *snapshot, RenderQueue *queue) {
+    ReserveArena(&snapshot->arena, sizeof(RenderCommand) * queue->command_count);
+    snapshot->commands = (RenderCommand *)ArenaAlloc(&snapshot->arena, sizeof(RenderCommand) * queue->command_count);
+    snapshot->command_count = queue->command_count;
+
+    for (int i = 0; i < queue->command_count; ++i) {
+        snapshot->commands[i] = *queue->commands[i];
+    }
+}
+
+// This frame's and the still living timed primitives, lines first.
+void CopyDebugDraw(RenderSnapshot *snapshot, DebugDraw *draw) {
+    DebugDrawList *list = &snapshot->debug_draw;
+    list->line_vertex_count = draw->lines.count + draw->timed_lines.count;
+    list->point_count = draw->points.count + draw->timed_points.count;
+
+    u64 size = sizeof(DebugVertex) * (list->line_vertex_count + list->point_count);
+    ReserveArena(&snapshot->debug_arena, size);
+    list->vertices = (DebugVertex *)ArenaAlloc(&snapshot->debug_arena, size);
+
+    DebugVertex *vertices = list->vertices;
+    DebugDrawStream *streams[] = { &draw->lines, &draw->timed_lines, &draw->points, &draw->timed_points };
+    for (int i = 0; i < (int)ArrayCount(streams); ++i) {
+        memcpy(vertices, streams[i]->vertices, sizeof(DebugVertex) * streams[i]->count);
+        vertices += streams[i]->count;
+    }
+}
+
+static u64 HashBytes(u64 hash, void *data, u64 size) {
+    u8 *bytes = (u8 *)data;
+    for (u64 i = 0; i < size; ++i) hash = (hash ^ bytes[i]) * 0x100000001b3ull; // FNV-1a
+    return hash;
+}
+
+// Headless backend, counts what would have been submitted. The checksum covers every command's
+// key, color and transform, two runs that drew the same frames end up with the same value.
+void SubmitNullRenderer(RenderSnapshot *snapshot, NullRendererStats *stats) {
+    if (!stats->frames) stats->checksum = 0xcbf29ce484222325ull;
+    ++stats->frames;
+    stats->commands += snapshot->command_count;
+    stats->lines += snapshot->debug_draw.line_vertex_count / 2;
+
+    for (int i = 0; i < snapshot->command_count; ++i) {
+        RenderCommand *command = snapshot->commands + i;
+        stats->checksum = HashBytes(stats->checksum, &command->sort_key, sizeof(command->sort_key));
+        stats->checksum = HashBytes(stats->checksum, &command->color, sizeof(command->color));
+        stats->checksum = HashBytes(stats->checksum, &command->model, sizeof(command->model));
+    }
+}
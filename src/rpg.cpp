@@ -1,7 +1,54 @@
-static Arena scratch_arena;
-static Arena persist_arena;
+#ifdef GAME_MODULE
+/*
+    Built as its own library (rpg.dll / librpg.so) that the platform layer reloads whenever it is
+    rebuilt. Everything that has to survive a reload lives in platform.memory; statics (GL programs,
+    the GLEW function pointers) are recreated by the new copy.
+*/
+#define GLEW_STATIC
+#include <GL/glew.h>
+#include <GLFW/glfw3.h>
+#include "platform.h"
+#include <stdlib.h>
+#include <string.h>
+
+static PlatformServiceContext *platform_context;
+static PlatformApi *platform_api;
+
+#include "arena.cpp"
+#endif
+
+#include "glutil.cpp"
+#include "gpu_profiler.cpp"
+#include "font.cpp"
+
+#ifdef GAME_MODULE
+// after glutil.cpp, stb_truetype has its own platform identifiers
+#define platform (*platform_context)
+#endif
+#include "animation.cpp"
+#include "animation_compression.cpp"
+#include "scene.cpp"
+#include "bvh.cpp"
+#include "culling.cpp"
+#include "entity.cpp"
+#include "pathfinding.cpp"
+#include "ui.cpp"
+#include "debug_draw.cpp"
+#include "radix_sort.cpp"
+#include "render_commands.cpp"
+#include "sprite_batch.cpp"
+#include "tilemap.cpp"
+#include "impostors.cpp"
+#include "picking.cpp"
+#include "world.cpp"
+#include "profile_overlay.cpp"
+
+#if defined(GAME_MODULE) && defined(_WIN32)
+#define GAME_EXPORT extern "C" __declspec(dllexport)
+#else
+#define GAME_EXPORT extern "C"
+#endif
 
-void *ArenaAlloc(Arena *arena, u64 count);
 Arena CreateArena(void *base_address, u64 size);
 
 struct Camera {
@@ -14,19 +61,48 @@ struct Camera {
 
 struct Object3D {
     mat4 basis;
+    Entity entity;
 };
 
 struct GameState {
     b32 initialized;
+    Arena scratch_arena;
+    Arena persist_arena;
 
     Object3D hero;
+    CompressedClip hero_clips[2];
+    AnimationLayer hero_layers[2];
+    Pose hero_pose;
+    Pose hero_pose_scratch;
+
+    EntityWorld world;
+    TransformHierarchy transforms;
+    Entity hero_body;
+    Entity camera_anchor;
+    Entity crate;
+
+    int *visible_renderables;
+    CullingStats culling_stats;
+    RenderQueue render_queue;
+    int snapshot_count;
+    RenderSnapshot snapshots[MAX_FRAME_LATENCY + 1];
+
+    BVH bvh;
+    Entity hovered_entity; // renderable under the cursor, NULL_ENTITY if none
 
     Mesh cube;
+    AABB cube_bounds;
     Camera camera;
     mat4 projection;
     Texture wall;
 
-    v3 hero_position;
+    DebugDraw debug_draw;
+    b32 show_bvh;
+    b32 freeze_frustum; // draw the next frame's frustum for a few seconds
+
+    u64 frame;
+    b32 show_profiler;
+    b32 show_frame_graph;
 };
 
 v3 GetObjectFront(Object3D *object) {
@@ -59,25 +135,113 @@ void CreateObject3D(Object3D *object) {
     object->basis = mat4(1.0f);
 }
 
-void DrawMesh(Mesh, v3, v4, mat4 *);
-void DrawLine(v3 a, v3 b, v4 color);
+// Single joint loop used to bob and sway the hero while idle or walking.
+AnimationClip CreateHeroClip(Arena *arena, f32 period, f32 bob_height, f32 sway) {
+    int frame_count = 31;
+    AnimationClip result = PushAnimationClip(arena, 1, frame_count, (frame_count - 1) / period);
+
+    for (int f = 0; f < frame_count; ++f) {
+        Pose frame = GetClipFrame(&result, f);
+        f32 phase = f * (2 * glm::pi<f32>() / (frame_count - 1));
+        f32 angle = sway * sinf(phase);
+
+        frame.tx[0] = 0;
+        frame.ty[0] = bob_height * 0.5f * (1 - cosf(2 * phase));
+        frame.tz[0] = 0;
+        frame.qx[0] = 0;
+        frame.qy[0] = 0;
+        frame.qz[0] = sinf(angle * 0.5f);
+        frame.qw[0] = cosf(angle * 0.5f);
+        frame.scale[0] = 1;
+    }
+
+    return result;
+}
+
+#define MAX_ENTITIES 4096
+#define RECORD_BATCH_SIZE 256
+
+struct RecordRenderablesJob {
+    EntityWorld *world;
+    TransformHierarchy *transforms;
+    RenderQueue *queue;
+    int *visible;
+    Entity hovered_entity;
+    u32 texture;
+    mat4 view_projection;
+};
+
+// Records mesh commands for a range of the visible list into the calling thread's buffer.
+static void RecordRenderables(void *data, int first, int one_past_last) {
+    ProfileFunction();
+
+    RecordRenderablesJob *job = (RecordRenderablesJob *)data;
+    RenderCommandBuffer *buffer = GetRenderCommandBuffer(job->queue);
+    ComponentStore *renderables = &job->world->stores[RenderComponent];
+    Mesh *meshes = GetColumn(renderables, Mesh, RenderMesh);
+    v4 *colors = GetColumn(renderables, v4, RenderColor);
+    v4 hover_tint = {1,0.7f,0.7f,1};
+
+    for (int i = first; i < one_past_last; ++i) {
+        int slot = job->visible[i];
+        Entity entity = renderables->entities[slot];
+        mat4 *model = GetWorldTransform(job->transforms, GetTransformNode(job->world, entity));
+
+        v4 clip = job->view_projection * (*model)[3];
+        f32 depth = clip.w > 0 ? clip.z / clip.w * 0.5f + 0.5f : 0;
+        u64 key = MakeRenderSortKey(0, job->texture, meshes[slot].vao, depth);
+
+        v4 color = job->hovered_entity == entity ? colors[slot] * hover_tint : colors[slot];
+        PushMeshCommand(buffer, key, meshes[slot], job->texture, color, model);
+    }
+}
+
+// Every node's box, leaves green and inner nodes fading from yellow to red with height.
+void DebugDrawBVH(DebugDraw *draw, BVH *bvh) {
+    ProfileFunction();
+
+    if (bvh->root == BVH_NULL) return;
+    f32 root_height = (f32)Max(bvh->nodes[bvh->root].height, 1);
+
+    for (int i = 0; i < bvh->node_capacity; ++i) {
+        BVHNode *node = bvh->nodes + i;
+        if (node->height < 0) continue;
+
+        v4 color = node->height == 0 ? v4(0.2f, 0.9f, 0.3f, 0.6f) : v4(1, 1 - node->height / root_height, 0, 0.6f);
+        DebugBox(draw, node->box.min, node->box.max, color, DebugDepthTest, 0);
+    }
+}
+
+void SubmitRenderCommands(RenderSnapshot *);
 
 Camera *GetGameCamera();
+Ray GetCursorRay(Camera *);
+void GetCameraTransform(Camera *, mat4 *);
+void GetProjectionTransform(mat4 *);
 v3 GetCameraEye(Camera *);
 v3 GetCameraViewVector(Camera *);
 void RotateLeft(Camera *, f32);
 void RotateUp(Camera *, f32);
 
-void UpdateAndRender() {
+// Main thread, before the first frame. Creates the GL resources the simulation refers to.
+void InitGame(int snapshot_count) {
+    ProfileFunction();
+
     GameState *state = (GameState *)platform.memory;
 
-    if (!state->initialized) {
-        u64 free_bytes = platform.memory_size - sizeof(GameState);
-        // initialize game state
-        scratch_arena = CreateArena((u8*)platform.memory + sizeof(GameState), free_bytes/2);
-        persist_arena = CreateArena((u8*)platform.memory + sizeof(GameState) + free_bytes/2, free_bytes/2);
+    state->snapshot_count = snapshot_count;
+    for (int i = 0; i < snapshot_count; ++i) InitRenderSnapshot(state->snapshots + i);
+
+    u64 free_bytes = platform.memory_size - sizeof(GameState);
+    // initialize game state
+    state->scratch_arena = CreateArena((u8*)platform.memory + sizeof(GameState), free_bytes/2);
+    state->persist_arena = CreateArena((u8*)platform.memory + sizeof(GameState) + free_bytes/2, free_bytes/2);
+
+    // headless runs have no GL context, the meshes and textures stay 0
+    b32 headless = !platform.window;
 
-        Mesh cube = {};
+    Mesh cube = {};
+    if (!headless) {
         glGenVertexArrays(1, &cube.vao);
         glGenBuffers(1,  &cube.vbo);
         glBindVertexArray(cube.vao);
@@ -87,40 +251,92 @@ void UpdateAndRender() {
         glEnableVertexAttribArray(0);
         glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, sizeof(v3) + sizeof(v2), (void *)(sizeof(v3)));
         glEnableVertexAttribArray(1);
-        cube.vertex_count = sizeof(cube_vertices) / (sizeof(v3) + sizeof(v2));
-        state->cube = cube;
-
-        Camera *camera = &state->camera;
-        camera->radius = 6;
-        camera->target = {};
-
-        RotateLeft(camera, radians(90.0f));
-        RotateUp(camera, radians(45.0f));
-
-        int w,h;
-        glfwGetFramebufferSize(platform.window, &w, &h);
+    }
+    cube.vertex_count = sizeof(cube_vertices) / (sizeof(v3) + sizeof(v2));
+    state->cube = cube;
+    state->cube_bounds = { v3(-0.5f), v3(0.5f) };
 
-        state->projection = perspective(radians(45.0f), (float)w / (float)h, 0.1f, 100.0f);
+    Camera *camera = &state->camera;
+    camera->radius = 6;
+    camera->target = {};
 
-        CreateObject3D(&state->hero);
+    RotateLeft(camera, radians(90.0f));
+    RotateUp(camera, radians(45.0f));
+
+    int w = platform.framebuffer_width;
+    int h = platform.framebuffer_height;
+
+    state->projection = perspective(radians(45.0f), (float)w / (float)h, 0.1f, 100.0f);
+
+    CreateObject3D(&state->hero);
+
+    EntityWorld *world = &state->world;
+    TransformHierarchy *transforms = &state->transforms;
+    *world = CreateEntityWorld(&state->persist_arena, MAX_ENTITIES);
+    *transforms = CreateTransformHierarchy(&state->persist_arena, MAX_ENTITIES);
+    state->bvh = CreateBVH(&state->persist_arena, MAX_ENTITIES, 0.1f);
+    state->visible_renderables = (int *)ArenaAlloc(&state->persist_arena, sizeof(int) * AlignUp(MAX_ENTITIES, 8));
+    state->render_queue = CreateRenderQueue(&state->persist_arena, GetJobThreadCount());
+    state->debug_draw = CreateDebugDraw(&state->persist_arena, 1 << 16, 1 << 12, 1 << 12, 1 << 10);
+
+    v4 white = {1,1,1,1};
+    state->hero.entity = CreateTransformEntity(world, transforms, NO_PARENT);
+    SetEntityVelocity(world, state->hero.entity, v3(0));
+    state->hero_body = CreateTransformEntity(world, transforms, GetTransformNode(world, state->hero.entity));
+    AddRenderComponent(world, state->hero_body, state->cube, state->cube_bounds, white);
+    state->camera_anchor = CreateTransformEntity(world, transforms, GetTransformNode(world, state->hero.entity));
+    state->crate = CreateTransformEntity(world, transforms, NO_PARENT);
+    SetLocalPosition(transforms, GetTransformNode(world, state->crate), v3(3, 0, 0));
+    AddRenderComponent(world, state->crate, state->cube, state->cube_bounds, white);
+
+    // a field of crates below the hero
+    int field_size = 48;
+    for (int z = 0; z < field_size; ++z) {
+        for (int x = 0; x < field_size; ++x) {
+            Entity crate = CreateTransformEntity(world, transforms, NO_PARENT);
+            SetLocalPosition(transforms, GetTransformNode(world, crate), v3((x - field_size/2) * 2.0f, -2.0f, (z - field_size/2) * 2.0f));
+            AddRenderComponent(world, crate, state->cube, state->cube_bounds, white);
+        }
+    }
 
+    ClipCompressionSettings compression = { 0.001f, 0.001f, 0.001f };
+    AnimationClip idle = CreateHeroClip(&state->scratch_arena, 3.0f, 0.05f, 0.0f);
+    AnimationClip walk = CreateHeroClip(&state->scratch_arena, 1.0f, 0.15f, radians(8.0f));
+    state->hero_clips[0] = CompressClip(&state->persist_arena, &state->scratch_arena, &idle, compression);
+    state->hero_clips[1] = CompressClip(&state->persist_arena, &state->scratch_arena, &walk, compression);
+    state->hero_layers[0] = CreateAnimationLayer(&state->persist_arena, &state->hero_clips[0], true);
+    state->hero_layers[1] = CreateAnimationLayer(&state->persist_arena, &state->hero_clips[1], true);
+    state->hero_layers[0].weight = 1;
+    state->hero_pose = PushPose(&state->persist_arena, 1);
+    state->hero_pose_scratch = PushPose(&state->persist_arena, 1);
+    state->scratch_arena.count = 0;
+
+    if (!headless) {
         LoadTexture("assets/wall.jpg", &state->wall);
 
         glClearColor(0, 0,0,0);
-
-        state->initialized = true;
     }
 
+    state->initialized = true;
+}
+
+// Simulation thread. Must not call GL, everything the renderer needs goes into the snapshot.
+void UpdateGame(RenderSnapshot *snapshot) {
+    ProfileFunction();
+
+    GameState *state = (GameState *)platform.memory;
+
     /* TODO:
         [x] draw a textured 3D cube
         [x] move textured cube around
         [] draw 3D line
         [] orbit camera controls attached to cube
-        [] fill scene with objects
+        [x] fill scene with objects
         [] lighting
-        [] entity parent-child relationships
+        [x] entity parent-child relationships
+        [x] entity component storage
         [] particle system entity
-        [] culling (collision volumes)
+        [x] culling (collision volumes)
         [] create 3D model
         [] rig 3D model
         [] render and animate 3D model in-engine
@@ -128,7 +344,11 @@ void UpdateAndRender() {
     */
 
 
+    BeginDebugDrawFrame(&state->debug_draw, (f32)platform.delta_time);
+
     Camera *camera = GetGameCamera();
+    EntityWorld *world = &state->world;
+    TransformHierarchy *transforms = &state->transforms;
 #if 0
     float radius = 10.0f;
     float camX = static_cast<float>(sin(glfwGetTime()) * radius);
@@ -137,22 +357,36 @@ void UpdateAndRender() {
     camera->target = {};
 #endif
 
+    v3 hero_velocity = {};
+
     if (IsKeyPressed(GLFW_KEY_W)) {
-        state->hero_position.z -= 1 * platform.delta_time;
+        hero_velocity.z -= 1;
     }
 
     if (IsKeyPressed(GLFW_KEY_S)) {
-        state->hero_position.z += 1 * platform.delta_time;
+        hero_velocity.z += 1;
     }
 
     if (IsKeyPressed(GLFW_KEY_Q) || IsKeyPressed(GLFW_KEY_A)) {
-        state->hero_position.x -= 1 * platform.delta_time;
+        hero_velocity.x -= 1;
     }
 
     if (IsKeyPressed(GLFW_KEY_E) || IsKeyPressed(GLFW_KEY_D)) {
-        state->hero_position.x += 1 * platform.delta_time;
+        hero_velocity.x += 1;
     }
 
+    SetEntityVelocity(world, state->hero.entity, hero_velocity);
+
+    // fade between the idle and walk loops
+    f32 walk_target = hero_velocity != v3(0) ? 1.0f : 0.0f;
+    f32 walk_weight = state->hero_layers[1].weight;
+    walk_weight += clamp(walk_target - walk_weight, -4 * (f32)platform.delta_time, 4 * (f32)platform.delta_time);
+    state->hero_layers[0].weight = 1 - walk_weight;
+    state->hero_layers[1].weight = walk_weight;
+
+    AdvanceAnimationLayers(state->hero_layers, ArrayCount(state->hero_layers), platform.delta_time);
+    SampleAnimationLayers(state->hero_layers, ArrayCount(state->hero_layers), &state->hero_pose_scratch, &state->hero_pose);
+
     InputEvent input_event;
     while (GetNextInputEvent(&input_event)) {
         if (input_event.type == CursorPositionEvent) {
@@ -171,6 +405,7 @@ void UpdateAndRender() {
                 v3 up    = normalize(cross(right, front));
 
                 SetObjectBasis(&state->hero, front);
+                SetLocalBasis(transforms, GetTransformNode(world, state->hero.entity), &state->hero.basis);
             } else if (IsButtonPressed(GLFW_MOUSE_BUTTON_LEFT)) {
                 // change the camera direction
                 f32 rotate_speed = 0.1f;
@@ -180,6 +415,20 @@ void UpdateAndRender() {
             }
         }
 
+        if (input_event.type == KeyEvent && input_event.key == GLFW_KEY_C && input_event.action == GLFW_PRESS) {
+            CullingStats *stats = &state->culling_stats;
+            fprintf(stdout, "culling: %d tested, %d culled, %d drawn\n", stats->tested, stats->culled, stats->drawn);
+            state->freeze_frustum = true;
+        }
+
+        if (input_event.type == KeyEvent && input_event.key == GLFW_KEY_F5 && input_event.action == GLFW_PRESS) {
+            state->show_bvh = !state->show_bvh;
+        }
+
+        if (input_event.type == KeyEvent && input_event.action == GLFW_PRESS) {
+            HandleProfilerKey(&state->show_profiler, &state->show_frame_graph, input_event.key);
+        }
+
         if (input_event.type == MouseScrollEvent) {
             f32 scroll = -input_event.y;
             f32 zoom_speed = 0.5f;
@@ -187,60 +436,108 @@ void UpdateAndRender() {
         }
     }
 
-    /* child-parent update if camera is anchored to hero */
-    v3 child_position_offset = v3(0,0,0);
-    camera->target = state->hero_position + child_position_offset;
+    int first_dirty = MoveEntities(world, transforms, platform.delta_time, 0, world->stores[VelocityComponent].count);
+    transforms->first_dirty = Min(transforms->first_dirty, first_dirty);
+    SetLocalFromPose(transforms, GetTransformNode(world, state->hero_body), &state->hero_pose, 0);
 
-    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+    UpdateTransforms(transforms);
+    ExtractRenderables(world, transforms, 0, world->stores[RenderComponent].count);
+    UpdateRenderProxies(world, &state->bvh);
 
-    mat4 i = mat4(1.0f);
+    // the camera anchor is a child of the hero
+    camera->target = GetWorldPosition(transforms, GetTransformNode(world, state->camera_anchor));
 
-    u32 temp = glutil_sampler_2d;
-    glutil_sampler_2d = state->wall.id;
-    DrawMesh(state->cube, state->hero_position, {1,1,1,1}, &state->hero.basis);
-    DrawMesh(state->cube, v3(3, 0, 0), {1,1,1,1}, &i);
-    glutil_sampler_2d = temp;
+    f32 hit_distance;
+    {
+        ProfileBlock("Pick");
+        state->hovered_entity = (Entity)RaycastBVH(&state->bvh, GetCursorRay(camera), 100.0f, &hit_distance);
+    }
 
-    glDisable(GL_DEPTH_TEST);
-    DrawLine(state->hero_position, state->hero_position + v3(state->hero.basis[0]), v4(1, 0, 0, 1));
-    DrawLine(state->hero_position, state->hero_position + v3(state->hero.basis[1]), v4(0, 1, 0, 1));
-    DrawLine(state->hero_position, state->hero_position + v3(state->hero.basis[2]), v4(0, 0, 1, 1));
-    glEnable(GL_DEPTH_TEST);
+    mat4 view, projection;
+    GetCameraTransform(camera, &view);
+    GetProjectionTransform(&projection);
+    mat4 view_projection = projection * view;
+    Frustum frustum = ExtractFrustumPlanes(&view_projection);
+
+    if (state->freeze_frustum) {
+        // shrunk a little towards the far plane so it doesn't fill the view it was taken from
+        mat4 frozen = perspective(radians(45.0f), (f32)platform.framebuffer_width / (f32)platform.framebuffer_height, 0.1f, 20.0f) * view;
+        DebugFrustum(&state->debug_draw, &frozen, v4(1, 1, 0, 1), DebugDepthTest, 5.0f);
+        state->freeze_frustum = false;
+    }
+    if (state->show_bvh) DebugDrawBVH(&state->debug_draw, &state->bvh);
+
+    state->culling_stats = {};
+    BoundingSpheres render_bounds = GetRenderBounds(world);
+    int visible_count = CullSpheres(&frustum, &render_bounds, state->visible_renderables, &state->culling_stats);
+
+    // record on the workers, sort and submit here
+    RenderQueue *render_queue = &state->render_queue;
+    ResetRenderQueue(render_queue);
+
+    RecordRenderablesJob record = {};
+    record.world = world;
+    record.transforms = transforms;
+    record.queue = render_queue;
+    record.visible = state->visible_renderables;
+    record.hovered_entity = state->hovered_entity;
+    record.texture = state->wall.id;
+    record.view_projection = view_projection;
+    ParallelFor(RecordRenderables, &record, visible_count, RECORD_BATCH_SIZE);
+
+    FinishRenderQueue(render_queue);
+
+    BeginRenderSnapshot(snapshot, state->frame++, &view, &projection);
+    snapshot->show_profiler = state->show_profiler;
+    snapshot->show_frame_graph = state->show_frame_graph;
+    CopyRenderQueue(snapshot, render_queue);
+
+    v3 hero_position = GetWorldPosition(transforms, GetTransformNode(world, state->hero.entity));
+    mat3 hero_basis = mat3(state->hero.basis);
+    DebugAxes(&state->debug_draw, hero_position, &hero_basis, 1.0f, 0, 0);
+
+    CopyDebugDraw(snapshot, &state->debug_draw);
 }
 
+// Main thread. Only reads the snapshot, the simulation may already be working on the next frame.
+void RenderGame(RenderSnapshot *snapshot) {
+    ProfileFunction();
 
-void *ArenaAlloc(Arena *arena, u64 count) {
-    if (arena->count + count > arena->size) {
-        u64 new_size = arena->size * 2;
-        arena->base_address = realloc(arena->base_address, new_size);
-        fprintf(stderr, "INFO: Arena resized: (%lld -> %lld)\n", arena->size, new_size);
-        arena->size = new_size;
+    if (!platform.window) {
+        SubmitNullRenderer(snapshot, &platform.null_renderer);
+        return;
     }
 
-    void *result = (u8 *)arena->base_address + arena->count;
-    arena->count += count;
+    BeginGpuFrame();
 
-    memset(result, 0, count);
-
-    return result;
-}
+    {
+        GpuPassBlock("Clear");
+        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+    }
 
-Arena CreateArena(u64 size) {
-    Arena result = {};
-    result.base_address = malloc(size);
-    result.size = size;
+    {
+        GpuPassBlock("Meshes");
+        SubmitRenderCommands(snapshot);
+    }
 
-    return result;
-}
+    mat4 view_projection = snapshot->projection * snapshot->view;
+    {
+        GpuPassBlock("DebugDraw");
+        SubmitDebugDraw(&snapshot->debug_draw, &view_projection);
+    }
 
-Arena CreateArena(void *base_address, u64 size) {
-    Arena result = {};
-    result.base_address = base_address;
-    result.size = size;
+    glDisable(GL_DEPTH_TEST);
 
-    return result;
+    if (snapshot->show_profiler || snapshot->show_frame_graph) {
+        GpuPassBlock("UI");
+        if (snapshot->show_profiler) DrawProfileOverlay();
+        if (snapshot->show_frame_graph) DrawFrameTimeGraph();
+        if (snapshot->show_profiler || snapshot->show_frame_graph) FlushText(GetDebugFont());
+    }
+    glEnable(GL_DEPTH_TEST);
 }
 
+
 void GetProjectionTransform(mat4 *m) {
     GameState *state = (GameState *)platform.memory;
     *m = state->projection;
@@ -259,6 +556,17 @@ void GetCameraTransform(Camera *camera, mat4 *t) {
     *t = result;
 }
 
+Ray GetCursorRay(Camera *camera) {
+    mat4 view, projection;
+    GetCameraTransform(camera, &view);
+    GetProjectionTransform(&projection);
+    mat4 view_projection = projection * view;
+
+    Ray result = ScreenToRay((f32)platform.cursor_x, (f32)platform.cursor_y,
+                             platform.framebuffer_width, platform.framebuffer_height, &view_projection);
+    return result;
+}
+
 Camera *GetGameCamera() {
     GameState *state = (GameState *)platform.memory;
     return &state->camera;
@@ -287,8 +595,7 @@ void RotateUp(Camera *camera, f32 radians) {
     camera->polar = glm::clamp(camera->polar += radians, -polar_cap, polar_cap);
 }
 
-
-void DrawMesh(Mesh mesh, v3 position, v4 color, mat4 *basis) {
+static u32 GetMeshProgram() {
     static b32 initialized = false;
     static u32 program = 0;
 
@@ -342,112 +649,175 @@ void DrawMesh(Mesh mesh, v3 position, v4 color, mat4 *basis) {
         initialized = true;
     }
 
-    Camera *camera = GetGameCamera();
-
-    mat4 view;
-    GetCameraTransform(camera, &view);
+    return program;
+}
 
-    mat4 projection;
-    GetProjectionTransform(&projection);
+// Draws the snapshot's commands, state is only changed when the sorted commands change it.
+void SubmitRenderCommands(RenderSnapshot *snapshot) {
+    ProfileFunction();
 
-    mat4 model = mat4(1.0f);
-    model = translate(model, position);
-    model = model * (*basis);
+    u32 program = GetMeshProgram();
 
     glUseProgram(program);
+    glUniformMatrix4fv(glGetUniformLocation(program, "view"), 1, GL_FALSE, (f32*)&snapshot->view);
+    glUniformMatrix4fv(glGetUniformLocation(program, "projection"), 1, GL_FALSE, (f32*)&snapshot->projection);
     int color_location = glGetUniformLocation(program, "color");
-    glUniform4fv(color_location, 1, (f32*)&color);
+    int model_location = glGetUniformLocation(program, "model");
+    glActiveTexture(GL_TEXTURE0);
 
-    int view_location = glGetUniformLocation(program, "view");
-    glUniformMatrix4fv(view_location, 1, GL_FALSE, (f32*)&view);
+    u32 bound_texture = 0;
+    u32 bound_vao = 0;
+    for (int i = 0; i < snapshot->command_count; ++i) {
+        RenderCommand *command = snapshot->commands + i;
 
-    int projection_location = glGetUniformLocation(program, "projection");
-    glUniformMatrix4fv(projection_location, 1, GL_FALSE, (f32*)&projection);
+        if (command->texture != bound_texture) {
+            glBindTexture(GL_TEXTURE_2D, command->texture);
+            bound_texture = command->texture;
+        }
 
-    int model_location = glGetUniformLocation(program, "model");
-    glUniformMatrix4fv(model_location, 1, GL_FALSE, (f32*)&model);
+        if (command->mesh.vao != bound_vao) {
+            glBindVertexArray(command->mesh.vao);
+            bound_vao = command->mesh.vao;
+        }
 
-    glActiveTexture(GL_TEXTURE0);
-    glBindTexture(GL_TEXTURE_2D, glutil_sampler_2d);
+        glUniform4fv(color_location, 1, (f32*)&command->color);
+        glUniformMatrix4fv(model_location, 1, GL_FALSE, (f32*)&command->model);
+        glDrawArrays(GL_TRIANGLES, 0, command->mesh.vertex_count);
+    }
+}
 
-    glBindVertexArray(mesh.vao);
-    glDrawArrays(GL_TRIANGLES, 0, mesh.vertex_count);
+GAME_EXPORT GAME_LOAD(GameLoad) {
+#ifdef GAME_MODULE
+    platform_context = context;
+    platform_api = api;
+#else
+    (void)api; // linked in, the platform layer is called directly
+#endif
+
+    // benchmarks load the game without a window
+    if (context->window) {
+#ifdef GAME_MODULE
+        // this copy of the library has its own GL function pointers
+        glewInit();
+#endif
+        InitializeUtilBuffers();
+    }
 }
 
-void DrawLine(v3 a, v3 b, v4 color) {
-    static GLuint vao, vbo, program;
-    static b32 initialized = false;
-    static int mvp_location, color_location;
+GAME_EXPORT GAME_INIT(GameInit) {
+    InitGame(snapshot_count);
+}
 
-    if (!initialized) {
-        glGenVertexArrays(1, &vao);
-        glGenBuffers(1, &vbo);
-        glBindVertexArray(vao);
-        glBindBuffer(GL_ARRAY_BUFFER, vbo);
-        glBufferData(GL_ARRAY_BUFFER, 2 * sizeof(v3), 0, GL_DYNAMIC_DRAW);
-        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(v3), 0);
-        glEnableVertexAttribArray(0);
+GAME_EXPORT GAME_UPDATE(GameUpdate) {
+    GameState *state = (GameState *)platform.memory;
+    UpdateGame(state->snapshots + snapshot);
+}
 
-        const char *vertex_source = R"(
-            #version 460
-            layout (location = 0) in vec3 p;
+GAME_EXPORT GAME_RENDER(GameRender) {
+    GameState *state = (GameState *)platform.memory;
+    RenderGame(state->snapshots + snapshot);
+}
 
-            uniform mat4 mvp;
+GAME_EXPORT GAME_RUN_BENCHMARKS(GameRunBenchmarks) {
+    BenchmarkSkinning();
+    BenchmarkAnimationSampling();
+    BenchmarkBVH();
+    BenchmarkEntities();
+    BenchmarkPathfinding();
+    BenchmarkUI();
+    BenchmarkSprites();
+    BenchmarkTilemap();
+    BenchmarkImpostors();
+    BenchmarkPicking();
+    BenchmarkWorld();
+}
 
-            void  main() {
-                gl_Position = mvp * vec4(p, 1.0);
-            }
-        )";
+#ifdef GAME_MODULE
+double GetTime() {
+    return platform_api->GetTime();
+}
 
-        const char *frag_source = R"(
-            #version 460
+void GetWindowFramebufferSize(int *width, int *height) {
+    platform_api->GetWindowFramebufferSize(width, height);
+}
 
-            out vec4 frag_color;
-            uniform vec4 color;
+bool GetNextInputEvent(InputEvent *event) {
+    return platform_api->GetNextInputEvent(event);
+}
 
-            void main() {
-                frag_color = color;
-            }
-        )";
+bool IsButtonPressed(int button) {
+    return platform_api->IsButtonPressed(button);
+}
 
-        GLuint vs = glCreateShader(GL_VERTEX_SHADER);
-        glShaderSource(vs, 1, &vertex_source, 0);
+bool IsKeyPressed(int key) {
+    return platform_api->IsKeyPressed(key);
+}
 
-        GLuint fs = glCreateShader(GL_FRAGMENT_SHADER);
-        glShaderSource(fs, 1, &frag_source, 0);
+bool MapFile(const char *filename, MappedFile *file) {
+    return platform_api->MapFile(filename, file);
+}
 
-        CompileShader(vs);
-        CompileShader(fs);
+void UnmapFile(MappedFile *file) {
+    platform_api->UnmapFile(file);
+}
 
-        program = glCreateProgram();
-        glAttachShader(program, vs);
-        glAttachShader(program, fs);
-        LinkProgram(program);
-        glDeleteShader(vs);
-        glDeleteShader(fs);
+int GetCoreCount() {
+    return platform_api->GetCoreCount();
+}
 
-        mvp_location = glGetUniformLocation(program, "mvp");
-        color_location = glGetUniformLocation(program, "color");
+void InitJobSystem(Arena *arena, int thread_count) {
+    platform_api->InitJobSystem(arena, thread_count);
+}
 
-        initialized = true;
-    }
+void ShutdownJobSystem() {
+    platform_api->ShutdownJobSystem();
+}
 
-    v3 points[] = { a, b };
-    glNamedBufferSubData(vbo, 0, sizeof(v3) * 2, (f32 *)points);
+int GetJobThreadIndex() {
+    return platform_api->GetJobThreadIndex();
+}
 
-    Camera *camera = GetGameCamera();
+int GetJobThreadCount() {
+    return platform_api->GetJobThreadCount();
+}
 
-    mat4 view;
-    GetCameraTransform(camera, &view);
+void RunJob(JobFunction *function, void *data, JobCounter *counter, JobCounter *dependency) {
+    platform_api->RunJob(function, data, counter, dependency);
+}
 
-    mat4 projection;
-    GetProjectionTransform(&projection);
+void ParallelFor(JobFunction *function, void *data, int count, int batch_size, JobCounter *counter, JobCounter *dependency) {
+    platform_api->ParallelFor(function, data, count, batch_size, counter, dependency);
+}
 
-    mat4 mvp = projection * view;
+void ParallelFor(JobFunction *function, void *data, int count, int batch_size) {
+    platform_api->ParallelForAndWait(function, data, count, batch_size);
+}
 
-    glUseProgram(program);
-    glUniformMatrix4fv(mvp_location, 1, GL_FALSE, (f32 *)&mvp);
-    glUniform4fv(color_location, 1, (f32 *)&color);
-    glBindVertexArray(vao);
-    glDrawArrays(GL_LINES, 0, 2);
+void WaitForCounter(JobCounter *counter) {
+    platform_api->WaitForCounter(counter);
+}
+
+void RecordProfileZone(const char *name, u64 start, u64 end) {
+    platform_api->RecordProfileZone(name, start, end);
+}
+
+void RecordGpuProfileZone(const char *name, double start, double end) {
+    platform_api->RecordGpuProfileZone(name, start, end);
+}
+
+u64 GetProfileFrameCount() {
+    return platform_api->GetProfileFrameCount();
+}
+
+bool GetProfileSummary(ProfileSummary *summary, u64 frame) {
+    return platform_api->GetProfileSummary(summary, frame);
 }
+
+bool ExportProfileTrace(const char *path, u64 first_frame, u64 one_past_last_frame) {
+    return platform_api->ExportProfileTrace(path, first_frame, one_past_last_frame);
+}
+
+void GetFrameStats(FrameStatsView *view) {
+    platform_api->GetFrameStats(view);
+}
+#endif
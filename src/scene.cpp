@@ -0,0 +1,266 @@
+#include <glm-1.0.1/glm/gtc/quaternion.hpp>
+
+/*
+    Transform hierarchy.
+
+    Nodes live in flat arrays sorted parents-before-children (a node can only be parented to a node
+    that already exists), local transforms are SoA in a Pose and world transforms are cached
+    matrices. Changing a local transform marks the node dirty; UpdateTransforms walks the arrays
+    once from the first dirty node, propagates the flag from parent to child and only recomputes
+    world matrices under something that moved.
+
+    Removed nodes go on a free list and are skipped by the sweep; a new node reuses one that sits
+    after its parent. Reparenting under an earlier node only rewrites the parent. Reparenting under
+    a later node stably moves the subtree's nodes in [node, parent] to just after the parent, so
+    nodes in that range change index; each node carries its owner's id so the caller can fix up
+    the indices it holds.
+*/
+
+#define NO_PARENT -1
+#define FREE_TRANSFORM -2
+
+struct TransformHierarchy {
+    int count;
+    int capacity;
+    int first_dirty;
+    u32 frame; // bumped by every UpdateTransforms
+
+    int *parents; // FREE_TRANSFORM for removed nodes
+    int *child_counts;
+    u32 *owners; // caller's id for the node, moves with it
+    Pose local;
+    mat4 *world;
+    u8 *dirty;
+    u32 *world_frame; // frame the world transform last changed on
+
+    int free_count;
+    int *free_nodes;
+    int *sort_scratch; // 2 * capacity, reparenting's old to new index and column copies
+};
+
+TransformHierarchy CreateTransformHierarchy(Arena *arena, int capacity) {
+    TransformHierarchy result = {};
+    result.capacity = capacity;
+    result.first_dirty = capacity;
+    result.parents = (int *)ArenaAlloc(arena, sizeof(int) * capacity);
+    result.child_counts = (int *)ArenaAlloc(arena, sizeof(int) * capacity);
+    result.owners = (u32 *)ArenaAlloc(arena, sizeof(u32) * capacity);
+    result.world_frame = (u32 *)ArenaAlloc(arena, sizeof(u32) * capacity);
+    result.free_nodes = (int *)ArenaAlloc(arena, sizeof(int) * capacity);
+    result.sort_scratch = (int *)ArenaAlloc(arena, sizeof(int) * 2 * capacity);
+    result.local = PushPose(arena, capacity);
+    result.world = (mat4 *)ArenaAllocAligned(arena, sizeof(mat4) * capacity, 16);
+    result.dirty = (u8 *)ArenaAlloc(arena, sizeof(u8) * capacity);
+
+    return result;
+}
+
+inline void MarkTransformDirty(TransformHierarchy *h, int node) {
+    h->dirty[node] = 1;
+    h->first_dirty = Min(h->first_dirty, node);
+}
+
+inline b32 IsTransformFree(TransformHierarchy *h, int node) {
+    return h->parents[node] == FREE_TRANSFORM;
+}
+
+int AddTransform(TransformHierarchy *h, int parent, u32 owner) {
+    Assert(parent < h->count);
+    Assert(parent == NO_PARENT || !IsTransformFree(h, parent));
+
+    // any free node after the parent keeps the order, usually the last one freed
+    int result = -1;
+    for (int i = h->free_count - 1; i >= 0; --i) {
+        if (h->free_nodes[i] > parent) {
+            result = h->free_nodes[i];
+            h->free_nodes[i] = h->free_nodes[--h->free_count];
+            break;
+        }
+    }
+    if (result < 0) {
+        Assert(h->count < h->capacity);
+        result = h->count++;
+    }
+
+    h->parents[result] = parent;
+    h->child_counts[result] = 0;
+    h->owners[result] = owner;
+    if (parent != NO_PARENT) ++h->child_counts[parent];
+    h->world[result] = mat4(1.0f);
+    h->world_frame[result] = 0;
+
+    Pose *local = &h->local;
+    local->tx[result] = local->ty[result] = local->tz[result] = 0;
+    local->qx[result] = local->qy[result] = local->qz[result] = 0;
+    local->qw[result] = 1;
+    local->scale[result] = 1;
+
+    MarkTransformDirty(h, result);
+
+    return result;
+}
+
+// The node's children move up to its parent and keep their local transforms.
+void RemoveTransform(TransformHierarchy *h, int node) {
+    Assert(!IsTransformFree(h, node));
+
+    int parent = h->parents[node];
+    for (int i = node + 1; i < h->count && h->child_counts[node]; ++i) {
+        if (h->parents[i] != node) continue;
+        h->parents[i] = parent;
+        --h->child_counts[node];
+        if (parent != NO_PARENT) ++h->child_counts[parent];
+        MarkTransformDirty(h, i);
+    }
+
+    if (parent != NO_PARENT) --h->child_counts[parent];
+    h->parents[node] = FREE_TRANSFORM;
+    h->dirty[node] = 0;
+    h->free_nodes[h->free_count++] = node;
+}
+
+// Keeps the node's local transform, so it snaps into the new parent's space. Reparenting under a
+// later node re-sorts [node, parent]: afterwards h->owners says which node is where in that range.
+void ReparentTransform(TransformHierarchy *h, int node, int parent) {
+    Assert(!IsTransformFree(h, node));
+    Assert(parent == NO_PARENT || !IsTransformFree(h, parent));
+
+    // a node can't go under its own subtree, which is all after it
+    for (int ancestor = parent; ancestor > node; ancestor = h->parents[ancestor]) {
+        Assert(h->parents[ancestor] != node);
+    }
+    Assert(parent != node);
+
+    int old_parent = h->parents[node];
+    if (old_parent != NO_PARENT) --h->child_counts[old_parent];
+    if (parent != NO_PARENT) ++h->child_counts[parent];
+    h->parents[node] = parent;
+    MarkTransformDirty(h, node);
+
+    if (parent < node) return;
+
+    // nodes in the range that aren't in the subtree keep their order and go first, the subtree
+    // follows them in its own order, so parents still come before children
+    int range = parent - node + 1;
+    int *new_index = h->sort_scratch;
+    int *copy = h->sort_scratch + h->capacity;
+    u8 *in_subtree = (u8 *)copy;
+    int outside_count = 0;
+    for (int i = node; i <= parent; ++i) {
+        int p = h->parents[i];
+        in_subtree[i - node] = i == node || (p >= node && in_subtree[p - node]);
+        outside_count += !in_subtree[i - node];
+    }
+    int next_outside = node;
+    int next_inside = node + outside_count;
+    for (int i = node; i <= parent; ++i) {
+        new_index[i - node] = in_subtree[i - node] ? next_inside++ : next_outside++;
+    }
+
+    // children anywhere after the range may point into it
+    for (int i = node; i < h->count; ++i) {
+        int p = h->parents[i];
+        if (p >= node && p <= parent) h->parents[i] = new_index[p - node];
+    }
+    for (int i = 0; i < h->free_count; ++i) {
+        int free_node = h->free_nodes[i];
+        if (free_node >= node && free_node <= parent) h->free_nodes[i] = new_index[free_node - node];
+    }
+
+    int *columns[] = { h->parents, h->child_counts, (int *)h->owners,
+                       (int *)h->local.tx, (int *)h->local.ty, (int *)h->local.tz,
+                       (int *)h->local.qx, (int *)h->local.qy, (int *)h->local.qz, (int *)h->local.qw,
+                       (int *)h->local.scale };
+    for (int c = 0; c < (int)ArrayCount(columns); ++c) {
+        int *column = columns[c] + node;
+        for (int i = 0; i < range; ++i) copy[new_index[i] - node] = column[i];
+        memcpy(column, copy, sizeof(int) * range);
+    }
+
+    // world matrices aren't moved, the whole range is recomputed instead
+    for (int i = node; i <= parent; ++i) {
+        if (!IsTransformFree(h, i)) h->dirty[i] = 1;
+    }
+}
+
+void SetLocalPosition(TransformHierarchy *h, int node, v3 position) {
+    h->local.tx[node] = position.x;
+    h->local.ty[node] = position.y;
+    h->local.tz[node] = position.z;
+    MarkTransformDirty(h, node);
+}
+
+void SetLocalRotation(TransformHierarchy *h, int node, quat rotation) {
+    h->local.qx[node] = rotation.x;
+    h->local.qy[node] = rotation.y;
+    h->local.qz[node] = rotation.z;
+    h->local.qw[node] = rotation.w;
+    MarkTransformDirty(h, node);
+}
+
+// basis must be orthonormal
+void SetLocalBasis(TransformHierarchy *h, int node, mat4 *basis) {
+    SetLocalRotation(h, node, quat_cast(*basis));
+}
+
+void SetLocalScale(TransformHierarchy *h, int node, f32 scale) {
+    h->local.scale[node] = scale;
+    MarkTransformDirty(h, node);
+}
+
+// Copies joint from an animation pose into the node's local transform.
+void SetLocalFromPose(TransformHierarchy *h, int node, Pose *pose, int joint) {
+    Pose *local = &h->local;
+    local->tx[node] = pose->tx[joint];
+    local->ty[node] = pose->ty[joint];
+    local->tz[node] = pose->tz[joint];
+    local->qx[node] = pose->qx[joint];
+    local->qy[node] = pose->qy[joint];
+    local->qz[node] = pose->qz[joint];
+    local->qw[node] = pose->qw[joint];
+    local->scale[node] = pose->scale[joint];
+    MarkTransformDirty(h, node);
+}
+
+v3 GetLocalPosition(TransformHierarchy *h, int node) {
+    v3 result = { h->local.tx[node], h->local.ty[node], h->local.tz[node] };
+    return result;
+}
+
+mat4 *GetWorldTransform(TransformHierarchy *h, int node) {
+    return h->world + node;
+}
+
+v3 GetWorldPosition(TransformHierarchy *h, int node) {
+    v3 result = v3(h->world[node][3]);
+    return result;
+}
+
+// Returns how many world transforms were recomputed.
+int UpdateTransforms(TransformHierarchy *h) {
+    ProfileFunction();
+
+    int updated = 0;
+    ++h->frame;
+
+    for (int i = h->first_dirty; i < h->count; ++i) {
+        int parent = h->parents[i];
+
+        // parents come first, so their flag is final by the time we get here, free nodes stay clean
+        if (parent >= 0 && h->dirty[parent]) h->dirty[i] = 1;
+
+        if (h->dirty[i]) {
+            mat4 local = GetJointTransform(&h->local, i);
+            h->world[i] = parent < 0 ? local : h->world[parent] * local;
+            h->world_frame[i] = h->frame;
+            ++updated;
+        }
+    }
+
+    if (h->first_dirty < h->count) {
+        memset(h->dirty + h->first_dirty, 0, h->count - h->first_dirty);
+    }
+    h->first_dirty = h->capacity;
+
+    return updated;
+}
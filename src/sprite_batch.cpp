@@ -0,0 +1,370 @@
+/*
+    Isometric sprite batch.
+
+    Every sprite carries a depth key built from its tile, IsoDepthKey: the diagonal (x + y) in
+    the high bits, then elevation, then the layer within a tile. Drawing in key order is the
+    painter's order for an isometric map, trees and cubes overlap the tiles behind them and get
+    covered by the tiles in front.
+
+    Two ways to get that order, both O(n):
+
+    use_depth_buffer: the key becomes the sprite's depth and the depth test does the ordering, so
+    sprites are drawn in submission order with no sort at all. Fragments under SPRITE_ALPHA_CUTOFF
+    are discarded so transparent texels don't write depth, which means soft sprite edges are cut
+    hard instead of blended.
+
+    Otherwise the sprites are sorted on the key with RadixSort (radix_sort.cpp), which only runs
+    the passes for the key's bytes that differ, and drawn back to front with blending. The sort is stable, sprites with equal keys keep the order they
+    were pushed in, and the depth buffer path matches that with GL_LEQUAL.
+
+    Either way it's one draw: up to SPRITE_BATCH_MAX_TEXTURES sheets are bound at once and each
+    vertex says which one it samples. Gradients are taken before the switch on the sheet, so
+    mipmapped sheets pick their level even though the sampling happens in a branch.
+*/
+
+#define SPRITE_BATCH_MAX_TEXTURES 8
+#define SPRITE_ALPHA_CUTOFF 0.5f
+
+#define SPRITE_LAYER_BITS 4
+#define SPRITE_ELEVATION_BITS 6
+#define SPRITE_DIAGONAL_BITS 12 // maps up to 2048 x 2048 tiles
+#define SPRITE_KEY_BITS (SPRITE_DIAGONAL_BITS + SPRITE_ELEVATION_BITS + SPRITE_LAYER_BITS)
+
+// Draw order of sprites on the same tile and elevation.
+enum SpriteLayer {
+    SpriteLayerGround,
+    SpriteLayerOverlay,
+    SpriteLayerObject,
+    SpriteLayerEffect,
+};
+
+struct Sprite {
+    Rect dest; // pixels, top left origin
+    Rect texture_rect; // texels, top left origin
+    u32 key;
+    u32 texture; // slot in the batch
+};
+
+struct SpriteVertex {
+    v3 p; // pixels, z is the depth in NDC
+    v2 uv;
+    u32 texture;
+};
+
+struct SpriteBatch {
+    int count;
+    int capacity;
+    Sprite *sprites;
+    SortEntry *sort_entries; // key and sprite index
+    SortEntry *sort_temp;
+    SpriteVertex *vertices;
+
+    Texture textures[SPRITE_BATCH_MAX_TEXTURES];
+    int texture_count;
+
+    b32 use_depth_buffer;
+
+    GLuint vao;
+    GLuint vbo;
+    GLuint ibo;
+    GLuint program;
+    int screen_size_location;
+    int alpha_cutoff_location;
+
+    int draw_calls; // last FlushSprites, for the overlay
+    int sort_passes;
+};
+
+// Larger keys are drawn later (in front). Tiles are clamped to the key's range.
+u32 IsoDepthKey(int tile_x, int tile_y, int elevation, int layer) {
+    u32 diagonal = (u32)clamp(tile_x + tile_y, 0, (1 << SPRITE_DIAGONAL_BITS) - 1);
+    u32 level = (u32)clamp(elevation, 0, (1 << SPRITE_ELEVATION_BITS) - 1);
+    u32 result = (diagonal << (SPRITE_ELEVATION_BITS + SPRITE_LAYER_BITS)) | (level << SPRITE_LAYER_BITS) | ((u32)layer & ((1 << SPRITE_LAYER_BITS) - 1));
+    return result;
+}
+
+static void InitSpriteRenderer(SpriteBatch *batch) {
+    glGenVertexArrays(1, &batch->vao);
+    glGenBuffers(1, &batch->vbo);
+    glGenBuffers(1, &batch->ibo);
+    glBindVertexArray(batch->vao);
+    glBindBuffer(GL_ARRAY_BUFFER, batch->vbo);
+    glBufferData(GL_ARRAY_BUFFER, sizeof(SpriteVertex) * 4 * batch->capacity, 0, GL_DYNAMIC_DRAW);
+
+    u32 *indices = (u32 *)malloc(sizeof(u32) * 6 * batch->capacity);
+    for (int i = 0; i < batch->capacity; ++i) {
+        u32 v = i * 4;
+        u32 *quad = indices + i * 6;
+        quad[0] = v; quad[1] = v + 1; quad[2] = v + 2;
+        quad[3] = v; quad[4] = v + 2; quad[5] = v + 3;
+    }
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, batch->ibo);
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(u32) * 6 * batch->capacity, indices, GL_STATIC_DRAW);
+    free(indices);
+
+    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(SpriteVertex), 0);
+    glEnableVertexAttribArray(0);
+    glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, sizeof(SpriteVertex), (void *)offsetof(SpriteVertex, uv));
+    glEnableVertexAttribArray(1);
+    glVertexAttribIPointer(2, 1, GL_UNSIGNED_INT, sizeof(SpriteVertex), (void *)offsetof(SpriteVertex, texture));
+    glEnableVertexAttribArray(2);
+    glBindVertexArray(0);
+
+    const char *vertex_source = R"(
+        #version 460
+        layout (location = 0) in vec3 p;
+        layout (location = 1) in vec2 uv;
+        layout (location = 2) in uint texture_slot;
+
+        uniform vec2 screen_size;
+
+        out vec2 vuv;
+        flat out uint vtexture;
+
+        void main() {
+            gl_Position = vec4(p.x / screen_size.x * 2.0 - 1.0, 1.0 - p.y / screen_size.y * 2.0, p.z, 1.0);
+            vuv = uv;
+            vtexture = texture_slot;
+        }
+    )";
+
+    // sampler arrays can't be indexed with a varying, a switch keeps every index constant
+    const char *frag_source = R"(
+        #version 460
+
+        in vec2 vuv;
+        flat in uint vtexture;
+
+        out vec4 frag_color;
+
+        uniform sampler2D sheets[8];
+        uniform float alpha_cutoff;
+
+        void main() {
+            vec2 dx = dFdx(vuv);
+            vec2 dy = dFdy(vuv);
+
+            vec4 color;
+            switch (vtexture) {
+                case 0: color = textureGrad(sheets[0], vuv, dx, dy); break;
+                case 1: color = textureGrad(sheets[1], vuv, dx, dy); break;
+                case 2: color = textureGrad(sheets[2], vuv, dx, dy); break;
+                case 3: color = textureGrad(sheets[3], vuv, dx, dy); break;
+                case 4: color = textureGrad(sheets[4], vuv, dx, dy); break;
+                case 5: color = textureGrad(sheets[5], vuv, dx, dy); break;
+                case 6: color = textureGrad(sheets[6], vuv, dx, dy); break;
+                default: color = textureGrad(sheets[7], vuv, dx, dy); break;
+            }
+            if (color.a < alpha_cutoff) discard;
+            frag_color = color;
+        }
+    )";
+
+    GLuint vs = glCreateShader(GL_VERTEX_SHADER);
+    glShaderSource(vs, 1, &vertex_source, 0);
+    CompileShader(vs);
+
+    GLuint fs = glCreateShader(GL_FRAGMENT_SHADER);
+    glShaderSource(fs, 1, &frag_source, 0);
+    CompileShader(fs);
+
+    batch->program = glCreateProgram();
+    glAttachShader(batch->program, vs);
+    glAttachShader(batch->program, fs);
+    LinkProgram(batch->program);
+    glDeleteShader(vs);
+    glDeleteShader(fs);
+
+    batch->screen_size_location = glGetUniformLocation(batch->program, "screen_size");
+    batch->alpha_cutoff_location = glGetUniformLocation(batch->program, "alpha_cutoff");
+
+    int units[SPRITE_BATCH_MAX_TEXTURES];
+    for (int i = 0; i < SPRITE_BATCH_MAX_TEXTURES; ++i) units[i] = i;
+    glProgramUniform1iv(batch->program, glGetUniformLocation(batch->program, "sheets"), SPRITE_BATCH_MAX_TEXTURES, units);
+}
+
+// Everything but the GL objects, BenchmarkSprites runs on this without a context.
+static SpriteBatch AllocateSpriteBatch(Arena *arena, int capacity) {
+    SpriteBatch result = {};
+    result.capacity = capacity;
+    result.sprites = (Sprite *)ArenaAlloc(arena, sizeof(Sprite) * capacity);
+    result.sort_entries = (SortEntry *)ArenaAlloc(arena, sizeof(SortEntry) * capacity);
+    result.sort_temp = (SortEntry *)ArenaAlloc(arena, sizeof(SortEntry) * capacity);
+    result.vertices = (SpriteVertex *)ArenaAlloc(arena, sizeof(SpriteVertex) * 4 * capacity);
+    result.use_depth_buffer = true;
+    return result;
+}
+
+// Main thread, needs the GL context.
+SpriteBatch CreateSpriteBatch(Arena *arena, int capacity) {
+    SpriteBatch result = AllocateSpriteBatch(arena, capacity);
+    InitSpriteRenderer(&result);
+    return result;
+}
+
+static u32 GetSpriteTextureSlot(SpriteBatch *batch, Texture texture) {
+    for (int i = 0; i < batch->texture_count; ++i) {
+        if (batch->textures[i].id == texture.id) return i;
+    }
+
+    // a flush here would break the ordering between the two halves
+    Assert(batch->texture_count < SPRITE_BATCH_MAX_TEXTURES);
+    batch->textures[batch->texture_count] = texture;
+    return batch->texture_count++;
+}
+
+void PushSprite(SpriteBatch *batch, Texture texture, Rect dest, Rect texture_rect, u32 key) {
+    if (batch->count == batch->capacity) return;
+
+    Sprite *sprite = batch->sprites + batch->count++;
+    sprite->dest = dest;
+    sprite->texture_rect = texture_rect;
+    sprite->key = key;
+    sprite->texture = GetSpriteTextureSlot(batch, texture);
+}
+
+static void BuildSpriteQuad(SpriteBatch *batch, Sprite *sprite, SpriteVertex *quad) {
+    Texture texture = batch->textures[sprite->texture];
+
+    // keys past the range of a 24 bit depth buffer would merge, half a step keeps them apart and
+    // the range stays behind z = 0, where the flat 2D overlays drawn after sit
+    f32 z = 1.0f - ((f32)sprite->key + 0.5f) / (f32)(1 << SPRITE_KEY_BITS);
+
+    f32 l = sprite->dest.x;
+    f32 r = sprite->dest.x + sprite->dest.width;
+    f32 t = sprite->dest.y;
+    f32 b = sprite->dest.y + sprite->dest.height;
+
+    f32 uvl = sprite->texture_rect.x / texture.width;
+    f32 uvr = (sprite->texture_rect.x + sprite->texture_rect.width) / texture.width;
+    f32 uvt = 1 - sprite->texture_rect.y / texture.height; // textures are loaded flipped
+    f32 uvb = 1 - (sprite->texture_rect.y + sprite->texture_rect.height) / texture.height;
+
+    quad[0] = { { l, t, z }, { uvl, uvt }, sprite->texture };
+    quad[1] = { { r, t, z }, { uvr, uvt }, sprite->texture };
+    quad[2] = { { r, b, z }, { uvr, uvb }, sprite->texture };
+    quad[3] = { { l, b, z }, { uvl, uvb }, sprite->texture };
+}
+
+// Fills batch->vertices in draw order, sorted by key unless the depth buffer does the ordering.
+static void BuildSpriteVertices(SpriteBatch *batch) {
+    if (batch->use_depth_buffer) {
+        for (int i = 0; i < batch->count; ++i) BuildSpriteQuad(batch, batch->sprites + i, batch->vertices + i * 4);
+    } else {
+        ProfileBlock("SortSprites");
+        for (int i = 0; i < batch->count; ++i) {
+            batch->sort_entries[i].key = batch->sprites[i].key;
+            batch->sort_entries[i].index = i;
+        }
+
+        SortEntry *sorted = RadixSort(batch->sort_entries, batch->sort_temp, batch->count, &batch->sort_passes);
+        for (int i = 0; i < batch->count; ++i) BuildSpriteQuad(batch, batch->sprites + sorted[i].index, batch->vertices + i * 4);
+    }
+}
+
+// Main thread. Draws everything pushed since the last flush in one draw and empties the batch.
+// Expects blending on, leaves depth testing off like the other 2D passes. Sprite positions are
+// pixels of a target_width x target_height render target.
+void FlushSpritesToTarget(SpriteBatch *batch, int target_width, int target_height) {
+    ProfileFunction();
+
+    batch->draw_calls = 0;
+    batch->sort_passes = 0;
+
+    if (!batch->count) {
+        batch->texture_count = 0;
+        return;
+    }
+
+    BuildSpriteVertices(batch);
+
+    glNamedBufferSubData(batch->vbo, 0, sizeof(SpriteVertex) * 4 * batch->count, batch->vertices);
+
+    if (batch->use_depth_buffer) {
+        glEnable(GL_DEPTH_TEST);
+        glDepthFunc(GL_LEQUAL);
+        glDepthMask(GL_TRUE);
+    } else {
+        glDisable(GL_DEPTH_TEST);
+    }
+
+    glUseProgram(batch->program);
+    glUniform2f(batch->screen_size_location, (f32)target_width, (f32)target_height);
+    glUniform1f(batch->alpha_cutoff_location, batch->use_depth_buffer ? SPRITE_ALPHA_CUTOFF : 1.0f / 255.0f);
+    for (int i = 0; i < batch->texture_count; ++i) glBindTextureUnit(i, batch->textures[i].id);
+
+    glBindVertexArray(batch->vao);
+    glDrawElements(GL_TRIANGLES, batch->count * 6, GL_UNSIGNED_INT, 0);
+    glBindVertexArray(0);
+    ++batch->draw_calls;
+
+    glDepthFunc(GL_LESS);
+    glDisable(GL_DEPTH_TEST);
+    glActiveTexture(GL_TEXTURE0);
+
+    batch->count = 0;
+    batch->texture_count = 0;
+}
+
+void FlushSprites(SpriteBatch *batch) {
+    int fb_width, fb_height;
+    GetWindowFramebufferSize(&fb_width, &fb_height);
+    FlushSpritesToTarget(batch, fb_width, fb_height);
+}
+
+// CPU side only: builds a frame's worth of sprites both ways and checks the sorted order.
+void BenchmarkSprites() {
+    const int sprite_count = 1 << 18;
+    const int map_size = 512;
+    const int iterations = 10;
+
+    Arena arena = CreateArena(Megabytes(64));
+    SpriteBatch batch = AllocateSpriteBatch(&arena, sprite_count);
+    Texture sheets[3] = { { 1, 1024, 1024 }, { 2, 512, 512 }, { 3, 2048, 1024 } };
+
+    // dest.x is the push order, equal keys have to come out in it
+    u32 seed = 99;
+    for (int i = 0; i < sprite_count; ++i) {
+        seed = seed * 1664525u + 1013904223u;
+        int x = (seed >> 8) % map_size;
+        seed = seed * 1664525u + 1013904223u;
+        int y = (seed >> 8) % map_size;
+        u32 key = IsoDepthKey(x, y, (seed >> 4) % 4, (seed >> 12) % 4);
+        PushSprite(&batch, sheets[i % 3], { (f32)i, 0, 64, 64 }, { 0, 0, 64, 64 }, key);
+    }
+
+    batch.use_depth_buffer = true;
+    double start = GetTime();
+    for (int i = 0; i < iterations; ++i) BuildSpriteVertices(&batch);
+    double depth_seconds = GetTime() - start;
+
+    batch.use_depth_buffer = false;
+    start = GetTime();
+    for (int i = 0; i < iterations; ++i) BuildSpriteVertices(&batch);
+    double sorted_seconds = GetTime() - start;
+
+    // z falls as the key rises, back to front; each sprite exactly once
+    b32 *seen = (b32 *)ArenaAlloc(&arena, sizeof(b32) * sprite_count);
+    memset(seen, 0, sizeof(b32) * sprite_count);
+    int out_of_order = 0;
+    for (int i = 0; i < sprite_count; ++i) {
+        SpriteVertex *quad = batch.vertices + i * 4;
+        int pushed = (int)quad[0].p.x;
+        Assert(!seen[pushed]);
+        seen[pushed] = true;
+
+        if (i == 0) continue;
+        SpriteVertex *previous = quad - 4;
+        if (quad[0].p.z > previous[0].p.z) ++out_of_order;
+        else if (quad[0].p.z == previous[0].p.z && pushed < (int)previous[0].p.x) ++out_of_order;
+    }
+
+    fprintf(stdout, "Sprites: %d on a %d x %d map\n", sprite_count, map_size, map_size);
+    fprintf(stdout, "  depth buffer: %7.3f ms/frame, no sort\n", depth_seconds * 1000 / iterations);
+    fprintf(stdout, "  sorted:       %7.3f ms/frame, %d radix passes, %d out of order\n",
+            sorted_seconds * 1000 / iterations, batch.sort_passes, out_of_order);
+    Assert(out_of_order == 0);
+    Assert(batch.sort_passes <= (SPRITE_KEY_BITS + 7) / 8);
+
+    free(arena.base_address);
+}
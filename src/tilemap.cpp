@@ -0,0 +1,442 @@
+/*
+    Layered tilemap.
+
+    The map is a stack of layers over one grid plus a height per tile. Each layer draws from a
+    single sheet, so a layer is one batch, and stores tile ids (a sheet cell, 0 for empty) in one
+    of two ways:
+
+    Dense layers, like the ground, are a plain columns * rows array of u16.
+
+    Sparse layers, like overlays and props, keep only their non empty tiles, sorted by grid index
+    (y * columns + x). Memory follows the content instead of the map area, a lookup is a binary
+    search, and walking a visible range is a search for its first row and a linear run after.
+    Setting tiles shifts the arrays, which is fine for editing but not for per frame changes.
+
+    Every layer tracks its tile count and the bounds of its content, so a renderer can skip the
+    whole layer when it's empty or its bounds are off screen.
+
+    The grid is also split into TILEMAP_CHUNK_SIZE square chunks, each with a revision that any
+    tile or height change in it bumps. Caches built from a chunk (impostors) compare revisions to
+    know when they're stale.
+
+    https://www.youtube.com/watch?v=04oQ2jOUjkU&t=254s&ab_channel=SimonDev
+    i,j
+    rotate 45
+    squash in half
+
+    i moves horizontally 1 tile width and down a half tile width (1, 0.5)
+    j moves horizontally -1 tile width and down a half tile width (-1, 0.5)
+
+    to find the screen coordinates of a tile, transforms the tile coordinates tx(1, 0.5) + ty(-1, 0.5)
+*/
+
+#define TILEMAP_MAX_LAYERS 8
+#define TILEMAP_ROTATION (2 / 3.0f) // 4 : 3 ?
+#define TILEMAP_CHUNK_SIZE 16
+
+// Tile ids: a cell of the layer's sheet, 0 is empty.
+#define MakeTile(row, column) (u16)((((row) << 8) | (column)) + 1)
+#define TileRow(tile) (((tile) - 1) >> 8)
+#define TileColumn(tile) (((tile) - 1) & 0xFF)
+
+struct TileRange {
+    int min_x;
+    int min_y;
+    int max_x; // inclusive, empty when min > max
+    int max_y;
+};
+
+struct TilemapLayer {
+    int sheet; // AssetTag
+    int sprite_layer; // SpriteLayer, draw order on a tile
+    f32 anchor_y; // texel row of a sheet cell that sits on the tile's top face
+    b32 sparse;
+    b32 hidden;
+
+    int tile_count;
+    TileRange bounds; // of the non empty tiles, only grows
+
+    u16 *tiles; // dense, columns * rows
+
+    int sparse_capacity;
+    u32 *sparse_indices; // sorted
+    u16 *sparse_tiles;
+};
+
+struct Tilemap {
+    int rows;
+    int columns;
+    int tile_width;
+    int tile_height;
+
+    u8 *heights; // elevation steps, columns * rows
+    int max_height; // only grows, for culling tall columns
+
+    int layer_count;
+    TilemapLayer layers[TILEMAP_MAX_LAYERS];
+
+    int chunk_columns;
+    int chunk_rows;
+    u32 *chunk_revisions; // start at 1
+};
+
+Tilemap CreateTilemap(Arena *arena, int columns, int rows, int tile_width, int tile_height) {
+    Tilemap result = {};
+    result.columns = columns;
+    result.rows = rows;
+    result.tile_width = tile_width;
+    result.tile_height = tile_height;
+    result.heights = (u8 *)ArenaAlloc(arena, columns * rows);
+
+    result.chunk_columns = (columns + TILEMAP_CHUNK_SIZE - 1) / TILEMAP_CHUNK_SIZE;
+    result.chunk_rows = (rows + TILEMAP_CHUNK_SIZE - 1) / TILEMAP_CHUNK_SIZE;
+    result.chunk_revisions = (u32 *)ArenaAlloc(arena, sizeof(u32) * result.chunk_columns * result.chunk_rows);
+    for (int i = 0; i < result.chunk_columns * result.chunk_rows; ++i) result.chunk_revisions[i] = 1;
+
+    return result;
+}
+
+// sparse_capacity is the most tiles a sparse layer can hold, dense layers ignore it.
+int AddTilemapLayer(Tilemap *map, Arena *arena, int sheet, int sprite_layer, f32 anchor_y, b32 sparse, int sparse_capacity) {
+    Assert(map->layer_count < TILEMAP_MAX_LAYERS);
+
+    int index = map->layer_count++;
+    TilemapLayer *layer = map->layers + index;
+    *layer = {};
+    layer->sheet = sheet;
+    layer->sprite_layer = sprite_layer;
+    layer->anchor_y = anchor_y;
+    layer->sparse = sparse;
+    layer->bounds = { map->columns, map->rows, -1, -1 };
+
+    if (sparse) {
+        layer->sparse_capacity = sparse_capacity;
+        layer->sparse_indices = (u32 *)ArenaAlloc(arena, sizeof(u32) * sparse_capacity);
+        layer->sparse_tiles = (u16 *)ArenaAlloc(arena, sizeof(u16) * sparse_capacity);
+    } else {
+        layer->tiles = (u16 *)ArenaAlloc(arena, sizeof(u16) * map->columns * map->rows);
+    }
+
+    return index;
+}
+
+b32 IsTileInMap(Tilemap *map, int x, int y) {
+    b32 result = x >= 0 && y >= 0 && x < map->columns && y < map->rows;
+    return result;
+}
+
+int GetTileChunk(Tilemap *map, int x, int y) {
+    int result = (y / TILEMAP_CHUNK_SIZE) * map->chunk_columns + x / TILEMAP_CHUNK_SIZE;
+    return result;
+}
+
+TileRange GetChunkTiles(Tilemap *map, int chunk) {
+    int x = (chunk % map->chunk_columns) * TILEMAP_CHUNK_SIZE;
+    int y = (chunk / map->chunk_columns) * TILEMAP_CHUNK_SIZE;
+    int end_x = Min(x + TILEMAP_CHUNK_SIZE, map->columns);
+    int end_y = Min(y + TILEMAP_CHUNK_SIZE, map->rows);
+    TileRange result = { x, y, end_x - 1, end_y - 1 };
+    return result;
+}
+
+// First sparse entry with an index >= the one given.
+static int LowerBoundSparse(TilemapLayer *layer, u32 index) {
+    int low = 0;
+    int high = layer->tile_count;
+    while (low < high) {
+        int middle = (low + high) / 2;
+        if (layer->sparse_indices[middle] < index) low = middle + 1;
+        else high = middle;
+    }
+    return low;
+}
+
+u16 GetTile(Tilemap *map, int layer_index, int x, int y) {
+    if (!IsTileInMap(map, x, y)) return 0;
+
+    TilemapLayer *layer = map->layers + layer_index;
+    u32 index = y * map->columns + x;
+
+    if (!layer->sparse) return layer->tiles[index];
+
+    int i = LowerBoundSparse(layer, index);
+    u16 result = (i < layer->tile_count && layer->sparse_indices[i] == index) ? layer->sparse_tiles[i] : 0;
+    return result;
+}
+
+// Returns false when a sparse layer is full.
+b32 SetTile(Tilemap *map, int layer_index, int x, int y, u16 tile) {
+    if (!IsTileInMap(map, x, y)) return false;
+
+    TilemapLayer *layer = map->layers + layer_index;
+    u32 index = y * map->columns + x;
+
+    b32 was_empty;
+    if (layer->sparse) {
+        int i = LowerBoundSparse(layer, index);
+        b32 found = i < layer->tile_count && layer->sparse_indices[i] == index;
+        was_empty = !found;
+
+        if (found && tile) {
+            layer->sparse_tiles[i] = tile;
+        } else if (found) {
+            int after = layer->tile_count - i - 1;
+            memmove(layer->sparse_indices + i, layer->sparse_indices + i + 1, sizeof(u32) * after);
+            memmove(layer->sparse_tiles + i, layer->sparse_tiles + i + 1, sizeof(u16) * after);
+        } else if (tile) {
+            if (layer->tile_count == layer->sparse_capacity) return false;
+            int after = layer->tile_count - i;
+            memmove(layer->sparse_indices + i + 1, layer->sparse_indices + i, sizeof(u32) * after);
+            memmove(layer->sparse_tiles + i + 1, layer->sparse_tiles + i, sizeof(u16) * after);
+            layer->sparse_indices[i] = index;
+            layer->sparse_tiles[i] = tile;
+        }
+    } else {
+        was_empty = layer->tiles[index] == 0;
+        layer->tiles[index] = tile;
+    }
+
+    ++map->chunk_revisions[GetTileChunk(map, x, y)];
+
+    if (was_empty && tile) {
+        ++layer->tile_count;
+        layer->bounds.min_x = Min(layer->bounds.min_x, x);
+        layer->bounds.min_y = Min(layer->bounds.min_y, y);
+        layer->bounds.max_x = Max(layer->bounds.max_x, x);
+        layer->bounds.max_y = Max(layer->bounds.max_y, y);
+    } else if (!was_empty && !tile) {
+        --layer->tile_count;
+    }
+
+    return true;
+}
+
+// Empties every layer and flattens the map, keeping its size and layers. Every chunk is stale.
+void ClearTilemap(Tilemap *map) {
+    memset(map->heights, 0, map->columns * map->rows);
+
+    for (int i = 0; i < map->layer_count; ++i) {
+        TilemapLayer *layer = map->layers + i;
+        if (!layer->sparse) memset(layer->tiles, 0, sizeof(u16) * map->columns * map->rows);
+        layer->tile_count = 0;
+        layer->bounds = { map->columns, map->rows, -1, -1 };
+    }
+
+    for (int i = 0; i < map->chunk_columns * map->chunk_rows; ++i) ++map->chunk_revisions[i];
+}
+
+int GetTileHeight(Tilemap *map, int x, int y) {
+    int result = IsTileInMap(map, x, y) ? map->heights[y * map->columns + x] : 0;
+    return result;
+}
+
+void SetTileHeight(Tilemap *map, int x, int y, int height) {
+    if (!IsTileInMap(map, x, y)) return;
+    map->heights[y * map->columns + x] = (u8)height;
+    ++map->chunk_revisions[GetTileChunk(map, x, y)];
+    map->max_height = Max(map->max_height, height);
+}
+
+TileRange IntersectTileRanges(TileRange a, TileRange b) {
+    TileRange result = {
+        Max(a.min_x, b.min_x),
+        Max(a.min_y, b.min_y),
+        Min(a.max_x, b.max_x),
+        Min(a.max_y, b.max_y),
+    };
+    return result;
+}
+
+b32 IsTileRangeEmpty(TileRange range) {
+    b32 result = range.min_x > range.max_x || range.min_y > range.max_y;
+    return result;
+}
+
+u64 GetTilemapLayerBytes(Tilemap *map, int layer_index) {
+    TilemapLayer *layer = map->layers + layer_index;
+    u64 result = layer->sparse ? (u64)layer->sparse_capacity * (sizeof(u32) + sizeof(u16)) : (u64)map->columns * map->rows * sizeof(u16);
+    return result;
+}
+
+// Walks the non empty tiles of a layer inside a range, row by row:
+//
+//     TileIterator it = IterateTiles(map, layer, range);
+//     while (NextTile(&it)) { ... it.x, it.y, it.tile ... }
+struct TileIterator {
+    Tilemap *map;
+    TilemapLayer *layer;
+    TileRange range;
+
+    int x;
+    int y;
+    u16 tile;
+
+    int cursor; // next dense grid index or sparse entry
+    u32 end; // grid index past the range's last row
+};
+
+TileIterator IterateTiles(Tilemap *map, int layer_index, TileRange range) {
+    TileIterator result = {};
+    result.map = map;
+    result.layer = map->layers + layer_index;
+    result.range = IntersectTileRanges(range, result.layer->bounds);
+
+    if (!result.layer->tile_count || result.layer->hidden || IsTileRangeEmpty(result.range)) {
+        result.end = 0;
+        return result;
+    }
+
+    u32 first = result.range.min_y * map->columns + result.range.min_x;
+    result.end = (result.range.max_y + 1) * map->columns;
+    result.cursor = result.layer->sparse ? LowerBoundSparse(result.layer, first) : first;
+
+    return result;
+}
+
+b32 NextTile(TileIterator *it) {
+    TilemapLayer *layer = it->layer;
+    int columns = it->map->columns;
+
+    if (layer->sparse) {
+        while (it->cursor < layer->tile_count && layer->sparse_indices[it->cursor] < it->end) {
+            u32 index = layer->sparse_indices[it->cursor];
+            u16 tile = layer->sparse_tiles[it->cursor++];
+
+            int x = index % columns;
+            if (x < it->range.min_x || x > it->range.max_x) continue;
+
+            it->x = x;
+            it->y = index / columns;
+            it->tile = tile;
+            return true;
+        }
+        return false;
+    }
+
+    while ((u32)it->cursor < it->end) {
+        int index = it->cursor;
+        int x = index % columns;
+
+        if (x > it->range.max_x) { // next row
+            it->cursor = (index / columns + 1) * columns + it->range.min_x;
+            continue;
+        }
+
+        ++it->cursor;
+        if (x < it->range.min_x || !layer->tiles[index]) continue;
+
+        it->x = x;
+        it->y = index / columns;
+        it->tile = layer->tiles[index];
+        return true;
+    }
+    return false;
+}
+
+// Walks range the slow way, every tile through GetTile, and checks the iterator agrees.
+static int CountTileIteratorMismatches(Tilemap *map, int layer_index, TileRange range) {
+    TileIterator it = IterateTiles(map, layer_index, range);
+    TileRange clipped = IntersectTileRanges(range, { 0, 0, map->columns - 1, map->rows - 1 });
+    int result = 0;
+
+    for (int y = clipped.min_y; y <= clipped.max_y; ++y) {
+        for (int x = clipped.min_x; x <= clipped.max_x; ++x) {
+            u16 tile = GetTile(map, layer_index, x, y);
+            if (!tile) continue;
+            if (!NextTile(&it) || it.x != x || it.y != y || it.tile != tile) ++result;
+        }
+    }
+    if (NextTile(&it)) ++result;
+
+    return result;
+}
+
+void BenchmarkTilemap() {
+    const int size = 1024;
+    const int sparse_capacity = 8192;
+    const int edit_count = 20000;
+    const int range_count = 2000;
+    const int view_size = 64; // tiles on a side of a zoomed in view
+
+    Arena arena = CreateArena(Megabytes(32));
+    Tilemap map = CreateTilemap(&arena, size, size, 256, 128);
+    int ground = AddTilemapLayer(&map, &arena, 0, 0, 64, false, 0);
+    int props = AddTilemapLayer(&map, &arena, 0, 2, 192, true, sparse_capacity);
+
+    // the sparse layer mirrors a dense copy through random sets and clears
+    u16 *expected = (u16 *)ArenaAlloc(&arena, sizeof(u16) * size * size);
+    memset(expected, 0, sizeof(u16) * size * size);
+
+    u32 seed = 31337;
+    for (int y = 0; y < size; ++y) {
+        for (int x = 0; x < size; ++x) SetTile(&map, ground, x, y, MakeTile((x + y) % 4, 1));
+    }
+
+    int expected_count = 0;
+    double start = GetTime();
+    for (int i = 0; i < edit_count; ++i) {
+        seed = seed * 1664525u + 1013904223u;
+        int x = (seed >> 8) % size;
+        seed = seed * 1664525u + 1013904223u;
+        int y = (seed >> 8) % size;
+        u16 tile = (seed >> 4) % 3 ? MakeTile((seed >> 20) % 4, (seed >> 24) % 8) : 0;
+
+        if (tile && !expected[y * size + x] && expected_count == sparse_capacity) continue;
+        Assert(SetTile(&map, props, x, y, tile));
+        expected_count += (tile != 0) - (expected[y * size + x] != 0);
+        expected[y * size + x] = tile;
+    }
+    double edit_seconds = GetTime() - start;
+
+    int lookup_mismatches = 0;
+    for (int y = 0; y < size; ++y) {
+        for (int x = 0; x < size; ++x) lookup_mismatches += GetTile(&map, props, x, y) != expected[y * size + x];
+    }
+    Assert(map.layers[props].tile_count == expected_count);
+
+    // random ranges, some hanging off the map
+    int iterator_mismatches = 0;
+    for (int i = 0; i < range_count; ++i) {
+        seed = seed * 1664525u + 1013904223u;
+        int x = (int)((seed >> 8) % (size + 64)) - 32;
+        seed = seed * 1664525u + 1013904223u;
+        int y = (int)((seed >> 8) % (size + 64)) - 32;
+        TileRange range = { x, y, x + (int)(seed >> 26), y + (int)((seed >> 20) & 63) };
+        iterator_mismatches += CountTileIteratorMismatches(&map, ground, range);
+        iterator_mismatches += CountTileIteratorMismatches(&map, props, range);
+    }
+
+    TileRange view = { size / 2, size / 2, size / 2 + view_size - 1, size / 2 + view_size - 1 };
+    int visited = 0;
+    start = GetTime();
+    for (int i = 0; i < range_count; ++i) {
+        for (int layer = 0; layer < map.layer_count; ++layer) {
+            TileIterator it = IterateTiles(&map, layer, view);
+            while (NextTile(&it)) ++visited;
+        }
+    }
+    double iterate_seconds = GetTime() - start;
+
+    // an edit stales its chunk and nothing else, a clear stales all of them
+    int chunk = GetTileChunk(&map, 100, 200);
+    u32 revision = map.chunk_revisions[chunk];
+    u32 neighbour_revision = map.chunk_revisions[chunk + 1];
+    SetTileHeight(&map, 100, 200, 3);
+    SetTile(&map, ground, 100, 200, MakeTile(0, 0));
+    Assert(map.chunk_revisions[chunk] == revision + 2);
+    Assert(map.chunk_revisions[chunk + 1] == neighbour_revision);
+    Assert(GetTileHeight(&map, 100, 200) == 3 && map.max_height == 3);
+    ClearTilemap(&map);
+    Assert(map.chunk_revisions[chunk + 1] == neighbour_revision + 1);
+    Assert(map.layers[props].tile_count == 0 && !GetTile(&map, props, 100, 200));
+
+    fprintf(stdout, "Tilemap: %d x %d, %d sparse tiles\n", size, size, expected_count);
+    fprintf(stdout, "  memory:  %.2f MB dense, %.2f MB sparse\n",
+            GetTilemapLayerBytes(&map, ground) / (1024.0 * 1024.0), GetTilemapLayerBytes(&map, props) / (1024.0 * 1024.0));
+    fprintf(stdout, "  edit:    %7.3f us/sparse set\n", edit_seconds * 1e6 / edit_count);
+    fprintf(stdout, "  iterate: %7.3f us per %d x %d view, all layers (%d lookup, %d iterator mismatches)\n",
+            iterate_seconds * 1e6 / range_count, view_size, view_size, lookup_mismatches, iterator_mismatches);
+    Assert(lookup_mismatches == 0 && iterator_mismatches == 0);
+
+    free(arena.base_address);
+}
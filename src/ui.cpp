@@ -0,0 +1,595 @@
+/*
+    Retained mode UI.
+
+    Widgets are created once and changed through setters. Each one owns a fixed slot in two
+    vertex buffers, one quad (a sprite from the UI sheet or a flat color) and UI_MAX_TEXT glyph
+    quads, and its geometry is only generated again when a setter or a hover/press change marks it
+    dirty. DrawUI rebuilds the dirty widgets, uploads the range they span and draws every quad in
+    one draw and every glyph in another. An idle UI is two draws and no uploads.
+
+    Unused slots (hidden widgets, short text) hold zero area quads, the GPU throws them away. All
+    text is drawn after all quads, so a label under a panel shows through it.
+
+    Hit testing goes through a uniform grid of UI_GRID_CELL_SIZE cells, each listing the
+    interactive widgets that touch it. It's rebuilt only when a widget moves, resizes or changes
+    visibility, a lookup is one cell's list, topmost widget (highest index) first.
+*/
+
+#define UI_MAX_TEXT 48 // glyph quads per widget
+#define UI_GRID_CELL_SIZE 64
+
+enum UIWidgetType {
+    UIWidgetPanel,
+    UIWidgetImage,
+    UIWidgetButton,
+    UIWidgetLabel,
+};
+
+enum UIWidgetFlags {
+    UIVisible = 0x1,
+    UIInteractive = 0x2, // can be hovered and clicked
+    UIHovered = 0x4,
+    UIPressed = 0x8,
+    UISelected = 0x10,
+};
+
+struct UIWidget {
+    UIWidgetType type;
+    u32 flags;
+    Rect rect; // pixels, top left origin
+    Rect sprite; // texels in the sheet, zero width for a flat color
+    v4 color;
+    v4 text_color;
+    char text[UI_MAX_TEXT + 1];
+};
+
+struct UIVertex {
+    v2 p;
+    v2 uv;
+    u32 color; // RGBA8
+    f32 textured; // 0 for flat color
+};
+
+struct UIGridEntry {
+    int widget;
+    int next;
+};
+
+struct UIContext {
+    int widget_count;
+    int max_widgets;
+    UIWidget *widgets;
+
+    Texture sheet;
+    Font *font;
+    u32 font_atlas_resets; // cached glyph quads are stale once this changes
+
+    // dirty widgets span [dirty_first, dirty_last], empty when first > last
+    b32 *dirty;
+    int dirty_first;
+    int dirty_last;
+
+    UIVertex *vertices; // 4 per widget
+    TextVertex *text_vertices; // UI_MAX_TEXT * 4 per widget
+
+    b32 layout_dirty;
+    int grid_columns;
+    int grid_rows;
+    int *grid_cells; // first entry, -1 when empty
+    int grid_entry_count;
+    int max_grid_entries;
+    UIGridEntry *grid_entries;
+    int grid_width; // the framebuffer size the grid was built for
+    int grid_height;
+
+    int hovered; // -1 for none
+    int pressed;
+
+    GLuint vao;
+    GLuint vbo;
+    GLuint text_vao;
+    GLuint text_vbo;
+    GLuint program;
+    int screen_size_location;
+
+    int rebuilt_widgets; // last DrawUI, for the overlay
+};
+
+#define UI_MAX_GRID_CELLS (64 * 64)
+
+static void InitUIRenderer(UIContext *ui) {
+    glGenVertexArrays(1, &ui->vao);
+    glGenBuffers(1, &ui->vbo);
+    glBindVertexArray(ui->vao);
+    glBindBuffer(GL_ARRAY_BUFFER, ui->vbo);
+    glBufferData(GL_ARRAY_BUFFER, sizeof(UIVertex) * 4 * ui->max_widgets, 0, GL_DYNAMIC_DRAW);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ui->font->ibo); // the same quad topology
+    glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, sizeof(UIVertex), 0);
+    glEnableVertexAttribArray(0);
+    glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, sizeof(UIVertex), (void *)offsetof(UIVertex, uv));
+    glEnableVertexAttribArray(1);
+    glVertexAttribPointer(2, 4, GL_UNSIGNED_BYTE, GL_TRUE, sizeof(UIVertex), (void *)offsetof(UIVertex, color));
+    glEnableVertexAttribArray(2);
+    glVertexAttribPointer(3, 1, GL_FLOAT, GL_FALSE, sizeof(UIVertex), (void *)offsetof(UIVertex, textured));
+    glEnableVertexAttribArray(3);
+
+    glGenVertexArrays(1, &ui->text_vao);
+    glGenBuffers(1, &ui->text_vbo);
+    glBindVertexArray(ui->text_vao);
+    glBindBuffer(GL_ARRAY_BUFFER, ui->text_vbo);
+    glBufferData(GL_ARRAY_BUFFER, sizeof(TextVertex) * 4 * UI_MAX_TEXT * ui->max_widgets, 0, GL_DYNAMIC_DRAW);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ui->font->ibo);
+    glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, sizeof(TextVertex), 0);
+    glEnableVertexAttribArray(0);
+    glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, sizeof(TextVertex), (void *)offsetof(TextVertex, uv));
+    glEnableVertexAttribArray(1);
+    glVertexAttribPointer(2, 4, GL_UNSIGNED_BYTE, GL_TRUE, sizeof(TextVertex), (void *)offsetof(TextVertex, color));
+    glEnableVertexAttribArray(2);
+    glBindVertexArray(0);
+
+    const char *vertex_source = R"(
+        #version 460
+        layout (location = 0) in vec2 p;
+        layout (location = 1) in vec2 uv;
+        layout (location = 2) in vec4 color;
+        layout (location = 3) in float textured;
+
+        uniform vec2 screen_size;
+
+        out vec2 vuv;
+        out vec4 vcolor;
+        out float vtextured;
+
+        void main() {
+            gl_Position = vec4(p.x / screen_size.x * 2.0 - 1.0, 1.0 - p.y / screen_size.y * 2.0, 0.0, 1.0);
+            vuv = uv;
+            vcolor = color;
+            vtextured = textured;
+        }
+    )";
+
+    const char *frag_source = R"(
+        #version 460
+
+        in vec2 vuv;
+        in vec4 vcolor;
+        in float vtextured;
+
+        out vec4 frag_color;
+
+        uniform sampler2D sheet;
+
+        void main() {
+            frag_color = mix(vec4(1.0), texture(sheet, vuv), vtextured) * vcolor;
+        }
+    )";
+
+    GLuint vs = glCreateShader(GL_VERTEX_SHADER);
+    glShaderSource(vs, 1, &vertex_source, 0);
+    CompileShader(vs);
+
+    GLuint fs = glCreateShader(GL_FRAGMENT_SHADER);
+    glShaderSource(fs, 1, &frag_source, 0);
+    CompileShader(fs);
+
+    ui->program = glCreateProgram();
+    glAttachShader(ui->program, vs);
+    glAttachShader(ui->program, fs);
+    LinkProgram(ui->program);
+    glDeleteShader(vs);
+    glDeleteShader(fs);
+
+    ui->screen_size_location = glGetUniformLocation(ui->program, "screen_size");
+}
+
+// Everything but the GL objects, BenchmarkUI runs on this without a context.
+static UIContext AllocateUI(Arena *arena, int max_widgets, Font *font) {
+    Assert(max_widgets * UI_MAX_TEXT <= FONT_MAX_QUADS);
+
+    UIContext result = {};
+    result.max_widgets = max_widgets;
+    result.widgets = (UIWidget *)ArenaAlloc(arena, sizeof(UIWidget) * max_widgets);
+    result.dirty = (b32 *)ArenaAlloc(arena, sizeof(b32) * max_widgets);
+    result.vertices = (UIVertex *)ArenaAlloc(arena, sizeof(UIVertex) * 4 * max_widgets);
+    result.text_vertices = (TextVertex *)ArenaAlloc(arena, sizeof(TextVertex) * 4 * UI_MAX_TEXT * max_widgets);
+    result.grid_cells = (int *)ArenaAlloc(arena, sizeof(int) * UI_MAX_GRID_CELLS);
+    result.max_grid_entries = max_widgets * 16;
+    result.grid_entries = (UIGridEntry *)ArenaAlloc(arena, sizeof(UIGridEntry) * result.max_grid_entries);
+
+    result.font = font;
+    result.font_atlas_resets = font->atlas_resets;
+    result.dirty_first = max_widgets;
+    result.dirty_last = -1;
+    result.hovered = -1;
+    result.pressed = -1;
+    return result;
+}
+
+// Main thread, needs the GL context and a loaded font. Glyph quads are drawn with the font's
+// index buffer, so max_widgets * UI_MAX_TEXT can't pass FONT_MAX_QUADS.
+UIContext CreateUI(Arena *arena, int max_widgets, Texture sheet, Font *font) {
+    Assert(font->loaded);
+
+    UIContext result = AllocateUI(arena, max_widgets, font);
+    result.sheet = sheet;
+
+    InitUIRenderer(&result);
+    return result;
+}
+
+static void MarkUIDirty(UIContext *ui, int id) {
+    ui->dirty[id] = true;
+    if (id < ui->dirty_first) ui->dirty_first = id;
+    if (id > ui->dirty_last) ui->dirty_last = id;
+}
+
+int AddUIWidget(UIContext *ui, UIWidgetType type, Rect rect, Rect sprite, v4 color, const char *text) {
+    Assert(ui->widget_count < ui->max_widgets);
+
+    int id = ui->widget_count++;
+    UIWidget *widget = ui->widgets + id;
+    widget->type = type;
+    widget->flags = UIVisible | (type == UIWidgetButton ? UIInteractive : 0);
+    widget->rect = rect;
+    widget->sprite = sprite;
+    widget->color = color;
+    widget->text_color = v4(1);
+    if (text) strncpy(widget->text, text, UI_MAX_TEXT);
+
+    MarkUIDirty(ui, id);
+    if (widget->flags & UIInteractive) ui->layout_dirty = true;
+    return id;
+}
+
+int AddUIPanel(UIContext *ui, Rect rect, v4 color) {
+    return AddUIWidget(ui, UIWidgetPanel, rect, {}, color, 0);
+}
+
+int AddUIImage(UIContext *ui, Rect rect, Rect sprite) {
+    return AddUIWidget(ui, UIWidgetImage, rect, sprite, v4(1), 0);
+}
+
+int AddUIButton(UIContext *ui, Rect rect, Rect sprite, const char *text) {
+    return AddUIWidget(ui, UIWidgetButton, rect, sprite, v4(1), text);
+}
+
+int AddUILabel(UIContext *ui, f32 x, f32 y, const char *text, v4 color) {
+    int id = AddUIWidget(ui, UIWidgetLabel, { x, y, 0, 0 }, {}, v4(0), text);
+    ui->widgets[id].text_color = color;
+    return id;
+}
+
+// Marks the widget dirty only when the text actually changed, safe to call every frame.
+void SetUIText(UIContext *ui, int id, const char *text) {
+    UIWidget *widget = ui->widgets + id;
+    if (strncmp(widget->text, text, UI_MAX_TEXT) == 0) return;
+
+    strncpy(widget->text, text, UI_MAX_TEXT);
+    widget->text[UI_MAX_TEXT] = 0;
+    MarkUIDirty(ui, id);
+}
+
+void SetUIColor(UIContext *ui, int id, v4 color) {
+    UIWidget *widget = ui->widgets + id;
+    if (widget->color == color) return;
+
+    widget->color = color;
+    MarkUIDirty(ui, id);
+}
+
+void SetUIRect(UIContext *ui, int id, Rect rect) {
+    UIWidget *widget = ui->widgets + id;
+    if (widget->rect.x == rect.x && widget->rect.y == rect.y && widget->rect.width == rect.width && widget->rect.height == rect.height) return;
+
+    widget->rect = rect;
+    MarkUIDirty(ui, id);
+    if (widget->flags & UIInteractive) ui->layout_dirty = true;
+}
+
+static void SetUIFlag(UIContext *ui, int id, u32 flag, b32 on) {
+    UIWidget *widget = ui->widgets + id;
+    u32 flags = on ? widget->flags | flag : widget->flags & ~flag;
+    if (flags == widget->flags) return;
+
+    widget->flags = flags;
+    MarkUIDirty(ui, id);
+    if (flag == UIVisible && (flags & UIInteractive)) ui->layout_dirty = true;
+}
+
+void SetUIVisible(UIContext *ui, int id, b32 visible) {
+    SetUIFlag(ui, id, UIVisible, visible);
+}
+
+void SetUISelected(UIContext *ui, int id, b32 selected) {
+    SetUIFlag(ui, id, UISelected, selected);
+}
+
+static void RebuildUIGrid(UIContext *ui, int width, int height) {
+    ProfileFunction();
+
+    ui->grid_width = width;
+    ui->grid_height = height;
+    ui->grid_columns = Min((width + UI_GRID_CELL_SIZE - 1) / UI_GRID_CELL_SIZE, 64);
+    ui->grid_rows = Min((height + UI_GRID_CELL_SIZE - 1) / UI_GRID_CELL_SIZE, 64);
+    ui->grid_entry_count = 0;
+    for (int i = 0; i < ui->grid_columns * ui->grid_rows; ++i) ui->grid_cells[i] = -1;
+
+    // in order, so each cell's list ends up topmost first
+    for (int id = 0; id < ui->widget_count; ++id) {
+        UIWidget *widget = ui->widgets + id;
+        if ((widget->flags & (UIVisible | UIInteractive)) != (UIVisible | UIInteractive)) continue;
+
+        int x0 = clamp((int)floorf(widget->rect.x / UI_GRID_CELL_SIZE), 0, ui->grid_columns - 1);
+        int y0 = clamp((int)floorf(widget->rect.y / UI_GRID_CELL_SIZE), 0, ui->grid_rows - 1);
+        int x1 = clamp((int)floorf((widget->rect.x + widget->rect.width) / UI_GRID_CELL_SIZE), 0, ui->grid_columns - 1);
+        int y1 = clamp((int)floorf((widget->rect.y + widget->rect.height) / UI_GRID_CELL_SIZE), 0, ui->grid_rows - 1);
+
+        for (int y = y0; y <= y1; ++y) {
+            for (int x = x0; x <= x1; ++x) {
+                if (ui->grid_entry_count == ui->max_grid_entries) return;
+
+                int *cell = ui->grid_cells + y * ui->grid_columns + x;
+                UIGridEntry *entry = ui->grid_entries + ui->grid_entry_count;
+                entry->widget = id;
+                entry->next = *cell;
+                *cell = ui->grid_entry_count++;
+            }
+        }
+    }
+
+    ui->layout_dirty = false;
+}
+
+// Topmost interactive widget under x, y or -1.
+int HitTestUI(UIContext *ui, f32 x, f32 y) {
+    if (x < 0 || y < 0) return -1;
+    int column = (int)(x / UI_GRID_CELL_SIZE);
+    int row = (int)(y / UI_GRID_CELL_SIZE);
+    if (column >= ui->grid_columns || row >= ui->grid_rows) return -1;
+
+    for (int e = ui->grid_cells[row * ui->grid_columns + column]; e >= 0; e = ui->grid_entries[e].next) {
+        UIWidget *widget = ui->widgets + ui->grid_entries[e].widget;
+        Rect *r = &widget->rect;
+        if (x >= r->x && x < r->x + r->width && y >= r->y && y < r->y + r->height) return ui->grid_entries[e].widget;
+    }
+
+    return -1;
+}
+
+// Once a frame. Returns the button that was clicked (pressed and released over it) or -1.
+int UpdateUI(UIContext *ui, f32 cursor_x, f32 cursor_y, b32 button_down) {
+    ProfileFunction();
+
+    int fb_width, fb_height;
+    GetWindowFramebufferSize(&fb_width, &fb_height);
+    if (ui->layout_dirty || fb_width != ui->grid_width || fb_height != ui->grid_height) RebuildUIGrid(ui, fb_width, fb_height);
+
+    int hovered = HitTestUI(ui, cursor_x, cursor_y);
+    if (hovered != ui->hovered) {
+        if (ui->hovered >= 0) SetUIFlag(ui, ui->hovered, UIHovered, false);
+        if (hovered >= 0) SetUIFlag(ui, hovered, UIHovered, true);
+        ui->hovered = hovered;
+    }
+
+    int clicked = -1;
+    if (button_down && ui->pressed < 0 && hovered >= 0) {
+        ui->pressed = hovered;
+        SetUIFlag(ui, hovered, UIPressed, true);
+    } else if (!button_down && ui->pressed >= 0) {
+        if (ui->pressed == hovered) clicked = hovered;
+        SetUIFlag(ui, ui->pressed, UIPressed, false);
+        ui->pressed = -1;
+    }
+
+    return clicked;
+}
+
+static void BuildUIWidget(UIContext *ui, int id) {
+    UIWidget *widget = ui->widgets + id;
+    UIVertex *quad = ui->vertices + id * 4;
+    TextVertex *text_quads = ui->text_vertices + id * 4 * UI_MAX_TEXT;
+
+    memset(quad, 0, sizeof(UIVertex) * 4);
+    memset(text_quads, 0, sizeof(TextVertex) * 4 * UI_MAX_TEXT);
+    if (!(widget->flags & UIVisible)) return;
+
+    v4 color = widget->color;
+    if (widget->flags & UISelected) color *= v4(1.0f, 0.85f, 0.5f, 1);
+    if (widget->flags & UIPressed) color *= v4(0.7f, 0.7f, 0.7f, 1);
+    else if (widget->flags & UIHovered) color *= v4(1.25f, 1.25f, 1.25f, 1);
+
+    if (widget->type != UIWidgetLabel) {
+        f32 l = widget->rect.x;
+        f32 t = widget->rect.y;
+        f32 r = l + widget->rect.width;
+        f32 b = t + widget->rect.height;
+
+        // the sheet is loaded flipped, same as DrawTextureRect
+        f32 textured = widget->sprite.width > 0 ? 1.0f : 0.0f;
+        f32 u0 = 0, v0 = 0, u1 = 0, v1 = 0;
+        if (textured > 0) {
+            u0 = widget->sprite.x / ui->sheet.width;
+            u1 = (widget->sprite.x + widget->sprite.width) / ui->sheet.width;
+            v0 = 1 - widget->sprite.y / ui->sheet.height;
+            v1 = 1 - (widget->sprite.y + widget->sprite.height) / ui->sheet.height;
+        }
+
+        u32 packed_color = PackColor(color);
+        quad[0] = { { l, t }, { u0, v0 }, packed_color, textured };
+        quad[1] = { { l, b }, { u0, v1 }, packed_color, textured };
+        quad[2] = { { r, b }, { u1, v1 }, packed_color, textured };
+        quad[3] = { { r, t }, { u1, v0 }, packed_color, textured };
+    }
+
+    if (widget->text[0] && ui->font->loaded) {
+        f32 x = widget->rect.x;
+        f32 y = widget->rect.y;
+        if (widget->type == UIWidgetButton) {
+            // centered
+            x += (widget->rect.width - MeasureText(ui->font, widget->text)) * 0.5f;
+            y += (widget->rect.height - ui->font->line_height) * 0.5f;
+        }
+        BuildTextQuads(ui->font, x, y, ui->font->pixel_height, widget->text, widget->text_color, text_quads, UI_MAX_TEXT, 0);
+    }
+}
+
+// Regenerates the dirty widgets' geometry. The widgets in [first, first + count) are the ones to
+// upload, false when nothing changed.
+static b32 RebuildDirtyUI(UIContext *ui, int *first, int *count) {
+    ui->rebuilt_widgets = 0;
+
+    // glyph quads built before an atlas reset point at glyphs that aren't there anymore
+    if (ui->font->atlas_resets != ui->font_atlas_resets) {
+        for (int id = 0; id < ui->widget_count; ++id) {
+            if (ui->widgets[id].text[0]) MarkUIDirty(ui, id);
+        }
+    }
+
+    if (ui->dirty_first > ui->dirty_last) return false;
+
+    u32 atlas_resets = ui->font->atlas_resets;
+    for (int id = ui->dirty_first; id <= ui->dirty_last; ++id) {
+        if (!ui->dirty[id]) continue;
+        BuildUIWidget(ui, id);
+        ui->dirty[id] = false;
+        ++ui->rebuilt_widgets;
+    }
+
+    // baking glyphs can have reset the atlas again halfway, the next frame catches that
+    ui->font_atlas_resets = atlas_resets;
+
+    *first = ui->dirty_first;
+    *count = ui->dirty_last - ui->dirty_first + 1;
+    ui->dirty_first = ui->max_widgets;
+    ui->dirty_last = -1;
+    return true;
+}
+
+// Main thread. Rebuilds and uploads what changed, then one draw for the quads and one for the
+// text. Expects blending on and depth testing off, like the other overlays.
+void DrawUI(UIContext *ui) {
+    ProfileFunction();
+
+    int first, count;
+    if (RebuildDirtyUI(ui, &first, &count)) {
+        glNamedBufferSubData(ui->vbo, sizeof(UIVertex) * 4 * first, sizeof(UIVertex) * 4 * count, ui->vertices + first * 4);
+        glNamedBufferSubData(ui->text_vbo, sizeof(TextVertex) * 4 * UI_MAX_TEXT * first, sizeof(TextVertex) * 4 * UI_MAX_TEXT * count,
+                             ui->text_vertices + first * 4 * UI_MAX_TEXT);
+    }
+
+    if (!ui->widget_count) return;
+
+    int fb_width, fb_height;
+    GetWindowFramebufferSize(&fb_width, &fb_height);
+
+    glUseProgram(ui->program);
+    glUniform2f(ui->screen_size_location, (f32)fb_width, (f32)fb_height);
+    glBindTexture(GL_TEXTURE_2D, ui->sheet.id);
+    glBindVertexArray(ui->vao);
+    glDrawElements(GL_TRIANGLES, ui->widget_count * 6, GL_UNSIGNED_INT, 0);
+
+    if (ui->font->loaded) {
+        BindTextProgram(ui->font);
+        glBindVertexArray(ui->text_vao);
+        glDrawElements(GL_TRIANGLES, ui->widget_count * UI_MAX_TEXT * 6, GL_UNSIGNED_INT, 0);
+    }
+    glBindVertexArray(0);
+}
+
+// Topmost visible interactive widget under x, y by testing every widget.
+static int HitTestUISlow(UIContext *ui, f32 x, f32 y) {
+    for (int id = ui->widget_count - 1; id >= 0; --id) {
+        UIWidget *widget = ui->widgets + id;
+        if ((widget->flags & (UIVisible | UIInteractive)) != (UIVisible | UIInteractive)) continue;
+
+        Rect *r = &widget->rect;
+        if (x >= r->x && x < r->x + r->width && y >= r->y && y < r->y + r->height) return id;
+    }
+
+    return -1;
+}
+
+// CPU side only, there's no GL context and no font (text is skipped like before the font loads).
+void BenchmarkUI() {
+    const int widget_count = FONT_MAX_QUADS / UI_MAX_TEXT;
+    const int width = 1920;
+    const int height = 1080;
+    const int point_count = 1 << 20;
+
+    Arena arena = CreateArena(Megabytes(16));
+    Font font = {};
+    UIContext ui = AllocateUI(&arena, widget_count, &font);
+
+    // overlapping buttons with panels between them, every seventh one hidden. At most 190 pixels
+    // on a side keeps each one within 16 grid entries.
+    u32 seed = 4242;
+    for (int i = 0; i < widget_count; ++i) {
+        seed = seed * 1664525u + 1013904223u;
+        f32 x = (f32)((seed >> 8) % (width - 190));
+        seed = seed * 1664525u + 1013904223u;
+        f32 y = (f32)((seed >> 8) % (height - 190));
+        seed = seed * 1664525u + 1013904223u;
+        Rect rect = { x, y, (f32)(8 + (seed >> 8) % 182), (f32)(8 + (seed >> 16) % 182) };
+
+        int id = i % 3 == 0 ? AddUIPanel(&ui, rect, v4(0.2f, 0.2f, 0.2f, 0.8f)) : AddUIButton(&ui, rect, {}, "button");
+        if (i % 7 == 0) SetUIVisible(&ui, id, false);
+    }
+
+    double start = GetTime();
+    RebuildUIGrid(&ui, width, height);
+    double grid_seconds = GetTime() - start;
+
+    f32 *points = (f32 *)ArenaAlloc(&arena, sizeof(f32) * 2 * point_count);
+    for (int i = 0; i < point_count * 2; i += 2) {
+        seed = seed * 1664525u + 1013904223u;
+        points[i] = (seed >> 8) % (width * 16) / 16.0f;
+        seed = seed * 1664525u + 1013904223u;
+        points[i + 1] = (seed >> 8) % (height * 16) / 16.0f;
+    }
+
+    int hits = 0;
+    start = GetTime();
+    for (int i = 0; i < point_count * 2; i += 2) hits += HitTestUI(&ui, points[i], points[i + 1]) >= 0;
+    double grid_hit_seconds = GetTime() - start;
+
+    int mismatches = 0;
+    start = GetTime();
+    for (int i = 0; i < point_count * 2; i += 2) mismatches += HitTestUI(&ui, points[i], points[i + 1]) != HitTestUISlow(&ui, points[i], points[i + 1]);
+    double slow_hit_seconds = GetTime() - start - grid_hit_seconds;
+
+    // everything is dirty after creation, then an unchanged setter is free and two changes only
+    // upload the range between them
+    int first = 0, count = 0;
+    start = GetTime();
+    b32 full = RebuildDirtyUI(&ui, &first, &count);
+    double full_seconds = GetTime() - start;
+    Assert(full && first == 0 && count == widget_count && ui.rebuilt_widgets == widget_count);
+
+    SetUIText(&ui, 1, "button");
+    SetUIColor(&ui, 3, ui.widgets[3].color);
+    Assert(!RebuildDirtyUI(&ui, &first, &count));
+
+    v4 color = v4(0.5f, 0.25f, 1, 1);
+    SetUIColor(&ui, 10, color);
+    SetUIRect(&ui, 40, { 100, 100, 50, 20 });
+    start = GetTime();
+    RebuildDirtyUI(&ui, &first, &count);
+    double dirty_seconds = GetTime() - start;
+    Assert(first == 10 && count == 31 && ui.rebuilt_widgets == 2);
+    Assert(ui.vertices[10 * 4].color == PackColor(color));
+    Assert(ui.vertices[40 * 4 + 2].p == v2(150, 120));
+
+    // moving a button invalidates the grid, the hit test has to see it at its new place
+    Assert(ui.layout_dirty);
+    RebuildUIGrid(&ui, width, height);
+    Assert(HitTestUI(&ui, 125, 110) == HitTestUISlow(&ui, 125, 110));
+
+    fprintf(stdout, "UI: %d widgets\n", widget_count);
+    fprintf(stdout, "  grid:     %7.3f ms (%d entries)\n", grid_seconds * 1000, ui.grid_entry_count);
+    fprintf(stdout, "  hit test: %7.1f ns/point (%d of %d hit, every widget %.1f ns, %d mismatches)\n",
+            grid_hit_seconds * 1e9 / point_count, hits, point_count, slow_hit_seconds * 1e9 / point_count, mismatches);
+    fprintf(stdout, "  rebuild:  %7.3f ms all, %.3f ms for 2 changes\n", full_seconds * 1000, dirty_seconds * 1000);
+    Assert(mismatches == 0);
+
+    free(arena.base_address);
+}
@@ -0,0 +1,821 @@
+#include <new>
+#include <limits.h>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+
+/*
+    Streamed world files.
+
+    A world too big to keep in memory lives in one file, split into TILEMAP_CHUNK_SIZE square
+    chunks:
+
+        WorldFileHeader
+        WorldFileLayer   layer_count, what each tile layer is
+        payloads         one per chunk, in whatever order they were written
+        WorldChunkEntry  chunk_count, row major, at header.index_offset (aligned, it's read in place)
+
+    A chunk decodes to the chunk's heights (u8) followed by each layer's tiles (u16), row major,
+    WorldChunkBytes in total. Payloads are LZ4 blocks (the block format only, no frames). Mostly
+    empty sparse layers and repeated tiles compress to a few percent. A payload that wouldn't get
+    smaller is stored as is.
+
+    The file is memory mapped and never read whole. A chunk's page is only touched when it's
+    decoded, so the file's size doesn't matter. Decoding happens on a loader thread.
+
+    Decoded chunks live in a cache of fixed slots under a byte budget. The main thread owns the
+    cache: it looks chunks up, requests missing ones and evicts the least recently used. A
+    requested chunk gets its slot immediately and is marked loading. The loader decodes straight
+    into that slot and hands it back through a queue. Slots used this frame are pinned and never
+    evicted, so the budget has to cover what's in view. The stream, its slots and its hash live in
+    one block of their own, sized when it opens: the loader holds pointers into it, so it can't sit
+    in an arena that might grow and move.
+
+    Resident memory is the cache plus whatever the caller copies chunks into. It depends on the
+    view distance, not on the world.
+*/
+
+#define WORLD_FILE_MAGIC 0x444C5257 // "WRLD"
+#define WORLD_FILE_VERSION 2
+#define WORLD_MAX_LOADS 256 // requests in flight
+#define WORLD_CHUNK_STORED 0x1 // payload isn't compressed
+
+struct WorldFileHeader {
+    u32 magic;
+    u32 version;
+    u32 columns;
+    u32 rows;
+    u32 chunk_size;
+    u32 chunk_columns;
+    u32 chunk_rows;
+    u32 layer_count;
+    u32 max_height; // tallest column anywhere, so headroom can be sized before anything loads
+    u64 index_offset;
+};
+
+struct WorldFileLayer {
+    u32 sheet;
+    u32 sprite_layer;
+    f32 anchor_y;
+    u32 sparse;
+};
+
+struct WorldChunkEntry {
+    u64 offset;
+    u32 size;
+    u32 flags;
+};
+
+struct WorldLoad {
+    int chunk;
+    int slot;
+    b32 ok;
+};
+
+enum WorldSlotState {
+    WorldSlotEmpty,
+    WorldSlotLoading,
+    WorldSlotReady,
+};
+
+struct WorldCacheSlot {
+    int chunk; // -1 when empty
+    int state; // WorldSlotState
+    u32 used_frame; // pinned when it's the current frame
+    int prev; // towards the most recently used
+    int next;
+    u8 *data;
+};
+
+struct WorldStream {
+    Arena memory; // this struct and the cache, never grows
+    MappedFile file;
+    WorldFileHeader *header;
+    WorldFileLayer *layers;
+    WorldChunkEntry *index;
+    int chunk_count;
+    int chunk_bytes;
+
+    int slot_count;
+    WorldCacheSlot *slots;
+    int lru_first; // most recently used
+    int lru_last;
+    int hash_mask;
+    int *hash_slots; // open addressing on chunk, -1 empty
+    u32 frame;
+
+    std::thread thread;
+    std::mutex mutex;
+    std::condition_variable wake;
+    b32 quit;
+    WorldLoad requests[WORLD_MAX_LOADS];
+    u32 request_read;
+    u32 request_write;
+    WorldLoad completed[WORLD_MAX_LOADS];
+    u32 completed_read;
+    u32 completed_write;
+    int loading; // main thread's count of requests not yet completed
+    int resident; // ready slots
+
+    u64 loads; // totals, for the overlay
+    u64 evictions;
+    u64 failures;
+};
+
+int WorldChunkBytes(int layer_count) {
+    int tiles = TILEMAP_CHUNK_SIZE * TILEMAP_CHUNK_SIZE;
+    int result = tiles + layer_count * tiles * (int)sizeof(u16);
+    return result;
+}
+
+u8 *GetWorldChunkHeights(u8 *chunk) {
+    return chunk;
+}
+
+u16 *GetWorldChunkTiles(u8 *chunk, int layer) {
+    int tiles = TILEMAP_CHUNK_SIZE * TILEMAP_CHUNK_SIZE;
+    u16 *result = (u16 *)(chunk + tiles) + layer * tiles;
+    return result;
+}
+
+//
+// LZ4 block format
+//
+
+static u32 Read32(u8 *p) {
+    u32 result;
+    memcpy(&result, p, sizeof(result));
+    return result;
+}
+
+static u8 *WriteLz4Length(u8 *out, u8 *end, int length) {
+    for (; length >= 255; length -= 255) {
+        if (out == end) return 0;
+        *out++ = 255;
+    }
+    if (out == end) return 0;
+    *out++ = (u8)length;
+    return out;
+}
+
+static u8 *WriteLz4Sequence(u8 *out, u8 *end, u8 *literals, int literal_length, int offset, int match_length) {
+    if (out == end) return 0;
+    u8 *token = out++;
+    *token = (u8)((literal_length < 15 ? literal_length : 15) << 4);
+    if (literal_length >= 15 && !(out = WriteLz4Length(out, end, literal_length - 15))) return 0;
+
+    if (end - out < literal_length) return 0;
+    memcpy(out, literals, literal_length);
+    out += literal_length;
+
+    if (!match_length) return out; // the last sequence is literals only
+
+    if (end - out < 2) return 0;
+    *out++ = (u8)offset;
+    *out++ = (u8)(offset >> 8);
+
+    int length = match_length - 4;
+    *token |= (u8)(length < 15 ? length : 15);
+    if (length >= 15 && !(out = WriteLz4Length(out, end, length - 15))) return 0;
+    return out;
+}
+
+// Greedy, one hash probe per position. Returns the compressed size, 0 when it doesn't fit in
+// capacity.
+int CompressLz4(u8 *source, int size, u8 *dest, int capacity) {
+    int table[4096];
+    for (int i = 0; i < (int)ArrayCount(table); ++i) table[i] = -1;
+
+    u8 *out = dest;
+    u8 *end = dest + capacity;
+    int anchor = 0;
+    int match_limit = size - 12; // the format wants the last match to start 12 bytes before the end
+    int copy_limit = size - 5; // and the last 5 bytes to be literals
+
+    int i = 0;
+    while (i < match_limit) {
+        u32 sequence = Read32(source + i);
+        u32 hash = (sequence * 2654435761u) >> 20;
+        int candidate = table[hash];
+        table[hash] = i;
+
+        if (candidate < 0 || i - candidate > 0xFFFF || Read32(source + candidate) != sequence) {
+            ++i;
+            continue;
+        }
+
+        int match_length = 4;
+        while (i + match_length < copy_limit && source[candidate + match_length] == source[i + match_length]) ++match_length;
+
+        out = WriteLz4Sequence(out, end, source + anchor, i - anchor, i - candidate, match_length);
+        if (!out) return 0;
+
+        i += match_length;
+        anchor = i;
+    }
+
+    out = WriteLz4Sequence(out, end, source + anchor, size - anchor, 0, 0);
+    if (!out) return 0;
+    return (int)(out - dest);
+}
+
+// Adds a length's extra bytes. False when the input runs out or the length passes limit, which
+// it checks after every byte so the sum can't overflow.
+static b32 ReadLz4Length(u8 **in, u8 *in_end, size_t *length, size_t limit) {
+    u8 byte;
+    do {
+        if (*in == in_end) return false;
+        byte = *(*in)++;
+        *length += byte;
+        if (*length > limit) return false;
+    } while (byte == 255);
+    return true;
+}
+
+// Fails on anything that doesn't decode to exactly size bytes, payloads come from disk.
+b32 DecompressLz4(u8 *source, int source_size, u8 *dest, int size) {
+    u8 *in = source;
+    u8 *in_end = source + source_size;
+    u8 *out = dest;
+    u8 *out_end = dest + size;
+
+    while (in < in_end) {
+        int token = *in++;
+
+        // literals come from the input and go to the output
+        size_t literal_length = token >> 4;
+        size_t literal_limit = Min(in_end - in, out_end - out);
+        if (literal_length == 15 && !ReadLz4Length(&in, in_end, &literal_length, literal_limit)) return false;
+        if (literal_length > (size_t)(in_end - in) || literal_length > (size_t)(out_end - out)) return false;
+        memcpy(out, in, literal_length);
+        in += literal_length;
+        out += literal_length;
+
+        if (in == in_end) break;
+
+        if (in_end - in < 2) return false;
+        int offset = in[0] | (in[1] << 8);
+        in += 2;
+        if (!offset || offset > out - dest) return false;
+
+        size_t match_length = (token & 15) + 4;
+        if ((token & 15) == 15 && !ReadLz4Length(&in, in_end, &match_length, out_end - out)) return false;
+        if (match_length > (size_t)(out_end - out)) return false;
+
+        // the match can overlap what it writes, byte by byte repeats short runs
+        u8 *match = out - offset;
+        for (size_t i = 0; i < match_length; ++i) out[i] = match[i];
+        out += match_length;
+    }
+
+    return out == out_end;
+}
+
+//
+// Writing
+//
+
+struct WorldWriter {
+    FILE *file;
+    WorldFileHeader header;
+    WorldChunkEntry *index;
+    int chunk_bytes;
+    int max_height;
+    u8 *compressed;
+    int compressed_capacity;
+    u64 payload_bytes;
+};
+
+// The layers are taken from a tilemap with the same layers the world will be loaded into.
+b32 BeginWorldFile(WorldWriter *writer, const char *path, int columns, int rows, Tilemap *layout) {
+    *writer = {};
+    writer->file = fopen(path, "wb");
+    if (!writer->file) {
+        fprintf(stderr, "ERROR: can't write world %s\n", path);
+        return false;
+    }
+
+    WorldFileHeader *header = &writer->header;
+    header->magic = WORLD_FILE_MAGIC;
+    header->version = WORLD_FILE_VERSION;
+    header->columns = columns;
+    header->rows = rows;
+    header->chunk_size = TILEMAP_CHUNK_SIZE;
+    header->chunk_columns = (columns + TILEMAP_CHUNK_SIZE - 1) / TILEMAP_CHUNK_SIZE;
+    header->chunk_rows = (rows + TILEMAP_CHUNK_SIZE - 1) / TILEMAP_CHUNK_SIZE;
+    header->layer_count = layout->layer_count;
+
+    u64 chunk_count = (u64)header->chunk_columns * header->chunk_rows;
+    writer->index = (WorldChunkEntry *)calloc(chunk_count, sizeof(WorldChunkEntry));
+    writer->chunk_bytes = WorldChunkBytes(layout->layer_count);
+    writer->compressed_capacity = writer->chunk_bytes;
+    writer->compressed = (u8 *)malloc(writer->compressed_capacity);
+
+    fwrite(header, sizeof(*header), 1, writer->file); // again at the end, with the index offset
+    for (int i = 0; i < layout->layer_count; ++i) {
+        TilemapLayer *layer = layout->layers + i;
+        WorldFileLayer file_layer = { (u32)layer->sheet, (u32)layer->sprite_layer, layer->anchor_y, (u32)layer->sparse };
+        fwrite(&file_layer, sizeof(file_layer), 1, writer->file);
+    }
+
+    return true;
+}
+
+// chunk is row major over the world's chunks, data is WorldChunkBytes laid out as decoded.
+void WriteWorldChunk(WorldWriter *writer, int chunk, u8 *data) {
+    WorldChunkEntry *entry = writer->index + chunk;
+    entry->offset = (u64)ftell(writer->file);
+
+    u8 *heights = GetWorldChunkHeights(data);
+    for (int i = 0; i < TILEMAP_CHUNK_SIZE * TILEMAP_CHUNK_SIZE; ++i) writer->max_height = Max(writer->max_height, heights[i]);
+
+    int size = CompressLz4(data, writer->chunk_bytes, writer->compressed, writer->compressed_capacity);
+    if (size && size < writer->chunk_bytes) {
+        entry->size = size;
+        fwrite(writer->compressed, size, 1, writer->file);
+    } else {
+        entry->size = writer->chunk_bytes;
+        entry->flags = WORLD_CHUNK_STORED;
+        fwrite(data, writer->chunk_bytes, 1, writer->file);
+    }
+    writer->payload_bytes += entry->size;
+}
+
+b32 EndWorldFile(WorldWriter *writer) {
+    WorldFileHeader *header = &writer->header;
+    u64 chunk_count = (u64)header->chunk_columns * header->chunk_rows;
+
+    header->max_height = writer->max_height;
+    u64 payloads_end = (u64)ftell(writer->file);
+    header->index_offset = (payloads_end + alignof(WorldChunkEntry) - 1) & ~(u64)(alignof(WorldChunkEntry) - 1);
+    for (u64 i = payloads_end; i < header->index_offset; ++i) fputc(0, writer->file);
+    fwrite(writer->index, sizeof(WorldChunkEntry), chunk_count, writer->file);
+    fseek(writer->file, 0, SEEK_SET);
+    fwrite(header, sizeof(*header), 1, writer->file);
+    b32 result = !ferror(writer->file);
+    fclose(writer->file);
+
+    fprintf(stdout, "INFO: wrote world %u x %u, %llu chunks, %.1f MB of payloads (%.1f%% of decoded)\n", header->columns, header->rows,
+            (unsigned long long)chunk_count, writer->payload_bytes / (1024.0 * 1024.0), 100.0 * writer->payload_bytes / ((double)chunk_count * writer->chunk_bytes));
+
+    free(writer->index);
+    free(writer->compressed);
+    *writer = {};
+    return result;
+}
+
+//
+// Streaming
+//
+
+static b32 DecodeWorldChunk(WorldStream *stream, int chunk, u8 *dest) {
+    WorldChunkEntry *entry = stream->index + chunk;
+    if (entry->offset > stream->file.size || entry->size > stream->file.size - entry->offset) return false;
+
+    u8 *payload = (u8 *)stream->file.data + entry->offset;
+    if (entry->flags & WORLD_CHUNK_STORED) {
+        if (entry->size != (u32)stream->chunk_bytes) return false;
+        memcpy(dest, payload, stream->chunk_bytes);
+        return true;
+    }
+    return DecompressLz4(payload, entry->size, dest, stream->chunk_bytes);
+}
+
+// Only touches the file and the slot it's handed, the main thread doesn't look at a loading slot.
+static void WorldLoaderThread(WorldStream *stream) {
+    for (;;) {
+        WorldLoad load;
+        {
+            std::unique_lock<std::mutex> lock(stream->mutex);
+            stream->wake.wait(lock, [stream] { return stream->quit || stream->request_read != stream->request_write; });
+            if (stream->quit) return;
+            load = stream->requests[stream->request_read++ % WORLD_MAX_LOADS];
+        }
+
+        load.ok = DecodeWorldChunk(stream, load.chunk, stream->slots[load.slot].data);
+
+        std::lock_guard<std::mutex> lock(stream->mutex);
+        stream->completed[stream->completed_write++ % WORLD_MAX_LOADS] = load;
+    }
+}
+
+// Whether the world's layers are the tilemap's, in the same order.
+b32 IsWorldLayout(WorldFileHeader *header, Tilemap *map) {
+    if (header->layer_count != (u32)map->layer_count) return false;
+
+    WorldFileLayer *layers = (WorldFileLayer *)(header + 1);
+    for (int i = 0; i < map->layer_count; ++i) {
+        TilemapLayer *layer = map->layers + i;
+        WorldFileLayer *file_layer = layers + i;
+        if (file_layer->sheet != (u32)layer->sheet || file_layer->sprite_layer != (u32)layer->sprite_layer || file_layer->sparse != (u32)layer->sparse) return false;
+    }
+    return true;
+}
+
+// Maps the world and starts its loader, null when the file isn't a world or its layers aren't
+// layout's. cache_bytes decides how many decoded chunks stay resident.
+WorldStream *OpenWorldStream(const char *path, u64 cache_bytes, Tilemap *layout) {
+    MappedFile file;
+    if (!MapFile(path, &file)) return 0;
+
+    // every size is bounded on its own against what's left of the file, the header can't be
+    // trusted to keep sums and products from wrapping
+    WorldFileHeader *header = (WorldFileHeader *)file.data;
+    b32 valid = file.size >= sizeof(*header) && header->magic == WORLD_FILE_MAGIC && header->version == WORLD_FILE_VERSION &&
+                header->chunk_size == TILEMAP_CHUNK_SIZE && header->layer_count <= TILEMAP_MAX_LAYERS &&
+                header->chunk_columns == ((u64)header->columns + TILEMAP_CHUNK_SIZE - 1) / TILEMAP_CHUNK_SIZE &&
+                header->chunk_rows == ((u64)header->rows + TILEMAP_CHUNK_SIZE - 1) / TILEMAP_CHUNK_SIZE;
+    u64 chunk_count = valid ? (u64)header->chunk_columns * header->chunk_rows : 0;
+    valid = valid && chunk_count <= INT_MAX && header->layer_count * sizeof(WorldFileLayer) <= file.size - sizeof(*header) &&
+            header->index_offset % alignof(WorldChunkEntry) == 0 && header->index_offset <= file.size && chunk_count * sizeof(WorldChunkEntry) <= file.size - header->index_offset;
+    if (!valid) {
+        fprintf(stderr, "ERROR: %s isn't a world file\n", path);
+        UnmapFile(&file);
+        return 0;
+    }
+    if (!IsWorldLayout(header, layout)) {
+        fprintf(stderr, "INFO: %s has other layers\n", path);
+        UnmapFile(&file);
+        return 0;
+    }
+
+    int chunk_bytes = WorldChunkBytes(header->layer_count);
+    int slot_count = Max((int)(cache_bytes / chunk_bytes), 1);
+    int hash_size = 1;
+    while (hash_size < slot_count * 2) hash_size *= 2;
+
+    u64 memory_size = sizeof(WorldStream) + sizeof(WorldCacheSlot) * slot_count + (u64)chunk_bytes * slot_count + sizeof(int) * hash_size;
+    Arena memory = CreateArena(memory_size);
+    WorldStream *stream = new (ArenaAlloc(&memory, sizeof(WorldStream))) WorldStream();
+    Arena *arena = &stream->memory;
+    *arena = memory;
+    stream->file = file;
+    stream->header = header;
+    stream->layers = (WorldFileLayer *)(header + 1);
+    stream->index = (WorldChunkEntry *)((u8 *)file.data + header->index_offset);
+    stream->chunk_count = (int)chunk_count;
+    stream->chunk_bytes = chunk_bytes;
+
+    stream->slot_count = slot_count;
+    stream->slots = (WorldCacheSlot *)ArenaAlloc(arena, sizeof(WorldCacheSlot) * stream->slot_count);
+    u8 *slot_memory = (u8 *)ArenaAlloc(arena, (u64)stream->chunk_bytes * stream->slot_count);
+    for (int i = 0; i < stream->slot_count; ++i) {
+        WorldCacheSlot *slot = stream->slots + i;
+        slot->chunk = -1;
+        slot->data = slot_memory + (u64)i * stream->chunk_bytes;
+        slot->prev = i - 1;
+        slot->next = i + 1 < stream->slot_count ? i + 1 : -1;
+    }
+    stream->lru_first = 0;
+    stream->lru_last = stream->slot_count - 1;
+
+    stream->hash_mask = hash_size - 1;
+    stream->hash_slots = (int *)ArenaAlloc(arena, sizeof(int) * hash_size);
+    for (int i = 0; i < hash_size; ++i) stream->hash_slots[i] = -1;
+    Assert(arena->count == arena->size);
+
+    stream->thread = std::thread(WorldLoaderThread, stream);
+
+    fprintf(stdout, "INFO: world %s, %u x %u tiles, %d chunk cache slots (%.1f MB)\n", path, header->columns, header->rows, stream->slot_count,
+            (double)stream->slot_count * stream->chunk_bytes / (1024 * 1024));
+    return stream;
+}
+
+void CloseWorldStream(WorldStream *stream) {
+    {
+        std::lock_guard<std::mutex> lock(stream->mutex);
+        stream->quit = true;
+    }
+    stream->wake.notify_one();
+    stream->thread.join();
+
+    UnmapFile(&stream->file);
+    void *memory = stream->memory.base_address;
+    stream->~WorldStream();
+    free(memory);
+}
+
+static u32 HashWorldChunk(int chunk) {
+    u32 result = (u32)chunk * 2654435761u;
+    return result ^ (result >> 16);
+}
+
+static int FindWorldSlot(WorldStream *stream, int chunk) {
+    for (u32 i = HashWorldChunk(chunk) & stream->hash_mask;; i = (i + 1) & stream->hash_mask) {
+        int slot = stream->hash_slots[i];
+        if (slot < 0) return -1;
+        if (stream->slots[slot].chunk == chunk) return slot;
+    }
+}
+
+static void InsertWorldSlot(WorldStream *stream, int slot) {
+    u32 i = HashWorldChunk(stream->slots[slot].chunk) & stream->hash_mask;
+    while (stream->hash_slots[i] >= 0) i = (i + 1) & stream->hash_mask;
+    stream->hash_slots[i] = slot;
+}
+
+// Backward shift deletion, the probe runs stay unbroken without tombstones.
+static void RemoveWorldSlot(WorldStream *stream, int slot) {
+    u32 i = HashWorldChunk(stream->slots[slot].chunk) & stream->hash_mask;
+    while (stream->hash_slots[i] != slot) i = (i + 1) & stream->hash_mask;
+
+    for (u32 j = (i + 1) & stream->hash_mask;; j = (j + 1) & stream->hash_mask) {
+        int other = stream->hash_slots[j];
+        if (other < 0) break;
+
+        // an entry can move back to i when its home isn't cyclically between i and j
+        u32 home = HashWorldChunk(stream->slots[other].chunk) & stream->hash_mask;
+        b32 stays = i <= j ? (i < home && home <= j) : (i < home || home <= j);
+        if (stays) continue;
+
+        stream->hash_slots[i] = other;
+        i = j;
+    }
+    stream->hash_slots[i] = -1;
+}
+
+static void UnlinkWorldSlot(WorldStream *stream, int slot) {
+    WorldCacheSlot *s = stream->slots + slot;
+    if (s->prev >= 0) stream->slots[s->prev].next = s->next;
+    else stream->lru_first = s->next;
+    if (s->next >= 0) stream->slots[s->next].prev = s->prev;
+    else stream->lru_last = s->prev;
+}
+
+// Most recently used, and pinned for this frame.
+static void TouchWorldSlot(WorldStream *stream, int slot) {
+    WorldCacheSlot *s = stream->slots + slot;
+    s->used_frame = stream->frame;
+    if (stream->lru_first == slot) return;
+
+    UnlinkWorldSlot(stream, slot);
+    s->prev = -1;
+    s->next = stream->lru_first;
+    stream->slots[stream->lru_first].prev = slot;
+    stream->lru_first = slot;
+}
+
+// The least recently used slot that isn't loading or pinned, -1 when the budget is all in use.
+static int EvictWorldSlot(WorldStream *stream) {
+    for (int slot = stream->lru_last; slot >= 0; slot = stream->slots[slot].prev) {
+        WorldCacheSlot *s = stream->slots + slot;
+        if (s->state == WorldSlotLoading) continue;
+        if (s->chunk >= 0 && s->used_frame == stream->frame) return -1; // everything after is newer
+
+        if (s->chunk >= 0) {
+            RemoveWorldSlot(stream, slot);
+            --stream->resident;
+            ++stream->evictions;
+        }
+        s->chunk = -1;
+        s->state = WorldSlotEmpty;
+        return slot;
+    }
+    return -1;
+}
+
+// Main thread, once a frame before the lookups: takes finished loads and unpins last frame's
+// chunks. Returns how many loads finished.
+int UpdateWorldStream(WorldStream *stream) {
+    ++stream->frame;
+
+    int count = 0;
+    std::lock_guard<std::mutex> lock(stream->mutex);
+    while (stream->completed_read != stream->completed_write) {
+        WorldLoad load = stream->completed[stream->completed_read++ % WORLD_MAX_LOADS];
+        WorldCacheSlot *slot = stream->slots + load.slot;
+        --stream->loading;
+
+        if (load.ok) {
+            slot->state = WorldSlotReady;
+            ++stream->resident;
+            ++stream->loads;
+        } else {
+            RemoveWorldSlot(stream, load.slot);
+            slot->chunk = -1;
+            slot->state = WorldSlotEmpty;
+            ++stream->failures;
+        }
+
+        ++count;
+    }
+    return count;
+}
+
+// A decoded chunk, null when it isn't resident yet. Pins it for the frame.
+u8 *GetWorldChunk(WorldStream *stream, int chunk) {
+    int slot = FindWorldSlot(stream, chunk);
+    if (slot < 0) return 0;
+
+    TouchWorldSlot(stream, slot);
+    u8 *result = stream->slots[slot].state == WorldSlotReady ? stream->slots[slot].data : 0;
+    return result;
+}
+
+// Queues a chunk that isn't resident or loading. False when the queue is full or every slot is
+// pinned, ask again next frame.
+b32 RequestWorldChunk(WorldStream *stream, int chunk) {
+    if (chunk < 0 || chunk >= stream->chunk_count) return false;
+
+    int slot = FindWorldSlot(stream, chunk);
+    if (slot >= 0) {
+        TouchWorldSlot(stream, slot);
+        return true;
+    }
+
+    if (stream->loading == WORLD_MAX_LOADS) return false;
+    slot = EvictWorldSlot(stream);
+    if (slot < 0) return false;
+
+    WorldCacheSlot *s = stream->slots + slot;
+    s->chunk = chunk;
+    s->state = WorldSlotLoading;
+    InsertWorldSlot(stream, slot);
+    TouchWorldSlot(stream, slot);
+    ++stream->loading;
+
+    {
+        std::lock_guard<std::mutex> lock(stream->mutex);
+        stream->requests[stream->request_write++ % WORLD_MAX_LOADS] = { chunk, slot, false };
+    }
+    stream->wake.notify_one();
+    return true;
+}
+
+//
+// Benchmark
+//
+
+// Runs of tiles with a sprinkling of noise, or noise only, which LZ4 can't shrink and gets stored.
+static void FillBenchmarkChunk(u8 *data, int layer_count, int chunk) {
+    int tiles = TILEMAP_CHUNK_SIZE * TILEMAP_CHUNK_SIZE;
+    u32 seed = chunk * 7919 + 1;
+    for (int i = 0; i < WorldChunkBytes(layer_count); ++i) {
+        seed = seed * 1664525u + 1013904223u;
+        data[i] = (u8)(seed >> 24);
+    }
+    if (chunk % 5 == 3) return;
+
+    u8 *heights = GetWorldChunkHeights(data);
+    for (int i = 0; i < tiles; ++i) heights[i] = (u8)((i / TILEMAP_CHUNK_SIZE + chunk) / 4 % 3);
+    for (int layer = 0; layer < layer_count; ++layer) {
+        u16 *layer_tiles = GetWorldChunkTiles(data, layer);
+        for (int i = 0; i < tiles; ++i) {
+            seed = seed * 1664525u + 1013904223u;
+            layer_tiles[i] = layer == 0 ? MakeTile(0, chunk % 4) : (seed >> 24) < 16 ? MakeTile(0, (seed >> 16) % 8 + 1) : 0;
+        }
+    }
+}
+
+static b32 WriteBenchmarkFile(const char *path, u8 *data, u64 size) {
+    FILE *file = fopen(path, "wb");
+    if (!file) return false;
+    b32 result = fwrite(data, 1, size, file) == size;
+    fclose(file);
+    return result;
+}
+
+// Requests every chunk and waits for the loader, how many loaded.
+static int StreamWholeWorld(WorldStream *stream) {
+    for (int chunk = 0; chunk < stream->chunk_count || stream->loading;) {
+        if (chunk < stream->chunk_count && RequestWorldChunk(stream, chunk)) {
+            ++chunk;
+            continue;
+        }
+        UpdateWorldStream(stream); // the queue is full, or waiting on the last loads
+        std::this_thread::yield();
+    }
+    return (int)stream->loads;
+}
+
+// CPU side only: LZ4 round trips of odd sized and mangled blocks, then a small world written,
+// streamed back and compared, then broken copies of it that must be turned away or fail to decode.
+void BenchmarkWorld() {
+    const char *path = "benchmark.world";
+    const char *broken_path = "benchmark_broken.world";
+    const int columns = 1000; // not a whole number of chunks
+    const int rows = 700;
+
+    Arena arena = CreateArena(Megabytes(64));
+    Tilemap layout = CreateTilemap(&arena, TILEMAP_CHUNK_SIZE, TILEMAP_CHUNK_SIZE, 256, 192);
+    AddTilemapLayer(&layout, &arena, 0, SpriteLayerGround, 64, false, 0);
+    AddTilemapLayer(&layout, &arena, 0, SpriteLayerObject, 470, true, 64);
+    int chunk_bytes = WorldChunkBytes(layout.layer_count);
+
+    // LZ4: sizes around the format's 12 and 5 byte tails and its 15 and 255 length steps
+    u8 *source = (u8 *)ArenaAlloc(&arena, chunk_bytes);
+    u8 *compressed = (u8 *)ArenaAlloc(&arena, chunk_bytes * 2);
+    u8 *decoded = (u8 *)ArenaAlloc(&arena, chunk_bytes);
+    int round_trips = 0, stored = 0, mangled_ok = 0;
+    int sizes[] = { 0, 1, 4, 5, 12, 13, 16, 19, 20, 270, 271, 1000, chunk_bytes - 1, chunk_bytes };
+    for (int i = 0; i < (int)ArrayCount(sizes) * 4; ++i) {
+        int size = sizes[i / 4];
+        u32 seed = i + 1;
+        for (int j = 0; j < size; ++j) {
+            seed = seed * 1664525u + 1013904223u;
+            // noise, long runs, short repeats and a mix
+            source[j] = i % 4 == 0 ? (u8)(seed >> 24) : i % 4 == 1 ? (u8)(j / 300) : i % 4 == 2 ? (u8)(j % 3) : (u8)((seed >> 24) < 32 ? seed >> 16 : j / 7);
+        }
+
+        int compressed_size = CompressLz4(source, size, compressed, chunk_bytes * 2);
+        if (!compressed_size || compressed_size >= size) ++stored;
+        if (!compressed_size) continue;
+
+        Assert(DecompressLz4(compressed, compressed_size, decoded, size) && memcmp(source, decoded, size) == 0);
+        ++round_trips;
+
+        // too short, too long, cut off or flipped: a clean failure, or at worst wrong bytes
+        if (size) Assert(!DecompressLz4(compressed, compressed_size, decoded, size - 1));
+        Assert(!DecompressLz4(compressed, compressed_size, decoded, size + 1));
+        if (compressed_size > 1) Assert(!DecompressLz4(compressed, compressed_size - 1, decoded, size));
+        for (int j = 0; j < compressed_size; j += Max(compressed_size / 16, 1)) {
+            compressed[j] ^= 0x5A;
+            mangled_ok += DecompressLz4(compressed, compressed_size, decoded, size);
+            compressed[j] ^= 0x5A;
+        }
+    }
+
+    // the world, written a chunk at a time
+    u8 *chunk_data = (u8 *)ArenaAlloc(&arena, chunk_bytes);
+    WorldWriter writer;
+    Assert(BeginWorldFile(&writer, path, columns, rows, &layout));
+    int chunk_count = (int)(writer.header.chunk_columns * writer.header.chunk_rows);
+    double start = GetTime();
+    for (int chunk = 0; chunk < chunk_count; ++chunk) {
+        FillBenchmarkChunk(chunk_data, layout.layer_count, chunk);
+        WriteWorldChunk(&writer, chunk, chunk_data);
+    }
+    Assert(EndWorldFile(&writer));
+    double write_seconds = GetTime() - start;
+
+    start = GetTime();
+    WorldStream *stream = OpenWorldStream(path, (u64)chunk_count * chunk_bytes, &layout);
+    Assert(stream && stream->chunk_count == chunk_count);
+    Assert(StreamWholeWorld(stream) == chunk_count && stream->failures == 0);
+    double stream_seconds = GetTime() - start;
+
+    int wrong = 0;
+    for (int chunk = 0; chunk < chunk_count; ++chunk) {
+        u8 *data = GetWorldChunk(stream, chunk);
+        FillBenchmarkChunk(chunk_data, layout.layer_count, chunk);
+        wrong += !data || memcmp(data, chunk_data, chunk_bytes) != 0;
+    }
+    Assert(wrong == 0);
+    Assert(!RequestWorldChunk(stream, -1) && !RequestWorldChunk(stream, chunk_count));
+
+    // a copy of the file to break
+    u64 file_size = stream->file.size;
+    u8 *file = (u8 *)ArenaAllocAligned(&arena, file_size, alignof(WorldChunkEntry));
+    memcpy(file, stream->file.data, file_size);
+    WorldFileHeader header = *stream->header;
+    CloseWorldStream(stream);
+
+    // headers and sizes that have to be turned away before anything is read through them
+    int rejected = 0, broken_count = 0;
+    for (int i = 0; i < 9; ++i) {
+        u64 size = file_size;
+        WorldFileHeader *broken = (WorldFileHeader *)file;
+        *broken = header;
+        if (i == 0) size = sizeof(WorldFileHeader) - 1;
+        if (i == 1) size = header.index_offset + chunk_count * sizeof(WorldChunkEntry) - 1; // cut into the index
+        if (i == 2) broken->magic ^= 1;
+        if (i == 3) broken->chunk_columns += 1;
+        if (i == 4) broken->rows = 0;
+        if (i == 5) broken->index_offset = ~0ull - 15; // wraps when the index size is added
+        if (i == 6) broken->layer_count = 0xFFFFFFFF;
+        if (i == 7) broken->columns = broken->rows = 0xFFFFFFF0, broken->chunk_columns = broken->chunk_rows = 0x0FFFFFFF; // a count past an int
+        if (i == 8) broken->chunk_size = TILEMAP_CHUNK_SIZE / 2;
+        Assert(WriteBenchmarkFile(broken_path, file, size));
+        WorldStream *opened = OpenWorldStream(broken_path, chunk_bytes, &layout);
+        rejected += !opened;
+        if (opened) CloseWorldStream(opened);
+        ++broken_count;
+    }
+    *(WorldFileHeader *)file = header;
+
+    // an index that points anywhere opens, the chunks it breaks fail to load and nothing else
+    WorldChunkEntry *index = (WorldChunkEntry *)(file + header.index_offset);
+    index[0].offset = ~0ull - 4; // wraps when the size is added
+    index[1].offset = file_size - 8;
+    index[2].size -= 1; // cut off
+    index[3].flags ^= WORLD_CHUNK_STORED; // stored read as compressed
+    Assert(WriteBenchmarkFile(broken_path, file, file_size));
+    stream = OpenWorldStream(broken_path, (u64)chunk_count * chunk_bytes, &layout);
+    Assert(stream);
+    int loaded = StreamWholeWorld(stream);
+    Assert(loaded == chunk_count - 4 && stream->failures == 4);
+    CloseWorldStream(stream);
+
+    remove(path);
+    remove(broken_path);
+
+    fprintf(stdout, "World: %d x %d tiles, %d chunks, %.1f KB a chunk decoded, %.1f KB on disk\n", columns, rows, chunk_count, chunk_bytes / 1024.0,
+            file_size / 1024.0);
+    fprintf(stdout, "  write:  %7.3f ms\n", write_seconds * 1000);
+    fprintf(stdout, "  stream: %7.3f ms (%.0f MB/s decoded)\n", stream_seconds * 1000, (double)chunk_count * chunk_bytes / (stream_seconds * 1024 * 1024));
+    fprintf(stdout, "  lz4:    %d round trips, %d stored, %d mangled blocks decoded to some bytes\n", round_trips, stored, mangled_ok);
+    fprintf(stdout, "  broken: %d of %d headers rejected, %d of %d chunks failed\n", rejected, broken_count, (int)(chunk_count - loaded), chunk_count);
+    Assert(rejected == broken_count);
+
+    free(arena.base_address);
+}